@@ -9,23 +9,115 @@
 #include "src/include/Nunchuck.h"
 #include "src/include/IMU_Sensor.h"
 #include "src/include/BLE.h"
+#include "src/include/Motion_Rate_Controller.h"
+#include "src/include/Time_Sync.h"
+#include "src/include/Flight_Recorder.h"
+#include "src/include/Gesture_Detector.h"
+#include "src/include/Gesture_Reporter.h"
+#include "src/include/Power_Governor.h"
+#include "src/include/Power_Manager.h"
+
+/** Maximum time the loop waits for a subscriber before polling again, in ms. */
+#define BLE_SUBSCRIBER_WAIT_MS 1000U
 
 // Initialize the BLE class
 static BLE ble("Wii Remote");
 // Initialize Wii Remote and Nunchuck IMUs
-static IMU_Sensor wiiRemoteImu(0x68, WIIMOTE_ACCELOROMETER_RANGE, MPU6500_NAME);
-static IMU_Sensor nunchuckImu(0x69, NUNCHUCK_ACCELOROMETER_RANGE, MPU9250_NAME);
+#if IMU_STATIC_DISPATCH
+static WiiRemote_IMU_t wiiRemoteImu(0x68);
+static Nunchuck_IMU_t nunchuckImu(0x69);
+#else
+static WiiRemote_IMU_t wiiRemoteImu(0x68, WIIMOTE_ACCELOROMETER_RANGE,
+                                    IMU_Traits<WIIMOTE_IMU_TYPE>::name);
+static Nunchuck_IMU_t nunchuckImu(0x69, NUNCHUCK_ACCELOROMETER_RANGE,
+                                  IMU_Traits<NUNCHUCK_IMU_TYPE>::name);
+#endif
+// Initialize the motion-adaptive rate controllers
+static const Rate_Controller_Config_t rateControllerConfig = RATE_CONTROLLER_DEFAULT_CONFIG;
+static MotionRateController wiiRemoteRateController(rateControllerConfig);
+static MotionRateController nunchuckRateController(rateControllerConfig);
+#if GESTURE_EVENTS_ENABLED
+// Initialize the gesture detectors (controller 0 is the Wii Remote, 1 the
+// Nunchuck) and the reporter they share
+static const Gesture_Detector_Config_t gestureDetectorConfig = GESTURE_DETECTOR_DEFAULT_CONFIG;
+static GestureDetector wiiRemoteGestureDetector(gestureDetectorConfig, 0U);
+static GestureDetector nunchuckGestureDetector(gestureDetectorConfig, 1U);
+static GestureReporter gestureReporter(&ble);
+// Initialize the Wii Remote and the Nunchuck
+static WiiRemote wiiRemote(&ble, &wiiRemoteImu, &wiiRemoteRateController,
+                           &wiiRemoteGestureDetector, &gestureReporter);
+static Nunchuck nunchuck(&ble, &nunchuckImu, &nunchuckRateController,
+                         &nunchuckGestureDetector, &gestureReporter);
+#else
 // Initialize the Wii Remote and the Nunchuck
-static WiiRemote wiiRemote(&ble, &wiiRemoteImu);
-static Nunchuck nunchuck(&ble, &nunchuckImu);
+static WiiRemote wiiRemote(&ble, &wiiRemoteImu, &wiiRemoteRateController);
+static Nunchuck nunchuck(&ble, &nunchuckImu, &nunchuckRateController);
+#endif
+// Initialize the device-to-host clock synchronization
+static TimeSync timeSync(&ble);
+#if POWER_GOVERNOR_ENABLED
+// Initialize the CPU frequency governor and the PM glue applying it
+static const Power_Governor_Config_t powerGovernorConfig = POWER_GOVERNOR_DEFAULT_CONFIG;
+static PowerGovernor powerGovernor(powerGovernorConfig);
+static PowerManager powerManager;
+
+/**
+ * @brief Applies the governor's frequency level if it changed.
+ */
+static void applyPowerLevel(bool changed)
+{
+  if (!changed) {
+    return;
+  }
+#if FLIGHT_RECORDER_ENABLED
+  const uint32_t previousMhz = powerManager.getFrequencyMhz();
+#endif
+  status_t status = powerManager.setFrequencyMhz(powerGovernor.getFrequencyMhz());
+#if FLIGHT_RECORDER_ENABLED
+  if ((status == STATUS_COMPLETE) && (powerManager.getFrequencyMhz() != previousMhz)) {
+    flightRecorder.recordCpuFrequency(previousMhz, powerManager.getFrequencyMhz());
+  }
+#endif
+#if SERIAL_OUTPUT_LOGGING
+  if (status != STATUS_COMPLETE) {
+    Serial.print("CPU frequency could not be changed. Status code: ");
+    Serial.println(status);
+  }
+#else
+  (void)status;
+#endif
+}
+#endif
 
 void setup()
 {
 #if SERIAL_OUTPUT_LOGGING
   Serial.begin(115200);
+#endif
+  status_t status;
+#if POWER_GOVERNOR_ENABLED
+  // Set the clock before the BLE controller starts
+  status = powerManager.initPowerManager(powerGovernor.getFrequencyMhz());
+  if (status != STATUS_COMPLETE) {
+    #if SERIAL_OUTPUT_LOGGING
+    Serial.print("Power manager could not be initialized. Status code: ");
+    Serial.println(status);
+    #endif
+    while (1);
+  }
 #endif
   ble.initBle();
-  status_t status = wiiRemote.initController();
+#if FLIGHT_RECORDER_ENABLED
+  status = flightRecorder.initFlightRecorder(&ble);
+  if (status != STATUS_COMPLETE) {
+    #if SERIAL_OUTPUT_LOGGING
+    Serial.print("Flight recorder could not be initialized. Status code: ");
+    Serial.println(status);
+    #endif
+    while (1);
+  }
+#endif
+  status = wiiRemote.initController();
   if (status != STATUS_COMPLETE) {
     #if SERIAL_OUTPUT_LOGGING
     Serial.print("Wii Remote could not be initialized. Status code: ");
@@ -41,6 +133,34 @@ void setup()
     #endif
     while (1);
   }
+#if GESTURE_EVENTS_ENABLED
+  status = gestureReporter.initGestureReporter();
+  if (status != STATUS_COMPLETE) {
+    #if SERIAL_OUTPUT_LOGGING
+    Serial.print("Gesture reporter could not be initialized. Status code: ");
+    Serial.println(status);
+    #endif
+    while (1);
+  }
+#endif
+  status = timeSync.initTimeSync();
+  if (status != STATUS_COMPLETE) {
+    #if SERIAL_OUTPUT_LOGGING
+    Serial.print("Time sync could not be initialized. Status code: ");
+    Serial.println(status);
+    #endif
+    while (1);
+  }
+#if BLE_HID_GAMEPAD_MODE
+  status = ble.initHidGamepad();
+  if (status != STATUS_COMPLETE) {
+    #if SERIAL_OUTPUT_LOGGING
+    Serial.print("HID gamepad could not be initialized. Status code: ");
+    Serial.println(status);
+    #endif
+    while (1);
+  }
+#endif
   status = ble.startAdvertising();
   if (status != STATUS_COMPLETE) {
     #if SERIAL_OUTPUT_LOGGING
@@ -53,14 +173,76 @@ void setup()
 
 void loop()
 {
+  if (!ble.isSubscribed()) {
+#if POWER_GOVERNOR_ENABLED
+    // No sampling deadline to meet while nobody is listening
+    applyPowerLevel(powerGovernor.idle(millis()));
+#endif
+    // Nobody is listening, so don't sample the IMUs or the ADC. This
+    // returns as soon as a central subscribes.
+    ble.waitForSubscriber(BLE_SUBSCRIBER_WAIT_MS);
+    return;
+  }
+  if (ble.consumePrimeRequest()) {
+    // A central just subscribed, send the latest state right away
+    uint32_t nowMs = millis();
+#if POWER_GOVERNOR_ENABLED
+    // Start sampling at full speed and let the governor step down
+    applyPowerLevel(powerGovernor.boost(nowMs));
+#endif
+    wiiRemoteRateController.wake(nowMs);
+    wiiRemoteRateController.forceReport();
+    nunchuckRateController.wake(nowMs);
+    nunchuckRateController.forceReport();
+  }
+#if FLIGHT_RECORDER_ENABLED || POWER_GOVERNOR_ENABLED
+  uint32_t loopStartUs = micros();
+#endif
   // Update Wii Remote button inputs
   wiiRemote.updateButtonInputs();
+#if POWER_GOVERNOR_ENABLED
+  uint32_t sampleStartUs = micros();
+#endif
   // Update Wii Remote sensor inputs
   wiiRemote.updateSensorInputs();
+#if POWER_GOVERNOR_ENABLED
+  uint32_t wiiRemoteSampleUs = micros() - sampleStartUs;
+#endif
   // Update Nunchuck Button Inputs
   nunchuck.updateButtonInputs();
+#if POWER_GOVERNOR_ENABLED
+  sampleStartUs = micros();
+#endif
   // Update Nunchuck Sensor Inputs
   nunchuck.updateSensorInputs();
+#if POWER_GOVERNOR_ENABLED
+  uint32_t nunchuckSampleUs = micros() - sampleStartUs;
+#endif
+#if BLE_HID_GAMEPAD_MODE
+  // Send the combined gamepad report straight to the host OS
+  ble.notifyHidReport();
+#endif
+  // Send the reports the link had no room for, now holding the newest values
+  ble.flushPendingNotifications();
+#if FLIGHT_RECORDER_ENABLED
+  uint32_t loopUs = micros() - loopStartUs;
+#endif
+#if POWER_GOVERNOR_ENABLED
+  // A sample could have waited for everything in the pass but its own
+  // work, and a controller that wasn't sampled (taking next to no time)
+  // for all of it. The deadline is the shortest sampling period.
+  uint32_t busyUs = micros() - loopStartUs;
+  uint32_t waitUs = busyUs - min(wiiRemoteSampleUs, nunchuckSampleUs);
+  uint32_t deadlineMs = min(wiiRemoteRateController.getSamplePeriodMs(),
+                            nunchuckRateController.getSamplePeriodMs());
+  applyPowerLevel(powerGovernor.update(busyUs, waitUs, deadlineMs * 1000U, millis()));
+#endif
+#if FLIGHT_RECORDER_ENABLED
+  if (loopUs > FLIGHT_RECORDER_LOOP_OVERRUN_US) {
+    uint32_t loopMs = loopUs / 1000U;
+    FLIGHT_RECORD(FLIGHT_EVENT_LOOP_OVERRUN, 0U, (uint16_t)((loopMs > 0xFFFFU) ? 0xFFFFU : loopMs));
+  }
+#endif
 #if DEBUG
   // wiiRemote.printIMUdata();
   // nunchuck.printIMUdata();
@@ -5,20 +5,36 @@
  */
 
 #include "Arduino.h"
+#include <esp_gap_ble_api.h>
 #include "include/BLE.h"
-
-// Indicates whether there is a device that is currently paired
-// with the ESP32 device
-static bool deviceConnected = false;
+#include "include/Flight_Recorder.h"
 
 class MyServerCallbacks : public BLEServerCallbacks {
+public:
+    MyServerCallbacks(BLE* pBle) : pBle(pBle) {};
+
     void onConnect(BLEServer* pServer) {
-      deviceConnected = true;
+      pBle->handleConnect();
     };
 
     void onDisconnect(BLEServer* pServer) {
-      deviceConnected = false;
+      pBle->handleDisconnect();
     }
+
+private:
+    BLE* pBle;
+};
+
+class MyCccdCallbacks : public BLEDescriptorCallbacks {
+public:
+    MyCccdCallbacks(BLE* pBle) : pBle(pBle) {};
+
+    void onWrite(BLEDescriptor* pDescriptor) {
+      pBle->handleSubscriptionChange();
+    }
+
+private:
+    BLE* pBle;
 };
 
 void BLE::initBle()
@@ -28,10 +44,12 @@ void BLE::initBle()
 
     // Create the BLE Server
     pServer = BLEDevice::createServer();
-    pServer->setCallbacks(new MyServerCallbacks());
+    pServer->setCallbacks(new MyServerCallbacks(this));
+    subscribeSemaphore = xSemaphoreCreateBinary();
 
-    // Create the BLE Service
-    pService = pServer->createService(SERVICE_UUID);
+    // Create the BLE Service. The default of 15 handles only fits four
+    // notifying characteristics.
+    pService = pServer->createService(BLEUUID(SERVICE_UUID), BLE_SERVICE_HANDLE_COUNT);
 
 #if SERIAL_OUTPUT_LOGGING
     Serial.println("BLE server and service has been initialized.");
@@ -40,7 +58,8 @@ void BLE::initBle()
 
 status_t BLE::createCharacteristic(const char* characteristicUuid,
                                     BLECharacteristic*& pCharacteristic,
-                                    BLE2902*& pNotifier)
+                                    BLE2902*& pNotifier,
+                                    uint32_t properties)
 {
     // Null check
     if (pService == nullptr) {
@@ -49,23 +68,104 @@ status_t BLE::createCharacteristic(const char* characteristicUuid,
         #endif
         return STATUS_NULL_POINTER;
     }
+    if (characteristicCount >= BLE_MAX_CHARACTERISTICS) {
+        #if DEBUG
+        Serial.println("Too many characteristics in BLE::createCharacteristic().");
+        #endif
+        return STATUS_NO_RESOURCES;
+    }
     // Create a characteristic to notify with
     pCharacteristic = pService->createCharacteristic (
                                     characteristicUuid,
-                                    BLECharacteristic::PROPERTY_NOTIFY
+                                    properties
                                 );
-    // Initialize the notifier
+    // Initialize the notifier. Notifications stay disabled until the
+    // central writes the CCCD, so nothing is sent before it listens.
     pNotifier = new BLE2902();
-    pNotifier->setNotifications(true);
+    pNotifier->setNotifications(false);
+    pNotifier->setCallbacks(new MyCccdCallbacks(this));
     pCharacteristic->addDescriptor(pNotifier);
+    // Track the characteristic for subscriber checks
+    status_t status = trackCharacteristic(pCharacteristic, pNotifier, false);
 
 #if SERIAL_OUTPUT_LOGGING
     Serial.print("Success initializing Characteristic with UUID:");
     Serial.println(characteristicUuid);
+#endif
+    return status;
+}
+
+status_t BLE::trackCharacteristic(BLECharacteristic* pCharacteristic,
+                                  BLE2902* pNotifier, bool persistent)
+{
+    if (characteristicCount >= BLE_MAX_CHARACTERISTICS) {
+        return STATUS_NO_RESOURCES;
+    }
+    characteristics[characteristicCount] = pCharacteristic;
+    notifiers[characteristicCount] = pNotifier;
+    if (persistent) {
+        persistentMask |= (1U << characteristicCount);
+    }
+    characteristicCount++;
+    return STATUS_COMPLETE;
+}
+
+#if BLE_HID_GAMEPAD_MODE
+status_t BLE::initHidGamepad(void)
+{
+    // Null check
+    if (pServer == nullptr) {
+        #if DEBUG
+        Serial.println("pServer is NULL in BLE::initHidGamepad().");
+        #endif
+        return STATUS_NULL_POINTER;
+    }
+    pHidDevice = new BLEHIDDevice(pServer);
+    pHidInputCharacteristic = pHidDevice->inputReport(HID_GAMEPAD_REPORT_ID);
+    pHidDevice->manufacturer()->setValue("Humza Ali");
+    // Vendor ID source 0x02 (USB-IF), Espressif vendor ID
+    pHidDevice->pnp(0x02, 0x303A, 0x0001, 0x0100);
+    pHidDevice->hidInfo(0x00, 0x01);
+    pHidDevice->reportMap((uint8_t*)HID_GAMEPAD_REPORT_DESCRIPTOR,
+                          HID_GAMEPAD_REPORT_DESCRIPTOR_SIZE);
+    pHidDevice->setBatteryLevel(100);
+
+    // HID hosts require a bonded connection
+    BLESecurity* pSecurity = new BLESecurity();
+    pSecurity->setAuthenticationMode(ESP_LE_AUTH_BOND);
+
+    // Track the input report CCCD created by BLEHIDDevice, so the loop
+    // wakes up when the host OS subscribes to the gamepad
+    BLE2902* pNotifier = (BLE2902*)pHidInputCharacteristic->getDescriptorByUUID(
+                                        BLEUUID((uint16_t)0x2902));
+    if (pNotifier == nullptr) {
+        return STATUS_NULL_POINTER;
+    }
+    pNotifier->setCallbacks(new MyCccdCallbacks(this));
+    status_t status = trackCharacteristic(pHidInputCharacteristic, pNotifier, true);
+    if (status != STATUS_COMPLETE) {
+        return status;
+    }
+    pHidDevice->startServices();
+
+#if SERIAL_OUTPUT_LOGGING
+    Serial.println("HID gamepad service has been initialized.");
 #endif
     return STATUS_COMPLETE;
 }
 
+void BLE::notifyHidReport(void)
+{
+    HID_Gamepad_Report_t report;
+    if (!hidGamepad.encodeReport(report)) {
+        // Nothing changed since the last report
+        return;
+    }
+    pHidInputCharacteristic->setValue((uint8_t*)&report, sizeof(report));
+    notifyCharacterisitic(pHidInputCharacteristic);
+}
+#endif
+
 status_t BLE::startAdvertising(void)
 {
     if (pService == nullptr) {
@@ -82,6 +182,13 @@ status_t BLE::startAdvertising(void)
     // Initialize the advertiser
     BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
     pAdvertising->addServiceUUID(SERVICE_UUID);
+#if BLE_HID_GAMEPAD_MODE
+    if (pHidDevice != nullptr) {
+        // Advertise as a gamepad so the host OS offers to pair with it
+        pAdvertising->setAppearance(HID_GAMEPAD);
+        pAdvertising->addServiceUUID(pHidDevice->hidService()->getUUID());
+    }
+#endif
     pAdvertising->setScanResponse(false);
     pAdvertising->setMinPreferred(0x0);
     // Start advertising now that everything is initialized
@@ -93,27 +200,163 @@ status_t BLE::startAdvertising(void)
     return STATUS_COMPLETE;
 }
 
+void BLE::handleConnect(void)
+{
+    FLIGHT_RECORD(FLIGHT_EVENT_CONNECT, 0U, pServer->getConnId());
+    connectTimeUs = micros();
+    subscribedMask.store(0U);
+    connectionState.store(BLE_STATE_CONNECTED);
+    // Bonded centrals may not rewrite CCCDs that persist across connections
+    handleSubscriptionChange();
+}
+
+void BLE::handleDisconnect(void)
+{
+    FLIGHT_RECORD(FLIGHT_EVENT_DISCONNECT, 0U, 0U);
+    connectionState.store(BLE_STATE_DISCONNECTED);
+    peerMtu = 0U;
+    subscribedMask.store(0U);
+    firstReportPending.store(false);
+    primeRequested.store(false);
+    // CCCD values belong to the connection, so clear them for the next central
+    for (uint8_t i = 0; i < characteristicCount; i++) {
+        if ((persistentMask & (1U << i)) == 0U) {
+            notifiers[i]->setNotifications(false);
+        }
+    }
+    // Advertise again so the central can reconnect
+    BLEDevice::startAdvertising();
+}
+
+void BLE::handleSubscriptionChange(void)
+{
+    uint32_t mask = 0U;
+    for (uint8_t i = 0; i < characteristicCount; i++) {
+        if (notifiers[i]->getNotifications()) {
+            mask |= (1U << i);
+        }
+    }
+    subscribedMask.store(mask);
+
+    BLE_Connection_State_t state = connectionState.load();
+    if (state == BLE_STATE_DISCONNECTED) {
+        return;
+    }
+    // The central exchanges the MTU before subscribing
+    peerMtu = pServer->getPeerMTU(pServer->getConnId());
+    FLIGHT_RECORD(FLIGHT_EVENT_SUBSCRIBE, (uint8_t)mask, peerMtu);
+    if ((mask != 0U) && (state != BLE_STATE_SUBSCRIBED)) {
+        subscribeTimeUs = micros();
+        connectionState.store(BLE_STATE_SUBSCRIBED);
+        firstReportPending.store(true);
+        primeRequested.store(true);
+        // Wake the loop if it is waiting for a subscriber
+        if (subscribeSemaphore != nullptr) {
+            xSemaphoreGive(subscribeSemaphore);
+        }
+    } else if ((mask == 0U) && (state == BLE_STATE_SUBSCRIBED)) {
+        connectionState.store(BLE_STATE_CONNECTED);
+    }
+}
+
+bool BLE::waitForSubscriber(uint32_t timeoutMs)
+{
+    if (isSubscribed()) {
+        return true;
+    }
+    if (subscribeSemaphore == nullptr) {
+        delay(timeoutMs);
+    } else {
+        xSemaphoreTake(subscribeSemaphore, pdMS_TO_TICKS(timeoutMs));
+    }
+    return isSubscribed();
+}
+
+uint32_t BLE::getSubscriptionBit(BLECharacteristic* pCharacteristic) const
+{
+    for (uint8_t i = 0; i < characteristicCount; i++) {
+        if (characteristics[i] == pCharacteristic) {
+            return (1U << i);
+        }
+    }
+    return 0U;
+}
+
+bool BLE::hasTxBuffer(void) const
+{
+    return esp_ble_get_cur_sendable_packets_num(pServer->getConnId()) != 0U;
+}
+
 void BLE::notifyCharacterisitic(BLECharacteristic* pCharacteristic)
 {
     // Null check
     if (pCharacteristic == nullptr) {
         #if DEBUG
         Serial.println("pCharacteristic is NULL in BLE::notifyCharacterisitic().");
-        delay(100);
         #endif
+        FLIGHT_RECORD(FLIGHT_EVENT_NOTIFY_FAILURE, 0xFFU, FLIGHT_NOTIFY_NULL_CHARACTERISTIC);
         return;
     }
     // Notify the characteristic value of pCharacteristic
-    // if there is a device connected
-    if (deviceConnected) {
-        pCharacteristic->notify();
-        delay(10);
+    // if the connected central has subscribed to it
+    const uint32_t subscriptionBit = getSubscriptionBit(pCharacteristic);
+    if ((subscribedMask.load() & subscriptionBit) == 0U) {
+        return;
     }
-#if SERIAL_OUTPUT_LOGGING
-    else {
-        Serial.println("No device currently connected.");
-        delay(500);
+    const uint8_t characteristicIndex = (uint8_t)__builtin_ctz(subscriptionBit);
+#if FLIGHT_RECORDER_ENABLED
+    if ((peerMtu != 0U) && (pCharacteristic->getLength() > (size_t)(peerMtu - 3U))) {
+        // The stack truncates the value to the MTU, which the host rejects
+        FLIGHT_RECORD(FLIGHT_EVENT_NOTIFY_FAILURE, characteristicIndex, FLIGHT_NOTIFY_TRUNCATED);
     }
+#else
+    (void)characteristicIndex;
 #endif
-    return;
-}
\ No newline at end of file
+    // Only hand the notification to the stack if the controller has a TX
+    // buffer for it, so the input loop never waits on the link. Reports
+    // already held back go first.
+    if ((pendingMask != 0U) || !hasTxBuffer()) {
+        if ((pendingMask & subscriptionBit) == 0U) {
+            // Recorded once per report held back, not per sample replaced
+            FLIGHT_RECORD(FLIGHT_EVENT_QUEUE_SATURATED, characteristicIndex, 0U);
+        }
+        pendingMask |= subscriptionBit;
+        return;
+    }
+    sendNotification(pCharacteristic, subscriptionBit);
+}
+
+void BLE::flushPendingNotifications(void)
+{
+    // Drop what the central unsubscribed from in the meantime
+    pendingMask &= subscribedMask.load();
+    // Take turns from the characteristic after the last one sent, so a
+    // busy link doesn't starve the last characteristics
+    while (pendingMask != 0U) {
+        if (!hasTxBuffer()) {
+            return;
+        }
+        uint32_t laterMask = pendingMask & ~((2U << lastFlushedIndex) - 1U);
+        const uint8_t characteristicIndex = (uint8_t)__builtin_ctz((laterMask != 0U) ? laterMask : pendingMask);
+        lastFlushedIndex = characteristicIndex;
+        sendNotification(characteristics[characteristicIndex], (1U << characteristicIndex));
+    }
+}
+
+void BLE::sendNotification(BLECharacteristic* pCharacteristic, uint32_t subscriptionBit)
+{
+    pendingMask &= ~subscriptionBit;
+    pCharacteristic->notify();
+    if (firstReportPending.exchange(false)) {
+        // Record how long it took to resume reporting after (re)connecting
+        uint32_t nowUs = micros();
+        connectToFirstReportUs = nowUs - connectTimeUs;
+        subscribeToFirstReportUs = nowUs - subscribeTimeUs;
+        #if SERIAL_OUTPUT_LOGGING
+        Serial.print("First report after connect (us): ");
+        Serial.print(connectToFirstReportUs);
+        Serial.print(", after subscribe (us): ");
+        Serial.println(subscribeToFirstReportUs);
+        #endif
+    }
+}
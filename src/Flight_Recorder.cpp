@@ -0,0 +1,173 @@
+/**
+ * @file Flight_Recorder.cpp
+ * @brief On-device flight recorder source file.
+ * @author Humza Ali
+ */
+
+#include "Arduino.h"
+#include <esp_heap_caps.h>
+#include <esp_system.h>
+
+#include "include/Flight_Recorder.h"
+#include "include/BLE.h"
+
+#if FLIGHT_RECORDER_ENABLED
+FlightRecorder flightRecorder;
+#endif
+
+#if !FLIGHT_RECORDER_USE_PSRAM
+static Flight_Recorder_Event_t flightRecorderEvents[FLIGHT_RECORDER_EVENT_COUNT];
+#endif
+
+class FlightRecorderCallbacks : public BLECharacteristicCallbacks {
+public:
+    FlightRecorderCallbacks(FlightRecorder* pRecorder) : pRecorder(pRecorder) {};
+
+    void onWrite(BLECharacteristic* pCharacteristic) {
+      pRecorder->handleRequest(pCharacteristic->getData(),
+                               pCharacteristic->getLength());
+    }
+
+private:
+    FlightRecorder* pRecorder;
+};
+
+status_t FlightRecorder::initFlightRecorder(BLE* pBle)
+{
+    // Null check
+    if (pBle == nullptr) {
+        #if DEBUG
+        Serial.println("pBle is NULL in FlightRecorder::initFlightRecorder().");
+        #endif
+        return STATUS_NULL_POINTER;
+    }
+#if FLIGHT_RECORDER_USE_PSRAM
+    pEvents = (Flight_Recorder_Event_t*)heap_caps_malloc(
+        FLIGHT_RECORDER_EVENT_COUNT * sizeof(Flight_Recorder_Event_t),
+        MALLOC_CAP_SPIRAM);
+    if (pEvents == nullptr) {
+        #if DEBUG
+        Serial.println("Could not allocate the flight recorder in PSRAM.");
+        #endif
+        return STATUS_NO_RESOURCES;
+    }
+#else
+    pEvents = flightRecorderEvents;
+#endif
+    status_t status = pBle->createCharacteristic(FLIGHT_RECORDER_CHARACTERISTIC_UUID,
+                                                 pRecorderCharacteristic,
+                                                 pRecorderNotifier,
+                                                 BLECharacteristic::PROPERTY_READ |
+                                                 BLECharacteristic::PROPERTY_WRITE);
+    if (status != STATUS_COMPLETE) {
+        return status;
+    }
+    pRecorderCharacteristic->setCallbacks(new FlightRecorderCallbacks(this));
+
+    resume();
+    return STATUS_COMPLETE;
+}
+
+void FlightRecorder::trigger(Flight_Event_Type_t type, uint32_t index)
+{
+    uint32_t expected = FLIGHT_RECORDER_NOT_TRIGGERED;
+    if (freezeIndex.compare_exchange_strong(expected, index + FLIGHT_RECORDER_POST_TRIGGER_EVENTS)) {
+        freezeReason = (uint8_t)type;
+    }
+}
+
+void FlightRecorder::freeze(Flight_Event_Type_t reason)
+{
+    if (frozen.load()) {
+        return;
+    }
+    record(reason);
+    uint32_t expected = FLIGHT_RECORDER_NOT_TRIGGERED;
+    if (freezeIndex.compare_exchange_strong(expected, head.load() - 1U)) {
+        freezeReason = (uint8_t)reason;
+    }
+    frozen.store(true);
+}
+
+void FlightRecorder::resume(void)
+{
+    // Stop recording while the ring is cleared
+    frozen.store(true);
+    head.store(0U);
+    freezeIndex.store(FLIGHT_RECORDER_NOT_TRIGGERED);
+    freezeReason = 0U;
+    cpuFreqMhz = (uint16_t)getCpuFrequencyMhz();
+    frozen.store(false);
+    record(FLIGHT_EVENT_BOOT, 0U, (uint16_t)esp_reset_reason());
+}
+
+void FlightRecorder::handleRequest(const uint8_t* pData, size_t length)
+{
+    if ((pData == nullptr) || (length < sizeof(Flight_Recorder_Request_t))) {
+        return;
+    }
+    Flight_Recorder_Request_t request;
+    memcpy(&request, pData, sizeof(request));
+
+    switch (request.command) {
+        case FLIGHT_RECORDER_COMMAND_READ_CHUNK:
+            // Reading a running ring would mix old and new events
+            freeze(FLIGHT_EVENT_FREEZE);
+            loadChunk(request.chunkIndex);
+            break;
+        case FLIGHT_RECORDER_COMMAND_FREEZE:
+            freeze(FLIGHT_EVENT_FREEZE);
+            break;
+        case FLIGHT_RECORDER_COMMAND_RESUME:
+            resume();
+            break;
+        default:
+            break;
+    }
+}
+
+void FlightRecorder::loadChunk(uint16_t chunkIndex)
+{
+    // Events past the freeze index were recorded by another task while
+    // freezing, and may only be partly written
+    uint32_t totalEvents = head.load();
+    const uint32_t lastIndex = freezeIndex.load();
+    if ((lastIndex != FLIGHT_RECORDER_NOT_TRIGGERED) && (totalEvents > (lastIndex + 1U))) {
+        totalEvents = lastIndex + 1U;
+    }
+    const uint32_t storedEvents = (totalEvents < FLIGHT_RECORDER_EVENT_COUNT) ?
+                                  totalEvents : FLIGHT_RECORDER_EVENT_COUNT;
+    const uint32_t oldestIndex = totalEvents - storedEvents;
+    const uint16_t chunkCount = (uint16_t)((storedEvents + FLIGHT_RECORDER_CHUNK_EVENTS - 1U) /
+                                           FLIGHT_RECORDER_CHUNK_EVENTS);
+
+    uint16_t eventCount = 0U;
+    if (chunkIndex < chunkCount) {
+        const uint32_t first = (uint32_t)chunkIndex * FLIGHT_RECORDER_CHUNK_EVENTS;
+        const uint32_t remaining = storedEvents - first;
+        eventCount = (uint16_t)((remaining < FLIGHT_RECORDER_CHUNK_EVENTS) ?
+                                remaining : FLIGHT_RECORDER_CHUNK_EVENTS);
+        Flight_Recorder_Event_t* pChunkEvents =
+            (Flight_Recorder_Event_t*)&chunkBuffer[sizeof(Flight_Recorder_Chunk_Header_t)];
+        for (uint16_t i = 0; i < eventCount; i++) {
+            const uint32_t index = oldestIndex + first + i;
+            pChunkEvents[i] = pEvents[index & (FLIGHT_RECORDER_EVENT_COUNT - 1U)];
+        }
+    }
+
+    // Payload format is defined by \ref Flight_Recorder_Chunk_Header_t and
+    // \ref Flight_Recorder_Event_t in wire_schema.h
+    Flight_Recorder_Chunk_Header_t header;
+    header.chunkIndex = chunkIndex;
+    header.chunkCount = chunkCount;
+    header.eventCount = eventCount;
+    // Not the current frequency, which may have changed since the freeze
+    header.cpuFreqMhz = cpuFreqMhz;
+    header.totalEvents = totalEvents;
+    header.frozen = frozen.load() ? 1U : 0U;
+    header.freezeReason = freezeReason;
+    header.reserved = 0U;
+    memcpy(chunkBuffer, &header, sizeof(header));
+    pRecorderCharacteristic->setValue(chunkBuffer,
+                                      sizeof(header) + (eventCount * sizeof(Flight_Recorder_Event_t)));
+}
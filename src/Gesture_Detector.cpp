@@ -0,0 +1,172 @@
+/**
+ * @file Gesture_Detector.cpp
+ * @brief Swing, shake and flick gesture detector source file.
+ * @author Humza Ali
+ */
+
+#include <math.h>
+
+#include "include/Gesture_Detector.h"
+
+/** Weight of a new sample in the gravity estimate. */
+#define GESTURE_GRAVITY_FILTER_WEIGHT 0.1f
+/** Max deviation of |accel| from 1g for the gravity estimate to update, in g. */
+#define GESTURE_GRAVITY_REST_ACCEL_G  0.1f
+
+void GestureDetector::addEvent(Gesture_Event_t* pEvents, uint8_t& eventCount,
+                               Gesture_Type_t type, float magnitude,
+                               uint32_t timestampUs) const
+{
+    if (eventCount >= GESTURE_MAX_EVENTS_PER_SAMPLE) {
+        return;
+    }
+    Gesture_Event_t* pEvent = &pEvents[eventCount++];
+    pEvent->type = (uint8_t)type;
+    pEvent->controller = controller;
+    pEvent->magnitude = (magnitude >= 65535.0f) ? 0xFFFFU : (uint16_t)magnitude;
+    pEvent->timestampUs = timestampUs;
+}
+
+void GestureDetector::updateSwing(float gyroMag, uint32_t timestampUs,
+                                  Gesture_Event_t* pEvents, uint8_t& eventCount)
+{
+    switch (swingState) {
+        case SWING_STATE_IDLE:
+            if (gyroMag >= config.swingStartGyroDps) {
+                addEvent(pEvents, eventCount, GESTURE_SWING_START, gyroMag, timestampUs);
+                swingState = SWING_STATE_SWINGING;
+                swingPeakDps = gyroMag;
+                swingPeakUs = timestampUs;
+            }
+            break;
+        case SWING_STATE_SWINGING:
+            if (gyroMag > swingPeakDps) {
+                swingPeakDps = gyroMag;
+                swingPeakUs = timestampUs;
+            } else if ((gyroMag < (swingPeakDps * config.swingPeakRatio)) ||
+                       (gyroMag < config.swingEndGyroDps)) {
+                // Stamped with the peak sample, not the one that confirmed it
+                addEvent(pEvents, eventCount, GESTURE_SWING_PEAK, swingPeakDps, swingPeakUs);
+                swingState = SWING_STATE_PEAKED;
+            }
+            if (gyroMag < config.swingEndGyroDps) {
+                swingState = SWING_STATE_IDLE;
+                hasSwung = true;
+                swingEndUs = timestampUs;
+            }
+            break;
+        case SWING_STATE_PEAKED:
+            if (gyroMag < config.swingEndGyroDps) {
+                swingState = SWING_STATE_IDLE;
+                hasSwung = true;
+                swingEndUs = timestampUs;
+            }
+            break;
+    }
+}
+
+void GestureDetector::updateShake(const float linear[3], uint32_t timestampUs,
+                                  Gesture_Event_t* pEvents, uint8_t& eventCount)
+{
+    // Unsigned subtraction handles micros() wrapping around
+    if ((shakeAxis >= 0) &&
+        ((uint32_t)(timestampUs - lastReversalUs) > config.shakeReversalTimeoutUs)) {
+        // Too long since the last stroke, the shake is over
+        shakeAxis = -1;
+        shakeSign = 0;
+        shakeReversalCount = 0U;
+        shaking = false;
+    }
+
+    // Follow the axis with the strongest linear acceleration
+    int8_t axis = 0;
+    for (int8_t i = 1; i < 3; i++) {
+        if (fabsf(linear[i]) > fabsf(linear[axis])) {
+            axis = i;
+        }
+    }
+    if (fabsf(linear[axis]) < config.shakeAccelThresholdG) {
+        return;
+    }
+    const int8_t sign = (linear[axis] > 0.0f) ? 1 : -1;
+    if (shakeAxis < 0) {
+        // First stroke
+        shakeAxis = axis;
+        shakeSign = sign;
+        shakeStartUs = timestampUs;
+        lastReversalUs = timestampUs;
+        return;
+    }
+    if ((axis != shakeAxis) || (sign == shakeSign)) {
+        if (axis == shakeAxis) {
+            // Same stroke is still going on
+            lastReversalUs = timestampUs;
+        }
+        return;
+    }
+    shakeSign = sign;
+    lastReversalUs = timestampUs;
+    if (shakeReversalCount < 0xFFU) {
+        shakeReversalCount++;
+    }
+    if (!shaking && (shakeReversalCount >= config.shakeReversals)) {
+        // Stamped with the first stroke, not the reversal that confirmed it
+        addEvent(pEvents, eventCount, GESTURE_SHAKE, (float)shakeReversalCount, shakeStartUs);
+        shaking = true;
+    }
+}
+
+void GestureDetector::updateFlick(float linearMag, float gyroMag, uint32_t timestampUs,
+                                  Gesture_Event_t* pEvents, uint8_t& eventCount)
+{
+    if (flickPending) {
+        flickPending = false;
+        if ((swingState == SWING_STATE_IDLE) && (gyroMag < config.swingEndGyroDps)) {
+            // No rotation followed the spike, so it wasn't a swing starting
+            addEvent(pEvents, eventCount, GESTURE_FLICK, pendingFlickMag * 1000.0f, pendingFlickUs);
+            hasFlicked = true;
+            lastFlickUs = pendingFlickUs;
+            return;
+        }
+    }
+    // Unsigned subtraction handles micros() wrapping around
+    if ((linearMag >= config.flickAccelThresholdG) &&
+        (swingState == SWING_STATE_IDLE) && !shaking &&
+        (!hasFlicked || ((uint32_t)(timestampUs - lastFlickUs) >= config.flickRefractoryUs)) &&
+        (!hasSwung || ((uint32_t)(timestampUs - swingEndUs) >= config.swingSettleUs))) {
+        flickPending = true;
+        pendingFlickMag = linearMag;
+        pendingFlickUs = timestampUs;
+    }
+}
+
+uint8_t GestureDetector::update(float ax, float ay, float az,
+                                float gx, float gy, float gz,
+                                uint32_t timestampUs, Gesture_Event_t* pEvents)
+{
+    uint8_t eventCount = 0U;
+
+    const float accelMag = sqrtf((ax * ax) + (ay * ay) + (az * az));
+    const float gyroMag = sqrtf((gx * gx) + (gy * gy) + (gz * gz));
+    if (!hasGravity) {
+        gravity[0] = ax;
+        gravity[1] = ay;
+        gravity[2] = az;
+        hasGravity = true;
+    } else if ((fabsf(accelMag - 1.0f) < GESTURE_GRAVITY_REST_ACCEL_G) &&
+               (gyroMag < config.swingEndGyroDps)) {
+        // Only track gravity near rest, so gestures don't leak into it
+        gravity[0] += (ax - gravity[0]) * GESTURE_GRAVITY_FILTER_WEIGHT;
+        gravity[1] += (ay - gravity[1]) * GESTURE_GRAVITY_FILTER_WEIGHT;
+        gravity[2] += (az - gravity[2]) * GESTURE_GRAVITY_FILTER_WEIGHT;
+    }
+    const float linear[3] = { ax - gravity[0], ay - gravity[1], az - gravity[2] };
+    const float linearMag = sqrtf((linear[0] * linear[0]) +
+                                  (linear[1] * linear[1]) +
+                                  (linear[2] * linear[2]));
+
+    updateSwing(gyroMag, timestampUs, pEvents, eventCount);
+    updateShake(linear, timestampUs, pEvents, eventCount);
+    updateFlick(linearMag, gyroMag, timestampUs, pEvents, eventCount);
+    return eventCount;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file Gesture_Reporter.cpp
+ * @brief Gesture event notification source file.
+ * @author Humza Ali
+ */
+
+#include "Arduino.h"
+
+#include "include/Gesture_Reporter.h"
+
+status_t GestureReporter::initGestureReporter(void)
+{
+    // Null check
+    if (pBle == nullptr) {
+        #if DEBUG
+        Serial.println("pBle is NULL in GestureReporter::initGestureReporter().");
+        #endif
+        return STATUS_NULL_POINTER;
+    }
+    return pBle->createCharacteristic(GESTURE_EVENT_CHARACTERISTIC_UUID,
+                                      pGestureEventCharacteristic,
+                                      pGestureEventNotifier);
+}
+
+void GestureReporter::reportEvents(const Gesture_Event_t* pEvents, uint8_t eventCount)
+{
+    // Null checks
+    if ((pBle == nullptr) || (pEvents == nullptr) || (eventCount == 0U)) {
+        return;
+    }
+    if (pGestureEventCharacteristic == nullptr) {
+        #if DEBUG
+        Serial.println("pGestureEventCharacteristic is NULL in GestureReporter::reportEvents().");
+        #endif
+        return;
+    }
+    if (eventCount > GESTURE_MAX_EVENTS_PER_SAMPLE) {
+        eventCount = GESTURE_MAX_EVENTS_PER_SAMPLE;
+    }
+    // Payload format is one or more \ref Gesture_Event_t in wire_schema.h
+    Gesture_Event_t payload[GESTURE_MAX_EVENTS_PER_SAMPLE];
+    memcpy(payload, pEvents, eventCount * sizeof(Gesture_Event_t));
+    pGestureEventCharacteristic->setValue((uint8_t*)payload, eventCount * sizeof(Gesture_Event_t));
+    pBle->notifyCharacterisitic(pGestureEventCharacteristic);
+}
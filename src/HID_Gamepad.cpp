@@ -0,0 +1,118 @@
+/**
+ * @file HID_Gamepad.cpp
+ * @brief HID-over-GATT gamepad report source file.
+ * @author Humza Ali
+ */
+
+#include <string.h>
+
+#include "include/HID_Gamepad.h"
+
+const uint8_t HID_GAMEPAD_REPORT_DESCRIPTOR[] = {
+    0x05, 0x01,                   // Usage Page (Generic Desktop)
+    0x09, 0x05,                   // Usage (Game Pad)
+    0xA1, 0x01,                   // Collection (Application)
+    0x85, HID_GAMEPAD_REPORT_ID,  //   Report ID
+    // Buttons 1-16 map to Button_Mapping_t, 17-18 to the Nunchuck C and Z
+    0x05, 0x09,                   //   Usage Page (Button)
+    0x19, 0x01,                   //   Usage Minimum (Button 1)
+    0x29, 0x12,                   //   Usage Maximum (Button 18)
+    0x15, 0x00,                   //   Logical Minimum (0)
+    0x25, 0x01,                   //   Logical Maximum (1)
+    0x75, 0x01,                   //   Report Size (1)
+    0x95, 0x12,                   //   Report Count (18)
+    0x81, 0x02,                   //   Input (Data, Variable, Absolute)
+    0x95, 0x06,                   //   Report Count (6)
+    0x81, 0x03,                   //   Input (Constant) - padding
+    // Nunchuck joystick
+    0x05, 0x01,                   //   Usage Page (Generic Desktop)
+    0x09, 0x30,                   //   Usage (X)
+    0x09, 0x31,                   //   Usage (Y)
+    0x15, 0x00,                   //   Logical Minimum (0)
+    0x26, 0xFF, 0x00,             //   Logical Maximum (255)
+    0x75, 0x08,                   //   Report Size (8)
+    0x95, 0x02,                   //   Report Count (2)
+    0x81, 0x02,                   //   Input (Data, Variable, Absolute)
+    // Accelerometer (Vx, Vy, Vz) and gyroscope (Vbrx, Vbry, Vbrz)
+    0x09, 0x40,                   //   Usage (Vx)
+    0x09, 0x41,                   //   Usage (Vy)
+    0x09, 0x42,                   //   Usage (Vz)
+    0x09, 0x43,                   //   Usage (Vbrx)
+    0x09, 0x44,                   //   Usage (Vbry)
+    0x09, 0x45,                   //   Usage (Vbrz)
+    0x16, 0x01, 0x80,             //   Logical Minimum (-32767)
+    0x26, 0xFF, 0x7F,             //   Logical Maximum (32767)
+    0x75, 0x10,                   //   Report Size (16)
+    0x95, 0x06,                   //   Report Count (6)
+    0x81, 0x02,                   //   Input (Data, Variable, Absolute)
+    0xC0,                         // End Collection
+};
+
+const size_t HID_GAMEPAD_REPORT_DESCRIPTOR_SIZE = sizeof(HID_GAMEPAD_REPORT_DESCRIPTOR);
+
+int16_t HidGamepad::scaleMotionAxis(float value, float range)
+{
+    float scaled = (value / range) * (float)HID_GAMEPAD_MOTION_AXIS_MAX;
+    if (scaled >= (float)HID_GAMEPAD_MOTION_AXIS_MAX) {
+        return HID_GAMEPAD_MOTION_AXIS_MAX;
+    }
+    if (scaled <= -(float)HID_GAMEPAD_MOTION_AXIS_MAX) {
+        return -HID_GAMEPAD_MOTION_AXIS_MAX;
+    }
+    // Round to the nearest step
+    return (int16_t)((scaled >= 0.0f) ? (scaled + 0.5f) : (scaled - 0.5f));
+}
+
+void HidGamepad::setButtons(uint16_t buttons)
+{
+    if (state.buttons != buttons) {
+        state.buttons = buttons;
+        changed = true;
+    }
+}
+
+void HidGamepad::setExtraButtons(uint8_t extraButtons)
+{
+    // Only the two Nunchuck button bits are part of the report
+    extraButtons &= 0x03U;
+    if (state.extraButtons != extraButtons) {
+        state.extraButtons = extraButtons;
+        changed = true;
+    }
+}
+
+void HidGamepad::setJoystick(uint8_t x, uint8_t y)
+{
+    if ((state.joystickX != x) || (state.joystickY != y)) {
+        state.joystickX = x;
+        state.joystickY = y;
+        changed = true;
+    }
+}
+
+void HidGamepad::setMotion(float ax, float ay, float az, float gx, float gy, float gz)
+{
+    const int16_t motion[6] = {
+        scaleMotionAxis(ax, HID_GAMEPAD_ACCEL_RANGE_G),
+        scaleMotionAxis(ay, HID_GAMEPAD_ACCEL_RANGE_G),
+        scaleMotionAxis(az, HID_GAMEPAD_ACCEL_RANGE_G),
+        scaleMotionAxis(gx, HID_GAMEPAD_GYRO_RANGE_DPS),
+        scaleMotionAxis(gy, HID_GAMEPAD_GYRO_RANGE_DPS),
+        scaleMotionAxis(gz, HID_GAMEPAD_GYRO_RANGE_DPS),
+    };
+    if (memcmp(state.accel, &motion[0], sizeof(state.accel)) ||
+        memcmp(state.gyro, &motion[3], sizeof(state.gyro))) {
+        memcpy(state.accel, &motion[0], sizeof(state.accel));
+        memcpy(state.gyro, &motion[3], sizeof(state.gyro));
+        changed = true;
+    }
+}
+
+bool HidGamepad::encodeReport(HID_Gamepad_Report_t& report)
+{
+    // The report struct is already in wire order (little endian, packed)
+    report = state;
+    bool wasChanged = changed;
+    changed = false;
+    return wasChanged;
+}
@@ -7,10 +7,67 @@
 #include "include/IMU_Sensor.h"
 #include "Arduino.h"
 
+bool readImuRegisters(uint8_t deviceAddress, uint8_t firstRegister, uint8_t* pData, uint8_t length)
+{
+    // Point the device at the first register, then read with a repeated start
+    Wire.beginTransmission(deviceAddress);
+    Wire.write(firstRegister);
+    if ((Wire.endTransmission(false) != 0) ||
+        (Wire.requestFrom(deviceAddress, length) != length)) {
+        return false;
+    }
+    for (uint8_t i = 0U; i < length; i++) {
+        pData[i] = (uint8_t)Wire.read();
+    }
+    return true;
+}
+
+status_t writeImuRegister(uint8_t deviceAddress, uint8_t registerAddress, uint8_t value)
+{
+    Wire.beginTransmission(deviceAddress);
+    Wire.write(registerAddress);
+    Wire.write(value);
+    return (Wire.endTransmission() == 0) ? STATUS_COMPLETE : STATUS_IMU_INIT_FAILURE;
+}
+
+status_t checkImuWhoAmI(uint8_t deviceAddress, uint8_t whoAmIRegister, uint8_t expectedWhoAmI)
+{
+    uint8_t whoAmI = 0U;
+    if (!readImuRegisters(deviceAddress, whoAmIRegister, &whoAmI, 1U)) {
+        #if DEBUG
+        Serial.print("No IMU answered at address:");
+        Serial.println(deviceAddress);
+        #endif
+        return STATUS_IMU_INIT_FAILURE;
+    }
+    if (whoAmI != expectedWhoAmI) {
+        #if DEBUG
+        Serial.print("IMU at address ");
+        Serial.print(deviceAddress);
+        Serial.print(" reported WHO_AM_I 0x");
+        Serial.print(whoAmI, HEX);
+        Serial.print(", expected 0x");
+        Serial.println(expectedWhoAmI, HEX);
+        #endif
+        return STATUS_IMU_INIT_FAILURE;
+    }
+    return STATUS_COMPLETE;
+}
+
 status_t IMU_Sensor::initImuSensor()
 {
+    // Null check, set when the IMU name was not recognized
+    if (IMU == nullptr) {
+        #if DEBUG
+        Serial.println("IMU is NULL in IMU_Sensor::initImuSensor().");
+        #endif
+        return STATUS_NULL_POINTER;
+    }
     Wire.begin();
     Wire.setClock(400000);
+    if (checkImuWhoAmI(deviceAddress, MPU_Traits::whoAmIRegister, whoAmI) != STATUS_COMPLETE) {
+        return STATUS_IMU_INIT_FAILURE;
+    }
     calData calib = { 0, };
     // Initialize the IMU
     int initStatus = IMU->init(calib, deviceAddress);
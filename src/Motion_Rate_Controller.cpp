@@ -0,0 +1,87 @@
+/**
+ * @file Motion_Rate_Controller.cpp
+ * @brief Motion-adaptive sampling and reporting rate controller source file.
+ * @author Humza Ali
+ */
+
+#include "include/Motion_Rate_Controller.h"
+
+bool MotionRateController::isMoving(float ax, float ay, float az,
+                                    float gx, float gy, float gz,
+                                    float accelThreshold, float gyroThreshold)
+{
+    // Compare squared magnitudes so no square root is needed per sample.
+    // A still IMU only measures gravity, so |accel| should sit at 1g.
+    const float accelMagSq = (ax * ax) + (ay * ay) + (az * az);
+    const float accelLow = 1.0f - accelThreshold;
+    const float accelHigh = 1.0f + accelThreshold;
+    if ((accelMagSq < (accelLow * accelLow)) || (accelMagSq > (accelHigh * accelHigh))) {
+        return true;
+    }
+    const float gyroMagSq = (gx * gx) + (gy * gy) + (gz * gz);
+    return gyroMagSq > (gyroThreshold * gyroThreshold);
+}
+
+bool MotionRateController::isSampleDue(uint32_t nowMs) const
+{
+    if (!hasSampled || reportForced) {
+        return true;
+    }
+    const uint32_t periodMs = (state == RATE_STATE_ACTIVE) ?
+                              config.activePeriodMs : config.idleSamplePeriodMs;
+    // Unsigned subtraction handles millis() wrapping around
+    return (uint32_t)(nowMs - lastSampleMs) >= periodMs;
+}
+
+void MotionRateController::wake(uint32_t nowMs)
+{
+    if (state == RATE_STATE_IDLE) {
+        // Report the next sample so the host sees the wake immediately
+        reportForced = true;
+    }
+    state = RATE_STATE_ACTIVE;
+    lastMotionMs = nowMs;
+}
+
+bool MotionRateController::update(float ax, float ay, float az,
+                                  float gx, float gy, float gz, uint32_t nowMs)
+{
+    if (!hasSampled) {
+        // Start the still time from the first sample, not from 0
+        lastMotionMs = nowMs;
+        lastReportMs = nowMs;
+    }
+    hasSampled = true;
+    lastSampleMs = nowMs;
+    sampleCount++;
+
+    bool report = reportForced;
+    reportForced = false;
+
+    if (state == RATE_STATE_ACTIVE) {
+        if (isMoving(ax, ay, az, gx, gy, gz,
+                     config.stillAccelThreshold, config.stillGyroThreshold)) {
+            lastMotionMs = nowMs;
+        } else if ((uint32_t)(nowMs - lastMotionMs) >= config.stillTimeMs) {
+            state = RATE_STATE_IDLE;
+        }
+        // Report every sample while active (including the one going idle)
+        report = true;
+    } else {
+        if (isMoving(ax, ay, az, gx, gy, gz,
+                     config.wakeAccelThreshold, config.wakeGyroThreshold)) {
+            // Motion onset, report this sample and go back to full rate
+            state = RATE_STATE_ACTIVE;
+            lastMotionMs = nowMs;
+            report = true;
+        } else if ((uint32_t)(nowMs - lastReportMs) >= config.keepalivePeriodMs) {
+            report = true;
+        }
+    }
+
+    if (report) {
+        lastReportMs = nowMs;
+        reportCount++;
+    }
+    return report;
+}
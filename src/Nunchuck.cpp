@@ -7,6 +7,8 @@
 #include "Arduino.h"
 
 #include "include/Nunchuck.h"
+#include "include/Controller_Inputs.h"
+#include "include/Flight_Recorder.h"
 
 std::map<Pins_t, uint8_t> Nunchuck::buttonPins;
 
@@ -20,13 +22,8 @@ void Nunchuck::buttonChangeIRQHandler(Pins_t pin)
     Serial.print("Digital Input Value: ");
     Serial.println(digitalRead(pin));
 #endif
-    if (digitalRead(pin)) {
-        // Button pressed (logical high)
-        buttonInput |= buttonPins[pin];
-    } else {
-        // Button released (logical low)
-        buttonInput &= ~buttonPins[pin];
-    }
+    // Button pressed while the pin reads logical high
+    updateButtonBits(buttonInput, buttonPins[pin], digitalRead(pin) != 0);
 }
 
 void Nunchuck::initButtonPins(void)
@@ -66,9 +63,9 @@ void Nunchuck::updateSensorInputs(void)
         #endif
         return;
     }
-    if (pNunchuckImu->IMU == nullptr) {
+    if (!pNunchuckImu->isReady()) {
         #if DEBUG
-        Serial.println("pNunchuckImu->IMU is NULL in Nunchuck::updateSensorInputs().");
+        Serial.println("pNunchuckImu has no IMU driver in Nunchuck::updateSensorInputs().");
         #endif
         return;
     }
@@ -78,23 +75,51 @@ void Nunchuck::updateSensorInputs(void)
         #endif
         return;
     }
+    uint32_t nowMs = millis();
+    if ((pRateController != nullptr) && !pRateController->isSampleDue(nowMs)) {
+        // Sampling period has not elapsed yet
+        return;
+    }
     // Update IMU data
-    pNunchuckImu->IMU->update();
+    pNunchuckImu->update();
+    uint32_t sampleTimeUs = micros();
 
     AccelData accelData;
+    GyroData gyroData;
     // Get accelorometer data
-    pNunchuckImu->IMU->getAccel(&accelData);
-    /**
-     * Payload Format of \ref accelGyroDataBytes:
-     * ----------------------------------------------
-     * | ax (4 bytes) | ay (4 bytes) | az (4 bytes) |
-     * ----------------------------------------------
-     */
-    uint8_t accelDataBytes[ACCEL_GYRO_DATA_SIZE];
-    // Load the accelorometer data
-    memcpy(accelDataBytes, &accelData, ACCEL_DATA_STRUCT_SIZE);
+    pNunchuckImu->getAccel(&accelData);
+    // The gyroscope data isn't transmitted, but it's still used to detect
+    // swings and a Nunchuck being rotated without much acceleration.
+    pNunchuckImu->getGyro(&gyroData);
+    if (isImuReadFailure(accelData)) {
+        FLIGHT_RECORD(FLIGHT_EVENT_I2C_ERROR, 1U, 0U);
+    }
+    if ((pGestureDetector != nullptr) && (pGestureReporter != nullptr)) {
+        Gesture_Event_t gestureEvents[GESTURE_MAX_EVENTS_PER_SAMPLE];
+        uint8_t eventCount = pGestureDetector->update(accelData.accelX, accelData.accelY, accelData.accelZ,
+                                                      gyroData.gyroX, gyroData.gyroY, gyroData.gyroZ,
+                                                      sampleTimeUs, gestureEvents);
+        if (eventCount > 0U) {
+            // Send the gesture ahead of the sample it was detected on
+            pGestureReporter->reportEvents(gestureEvents, eventCount);
+            if (pRateController != nullptr) {
+                // Make sure the sample itself is reported too
+                pRateController->wake(nowMs);
+            }
+        }
+    }
+
+    if ((pRateController != nullptr) &&
+        !pRateController->update(accelData.accelX, accelData.accelY, accelData.accelZ,
+                                 gyroData.gyroX, gyroData.gyroY, gyroData.gyroZ,
+                                 nowMs)) {
+        // Nunchuck is idle and the keepalive period has not elapsed
+        return;
+    }
+    // Payload format is defined by \ref Nunchuck_Sensor_Input_t in wire_schema.h
+    Nunchuck_Sensor_Input_t payload = packNunchuckSensorInput(accelData, sampleTimeUs);
     // Updaate notification value
-    pSensorInputCharacteristic->setValue(accelDataBytes, ACCEL_DATA_STRUCT_SIZE);
+    pSensorInputCharacteristic->setValue((uint8_t*)&payload, sizeof(payload));
     // Transmit the data
     pBle->notifyCharacterisitic(pSensorInputCharacteristic);
 }
@@ -114,22 +139,31 @@ void Nunchuck::updateButtonInputs(void)
         #endif
         return;
     }
-    // C++ compilers should recognize dividing by a power of 2, in this case 16,
-    // however I'm not really too sure, so just know that all this is doing is
-    // dividing the analog reading by 16.
-    uint8_t xAxisValue = (uint8_t)(analogRead(JOYSTICK_VRX_PIN) >> JOYSTICK_SCALE_DOWN_SHIFT);
-    uint8_t yAxisValue = (uint8_t)(analogRead(JOYSTICK_VRY_PIN) >> JOYSTICK_SCALE_DOWN_SHIFT);
-    /**
-     * Payload Format of \ref buttonJoystickInputs:
-     * -------------------------------------------------------------------------------
-     * | Nunchuck::buttonInput (1 byte) | xAxisValue (1 bytes) | yAxisValue (1 byte) |
-     * -------------------------------------------------------------------------------
-     */
-    uint8_t buttonJoystickInputs[BUTTON_JOYSTICK_DATA_SIZE] = {
-        xAxisValue, yAxisValue, Nunchuck::buttonInput
-    };
+    uint8_t xAxisValue = scaleJoystickAxis(analogRead(JOYSTICK_VRX_PIN));
+    uint8_t yAxisValue = scaleJoystickAxis(analogRead(JOYSTICK_VRY_PIN));
+    // Payload format is defined by \ref Nunchuck_Button_Joystick_Input_t in
+    // wire_schema.h
+    Nunchuck_Button_Joystick_Input_t payload;
+    payload.joystickX = xAxisValue;
+    payload.joystickY = yAxisValue;
+    payload.buttons = Nunchuck::buttonInput;
+#if BLE_HID_GAMEPAD_MODE
+    pBle->hidGamepad.setJoystick(xAxisValue, yAxisValue);
+    pBle->hidGamepad.setExtraButtons(payload.buttons);
+#endif
+    if (pRateController != nullptr) {
+        if (payload.buttons != lastButtonJoystickInputs.buttons) {
+            // Button presses count as activity for the rate controller
+            pRateController->wake(millis());
+        } else if ((pRateController->getState() == RATE_STATE_IDLE) &&
+                   isJoystickWithinDeadband(lastButtonJoystickInputs, xAxisValue, yAxisValue)) {
+            // Nothing has changed while idle, skip the notification
+            return;
+        }
+    }
+    lastButtonJoystickInputs = payload;
     // Load the button input + joystick data
-    pButtonJoystickInputCharacteristic->setValue(buttonJoystickInputs, BUTTON_JOYSTICK_DATA_SIZE);
+    pButtonJoystickInputCharacteristic->setValue((uint8_t*)&payload, sizeof(payload));
     // Trasmit the data
     pBle->notifyCharacterisitic(pButtonJoystickInputCharacteristic);
 }
\ No newline at end of file
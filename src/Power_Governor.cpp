@@ -0,0 +1,104 @@
+/**
+ * @file Power_Governor.cpp
+ * @brief Load-aware CPU frequency governor source file.
+ * @author Humza Ali
+ */
+
+#include "include/Power_Governor.h"
+
+const uint32_t PowerGovernor::levelsMhz[POWER_GOVERNOR_LEVEL_COUNT] = POWER_GOVERNOR_LEVELS_MHZ;
+
+uint32_t PowerGovernor::predictBusyUs(uint32_t busyUs, uint8_t toLevel) const
+{
+    // Round up, a prediction that is too low costs jitter
+    const uint64_t scaled = ((uint64_t)busyUs * levelsMhz[level]) + levelsMhz[toLevel] - 1U;
+    return (uint32_t)(scaled / levelsMhz[toLevel]);
+}
+
+bool PowerGovernor::setLevel(uint8_t newLevel, uint32_t nowMs)
+{
+    hasWindow = false;
+    if (newLevel == level) {
+        return false;
+    }
+    if (newLevel > level) {
+        hasSteppedUp = true;
+        lastUpMs = nowMs;
+    }
+    level = newLevel;
+    switchCount++;
+    return true;
+}
+
+bool PowerGovernor::boost(uint32_t nowMs)
+{
+    // Hold the top level off a step down even if already there
+    hasSteppedUp = true;
+    lastUpMs = nowMs;
+    return setLevel(POWER_GOVERNOR_LEVEL_COUNT - 1U, nowMs);
+}
+
+bool PowerGovernor::idle(uint32_t nowMs)
+{
+    return setLevel(0U, nowMs);
+}
+
+bool PowerGovernor::update(uint32_t busyUs, uint32_t waitUs, uint32_t deadlineUs, uint32_t nowMs)
+{
+    const uint8_t topLevel = POWER_GOVERNOR_LEVEL_COUNT - 1U;
+    // A shorter deadline means the rate controller has raised the sampling
+    // rate, so the load is about to rise before any pass shows it
+    const bool deadlineShortened = (lastDeadlineUs != 0U) && (deadlineUs < lastDeadlineUs);
+    lastDeadlineUs = deadlineUs;
+    if (deadlineShortened) {
+        return boost(nowMs);
+    }
+    // Step up on the first pass that gets close to the deadline, straight
+    // to the top so it can't happen twice
+    if ((level < topLevel) &&
+        (busyUs > (uint32_t)(config.upUtilization * (float)deadlineUs))) {
+        return setLevel(topLevel, nowMs);
+    }
+    if (level == 0U) {
+        return false;
+    }
+
+    if (!hasWindow) {
+        hasWindow = true;
+        windowStartMs = nowMs;
+        windowPeakBusyUs = 0U;
+        windowPeakWaitUs = 0U;
+        windowDeadlineUs = deadlineUs;
+    }
+    if (busyUs > windowPeakBusyUs) {
+        windowPeakBusyUs = busyUs;
+    }
+    if (waitUs > windowPeakWaitUs) {
+        windowPeakWaitUs = waitUs;
+    }
+    if (deadlineUs < windowDeadlineUs) {
+        windowDeadlineUs = deadlineUs;
+    }
+    // Unsigned subtraction handles millis() wrapping around
+    if ((uint32_t)(nowMs - windowStartMs) < config.downWindowMs) {
+        return false;
+    }
+    if (hasSteppedUp && ((uint32_t)(nowMs - lastUpMs) < config.upHoldoffMs)) {
+        hasWindow = false;
+        return false;
+    }
+
+    // Step down only if the busiest pass of the window would have fit the
+    // deadline at the lower level. Samples are scheduled from the previous
+    // sample, so the switch only stretches a sample period by how much
+    // longer a sample waits behind the rest of its pass, plus the stall.
+    const uint8_t lowerLevel = level - 1U;
+    const uint32_t predictedBusyUs = predictBusyUs(windowPeakBusyUs, lowerLevel);
+    const uint32_t waitIncreaseUs = predictBusyUs(windowPeakWaitUs, lowerLevel) - windowPeakWaitUs;
+    if ((predictedBusyUs <= (uint32_t)(config.downUtilization * (float)windowDeadlineUs)) &&
+        ((waitIncreaseUs + config.switchCostUs) <= config.jitterBudgetUs)) {
+        return setLevel(lowerLevel, nowMs);
+    }
+    hasWindow = false;
+    return false;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file Power_Manager.cpp
+ * @brief CPU frequency control source file.
+ * @author Humza Ali
+ */
+
+#include "include/Power_Manager.h"
+
+status_t PowerManager::initPowerManager(uint32_t frequencyMhz)
+{
+#if CONFIG_PM_ENABLE
+    if ((esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "governor_cpu", &cpuFrequencyLock) != ESP_OK) ||
+        (esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "governor_apb", &apbFrequencyLock) != ESP_OK)) {
+        #if DEBUG
+        Serial.println("PM locks could not be created in PowerManager::initPowerManager().");
+        #endif
+        return STATUS_NO_RESOURCES;
+    }
+    // Held for good, the frequency is stepped through the PM maximum instead
+    esp_pm_lock_acquire(cpuFrequencyLock);
+    esp_pm_lock_acquire(apbFrequencyLock);
+    return setFrequencyMhz(frequencyMhz);
+#else
+    (void)frequencyMhz;
+    #if DEBUG
+    Serial.println("Power management is disabled in PowerManager::initPowerManager().");
+    #endif
+    return STATUS_POWER_CONFIG_FAILURE;
+#endif
+}
+
+status_t PowerManager::setFrequencyMhz(uint32_t newFrequencyMhz)
+{
+    if (newFrequencyMhz == frequencyMhz) {
+        return STATUS_COMPLETE;
+    }
+#if CONFIG_PM_ENABLE
+    #if ESP_IDF_VERSION_MAJOR >= 5
+    esp_pm_config_t pmConfig = {};
+    #else
+    esp_pm_config_esp32_t pmConfig = {};
+    #endif
+    pmConfig.max_freq_mhz = (int)newFrequencyMhz;
+    pmConfig.min_freq_mhz = (int)POWER_MIN_FREQUENCY_MHZ;
+    pmConfig.light_sleep_enable = false;
+    if (esp_pm_configure(&pmConfig) != ESP_OK) {
+        #if DEBUG
+        Serial.println("esp_pm_configure() failed in PowerManager::setFrequencyMhz().");
+        #endif
+        return STATUS_POWER_CONFIG_FAILURE;
+    }
+    frequencyMhz = newFrequencyMhz;
+    return STATUS_COMPLETE;
+#else
+    #if DEBUG
+    Serial.println("Power management is disabled in PowerManager::setFrequencyMhz().");
+    #endif
+    return STATUS_POWER_CONFIG_FAILURE;
+#endif
+}
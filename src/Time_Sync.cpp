@@ -0,0 +1,71 @@
+/**
+ * @file Time_Sync.cpp
+ * @brief Device-to-host clock synchronization source file.
+ * @author Humza Ali
+ */
+
+#include "Arduino.h"
+
+#include "include/Time_Sync.h"
+
+class TimeSyncCallbacks : public BLECharacteristicCallbacks {
+public:
+    TimeSyncCallbacks(TimeSync* pTimeSync) : pTimeSync(pTimeSync) {};
+
+    void onWrite(BLECharacteristic* pCharacteristic) {
+      // Stamp the receive time before doing anything else
+      uint32_t receiveTimeUs = micros();
+      pTimeSync->handleRequest(pCharacteristic->getData(),
+                               pCharacteristic->getLength(),
+                               receiveTimeUs);
+    }
+
+private:
+    TimeSync* pTimeSync;
+};
+
+status_t TimeSync::initTimeSync(void)
+{
+    // Null check
+    if (pBle == nullptr) {
+        #if DEBUG
+        Serial.println("pBle is NULL in TimeSync::initTimeSync().");
+        #endif
+        return STATUS_NULL_POINTER;
+    }
+    status_t status = pBle->createCharacteristic(TIME_SYNC_CHARACTERISTIC_UUID,
+                                                 pTimeSyncCharacteristic,
+                                                 pTimeSyncNotifier,
+                                                 BLECharacteristic::PROPERTY_NOTIFY |
+                                                 BLECharacteristic::PROPERTY_WRITE |
+                                                 BLECharacteristic::PROPERTY_WRITE_NR);
+    if (status != STATUS_COMPLETE) {
+        return status;
+    }
+    pTimeSyncCharacteristic->setCallbacks(new TimeSyncCallbacks(this));
+    return STATUS_COMPLETE;
+}
+
+void TimeSync::handleRequest(const uint8_t* pData, size_t length, uint32_t receiveTimeUs)
+{
+    if ((pData == nullptr) || (length < sizeof(Time_Sync_Request_t))) {
+        return;
+    }
+    // Only answer if the host is listening for the response
+    if (!pTimeSyncNotifier->getNotifications()) {
+        return;
+    }
+    Time_Sync_Request_t request;
+    memcpy(&request, pData, sizeof(request));
+
+    // Payload format is defined by \ref Time_Sync_Response_t in wire_schema.h
+    Time_Sync_Response_t response;
+    response.sequence = request.sequence;
+    response.receiveTimeUs = receiveTimeUs;
+    response.transmitTimeUs = micros();
+    pTimeSyncCharacteristic->setValue((uint8_t*)&response, sizeof(response));
+    // Notify directly rather than through BLE::notifyCharacterisitic(), since
+    // this runs in the BLE stack and the response must not be held back
+    // behind the input reports.
+    pTimeSyncCharacteristic->notify();
+}
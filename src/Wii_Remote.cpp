@@ -8,7 +8,9 @@
 
 #include "include/Wii_Remote.h"
 #include "include/BLE.h"
+#include "include/Controller_Inputs.h"
 #include "include/IMU_Sensor.h"
+#include "include/Flight_Recorder.h"
 #include "include/generic_types.h"
 
 // \ref WiiRemote Static Variables
@@ -23,13 +25,8 @@ void WiiRemote::buttonChangeIRQHandler(Pins_t pin)
     Serial.print("Digital Input Value: ")
     Serial.println(digitalRead(pin));
 #endif
-    if (digitalRead(pin)) {
-        // Button pressed (logical high)
-        buttonInput |= buttonPins[pin];
-    } else {
-        // Button released (logical low)
-        buttonInput &= ~buttonPins[pin];
-    }
+    // Button pressed while the pin reads logical high
+    updateButtonBits(buttonInput, (uint32_t)buttonPins[pin], digitalRead(pin) != 0);
 }
 
 void WiiRemote::initButtonPins(void)
@@ -113,15 +110,24 @@ void WiiRemote::updateButtonInputs(void) {
         #endif
         return;
     }
-    /**
-     * Load the button input data
-     * 
-     * Payload Format of \ref WiiRemote::buttonInput:
-     * -------------------------------------------
-     * | buttons1 (2 bytes) | buttons2 (2 bytes) |
-     * -------------------------------------------
-     */
-    pButtonInputCharacteristic->setValue(WiiRemote::buttonInput);
+    uint32_t buttons = WiiRemote::buttonInput;
+#if BLE_HID_GAMEPAD_MODE
+    pBle->hidGamepad.setButtons((uint16_t)buttons);
+#endif
+    if (pRateController != nullptr) {
+        if (buttons != lastButtonInput) {
+            // Button presses count as activity for the rate controller
+            pRateController->wake(millis());
+        } else if (pRateController->getState() == RATE_STATE_IDLE) {
+            // Nothing has changed while idle, skip the notification
+            return;
+        }
+    }
+    lastButtonInput = buttons;
+    // Load the button input data. Payload format is defined by
+    // \ref Wiimote_Button_Input_t in wire_schema.h
+    Wiimote_Button_Input_t payload = packWiimoteButtonInput(buttons);
+    pButtonInputCharacteristic->setValue((uint8_t*)&payload, sizeof(payload));
     // Transmit the data
     pBle->notifyCharacterisitic(pButtonInputCharacteristic);
 }
@@ -134,9 +140,9 @@ void WiiRemote::updateSensorInputs(void) {
         #endif
         return;
     }
-    if (pWiiRemoteImu->IMU == nullptr) {
+    if (!pWiiRemoteImu->isReady()) {
         #if DEBUG
-        Serial.println("pWiiRemoteImu->IMU is NULL in WiiRemote::updateSensorInputs()");
+        Serial.println("pWiiRemoteImu has no IMU driver in WiiRemote::updateSensorInputs()");
         #endif
         return;
     }
@@ -146,32 +152,59 @@ void WiiRemote::updateSensorInputs(void) {
         #endif
         return;
     }
+    uint32_t nowMs = millis();
+    if ((pRateController != nullptr) && !pRateController->isSampleDue(nowMs)) {
+        // Sampling period has not elapsed yet
+        return;
+    }
     // Update IMU sensor readings
-    pWiiRemoteImu->IMU->update();
+    pWiiRemoteImu->update();
+    uint32_t sampleTimeUs = micros();
     
     AccelData accelData;
     GyroData gyroData;
 
     // Get accelorometer and gyro data
-    pWiiRemoteImu->IMU->getAccel(&accelData);
-    pWiiRemoteImu->IMU->getGyro(&gyroData);
+    pWiiRemoteImu->getAccel(&accelData);
+    pWiiRemoteImu->getGyro(&gyroData);
+    if (isImuReadFailure(accelData)) {
+        FLIGHT_RECORD(FLIGHT_EVENT_I2C_ERROR, 0U, 0U);
+    }
+    if ((pGestureDetector != nullptr) && (pGestureReporter != nullptr)) {
+        Gesture_Event_t gestureEvents[GESTURE_MAX_EVENTS_PER_SAMPLE];
+        uint8_t eventCount = pGestureDetector->update(accelData.accelX, accelData.accelY, accelData.accelZ,
+                                                      gyroData.gyroX, gyroData.gyroY, gyroData.gyroZ,
+                                                      sampleTimeUs, gestureEvents);
+        if (eventCount > 0U) {
+            // Send the gesture ahead of the sample it was detected on
+            pGestureReporter->reportEvents(gestureEvents, eventCount);
+            if (pRateController != nullptr) {
+                // Make sure the sample itself is reported too
+                pRateController->wake(nowMs);
+            }
+        }
+    }
+#if BLE_HID_GAMEPAD_MODE
+    pBle->hidGamepad.setMotion(accelData.accelX, accelData.accelY, accelData.accelZ,
+                               gyroData.gyroX, gyroData.gyroY, gyroData.gyroZ);
+#endif
+
+    if ((pRateController != nullptr) &&
+        !pRateController->update(accelData.accelX, accelData.accelY, accelData.accelZ,
+                                 gyroData.gyroX, gyroData.gyroY, gyroData.gyroZ,
+                                 nowMs)) {
+        // Remote is idle and the keepalive period has not elapsed
+        return;
+    }
 
     /**
      * Consolidate both sensor data into one characteristic
-     * to minimize characteristic overhead
-     * 
-     * Payload Format of \ref accelGyroDataBytes:
-     * --------------------------------------------------------------------------------------------
-     * | ax (4 bytes) | ay (4 bytes) | az (4 bytes) | gx (4 bytes) | gy (4 bytes) | gz (4 bytes)  |
-     * --------------------------------------------------------------------------------------------
+     * to minimize characteristic overhead. Payload format is defined by
+     * \ref Wiimote_Sensor_Input_t in wire_schema.h
      */
-    uint8_t accelGyroDataBytes[ACCEL_GYRO_DATA_SIZE];
-    // Load the accelorometer data
-    memcpy(accelGyroDataBytes, &accelData, ACCEL_DATA_STRUCT_SIZE);
-    // Load the gyroscope data
-    memcpy(accelGyroDataBytes + ACCEL_DATA_STRUCT_SIZE, &gyroData, GYRO_DATA_STRUCT_SIZE);
+    Wiimote_Sensor_Input_t payload = packWiimoteSensorInput(accelData, gyroData, sampleTimeUs);
     // Update notification value
-    pSensorInputCharacteristic->setValue(accelGyroDataBytes, ACCEL_GYRO_DATA_SIZE);
+    pSensorInputCharacteristic->setValue((uint8_t*)&payload, sizeof(payload));
     // Transmit the data
     pBle->notifyCharacterisitic(pSensorInputCharacteristic);
 }
@@ -0,0 +1,291 @@
+"""
+File: dsu_fuzz.py
+Description: Fuzzes the DSU server request path and checks that a client
+             flooding it with requests can't starve the pad data output.
+
+             The fuzz pass feeds valid requests and random mutations of
+             them (bit flips, truncation, extra bytes, forged length and
+             CRC fields, random data) to DSU_Server.handleRequest, and
+             checks every one is accepted or dropped the same way an
+             independent validator decides, without raising.
+
+             The flood pass runs the server loop while another process
+             sends requests as fast as it can, and reports how often pad
+             data went out compared to a run without the flood. Exits with
+             an error if a request was mishandled, or if the pad data rate
+             under flood fell below what a controller needs or had a long
+             gap:
+
+                 python dsu_fuzz.py                    # fuzz and flood
+                 python dsu_fuzz.py --requests 100000  # longer fuzz pass
+                 python dsu_fuzz.py --skip-flood       # fuzz only
+Author: Humza Ali
+"""
+
+import argparse
+import multiprocessing
+import os
+import random
+import socket
+import struct
+import sys
+import time
+from binascii import crc32
+
+BENCHMARK_DIR = os.path.dirname(os.path.abspath(__file__))
+SOURCE_DIR = os.path.dirname(BENCHMARK_DIR)
+sys.path.insert(0, os.path.join(SOURCE_DIR, 'python'))
+
+from dsu import DSU_Server, DSU_TYPES, DSU_MAX_REQUESTS_PER_WAKEUP
+
+# Default number of fuzzed requests
+DEFAULT_REQUESTS = 20000
+# Default length of each flood run, in seconds
+DEFAULT_DURATION = 2.0
+# Lowest allowed pad data rate under flood, in packets per second. Well
+# above the rate controller samples arrive at.
+DEFAULT_MIN_OUTPUT_RATE = 1000.0
+# Highest allowed time between two pad data packets under flood, in ms
+DEFAULT_MAX_GAP_MS = 20.0
+# Minimum size of each request type, header and message type included
+REQUEST_MIN_SIZES = {
+    DSU_TYPES.DSUC_VersionReq.value: 20,
+    DSU_TYPES.DSUC_ListPorts.value: 24,
+    DSU_TYPES.DSUC_PadDataReq.value: 28,
+}
+
+
+def buildRequest(msgType, body=b'', clientId=0x1234, magic=b"DSUC",
+                 version=1001, length=None, crc=None):
+    """
+    Builds a client request. The length and CRC are computed unless given.
+
+    Return:
+        (bytes): Request datagram.
+    """
+    payload = struct.pack('<I', msgType) + body
+    if length == None:
+        length = len(payload)
+    header = struct.pack('<4s2HII', magic, version, length & 0xFFFF, 0, clientId)
+    if crc == None:
+        crc = crc32(header + payload)
+    return struct.pack('<4s2HII', magic, version, length & 0xFFFF, crc, clientId) + payload
+
+
+def validRequests():
+    """ Returns one valid request of each kind. """
+    return [
+        buildRequest(DSU_TYPES.DSUC_VersionReq.value),
+        buildRequest(DSU_TYPES.DSUC_ListPorts.value, struct.pack('<I', 4) + bytes([0, 1, 2, 3])),
+        buildRequest(DSU_TYPES.DSUC_ListPorts.value, struct.pack('<I', 1) + bytes([0])),
+        buildRequest(DSU_TYPES.DSUC_PadDataReq.value, struct.pack('<2B6s', 0, 0, bytes(6))),
+        buildRequest(DSU_TYPES.DSUC_PadDataReq.value, struct.pack('<2B6s', 2, 0, b"FPIE00")),
+    ]
+
+
+def isValid(data):
+    """
+    Independent check of whether the server should accept a request.
+
+    Return:
+        (bool): Indicates whether the request is valid.
+    """
+    if len(data) < 20:
+        return False
+    magic, _, length, crc, _ = struct.unpack_from('<4s2HII', data)
+    msgType, = struct.unpack_from('<I', data, 16)
+    if (magic != b"DSUC") or (length + 16 != len(data)):
+        return False
+    if crc32(data[:8] + bytes(4) + data[12:]) != crc:
+        return False
+    return (msgType in REQUEST_MIN_SIZES) and (len(data) >= REQUEST_MIN_SIZES[msgType])
+
+
+def mutate(rng, data):
+    """ Returns a random mutation of a request. """
+    kind = rng.randrange(7)
+    if kind == 0:
+        # Flip one bit
+        mutated = bytearray(data)
+        bit = rng.randrange(len(mutated) * 8)
+        mutated[bit // 8] ^= 1 << (bit % 8)
+        return bytes(mutated)
+    if kind == 1:
+        # Truncate
+        return data[:rng.randrange(len(data))]
+    if kind == 2:
+        # Extra bytes
+        return data + rng.randbytes(rng.randrange(1, 32))
+    if kind == 3:
+        # Random data
+        return rng.randbytes(rng.randrange(64))
+    msgType, = struct.unpack_from('<I', data, 16)
+    body = data[20:]
+    if kind == 4:
+        # Truncated or extended body with matching length and CRC
+        body = body[:rng.randrange(len(body) + 1)] + rng.randbytes(rng.randrange(4))
+        return buildRequest(msgType, body)
+    if kind == 5:
+        # Unknown message type or forged length, with a matching CRC
+        if rng.random() < 0.5:
+            return buildRequest(rng.randrange(0x100010), body)
+        return buildRequest(msgType, body, length=rng.randrange(0x10000))
+    # Random port list with a matching CRC
+    count = rng.randrange(0x100000000)
+    ports = rng.randbytes(rng.randrange(8))
+    return buildRequest(DSU_TYPES.DSUC_ListPorts.value, struct.pack('<I', count) + ports)
+
+
+def fuzz(server, requests, seed):
+    """
+    Feeds valid and mutated requests to the server.
+
+    Return:
+        (tuple): Requests accepted, requests dropped, and a list of
+                 requests the server handled differently than expected.
+    """
+    rng = random.Random(seed)
+    valid = validRequests()
+    client = ('127.0.0.1', server.dsuSocket.getsockname()[1])
+    accepted = 0
+    dropped = 0
+    mishandled = []
+    for n in range(requests):
+        data = valid[n % len(valid)] if (n % 4) == 0 else mutate(rng, rng.choice(valid))
+        invalidBefore = server.invalidRequests
+        try:
+            server.handleRequest(data, client)
+        except Exception as e:
+            mishandled.append((data, repr(e)))
+            continue
+        handled = server.invalidRequests == invalidBefore
+        if handled != isValid(data):
+            mishandled.append((data, 'accepted' if handled else 'dropped'))
+        if handled:
+            accepted += 1
+        else:
+            dropped += 1
+    return accepted, dropped, mishandled
+
+
+def flood(address, stop):
+    """ Sends a mix of valid and invalid requests until stopped. """
+    rng = random.Random(0)
+    requests = validRequests()
+    requests += [mutate(rng, rng.choice(requests)) for _ in range(len(requests) * 3)]
+    sender = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sender.bind(('127.0.0.1', 0))
+    sender.setblocking(False)
+    while not stop.is_set():
+        for data in requests:
+            try:
+                sender.sendto(data, address)
+            except BlockingIOError:
+                pass
+    sender.close()
+
+
+def runServer(duration, flooded):
+    """
+    Runs the server loop for a while with one subscribed client.
+
+    Params:
+        duration (float): Run time, in seconds.
+        flooded (bool): Indicates whether another process floods the server.
+
+    Return:
+        (tuple): Pad data packets sent, longest gap between two of them in
+                 ms, and invalid requests dropped.
+    """
+    server = DSU_Server('127.0.0.1', 0)
+    subscriber = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    subscriber.bind(('127.0.0.1', 0))
+    subscriber.setblocking(False)
+    server.p0list[subscriber.getsockname()] = time.time()
+    stop = multiprocessing.Event()
+    flooder = None
+    if flooded:
+        flooder = multiprocessing.Process(target=flood,
+                                          args=(server.dsuSocket.getsockname(), stop))
+        flooder.start()
+        # Give the flood time to fill the socket buffer
+        time.sleep(0.2)
+    invalid = 0
+    sent = 0
+    maxGap = 0
+    try:
+        start = time.perf_counter()
+        last = start
+        while (time.perf_counter() - start) < duration:
+            invalidBefore = server.invalidRequests
+            p0Before = server.p0count
+            server.communicateWithDsuClient()
+            server.transmitInputData()
+            now = time.perf_counter()
+            maxGap = max(maxGap, now - last)
+            last = now
+            sent += server.p0count - p0Before
+            invalid += server.invalidRequests - invalidBefore
+            # Keep the subscriber socket from filling up
+            try:
+                while True:
+                    subscriber.recv(1024)
+            except BlockingIOError:
+                pass
+    finally:
+        stop.set()
+        if flooder != None:
+            flooder.join()
+        server.dsuSocket.close()
+        subscriber.close()
+    return sent, maxGap * 1000, invalid
+
+
+def main():
+    """ Main function handler. """
+    parser = argparse.ArgumentParser(description="DSU server fuzzing and flood test")
+    parser.add_argument('--requests', type=int, default=DEFAULT_REQUESTS,
+                        help='number of fuzzed requests')
+    parser.add_argument('--seed', type=int, default=1, help='fuzzing seed')
+    parser.add_argument('--duration', type=float, default=DEFAULT_DURATION,
+                        help='length of each flood run, in seconds')
+    parser.add_argument('--min-output-rate', type=float, default=DEFAULT_MIN_OUTPUT_RATE,
+                        help='lowest allowed pad data rate under flood, in '
+                             'packets per second')
+    parser.add_argument('--max-gap-ms', type=float, default=DEFAULT_MAX_GAP_MS,
+                        help='highest allowed time between two pad data '
+                             'packets under flood')
+    parser.add_argument('--skip-flood', action='store_true', help='only run the fuzz pass')
+    args = parser.parse_args()
+    failed = False
+
+    server = DSU_Server('127.0.0.1', 0)
+    try:
+        accepted, dropped, mishandled = fuzz(server, args.requests, args.seed)
+    finally:
+        server.dsuSocket.close()
+    print(f"Fuzz: {accepted} accepted, {dropped} dropped, {len(mishandled)} mishandled")
+    for data, reason in mishandled[:10]:
+        print(f"  {reason}: {data.hex()}")
+    if mishandled:
+        failed = True
+
+    if not args.skip_flood:
+        quietSent, quietGap, _ = runServer(args.duration, False)
+        floodSent, floodGap, floodInvalid = runServer(args.duration, True)
+        floodRate = floodSent / args.duration
+        print(f"Pad data without flood: {quietSent / args.duration:.0f}/s, "
+              f"longest gap {quietGap:.2f} ms")
+        print(f"Pad data under flood:   {floodRate:.0f}/s, "
+              f"longest gap {floodGap:.2f} ms, {floodInvalid} invalid requests "
+              f"dropped, at most {DSU_MAX_REQUESTS_PER_WAKEUP} requests per wakeup")
+        if (floodRate < args.min_output_rate) or (floodGap > args.max_gap_ms):
+            print("Pad data output is starved under flood")
+            failed = True
+
+    if failed:
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,241 @@
+/**
+ * @file firmware_benchmark.cpp
+ * @brief Host benchmark of the firmware input hot paths.
+ * @author Humza Ali
+ *
+ * Runs the input hot paths of the sketch on the host, against the stand-ins
+ * in host/, and prints the results as JSON. The sketch itself is compiled
+ * in, so the benchmarks call the same WiiRemote and Nunchuck objects, IRQ
+ * handlers and button maps the firmware runs, not copies of them. Usually
+ * built and run through run_benchmarks.py, or by hand from the repository
+ * root:
+ *
+ *     g++ -O2 -std=gnu++11 -Isrc/benchmark/host -Isrc/include \
+ *         src/benchmark/firmware_benchmark.cpp src/[A-Z]*.cpp \
+ *         src/benchmark/host/[A-Z]*.cpp -o firmware_benchmark
+ *     ./firmware_benchmark [iterations]
+ *
+ * The numbers are host numbers. They track regressions in the code around
+ * a sample (rate control, gesture detection, packing, button bit updates,
+ * scaling), not the I2C and BLE time that dominates on the device. They
+ * include the stand-ins' own cost, such as the map lookup behind
+ * digitalRead() and analogRead() and the simulated IMU encoding every
+ * burst read. Each run of a benchmark follows a run of fixed reference
+ * work, and the time relative to it is reported along with the time, so
+ * results can be compared across machines.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Arduino.h"
+#include "BLEDevice.h"
+#include "BLE2902.h"
+#include "FastIMU.h"
+
+#include "../../Wii-Remote.ino"
+
+/** Default number of iterations per run. */
+#define BENCHMARK_ITERATIONS 2000000UL
+/** Number of runs, the fastest is reported. */
+#define BENCHMARK_RUNS       5
+/** ATT MTU negotiated by the simulated central. */
+#define BENCHMARK_ATT_MTU    185U
+
+/** @brief Keeps the compiler from optimizing away a result. */
+template <typename T>
+static inline void keep(const T& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+/** Rotation rates of a controller being waved around, in dps. */
+static volatile float wavingGyroDps[8] = {
+    40.0f, 120.0f, 260.0f, 120.0f, -40.0f, -120.0f, -260.0f, -120.0f
+};
+
+/** Wii Remote button pins, in the order the button IRQs are raised. */
+static const Pins_t wiiRemoteButtonPins[] = {
+    BUTTON_A_PIN, BUTTON_B_PIN, BUTTON_1_PIN, BUTTON_2_PIN, BUTTON_PLUS_PIN,
+    BUTTON_HOME_PIN, BUTTON_MINUS_PIN, DPAD_UP_PIN, DPAD_DOWN_PIN,
+    DPAD_LEFT_PIN, DPAD_RIGHT_PIN
+};
+
+/** Number of Wii Remote button pins. */
+#define BENCHMARK_BUTTON_PINS (sizeof(wiiRemoteButtonPins) / sizeof(wiiRemoteButtonPins[0]))
+
+/** Index of the next simulated IMU sample. */
+static uint32_t imuSampleIndex = 0U;
+
+/**
+ * @brief Supplies the samples of a controller being waved around, so the
+ *        rate controller stays active and every sample is reported.
+ */
+static bool readWavingSample(uint8_t address, AccelData* pAccel, GyroData* pGyro)
+{
+    (void)address;
+    const float gyroDps = wavingGyroDps[imuSampleIndex++ & 7U];
+    pAccel->accelX = gyroDps * 0.001f;
+    pAccel->accelY = 0.05f;
+    pAccel->accelZ = 1.0f;
+    pGyro->gyroX = gyroDps;
+    pGyro->gyroY = 0.5f * gyroDps;
+    pGyro->gyroZ = 0.0f;
+    return true;
+}
+
+/**
+ * @brief Connects a central and subscribes it to every characteristic, so
+ *        every notification is sent as in a session.
+ */
+static void connectCentral(void)
+{
+    BLEServer* pServer = BLEDevice::hostGetServer();
+    pServer->hostConnect(BENCHMARK_ATT_MTU);
+    for (BLEService* pService : pServer->services) {
+        for (BLECharacteristic* pCharacteristic : pService->characteristics) {
+            if ((pCharacteristic->getProperties() & BLECharacteristic::PROPERTY_NOTIFY) == 0U) {
+                continue;
+            }
+            BLE2902* pNotifier = (BLE2902*)pCharacteristic->getDescriptorByUUID(
+                                               BLEUUID((uint16_t)0x2902));
+            if (pNotifier != nullptr) {
+                pNotifier->hostWrite(true);
+            }
+        }
+    }
+}
+
+/**
+ * @struct Measurement_t
+ * @brief Fastest times per iteration of a kernel and of the reference work
+ *        run before it, in ns.
+ */
+typedef struct {
+    double ns;          /** Time of the kernel. */
+    double referenceNs; /** Time of the reference work. */
+} Measurement_t;
+
+/**
+ * @brief Reference work: integer and float arithmetic in dependent chains,
+ *        like the input paths, but independent of the firmware sources.
+ */
+static uint32_t referenceKernel(uint32_t seed)
+{
+    uint32_t state = seed | 1U;
+    float sum = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        sum += (float)(state & 0xFFFFU) * 0.001f;
+    }
+    return state + (uint32_t)sum;
+}
+
+/**
+ * @brief Runs a kernel and returns its time per iteration, in ns.
+ */
+template <typename Kernel>
+static double timeRun(Kernel kernel, unsigned long iterations)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; i++) {
+        kernel((uint32_t)i);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+/**
+ * @brief Runs a kernel several times, each right after a run of the
+ *        reference work, and returns the fastest times per iteration.
+ */
+template <typename Kernel>
+static Measurement_t measure(Kernel kernel, unsigned long iterations)
+{
+    Measurement_t best = { 0.0, 0.0 };
+    for (int run = 0; run < BENCHMARK_RUNS; run++) {
+        const double referenceNs = timeRun([](uint32_t i) {
+            keep(referenceKernel(i));
+        }, iterations);
+        const double ns = timeRun(kernel, iterations);
+        if ((run == 0) || (ns < best.ns)) {
+            best.ns = ns;
+        }
+        if ((run == 0) || (referenceNs < best.referenceNs)) {
+            best.referenceNs = referenceNs;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Prints one result as a JSON object.
+ */
+static void printResult(const char* name, const Measurement_t& measurement, bool last)
+{
+    printf("    {\"name\": \"%s\", \"unit\": \"ns/op\", \"value\": %.3f, \"relative\": %.4f}%s\n",
+           name, measurement.ns, measurement.ns / measurement.referenceNs, last ? "" : ",");
+}
+
+int main(int argc, char** argv)
+{
+    const unsigned long iterations = (argc > 1) ? strtoul(argv[1], nullptr, 10) : BENCHMARK_ITERATIONS;
+
+    // Bring the sketch up with its IMUs answering and a subscribed central
+    hostSetI2cRegister(0x68U, MPU_Traits::whoAmIRegister, IMU_Traits<WIIMOTE_IMU_TYPE>::whoAmI);
+    hostSetI2cRegister(0x69U, MPU_Traits::whoAmIRegister, IMU_Traits<NUNCHUCK_IMU_TYPE>::whoAmI);
+    hostSetImuSource(readWavingSample);
+    setup();
+    connectCentral();
+    if (!ble.isSubscribed()) {
+        fprintf(stderr, "The central could not subscribe\n");
+        return 1;
+    }
+
+    // WiiRemote::updateSensorInputs() once per active sampling period
+    const Measurement_t updateSensorNs = measure([&](uint32_t i) {
+        (void)i;
+        hostAdvanceUs(RATE_ACTIVE_PERIOD_MS * 1000U);
+        wiiRemote.updateSensorInputs();
+    }, iterations);
+
+    // Payload packing alone
+    uint8_t characteristicValue[sizeof(Wiimote_Sensor_Input_t)];
+    AccelData accelData = { 0.01f, -0.02f, 1.0f };
+    GyroData gyroData = { 0.5f, -0.25f, 0.125f };
+    const Measurement_t packSensorNs = measure([&](uint32_t i) {
+        accelData.accelX += 0.001f;
+        Wiimote_Sensor_Input_t payload = packWiimoteSensorInput(accelData, gyroData, i);
+        memcpy(characteristicValue, &payload, sizeof(payload));
+        keep(characteristicValue);
+    }, iterations);
+
+    // Button IRQ handler: pin to button mapping lookup and bit update, with
+    // every other button held down
+    for (uint32_t pin = 0U; pin < BENCHMARK_BUTTON_PINS; pin++) {
+        hostSetPin(wiiRemoteButtonPins[pin], (int)(pin & 1U));
+    }
+    const Measurement_t buttonIsrNs = measure([&](uint32_t i) {
+        WiiRemote::buttonChangeIRQHandler(wiiRemoteButtonPins[i % BENCHMARK_BUTTON_PINS]);
+    }, iterations);
+
+    // Nunchuck::updateButtonInputs(): joystick scaling, deadband check,
+    // packing and the notification
+    const Measurement_t joystickNs = measure([&](uint32_t i) {
+        (void)i;
+        nunchuck.updateButtonInputs();
+    }, iterations);
+
+    printf("{\n  \"benchmarks\": [\n");
+    printResult("firmware.wiimote_update_sensor_inputs", updateSensorNs, false);
+    printResult("firmware.wiimote_sensor_packing", packSensorNs, false);
+    printResult("firmware.button_isr", buttonIsrNs, false);
+    printResult("firmware.nunchuck_update_button_inputs", joystickNs, true);
+    printf("  ]\n}\n");
+    return 0;
+}
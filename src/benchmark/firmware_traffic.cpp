@@ -0,0 +1,406 @@
+/**
+ * @file firmware_traffic.cpp
+ * @brief Runs the sketch on the host and reports the notifications it sends.
+ * @author Humza Ali
+ *
+ * Wii-Remote.ino and the firmware sources are built unchanged against the
+ * stand-ins in host/, on a simulated clock. The IMUs replay a recorded
+ * trace, buttons and the joystick are moved at random, and a simulated
+ * central connects, subscribes to every notifying characteristic and runs
+ * time sync exchanges like pymote_controller.py. Usually built and run
+ * through link_sim.py, or by hand from the repository root:
+ *
+ *     g++ -O2 -std=gnu++11 -Isrc/benchmark/host -Isrc/include \
+ *         src/benchmark/firmware_traffic.cpp src/[A-Z]*.cpp src/benchmark/host/[A-Z]*.cpp \
+ *         -o firmware_traffic
+ *     ./firmware_traffic --trace src/test/traces/still_motion.csv
+ *
+ * Build with -DBLE_HID_GAMEPAD_MODE=1 to include the HID gamepad reports.
+ * Every line printed starts with the simulated time, in us:
+ *
+ *     <timeUs> N <characteristic> <payload in hex>   notification sent
+ *     <timeUs> P                                     end of a loop pass
+ *                                                    that notified
+ *     <timeUs> F <MHz>                               CPU frequency changed
+ *     <timeUs> Q                                     TX buffer query
+ *     <timeUs> E <key>=<value>...                    end of the run
+ *
+ * With --lockstep every query waits for the number of free controller TX
+ * buffers on stdin, so a link model can push back on the firmware the way
+ * esp_ble_get_cur_sendable_packets_num() does. Without it buffers are
+ * always free. Costs of the calls are modelled at 240MHz and scaled to the
+ * CPU frequency picked by the power governor, except for the I2C reads.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "BLEDevice.h"
+#include "BLE2902.h"
+#include "FastIMU.h"
+
+#include "../../Wii-Remote.ino"
+
+/** Default time simulated, in s. */
+#define TRAFFIC_DEFAULT_DURATION_S     30.0
+/** Default time at which the central connects, in ms. */
+#define TRAFFIC_DEFAULT_CONNECT_MS     1000U
+/** Default ATT MTU negotiated by the central. */
+#define TRAFFIC_DEFAULT_MTU            185U
+/** Default time of one IMU read at 400kHz, in us. */
+#define TRAFFIC_DEFAULT_IMU_READ_US    400U
+/** Default cost of handing a notification to the stack at 240MHz, in us. */
+#define TRAFFIC_DEFAULT_NOTIFY_US      60U
+/** Default cost of the rest of a loop pass at 240MHz, in us. */
+#define TRAFFIC_DEFAULT_LOOP_US        10U
+/** Default time sync period once synced, in ms. See time_sync.py. */
+#define TRAFFIC_DEFAULT_SYNC_PERIOD_MS 500U
+/** Default time sync period until synced, in ms. See time_sync.py. */
+#define TRAFFIC_DEFAULT_SYNC_STARTUP_PERIOD_MS 50U
+/** Default number of exchanges the host needs to be synced. */
+#define TRAFFIC_DEFAULT_SYNC_STARTUP_EXCHANGES 4U
+
+/**
+ * @struct Traffic_Config_t
+ * @brief Configuration of a run, set from the command line.
+ */
+typedef struct {
+    const char* wiiRemoteTrace;      /** IMU trace of the Wii Remote. */
+    const char* nunchuckTrace;       /** IMU trace of the Nunchuck. */
+    double durationS;                /** Time simulated, in s. */
+    uint32_t connectMs;              /** Time the central connects, in ms. */
+    uint16_t mtu;                    /** ATT MTU of the central. */
+    uint32_t imuReadUs;              /** Time of one IMU read, in us. */
+    uint32_t notifyUs;               /** Cost of a notification at 240MHz, in us. */
+    uint32_t loopUs;                 /** Cost of the rest of a pass at 240MHz, in us. */
+    double buttonRateHz;             /** Rate of button presses. */
+    double joystickRateHz;           /** Rate of joystick movements. */
+    uint32_t syncPeriodMs;           /** Time sync period once synced, in ms. */
+    uint32_t syncStartupPeriodMs;    /** Time sync period until synced, in ms. */
+    uint32_t syncStartupExchanges;   /** Exchanges until synced. */
+    unsigned seed;                   /** Seed of the button and joystick inputs. */
+    bool lockstep;                   /** Read the free TX buffers from stdin. */
+} Traffic_Config_t;
+
+/**
+ * @struct Trace_t
+ * @brief IMU trace replayed by a simulated IMU, looping.
+ */
+typedef struct {
+    std::vector<uint32_t> timestampsUs;
+    std::vector<AccelData> accel;
+    std::vector<GyroData> gyro;
+    uint64_t offsetUs;
+} Trace_t;
+
+static Traffic_Config_t config = {
+    "src/test/traces/still_motion.csv", nullptr, TRAFFIC_DEFAULT_DURATION_S,
+    TRAFFIC_DEFAULT_CONNECT_MS, TRAFFIC_DEFAULT_MTU, TRAFFIC_DEFAULT_IMU_READ_US,
+    TRAFFIC_DEFAULT_NOTIFY_US, TRAFFIC_DEFAULT_LOOP_US, 0.5, 0.2,
+    TRAFFIC_DEFAULT_SYNC_PERIOD_MS, TRAFFIC_DEFAULT_SYNC_STARTUP_PERIOD_MS,
+    TRAFFIC_DEFAULT_SYNC_STARTUP_EXCHANGES, 1U, false
+};
+static Trace_t traces[2];
+static std::mt19937 inputRandom;
+static bool passNotified = false;
+static uint32_t timeSyncSequence = 0U;
+
+/**
+ * @brief Reads an IMU trace in the timestampUs,ax,ay,az,gx,gy,gz[,label]
+ *        format.
+ */
+static bool readTrace(const char* path, Trace_t& trace)
+{
+    FILE* pTrace = fopen(path, "r");
+    if (pTrace == nullptr) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), pTrace) != nullptr) {
+        unsigned long timestampUs;
+        AccelData accel;
+        GyroData gyro;
+        if (sscanf(line, "%lu,%f,%f,%f,%f,%f,%f", &timestampUs,
+                   &accel.accelX, &accel.accelY, &accel.accelZ,
+                   &gyro.gyroX, &gyro.gyroY, &gyro.gyroZ) != 7) {
+            continue;
+        }
+        trace.timestampsUs.push_back((uint32_t)timestampUs);
+        trace.accel.push_back(accel);
+        trace.gyro.push_back(gyro);
+    }
+    fclose(pTrace);
+    if (trace.timestampsUs.size() < 2U) {
+        fprintf(stderr, "%s has no samples\n", path);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the trace sample measured at the current time, looping
+ *        over the trace. The read takes the I2C transfer time.
+ */
+static bool readTraceSample(uint8_t address, AccelData* pAccel, GyroData* pGyro)
+{
+    hostAdvanceUs(config.imuReadUs);
+    const Trace_t& trace = traces[(address == 0x68U) ? 0 : 1];
+    const uint64_t firstUs = trace.timestampsUs.front();
+    const uint64_t spanUs = trace.timestampsUs.back() - firstUs;
+    const uint64_t traceUs = firstUs + ((hostTimeUs() + trace.offsetUs) % spanUs);
+    // Latest sample taken at or before the trace time
+    size_t index = std::upper_bound(trace.timestampsUs.begin(), trace.timestampsUs.end(),
+                                    (uint32_t)traceUs) - trace.timestampsUs.begin();
+    index = (index > 0U) ? (index - 1U) : 0U;
+    *pAccel = trace.accel[index];
+    *pGyro = trace.gyro[index];
+    return true;
+}
+
+/** @brief Returns the time until the next event of a Poisson process, in us. */
+static uint64_t nextInputDelayUs(double rateHz)
+{
+    std::exponential_distribution<double> distribution(rateHz);
+    return (uint64_t)(distribution(inputRandom) * 1e6) + 1U;
+}
+
+/** @brief Presses a random button and schedules its release and the next press. */
+static void pressButton(void)
+{
+    static const Pins_t pins[] = {
+        BUTTON_A_PIN, BUTTON_B_PIN, BUTTON_1_PIN, BUTTON_2_PIN, BUTTON_PLUS_PIN,
+        BUTTON_HOME_PIN, BUTTON_MINUS_PIN, DPAD_UP_PIN, DPAD_DOWN_PIN,
+        DPAD_LEFT_PIN, DPAD_RIGHT_PIN, BUTTON_C_PIN, BUTTON_Z_PIN
+    };
+    const Pins_t pin = pins[inputRandom() % (sizeof(pins) / sizeof(pins[0]))];
+    hostSetPin(pin, 1);
+    const uint64_t holdUs = 80000U + (inputRandom() % 220000U);
+    hostSchedule(hostTimeUs() + holdUs, [pin]() { hostSetPin(pin, 0); });
+    hostSchedule(hostTimeUs() + holdUs + nextInputDelayUs(config.buttonRateHz), pressButton);
+}
+
+/** @brief Deflects the joystick and schedules its return and the next move. */
+static void moveJoystick(void)
+{
+    hostSetAnalog(JOYSTICK_VRX_PIN, (uint16_t)(inputRandom() % 4096U));
+    hostSetAnalog(JOYSTICK_VRY_PIN, (uint16_t)(inputRandom() % 4096U));
+    const uint64_t holdUs = 200000U + (inputRandom() % 600000U);
+    hostSchedule(hostTimeUs() + holdUs, []() {
+        hostSetAnalog(JOYSTICK_VRX_PIN, 2048U);
+        hostSetAnalog(JOYSTICK_VRY_PIN, 2048U);
+    });
+    hostSchedule(hostTimeUs() + holdUs + nextInputDelayUs(config.joystickRateHz), moveJoystick);
+}
+
+/** @brief Returns the characteristic with a UUID, or NULL. */
+static BLECharacteristic* findCharacteristic(const char* uuid)
+{
+    for (BLEService* pService : BLEDevice::hostGetServer()->services) {
+        for (BLECharacteristic* pCharacteristic : pService->characteristics) {
+            if (pCharacteristic->getUUID().equals(BLEUUID(uuid))) {
+                return pCharacteristic;
+            }
+        }
+    }
+    return nullptr;
+}
+
+/** @brief Writes a time sync request and schedules the next one. */
+static void requestTimeSync(void)
+{
+    Time_Sync_Request_t request;
+    request.sequence = ++timeSyncSequence;
+    findCharacteristic(TIME_SYNC_CHARACTERISTIC_UUID)->hostWrite((uint8_t*)&request,
+                                                                 sizeof(request));
+    const uint32_t periodMs = (timeSyncSequence < config.syncStartupExchanges) ?
+                              config.syncStartupPeriodMs : config.syncPeriodMs;
+    hostSchedule(hostTimeUs() + (periodMs * 1000U), requestTimeSync);
+}
+
+/** @brief Connects the central and enables every notification. */
+static void connectCentral(void)
+{
+    BLEServer* pServer = BLEDevice::hostGetServer();
+    pServer->hostConnect(config.mtu);
+    for (BLEService* pService : pServer->services) {
+        for (BLECharacteristic* pCharacteristic : pService->characteristics) {
+            if ((pCharacteristic->getProperties() & BLECharacteristic::PROPERTY_NOTIFY) == 0U) {
+                continue;
+            }
+            BLE2902* pNotifier = (BLE2902*)pCharacteristic->getDescriptorByUUID(
+                                               BLEUUID((uint16_t)0x2902));
+            if (pNotifier != nullptr) {
+                pNotifier->hostWrite(true);
+            }
+        }
+    }
+    if (config.syncPeriodMs > 0U) {
+        requestTimeSync();
+    }
+}
+
+/** @brief Returns the name link_sim.py knows a characteristic by. */
+static const char* characteristicName(BLECharacteristic* pCharacteristic)
+{
+    static const struct {
+        const char* uuid;
+        const char* name;
+    } names[] = {
+        { WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID, "wiimote_button" },
+        { WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID, "wiimote_sensor" },
+        { NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID, "nunchuck_button" },
+        { NUNCHUCK_SENSOR_INPUT_CHARACTERISTIC_UUID, "nunchuck_sensor" },
+        { TIME_SYNC_CHARACTERISTIC_UUID, "time_sync" },
+        { GESTURE_EVENT_CHARACTERISTIC_UUID, "gesture" },
+        { FLIGHT_RECORDER_CHARACTERISTIC_UUID, "flight_recorder" },
+    };
+    for (size_t i = 0; i < (sizeof(names) / sizeof(names[0])); i++) {
+        if (pCharacteristic->getUUID().equals(BLEUUID(names[i].uuid))) {
+            return names[i].name;
+        }
+    }
+    // Only the HID input report is left
+    return "hid_report";
+}
+
+/** @brief Prints a notification handed to the stack. */
+static void printNotification(BLECharacteristic* pCharacteristic)
+{
+    printf("%llu N %s ", (unsigned long long)hostTimeUs(), characteristicName(pCharacteristic));
+    const uint8_t* pData = pCharacteristic->getData();
+    for (size_t i = 0; i < pCharacteristic->getLength(); i++) {
+        printf("%02x", pData[i]);
+    }
+    printf("\n");
+    passNotified = true;
+    hostSpendUs(config.notifyUs);
+}
+
+/** @brief Returns the free TX buffers, from stdin in lockstep mode. */
+static uint16_t querySendablePackets(void)
+{
+    if (!config.lockstep) {
+        return 0xFFFFU;
+    }
+    printf("%llu Q\n", (unsigned long long)hostTimeUs());
+    fflush(stdout);
+    unsigned packets = 0U;
+    if (scanf("%u", &packets) != 1) {
+        fprintf(stderr, "Lost the link model on stdin\n");
+        exit(1);
+    }
+    return (uint16_t)packets;
+}
+
+/** @brief Parses the command line into \ref config. */
+static bool parseArguments(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++) {
+        const char* pName = argv[i];
+        if (strcmp(pName, "--lockstep") == 0) {
+            config.lockstep = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", pName);
+            return false;
+        }
+        const char* pValue = argv[++i];
+        if (strcmp(pName, "--trace") == 0) {
+            config.wiiRemoteTrace = pValue;
+        } else if (strcmp(pName, "--nunchuck-trace") == 0) {
+            config.nunchuckTrace = pValue;
+        } else if (strcmp(pName, "--duration") == 0) {
+            config.durationS = atof(pValue);
+        } else if (strcmp(pName, "--connect-ms") == 0) {
+            config.connectMs = (uint32_t)atol(pValue);
+        } else if (strcmp(pName, "--mtu") == 0) {
+            config.mtu = (uint16_t)atoi(pValue);
+        } else if (strcmp(pName, "--imu-read-us") == 0) {
+            config.imuReadUs = (uint32_t)atol(pValue);
+        } else if (strcmp(pName, "--notify-us") == 0) {
+            config.notifyUs = (uint32_t)atol(pValue);
+        } else if (strcmp(pName, "--loop-us") == 0) {
+            config.loopUs = (uint32_t)atol(pValue);
+        } else if (strcmp(pName, "--button-rate-hz") == 0) {
+            config.buttonRateHz = atof(pValue);
+        } else if (strcmp(pName, "--joystick-rate-hz") == 0) {
+            config.joystickRateHz = atof(pValue);
+        } else if (strcmp(pName, "--sync-period-ms") == 0) {
+            config.syncPeriodMs = (uint32_t)atol(pValue);
+        } else if (strcmp(pName, "--sync-startup-period-ms") == 0) {
+            config.syncStartupPeriodMs = (uint32_t)atol(pValue);
+        } else if (strcmp(pName, "--sync-startup-exchanges") == 0) {
+            config.syncStartupExchanges = (uint32_t)atol(pValue);
+        } else if (strcmp(pName, "--seed") == 0) {
+            config.seed = (unsigned)atol(pValue);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", pName);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (!parseArguments(argc, argv)) {
+        return 1;
+    }
+    if (!readTrace(config.wiiRemoteTrace, traces[0]) ||
+        !readTrace((config.nunchuckTrace != nullptr) ? config.nunchuckTrace :
+                   config.wiiRemoteTrace, traces[1])) {
+        return 1;
+    }
+    if (config.nunchuckTrace == nullptr) {
+        // Don't move both controllers the same way at the same time
+        traces[1].offsetUs = (traces[1].timestampsUs.back() - traces[1].timestampsUs.front()) / 2U;
+    }
+    inputRandom.seed(config.seed);
+    // The IMUs of the build answer their WHO_AM_I at the sketch's addresses
+    hostSetI2cRegister(0x68U, MPU_Traits::whoAmIRegister, IMU_Traits<WIIMOTE_IMU_TYPE>::whoAmI);
+    hostSetI2cRegister(0x69U, MPU_Traits::whoAmIRegister, IMU_Traits<NUNCHUCK_IMU_TYPE>::whoAmI);
+    hostSetImuSource(readTraceSample);
+    hostSetNotifyHandler(printNotification);
+    hostSetSendablePacketsHandler(querySendablePackets);
+
+    setup();
+    hostSchedule((uint64_t)config.connectMs * 1000U, connectCentral);
+    if (config.buttonRateHz > 0.0) {
+        hostSchedule(nextInputDelayUs(config.buttonRateHz), pressButton);
+    }
+    if (config.joystickRateHz > 0.0) {
+        hostSchedule(nextInputDelayUs(config.joystickRateHz), moveJoystick);
+    }
+
+    const uint64_t durationUs = (uint64_t)(config.durationS * 1e6);
+    uint32_t frequencyMhz = getCpuFrequencyMhz();
+    uint32_t frequencyChanges = 0U;
+    uint64_t passes = 0U;
+    printf("%llu F %u\n", (unsigned long long)hostTimeUs(), (unsigned)frequencyMhz);
+    while (hostTimeUs() < durationUs) {
+        passNotified = false;
+        loop();
+        hostSpendUs(config.loopUs);
+        passes++;
+        if (passNotified) {
+            printf("%llu P\n", (unsigned long long)hostTimeUs());
+        }
+        if (getCpuFrequencyMhz() != frequencyMhz) {
+            frequencyMhz = getCpuFrequencyMhz();
+            frequencyChanges++;
+            printf("%llu F %u\n", (unsigned long long)hostTimeUs(), (unsigned)frequencyMhz);
+        }
+    }
+    printf("%llu E passes=%llu subscribeToFirstReportUs=%u frequencyChanges=%u\n",
+           (unsigned long long)hostTimeUs(), (unsigned long long)passes,
+           (unsigned)ble.getSubscribeToFirstReportUs(), (unsigned)frequencyChanges);
+    return 0;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file gesture_replay.cpp
+ * @brief Replays an IMU trace through the firmware gesture detector on the
+ *        host.
+ * @author Humza Ali
+ *
+ * Usually built and run through gesture_validation.py, or by hand from the
+ * repository root:
+ *
+ *     g++ -O2 -std=gnu++11 -Isrc/include src/benchmark/gesture_replay.cpp \
+ *         src/Gesture_Detector.cpp -o gesture_replay
+ *     ./gesture_replay trace.csv
+ *
+ * The trace has a header line followed by one sample per line:
+ *
+ *     timestampUs,ax,ay,az,gx,gy,gz[,label]
+ *
+ * with the acceleration in g and the rotation rate in dps. Labels are
+ * ignored here. Every detected event is printed as
+ *
+ *     sampleUs,type,magnitude,timestampUs
+ *
+ * where sampleUs is the time of the sample the event was reported on.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "Gesture_Detector.h"
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s trace.csv\n", argv[0]);
+        return 1;
+    }
+    FILE* pTrace = fopen(argv[1], "r");
+    if (pTrace == nullptr) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    const Gesture_Detector_Config_t config = GESTURE_DETECTOR_DEFAULT_CONFIG;
+    GestureDetector detector(config, 0U);
+    Gesture_Event_t events[GESTURE_MAX_EVENTS_PER_SAMPLE];
+
+    char line[256];
+    // Skip the header
+    if (fgets(line, sizeof(line), pTrace) == nullptr) {
+        fclose(pTrace);
+        return 0;
+    }
+    printf("sampleUs,type,magnitude,timestampUs\n");
+    while (fgets(line, sizeof(line), pTrace) != nullptr) {
+        unsigned long timestampUs;
+        float ax, ay, az, gx, gy, gz;
+        if (sscanf(line, "%lu,%f,%f,%f,%f,%f,%f",
+                   &timestampUs, &ax, &ay, &az, &gx, &gy, &gz) != 7) {
+            continue;
+        }
+        const uint8_t eventCount = detector.update(ax, ay, az, gx, gy, gz,
+                                                   (uint32_t)timestampUs, events);
+        for (uint8_t i = 0; i < eventCount; i++) {
+            printf("%lu,%u,%u,%lu\n", timestampUs, (unsigned)events[i].type,
+                   (unsigned)events[i].magnitude, (unsigned long)events[i].timestampUs);
+        }
+    }
+    fclose(pTrace);
+    return 0;
+}
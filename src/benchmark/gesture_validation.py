@@ -0,0 +1,378 @@
+"""
+File: gesture_validation.py
+Description: Validates the firmware gesture detector against labeled IMU
+             traces. The detector is built for the host from
+             gesture_replay.cpp, every trace is replayed through it, and
+             the detections are matched against the labels to report
+             misses, false positives and detection latency. Exits with an
+             error if the recall or the false positive rate is out of
+             bounds:
+
+                 python gesture_validation.py                      # checked-in and synthetic traces
+                 python gesture_validation.py --trace swings.csv   # labeled recording
+                 python gesture_validation.py --save-trace out.csv # keep the synthetic trace
+
+             Traces are CSV files with a header line and one sample per
+             line: timestampUs,ax,ay,az,gx,gy,gz,label. Acceleration is in
+             g and rotation rate in dps. The label column is empty except on
+             the sample a gesture starts at (SWING_START, SHAKE, FLICK) and
+             the sample a swing peaks at (SWING_PEAK). The checked-in
+             trace, src/test/traces/gestures.csv, comes from the rigid body
+             and sensor model in generate_traces.py rather than from the
+             simple generator here, so the detector isn't only validated
+             against motion shaped like its own thresholds.
+Author: Humza Ali
+"""
+
+import argparse
+import csv
+import math
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+
+BENCHMARK_DIR = os.path.dirname(os.path.abspath(__file__))
+SOURCE_DIR = os.path.dirname(BENCHMARK_DIR)
+sys.path.insert(0, os.path.join(SOURCE_DIR, 'python'))
+
+from wire_schema import GESTURE_TYPE_NAMES
+
+# Sources of the replay tool, relative to the source directory
+REPLAY_SOURCES = [
+    'benchmark/gesture_replay.cpp',
+    'Gesture_Detector.cpp',
+]
+# Labeled gesture trace checked in with the host tests
+GESTURE_TRACE = os.path.join(SOURCE_DIR, 'test', 'traces', 'gestures.csv')
+# Time after a label within which a detection of the same type matches it, in us
+MATCH_WINDOW_US = 500000
+# Default number of synthetic gestures
+DEFAULT_GESTURES = 300
+# Default sample rate of the synthetic traces, in Hz
+DEFAULT_RATE_HZ = 100
+# Distance of the IMU from the swing pivot in the synthetic traces, in m
+SWING_RADIUS_M = 0.12
+# Standard gravity, in m/s^2
+GRAVITY = 9.80665
+# Noise of the synthetic samples
+ACCEL_NOISE_G = 0.02
+GYRO_NOISE_DPS = 2.0
+
+GESTURE_TYPES = {name: value for value, name in GESTURE_TYPE_NAMES.items()}
+
+
+def rotate(vector, axis, angle):
+    """ Rotates a vector about a unit axis by an angle, in radians. """
+    c = math.cos(angle)
+    s = math.sin(angle)
+    dot = sum(v * a for v, a in zip(vector, axis))
+    cross = (axis[1] * vector[2] - axis[2] * vector[1],
+             axis[2] * vector[0] - axis[0] * vector[2],
+             axis[0] * vector[1] - axis[1] * vector[0])
+    return tuple(v * c + x * s + a * dot * (1 - c)
+                 for v, x, a in zip(vector, cross, axis))
+
+
+class TraceGenerator(object):
+    """
+    Generates a labeled IMU trace of random swings, shakes and flicks
+    separated by rest.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, seed, rateHz):
+        self.random = random.Random(seed)
+        self.periodUs = int(1000000 / rateHz)
+        self.timeUs = 0
+        # Gravity in the sensor frame, changed by swings
+        self.gravity = (0.0, 0.0, 1.0)
+        self.rows = []
+
+    def sample(self, linear=(0.0, 0.0, 0.0), gyro=(0.0, 0.0, 0.0), label=''):
+        """ Adds a sample of the current gravity plus linear acceleration. """
+        accel = [g + l + self.random.gauss(0.0, ACCEL_NOISE_G)
+                 for g, l in zip(self.gravity, linear)]
+        rate = [w + self.random.gauss(0.0, GYRO_NOISE_DPS) for w in gyro]
+        self.rows.append([self.timeUs] + accel + rate + [label])
+        self.timeUs += self.periodUs
+
+    def randomAxis(self):
+        """ Returns one of the sensor axes with a random sign. """
+        axis = [0.0, 0.0, 0.0]
+        axis[self.random.randrange(3)] = self.random.choice((-1.0, 1.0))
+        return tuple(axis)
+
+    def rest(self):
+        for _ in range(int(self.random.uniform(0.6, 1.5) * 1000000 / self.periodUs)):
+            self.sample()
+
+    def swing(self):
+        """
+        Rotation rate follows a half sine about one axis. The IMU sits off
+        the pivot, so it also sees tangential and centripetal acceleration,
+        and gravity rotates in the sensor frame.
+        """
+        durationS = self.random.uniform(0.2, 0.4)
+        peakDps = self.random.uniform(400.0, 1000.0)
+        axis = self.randomAxis()
+        # Tangential direction is perpendicular to the rotation axis
+        tangent = rotate(self.randomPerpendicular(axis), axis, 0.0)
+        samples = max(3, int(durationS * 1000000 / self.periodUs))
+        peakIndex = samples // 2
+        dt = self.periodUs / 1000000
+        for n in range(samples):
+            phase = math.pi * n / samples
+            rateDps = peakDps * math.sin(phase)
+            rateRad = math.radians(rateDps)
+            angularAccel = math.radians(peakDps) * (math.pi / durationS) * math.cos(phase)
+            tangential = angularAccel * SWING_RADIUS_M / GRAVITY
+            centripetal = rateRad * rateRad * SWING_RADIUS_M / GRAVITY
+            radial = tuple(-c for c in self.cross(axis, tangent))
+            linear = tuple(t * tangential + r * centripetal
+                           for t, r in zip(tangent, radial))
+            label = 'SWING_START' if n == 0 else ('SWING_PEAK' if n == peakIndex else '')
+            self.sample(linear, tuple(a * rateDps for a in axis), label)
+            # Gravity turns the other way in the sensor frame
+            self.gravity = rotate(self.gravity, axis, -rateRad * dt)
+
+    def shake(self):
+        """ Sinusoidal linear acceleration along one axis. """
+        frequencyHz = self.random.uniform(4.0, 7.0)
+        amplitude = self.random.uniform(1.4, 2.2)
+        durationS = self.random.uniform(0.8, 1.2)
+        axis = self.randomAxis()
+        samples = int(durationS * 1000000 / self.periodUs)
+        for n in range(samples):
+            value = amplitude * math.sin(2 * math.pi * frequencyHz * n * self.periodUs / 1000000)
+            self.sample(tuple(a * value for a in axis),
+                        tuple(self.random.gauss(0.0, 20.0) for _ in range(3)),
+                        'SHAKE' if n == 0 else '')
+
+    def flick(self):
+        """ Short linear acceleration pulse followed by a smaller rebound. """
+        amplitude = self.random.uniform(3.5, 5.0)
+        axis = self.randomAxis()
+        pulseSamples = max(3, int(0.04 * 1000000 / self.periodUs))
+        for n in range(pulseSamples):
+            value = amplitude * math.sin(math.pi * (n + 0.5) / pulseSamples)
+            self.sample(tuple(a * value for a in axis),
+                        tuple(self.random.gauss(0.0, 30.0) for _ in range(3)),
+                        'FLICK' if n == 0 else '')
+        reboundSamples = max(3, int(0.08 * 1000000 / self.periodUs))
+        for n in range(reboundSamples):
+            value = -0.6 * math.sin(math.pi * (n + 0.5) / reboundSamples)
+            self.sample(tuple(a * value for a in axis))
+
+    def randomPerpendicular(self, axis):
+        """ Returns a sensor axis perpendicular to the given one. """
+        while True:
+            candidate = self.randomAxis()
+            if sum(c * a for c, a in zip(candidate, axis)) == 0:
+                return candidate
+
+    @staticmethod
+    def cross(a, b):
+        return (a[1] * b[2] - a[2] * b[1],
+                a[2] * b[0] - a[0] * b[2],
+                a[0] * b[1] - a[1] * b[0])
+
+    def generate(self, gestureCount):
+        """
+        Generates the trace.
+
+        Params:
+            gestureCount (int): Number of gestures.
+
+        Return:
+            (list): Trace rows.
+        """
+        self.rest()
+        for _ in range(gestureCount):
+            self.random.choice((self.swing, self.shake, self.flick))()
+            self.rest()
+        return self.rows
+
+
+def writeTrace(path, rows):
+    """ Writes a trace to a CSV file. """
+    with open(path, 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(['timestampUs', 'ax', 'ay', 'az', 'gx', 'gy', 'gz', 'label'])
+        for row in rows:
+            writer.writerow([row[0]] + [f"{v:.5f}" for v in row[1:7]] + [row[7]])
+
+
+def readLabels(path):
+    """
+    Reads the labels of a trace.
+
+    Return:
+        (list): (timestamp in us, gesture type) of every label.
+    """
+    labels = []
+    with open(path, newline='') as f:
+        reader = csv.reader(f)
+        next(reader, None)
+        for row in reader:
+            label = row[7].strip().upper() if len(row) > 7 else ''
+            # Other labels, such as MOTION, mark movements that aren't gestures
+            if label in GESTURE_TYPES:
+                labels.append((int(row[0]), GESTURE_TYPES[label]))
+    return labels
+
+
+def buildReplay(buildDir):
+    """ Builds the replay tool and returns its path. """
+    compiler = os.environ.get('CXX', 'g++')
+    if shutil.which(compiler) == None:
+        raise RuntimeError(f"{compiler} not found, set CXX")
+    binary = os.path.join(buildDir, 'gesture_replay')
+    subprocess.run([compiler, '-O2', '-std=gnu++11',
+                    '-I' + os.path.join(SOURCE_DIR, 'include')] +
+                   [os.path.join(SOURCE_DIR, s) for s in REPLAY_SOURCES] +
+                   ['-o', binary], check=True)
+    return binary
+
+
+def replay(binary, path):
+    """
+    Replays a trace through the detector.
+
+    Return:
+        (list): (sample time in us, gesture type, magnitude, event
+                timestamp in us) of every detection.
+    """
+    output = subprocess.run([binary, path], check=True, capture_output=True,
+                            text=True).stdout
+    detections = []
+    for line in output.splitlines()[1:]:
+        sampleUs, gestureType, magnitude, timestampUs = (int(v) for v in line.split(','))
+        detections.append((sampleUs, gestureType, magnitude, timestampUs))
+    return detections
+
+
+def score(labels, detections):
+    """
+    Matches the detections against the labels.
+
+    Params:
+        labels (list): (timestamp, type) of every label.
+        detections (list): (sample time, type, magnitude, timestamp) of
+                           every detection.
+
+    Return:
+        (dict): Per gesture type counts and latencies. The latency is the
+                time from the label to the sample the event was reported
+                on, and the timestamp error the difference between the
+                event timestamp and the label.
+    """
+    results = {t: {'labels': 0, 'hits': 0, 'falsePositives': 0,
+                   'latenciesUs': [], 'timestampErrorsUs': []}
+               for t in GESTURE_TYPE_NAMES}
+    unmatched = sorted(labels)
+    for labelUs, gestureType in unmatched:
+        results[gestureType]['labels'] += 1
+    for sampleUs, gestureType, _, timestampUs in detections:
+        match = None
+        for label in unmatched:
+            labelUs, labelType = label
+            if (labelType == gestureType) and (labelUs <= sampleUs <= labelUs + MATCH_WINDOW_US):
+                match = label
+                break
+        if match == None:
+            results[gestureType]['falsePositives'] += 1
+            continue
+        unmatched.remove(match)
+        entry = results[gestureType]
+        entry['hits'] += 1
+        entry['latenciesUs'].append(sampleUs - match[0])
+        entry['timestampErrorsUs'].append(timestampUs - match[0])
+    return results
+
+
+def percentile(values, q):
+    """ Returns a percentile of a list of values, or None if it is empty. """
+    if not values:
+        return None
+    values = sorted(values)
+    return values[min(len(values) - 1, int(q * len(values)))]
+
+
+def printResults(results):
+    """ Prints the per gesture type results. """
+    print(f"{'gesture':12s} {'labels':>6s} {'hits':>6s} {'missed':>6s} {'false+':>6s} "
+          f"{'latency p50':>12s} {'p95':>8s} {'max':>8s} {'stamp err p50':>14s}")
+    for gestureType, entry in sorted(results.items()):
+        latencies = entry['latenciesUs']
+        def ms(value):
+            return f"{value / 1000:.1f} ms" if value != None else '-'
+        print(f"{GESTURE_TYPE_NAMES[gestureType]:12s} {entry['labels']:6d} "
+              f"{entry['hits']:6d} {entry['labels'] - entry['hits']:6d} "
+              f"{entry['falsePositives']:6d} {ms(percentile(latencies, 0.5)):>12s} "
+              f"{ms(percentile(latencies, 0.95)):>8s} "
+              f"{ms(max(latencies) if latencies else None):>8s} "
+              f"{ms(percentile(entry['timestampErrorsUs'], 0.5)):>14s}")
+
+
+def main():
+    """ Main function handler. """
+    parser = argparse.ArgumentParser(description="Gesture detector validation")
+    parser.add_argument('--trace', action='append',
+                        help='labeled trace to validate against, may be repeated')
+    parser.add_argument('--gestures', type=int, default=DEFAULT_GESTURES,
+                        help='number of gestures in the synthetic trace')
+    parser.add_argument('--rate-hz', type=float, default=DEFAULT_RATE_HZ,
+                        help='sample rate of the synthetic trace')
+    parser.add_argument('--seed', type=int, default=1, help='synthetic trace seed')
+    parser.add_argument('--save-trace', help='file to save the synthetic trace to')
+    parser.add_argument('--min-recall', type=float, default=0.95,
+                        help='lowest allowed fraction of labels detected')
+    parser.add_argument('--max-false-positives', type=float, default=0.05,
+                        help='highest allowed false positives, as a fraction '
+                             'of the labels')
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as buildDir:
+        binary = buildReplay(buildDir)
+        traces = args.trace
+        if not traces:
+            path = args.save_trace or os.path.join(buildDir, 'synthetic.csv')
+            writeTrace(path, TraceGenerator(args.seed, args.rate_hz).generate(args.gestures))
+            traces = [GESTURE_TRACE, path]
+        labels = []
+        detections = []
+        offsetUs = 0
+        for path in traces:
+            # Line the traces up one after the other
+            traceLabels = readLabels(path)
+            traceDetections = replay(binary, path)
+            labels += [(t + offsetUs, g) for t, g in traceLabels]
+            detections += [(s + offsetUs, g, m, t + offsetUs)
+                           for s, g, m, t in traceDetections]
+            lastUs = max([t for t, _ in traceLabels] + [s for s, _, _, _ in traceDetections] + [0])
+            offsetUs += lastUs + 10 * MATCH_WINDOW_US
+
+    results = score(labels, detections)
+    printResults(results)
+
+    labelCount = sum(e['labels'] for e in results.values())
+    hitCount = sum(e['hits'] for e in results.values())
+    falsePositives = sum(e['falsePositives'] for e in results.values())
+    if labelCount == 0:
+        print("No labels found")
+        sys.exit(1)
+    recall = hitCount / labelCount
+    falsePositiveRate = falsePositives / labelCount
+    print(f"Recall {recall:.1%}, false positives {falsePositiveRate:.1%} of labels")
+    if (recall < args.min_recall) or (falsePositiveRate > args.max_false_positives):
+        print("Gesture detection is out of bounds")
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
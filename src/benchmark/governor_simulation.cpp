@@ -0,0 +1,358 @@
+/**
+ * @file governor_simulation.cpp
+ * @brief Runs the firmware CPU frequency governor against a simulated load
+ *        trace on the host.
+ * @author Humza Ali
+ *
+ * Built and run by hand from the repository root:
+ *
+ *     g++ -O2 -std=gnu++11 -Isrc/include src/benchmark/governor_simulation.cpp \
+ *         src/Power_Governor.cpp -o governor_simulation
+ *     ./governor_simulation [seed]
+ *
+ * The trace follows a play session: connect, rest, motion, vigorous motion
+ * with gestures, and rest again. Each loop pass samples whichever of the
+ * two controllers is due, the Wii Remote first. A sample costs CPU time
+ * (reading, packing, gesture detection, notifying), which scales with the
+ * clock, plus I2C time, which doesn't. How late a sample is taken after
+ * it became due is its jitter.
+ *
+ * The CPU cost of a sample on the device depends on the build (HID mode,
+ * gesture detection, debug output), so the trace is run at several load
+ * scales, with the governor and at each fixed frequency. Average current
+ * uses the ESP32 datasheet figures for each frequency with the radio in
+ * modem sleep. A run meets the budget if no sample is later than the
+ * jitter budget and no sampling deadline is missed. At each scale the
+ * governor is compared with the cheapest fixed frequency that meets it.
+ *
+ * Exits with an error if at any scale the governed run goes over the
+ * budget, draws more than the fixed frequency that meets the budget at
+ * every scale, or makes a wrong decision: it must step down during rest,
+ * boost as soon as the deadline gets shorter, and never step down within
+ * the up holdoff.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Power_Governor.h"
+
+/** Number of controllers sampled by the loop. */
+#define SIM_CONTROLLERS 2U
+/** CPU time of an empty loop pass at 240MHz, in us. */
+#define SIM_SPIN_CPU_US 5U
+
+/** Frequency levels, in MHz. */
+static const uint32_t levelsMhz[POWER_GOVERNOR_LEVEL_COUNT] = POWER_GOVERNOR_LEVELS_MHZ;
+/** Current draw at each frequency level, in mA. */
+static const double levelCurrentMa[POWER_GOVERNOR_LEVEL_COUNT] = { 31.0, 44.0, 68.0 };
+/** Scales applied to the CPU time of every sample, in %. */
+static const uint32_t loadScales[] = { 100U, 200U, 400U, 800U };
+/** Number of load scales. */
+#define SIM_SCALE_COUNT (sizeof(loadScales) / sizeof(loadScales[0]))
+
+/**
+ * @struct Sim_Phase_t
+ * @brief One phase of the load trace.
+ */
+typedef struct {
+    const char* name;     /** Name of the phase. */
+    uint32_t durationMs;  /** Length of the phase, in ms. */
+    uint32_t periodUs;    /** Sampling period of each controller, in us. */
+    uint32_t cpuUs;       /** CPU time of a sample at 240MHz, in us. */
+    uint32_t ioUs;        /** I2C time of a sample, in us. */
+    uint32_t burstCpuUs;  /** Extra CPU time of a gesture sample at 240MHz, in us. */
+    uint32_t burstChance; /** Chance of a sample being a gesture sample, in %. */
+} Sim_Phase_t;
+
+/** Load trace of a play session. */
+static const Sim_Phase_t phases[] = {
+    { "rest",     5000U, 50000U, 120U, 350U,   0U,  0U },
+    { "motion",  10000U, 10000U, 250U, 350U, 150U, 10U },
+    { "vigorous", 5000U, 10000U, 350U, 350U, 200U, 30U },
+    { "motion",   5000U, 10000U, 250U, 350U, 150U, 10U },
+    { "rest",    10000U, 50000U, 120U, 350U,   0U,  0U },
+    { "vigorous", 3000U, 10000U, 350U, 350U, 200U, 30U },
+    { "rest",     5000U, 50000U, 120U, 350U,   0U,  0U },
+};
+/** Number of phases in the load trace. */
+#define SIM_PHASE_COUNT (sizeof(phases) / sizeof(phases[0]))
+
+/**
+ * @struct Sim_Result_t
+ * @brief Outcome of a run over the load trace.
+ */
+typedef struct {
+    double averageCurrentMa;               /** Time weighted current, in mA. */
+    uint32_t maxLatenessUs;                /** Latest sample, in us. */
+    uint32_t p99LatenessUs;                /** 99th percentile sample lateness, in us. */
+    uint32_t deadlineMisses;               /** Samples taken a full period late. */
+    uint32_t switchCount;                  /** Frequency changes. */
+    double levelShare[POWER_GOVERNOR_LEVEL_COUNT]; /** Share of time at each level. */
+    uint8_t phaseStartLevel[SIM_PHASE_COUNT]; /** Level at the start of each phase. */
+    uint8_t phaseLowestLevel[SIM_PHASE_COUNT]; /** Lowest level during each phase. */
+    uint32_t lateBoosts;                   /** Shorter deadlines not answered by the top level. */
+    uint32_t holdoffViolations;            /** Step downs within the up holdoff. */
+} Sim_Result_t;
+
+/** @brief Small deterministic PRNG so runs are repeatable across platforms. */
+static uint32_t nextRandom(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/** @brief Scales CPU time measured at 240MHz to another frequency. */
+static uint32_t scaleCpuUs(uint32_t cpuUs, uint32_t frequencyMhz)
+{
+    return (cpuUs * 240U + frequencyMhz - 1U) / frequencyMhz;
+}
+
+/** @brief Indicates whether a run met the jitter budget and every deadline. */
+static bool meetsBudget(const Sim_Result_t& result, const Power_Governor_Config_t& config)
+{
+    return (result.maxLatenessUs <= config.jitterBudgetUs) && (result.deadlineMisses == 0U);
+}
+
+/**
+ * @brief Runs the load trace.
+ *
+ * @param[in] seed Seed of the sample load variation.
+ * @param[in] loadScale Scale applied to the CPU time of every sample, in %.
+ * @param[in] fixedLevel Frequency level to stay at, or -1 to run the governor.
+ * @param[in] config Thresholds used by the governor.
+ */
+static Sim_Result_t runTrace(uint32_t seed, uint32_t loadScale, int fixedLevel,
+                             const Power_Governor_Config_t& config)
+{
+    PowerGovernor governor(config);
+    uint8_t level = (fixedLevel < 0) ? governor.getLevel() : (uint8_t)fixedLevel;
+    uint32_t random = seed;
+    std::vector<uint32_t> lateness;
+    double chargeMaUs = 0.0;
+    double levelTimeUs[POWER_GOVERNOR_LEVEL_COUNT] = { 0.0, };
+    Sim_Result_t result = {};
+
+    uint64_t nowUs = 0U;
+    uint64_t phaseStartUs = 0U;
+    uint32_t lastUpMs = 0U;
+    uint32_t lastDeadlineUs = 0U;
+    // A central subscribes at the start of the trace and both controllers
+    // are primed in the same pass
+    if (fixedLevel < 0) {
+        governor.boost(0U);
+        level = governor.getLevel();
+    }
+    uint64_t nextDueUs[SIM_CONTROLLERS] = { 0U, 0U };
+    for (uint8_t p = 0U; p < SIM_PHASE_COUNT; p++) {
+        const Sim_Phase_t& phase = phases[p];
+        const uint64_t phaseEndUs = phaseStartUs + (uint64_t)phase.durationMs * 1000U;
+        result.phaseStartLevel[p] = level;
+        result.phaseLowestLevel[p] = level;
+        while (nowUs < phaseEndUs) {
+            const uint32_t frequencyMhz = levelsMhz[level];
+            uint32_t busyUs = scaleCpuUs(SIM_SPIN_CPU_US, frequencyMhz);
+            // A controller that isn't sampled may come due at any point of
+            // the pass, so it could wait for all of it
+            uint32_t shortestSampleUs = 0U;
+            bool everySampled = true;
+            for (uint8_t c = 0U; c < SIM_CONTROLLERS; c++) {
+                const uint64_t sampleUs = nowUs + busyUs;
+                if (sampleUs < nextDueUs[c]) {
+                    everySampled = false;
+                    continue;
+                }
+                const uint64_t lateUs = sampleUs - nextDueUs[c];
+                lateness.push_back((uint32_t)lateUs);
+                if (lateUs >= phase.periodUs) {
+                    result.deadlineMisses++;
+                }
+                // The rate controller schedules from the sample time
+                nextDueUs[c] = sampleUs + phase.periodUs;
+                // CPU time varies by up to 20% between samples
+                uint32_t cpuUs = phase.cpuUs + (phase.cpuUs * (nextRandom(random) % 21U)) / 100U;
+                if ((nextRandom(random) % 100U) < phase.burstChance) {
+                    cpuUs += phase.burstCpuUs;
+                }
+                const uint32_t sampleCostUs = scaleCpuUs((cpuUs * loadScale) / 100U, frequencyMhz) +
+                                              phase.ioUs;
+                if ((c == 0U) || (sampleCostUs < shortestSampleUs)) {
+                    shortestSampleUs = sampleCostUs;
+                }
+                busyUs += sampleCostUs;
+            }
+            // A sample taken in the pass only waited for the rest of it
+            const uint32_t waitUs = everySampled ? (busyUs - shortestSampleUs) : busyUs;
+            chargeMaUs += levelCurrentMa[level] * busyUs;
+            levelTimeUs[level] += busyUs;
+            nowUs += busyUs;
+            if (fixedLevel >= 0) {
+                continue;
+            }
+            const uint8_t previousLevel = level;
+            const uint32_t updateMs = (uint32_t)(nowUs / 1000U);
+            if (governor.update(busyUs, waitUs, phase.periodUs, updateMs)) {
+                // The CPU stalls while the clock switches
+                level = governor.getLevel();
+                chargeMaUs += levelCurrentMa[level] * config.switchCostUs;
+                levelTimeUs[level] += config.switchCostUs;
+                nowUs += config.switchCostUs;
+            }
+            // The sampling rate went up, so the governor must already be
+            // at the top level for the passes that follow
+            if ((lastDeadlineUs != 0U) && (phase.periodUs < lastDeadlineUs) &&
+                (level != POWER_GOVERNOR_LEVEL_COUNT - 1U)) {
+                result.lateBoosts++;
+            }
+            lastDeadlineUs = phase.periodUs;
+            result.phaseLowestLevel[p] = std::min(result.phaseLowestLevel[p], level);
+            if (level > previousLevel) {
+                lastUpMs = updateMs;
+            } else if ((level < previousLevel) && ((updateMs - lastUpMs) < config.upHoldoffMs)) {
+                result.holdoffViolations++;
+            }
+        }
+        phaseStartUs = phaseEndUs;
+    }
+
+    std::sort(lateness.begin(), lateness.end());
+    double totalUs = 0.0;
+    for (uint8_t i = 0U; i < POWER_GOVERNOR_LEVEL_COUNT; i++) {
+        totalUs += levelTimeUs[i];
+    }
+    for (uint8_t i = 0U; i < POWER_GOVERNOR_LEVEL_COUNT; i++) {
+        result.levelShare[i] = levelTimeUs[i] / totalUs;
+    }
+    result.averageCurrentMa = chargeMaUs / totalUs;
+    result.maxLatenessUs = lateness.empty() ? 0U : lateness.back();
+    result.p99LatenessUs = lateness.empty() ? 0U : lateness[(lateness.size() * 99U) / 100U];
+    result.switchCount = governor.getSwitchCount();
+    return result;
+}
+
+/** @brief Prints one row of the results table. */
+static void printResult(const char* name, const Sim_Result_t& result,
+                        const Power_Governor_Config_t& config)
+{
+    printf("%-10s %8.1f mA %9u us %9u us %7u %8u   %5.1f%% %5.1f%% %5.1f%%   %s\n",
+           name, result.averageCurrentMa, result.p99LatenessUs, result.maxLatenessUs,
+           result.deadlineMisses, result.switchCount,
+           result.levelShare[0] * 100.0, result.levelShare[1] * 100.0,
+           result.levelShare[2] * 100.0, meetsBudget(result, config) ? "yes" : "no");
+}
+
+/**
+ * @brief Checks the decisions of a governed run.
+ *
+ * @return Number of wrong decisions.
+ */
+static uint32_t checkDecisions(const Sim_Result_t& result)
+{
+    uint32_t failures = 0U;
+    for (uint8_t p = 0U; p < SIM_PHASE_COUNT; p++) {
+        if (strcmp(phases[p].name, "rest") != 0) {
+            continue;
+        }
+        if ((result.phaseStartLevel[p] > 0U) &&
+            (result.phaseLowestLevel[p] >= result.phaseStartLevel[p])) {
+            printf("Governor didn't step down during rest phase %u\n", (unsigned)p);
+            failures++;
+        }
+    }
+    if (result.lateBoosts > 0U) {
+        printf("Governor not at the top level on %u passes with a shorter deadline\n",
+               (unsigned)result.lateBoosts);
+        failures++;
+    }
+    if (result.holdoffViolations > 0U) {
+        printf("Governor stepped down %u times within the up holdoff\n",
+               (unsigned)result.holdoffViolations);
+        failures++;
+    }
+    return failures;
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t seed = (argc > 1) ? (uint32_t)strtoul(argv[1], nullptr, 10) : 1U;
+    const Power_Governor_Config_t config = POWER_GOVERNOR_DEFAULT_CONFIG;
+
+    printf("Jitter budget %u us\n", (unsigned)config.jitterBudgetUs);
+    Sim_Result_t governed[SIM_SCALE_COUNT];
+    Sim_Result_t fixed[SIM_SCALE_COUNT][POWER_GOVERNOR_LEVEL_COUNT];
+    uint32_t failures = 0U;
+    for (uint32_t s = 0U; s < SIM_SCALE_COUNT; s++) {
+        printf("\nLoad at %u%%\n", (unsigned)loadScales[s]);
+        printf("%-10s %11s %12s %12s %7s %8s   %6s %6s %6s   %s\n", "run", "current",
+               "p99 late", "max late", "misses", "switches", "80MHz", "160MHz", "240MHz", "meets budget");
+        governed[s] = runTrace(seed, loadScales[s], -1, config);
+        printResult("governor", governed[s], config);
+        for (int level = POWER_GOVERNOR_LEVEL_COUNT - 1; level >= 0; level--) {
+            char name[16];
+            snprintf(name, sizeof(name), "%uMHz", (unsigned)levelsMhz[level]);
+            fixed[s][level] = runTrace(seed, loadScales[s], level, config);
+            printResult(name, fixed[s][level], config);
+        }
+
+        if (!meetsBudget(governed[s], config)) {
+            printf("Governor went over the jitter budget\n");
+            failures++;
+        }
+        failures += checkDecisions(governed[s]);
+        int cheapest = -1;
+        for (int level = 0; level < (int)POWER_GOVERNOR_LEVEL_COUNT; level++) {
+            if (meetsBudget(fixed[s][level], config)) {
+                cheapest = level;
+                break;
+            }
+        }
+        if (cheapest < 0) {
+            printf("No fixed frequency meets the budget, the governor draws %.1f mA\n",
+                   governed[s].averageCurrentMa);
+        } else {
+            printf("Cheapest fixed frequency meeting the budget: %uMHz at %.1f mA, "
+                   "the governor draws %+.1f mA (%+.0f%%)\n",
+                   (unsigned)levelsMhz[cheapest], fixed[s][cheapest].averageCurrentMa,
+                   governed[s].averageCurrentMa - fixed[s][cheapest].averageCurrentMa,
+                   ((governed[s].averageCurrentMa / fixed[s][cheapest].averageCurrentMa) - 1.0) * 100.0);
+        }
+    }
+
+    // Without the governor, the clock has to be fixed for the heaviest load
+    // the build may have
+    int safeLevel = -1;
+    for (int level = 0; (level < (int)POWER_GOVERNOR_LEVEL_COUNT) && (safeLevel < 0); level++) {
+        safeLevel = level;
+        for (uint32_t s = 0U; s < SIM_SCALE_COUNT; s++) {
+            if (!meetsBudget(fixed[s][level], config)) {
+                safeLevel = -1;
+                break;
+            }
+        }
+    }
+    printf("\n");
+    if (safeLevel < 0) {
+        printf("No fixed frequency meets the budget at every load\n");
+    } else {
+        printf("Fixed frequency meeting the budget at every load: %uMHz\n",
+               (unsigned)levelsMhz[safeLevel]);
+        for (uint32_t s = 0U; s < SIM_SCALE_COUNT; s++) {
+            if (governed[s].averageCurrentMa > fixed[s][safeLevel].averageCurrentMa) {
+                printf("Governor draws more than %uMHz at %u%% load\n",
+                       (unsigned)levelsMhz[safeLevel], (unsigned)loadScales[s]);
+                failures++;
+            }
+        }
+    }
+    if (failures > 0U) {
+        printf("%u governor checks failed\n", (unsigned)failures);
+        return 1;
+    }
+    printf("Governor checks passed\n");
+    return 0;
+}
@@ -0,0 +1,210 @@
+/**
+ * @file Arduino.cpp
+ * @brief Host stand-in for the Arduino core: simulated clock, GPIO, the
+ *        FreeRTOS calls used by the sketch and the ESP-IDF power management
+ *        that sets the CPU frequency.
+ * @author Humza Ali
+ */
+
+#include "Arduino.h"
+#include "esp_pm.h"
+
+#include <map>
+#include <queue>
+#include <vector>
+
+EspClass ESP;
+
+struct HostSemaphore {
+    bool given;
+};
+
+/** Callback scheduled with hostSchedule(). */
+struct HostCallback {
+    uint64_t timeUs;
+    uint64_t order;
+    std::function<void(void)> callback;
+
+    bool operator>(const HostCallback& other) const
+    {
+        return (timeUs != other.timeUs) ? (timeUs > other.timeUs) : (order > other.order);
+    }
+};
+
+static uint64_t nowUs = 0U;
+static uint64_t callbackCount = 0U;
+static std::priority_queue<HostCallback, std::vector<HostCallback>,
+                           std::greater<HostCallback> > callbacks;
+static uint32_t cpuFrequencyMhz = HOST_REFERENCE_CPU_FREQUENCY_MHZ;
+/** Cycles counted up to the last frequency change, and when it happened. */
+static uint64_t cyclesAtFrequencyChange = 0U;
+static uint64_t frequencyChangeUs = 0U;
+static std::map<uint8_t, int> pinLevels;
+static std::map<uint8_t, uint16_t> analogValues;
+static std::map<uint8_t, void (*)(void)> interruptHandlers;
+
+uint64_t hostTimeUs(void)
+{
+    return nowUs;
+}
+
+void hostAdvanceUs(uint64_t us)
+{
+    const uint64_t endUs = nowUs + us;
+    while (!callbacks.empty() && (callbacks.top().timeUs <= endUs)) {
+        HostCallback due = callbacks.top();
+        callbacks.pop();
+        if (due.timeUs > nowUs) {
+            nowUs = due.timeUs;
+        }
+        due.callback();
+    }
+    nowUs = endUs;
+}
+
+void hostSpendUs(uint32_t us)
+{
+    hostAdvanceUs(((uint64_t)us * HOST_REFERENCE_CPU_FREQUENCY_MHZ) / cpuFrequencyMhz);
+}
+
+void hostSchedule(uint64_t timeUs, std::function<void(void)> callback)
+{
+    callbacks.push(HostCallback{ timeUs, callbackCount++, callback });
+}
+
+void hostSetPin(uint8_t pin, int level)
+{
+    pinLevels[pin] = level;
+    std::map<uint8_t, void (*)(void)>::iterator handler = interruptHandlers.find(pin);
+    if (handler != interruptHandlers.end()) {
+        handler->second();
+    }
+}
+
+void hostSetAnalog(uint8_t pin, uint16_t value)
+{
+    analogValues[pin] = value;
+}
+
+uint32_t micros(void)
+{
+    return (uint32_t)nowUs;
+}
+
+uint32_t millis(void)
+{
+    return (uint32_t)(nowUs / 1000U);
+}
+
+void delay(uint32_t ms)
+{
+    hostAdvanceUs((uint64_t)ms * 1000U);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)mode;
+    pinLevels[pin] = 0;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pinLevels[pin];
+}
+
+uint16_t analogRead(uint8_t pin)
+{
+    // A conversion takes about 10 us regardless of the CPU clock
+    hostAdvanceUs(10U);
+    std::map<uint8_t, uint16_t>::iterator value = analogValues.find(pin);
+    return (value != analogValues.end()) ? value->second : 2048U;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode)
+{
+    (void)mode;
+    interruptHandlers[pin] = handler;
+}
+
+bool setCpuFrequencyMhz(uint32_t frequencyMhz)
+{
+    if ((frequencyMhz != 80U) && (frequencyMhz != 160U) && (frequencyMhz != 240U)) {
+        return false;
+    }
+    // The cycle counter keeps counting, at the new rate from now on
+    cyclesAtFrequencyChange += (nowUs - frequencyChangeUs) * cpuFrequencyMhz;
+    frequencyChangeUs = nowUs;
+    cpuFrequencyMhz = frequencyMhz;
+    return true;
+}
+
+uint32_t getCpuFrequencyMhz(void)
+{
+    return cpuFrequencyMhz;
+}
+
+uint32_t EspClass::getCycleCount(void)
+{
+    return (uint32_t)(cyclesAtFrequencyChange + ((nowUs - frequencyChangeUs) * cpuFrequencyMhz));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    hostAdvanceUs((uint64_t)ticks * portTICK_PERIOD_MS * 1000U);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return new HostSemaphore{ false };
+}
+
+int xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->given = true;
+    return pdTRUE;
+}
+
+int xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    const uint64_t deadlineUs = nowUs + ((uint64_t)ticks * portTICK_PERIOD_MS * 1000U);
+    // Sleep until a callback gives the semaphore or the timeout elapses
+    while (!semaphore->given && (nowUs < deadlineUs)) {
+        uint64_t wakeUs = deadlineUs;
+        if (!callbacks.empty() && (callbacks.top().timeUs < wakeUs)) {
+            wakeUs = callbacks.top().timeUs;
+        }
+        hostAdvanceUs((wakeUs > nowUs) ? (wakeUs - nowUs) : 0U);
+    }
+    if (!semaphore->given) {
+        return pdFALSE;
+    }
+    semaphore->given = false;
+    return pdTRUE;
+}
+
+esp_err_t esp_pm_configure(const void* pConfig)
+{
+    // Nothing else runs, so the CPU stays at the maximum frequency
+    const esp_pm_config_t* pPmConfig = (const esp_pm_config_t*)pConfig;
+    if ((pPmConfig->min_freq_mhz > pPmConfig->max_freq_mhz) ||
+        !setCpuFrequencyMhz((uint32_t)pPmConfig->max_freq_mhz)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lockType, int arg, const char* name,
+                             esp_pm_lock_handle_t* pHandle)
+{
+    (void)lockType;
+    (void)arg;
+    (void)name;
+    *pHandle = (esp_pm_lock_handle_t)1;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the Arduino core used by the benchmarks.
+ * @author Humza Ali
+ *
+ * The benchmarks only need the standard headers pulled in below. The rest
+ * of the file is the part of the ESP32 Arduino core (and the FreeRTOS calls
+ * it exposes) used by the sketch, so the firmware can run on the host
+ * against a simulated clock. Those functions are defined in Arduino.cpp.
+ *
+ * Simulated time only moves when the firmware waits (delay(), vTaskDelay(),
+ * semaphores) or when a stand-in models the cost of a call with
+ * \ref hostSpendUs. Callbacks scheduled with \ref hostSchedule, e.g. a
+ * central connecting or a button being pressed, run when the clock passes
+ * their time, as the BLE stack task and the GPIO interrupts would.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <functional>
+
+// Pulled in by the core through esp32-hal.h
+#include "sdkconfig.h"
+
+#define INPUT  0x01
+#define OUTPUT 0x03
+#define CHANGE 0x03
+
+/** CPU frequency the simulated costs are given at, in MHz. */
+#define HOST_REFERENCE_CPU_FREQUENCY_MHZ 240U
+
+// Time
+uint32_t micros(void);
+uint32_t millis(void);
+void delay(uint32_t ms);
+
+// GPIO
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+static inline uint8_t digitalPinToInterrupt(uint8_t pin) { return pin; }
+
+// CPU clock
+bool setCpuFrequencyMhz(uint32_t frequencyMhz);
+uint32_t getCpuFrequencyMhz(void);
+
+class EspClass {
+public:
+    uint32_t getCycleCount(void);
+};
+
+extern EspClass ESP;
+
+template <typename T, typename U>
+static inline T min(T a, U b) { return (a < (T)b) ? a : (T)b; }
+
+// FreeRTOS
+typedef uint32_t TickType_t;
+typedef struct HostSemaphore* SemaphoreHandle_t;
+#define portTICK_PERIOD_MS 1U
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms) / portTICK_PERIOD_MS)
+#define pdTRUE             1
+#define pdFALSE            0
+
+void vTaskDelay(TickType_t ticks);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+int xSemaphoreGive(SemaphoreHandle_t semaphore);
+int xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+
+// Host simulation
+/** @brief Returns the simulated time, in us. Doesn't wrap. */
+uint64_t hostTimeUs(void);
+/**
+ * @brief Advances the simulated time, running the callbacks that fall due.
+ *
+ * @param[in] us Time to advance by, in us.
+ */
+void hostAdvanceUs(uint64_t us);
+/**
+ * @brief Advances the simulated time by the cost of a computation given at
+ *        \ref HOST_REFERENCE_CPU_FREQUENCY_MHZ, scaled to the current CPU
+ *        frequency.
+ *
+ * @param[in] us Cost at the reference frequency, in us.
+ */
+void hostSpendUs(uint32_t us);
+/**
+ * @brief Schedules a callback at a simulated time.
+ *
+ * @param[in] timeUs Time to run the callback at, in us.
+ * @param[in] callback Callback to run.
+ */
+void hostSchedule(uint64_t timeUs, std::function<void(void)> callback);
+/** @brief Sets the level read from a pin and runs its interrupt handler. */
+void hostSetPin(uint8_t pin, int level);
+/** @brief Sets the value read from an analog pin. */
+void hostSetAnalog(uint8_t pin, uint16_t value);
@@ -0,0 +1,9 @@
+/**
+ * @file BLE2902.h
+ * @brief Host stand-in for the ESP32 BLE library, see BLEDevice.h.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include "BLEDevice.h"
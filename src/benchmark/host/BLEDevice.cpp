@@ -0,0 +1,144 @@
+/**
+ * @file BLEDevice.cpp
+ * @brief Host stand-in for the ESP32 BLE library, see BLEDevice.h.
+ * @author Humza Ali
+ */
+
+#include "BLEDevice.h"
+#include "BLE2902.h"
+#include "BLEHIDDevice.h"
+#include "esp_gap_ble_api.h"
+
+#include <cstdio>
+
+static BLEServer* pHostServer = nullptr;
+static BLEAdvertising hostAdvertising;
+static std::function<void(BLECharacteristic*)> notifyHandler;
+static std::function<uint16_t(void)> sendablePacketsHandler;
+
+BLEUUID::BLEUUID(uint16_t uuid)
+{
+    char text[40];
+    snprintf(text, sizeof(text), "0000%04x-0000-1000-8000-00805f9b34fb", uuid);
+    this->uuid = text;
+}
+
+void BLE2902::hostWrite(bool enabled)
+{
+    notifications = enabled;
+    if (pCallbacks != nullptr) {
+        pCallbacks->onWrite(this);
+    }
+}
+
+BLEDescriptor* BLECharacteristic::getDescriptorByUUID(BLEUUID descriptorUuid)
+{
+    for (BLEDescriptor* pDescriptor : descriptors) {
+        if (pDescriptor->getUUID().equals(descriptorUuid)) {
+            return pDescriptor;
+        }
+    }
+    return nullptr;
+}
+
+void BLECharacteristic::notify(void)
+{
+    if (notifyHandler) {
+        notifyHandler(this);
+    }
+}
+
+void BLECharacteristic::hostWrite(const uint8_t* pData, size_t length)
+{
+    value.assign(pData, pData + length);
+    if (pCallbacks != nullptr) {
+        pCallbacks->onWrite(this);
+    }
+}
+
+BLECharacteristic* BLEService::createCharacteristic(const char* characteristicUuid,
+                                                    uint32_t properties)
+{
+    return createCharacteristic(BLEUUID(characteristicUuid), properties);
+}
+
+BLECharacteristic* BLEService::createCharacteristic(BLEUUID characteristicUuid,
+                                                    uint32_t properties)
+{
+    BLECharacteristic* pCharacteristic = new BLECharacteristic(characteristicUuid, properties);
+    characteristics.push_back(pCharacteristic);
+    return pCharacteristic;
+}
+
+BLEService* BLEServer::createService(BLEUUID uuid, uint32_t numHandles)
+{
+    (void)numHandles;
+    BLEService* pService = new BLEService(uuid);
+    services.push_back(pService);
+    return pService;
+}
+
+void BLEServer::hostConnect(uint16_t mtu)
+{
+    peerMtu = mtu;
+    if (pCallbacks != nullptr) {
+        pCallbacks->onConnect(this);
+    }
+}
+
+void BLEServer::hostDisconnect(void)
+{
+    peerMtu = 23U;
+    if (pCallbacks != nullptr) {
+        pCallbacks->onDisconnect(this);
+    }
+}
+
+BLEServer* BLEDevice::createServer(void)
+{
+    pHostServer = new BLEServer();
+    return pHostServer;
+}
+
+BLEAdvertising* BLEDevice::getAdvertising(void)
+{
+    return &hostAdvertising;
+}
+
+BLEServer* BLEDevice::hostGetServer(void)
+{
+    return pHostServer;
+}
+
+BLEHIDDevice::BLEHIDDevice(BLEServer* pServer)
+{
+    pHidService = pServer->createService(BLEUUID((uint16_t)0x1812));
+    pManufacturer = new BLECharacteristic(BLEUUID((uint16_t)0x2A29),
+                                          BLECharacteristic::PROPERTY_READ);
+}
+
+BLECharacteristic* BLEHIDDevice::inputReport(uint8_t reportId)
+{
+    (void)reportId;
+    BLECharacteristic* pReport = pHidService->createCharacteristic(
+        BLEUUID((uint16_t)0x2A4D),
+        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY);
+    pReport->addDescriptor(new BLE2902());
+    return pReport;
+}
+
+void hostSetNotifyHandler(std::function<void(BLECharacteristic*)> handler)
+{
+    notifyHandler = handler;
+}
+
+void hostSetSendablePacketsHandler(std::function<uint16_t(void)> handler)
+{
+    sendablePacketsHandler = handler;
+}
+
+uint16_t esp_ble_get_cur_sendable_packets_num(uint16_t connid)
+{
+    (void)connid;
+    return sendablePacketsHandler ? sendablePacketsHandler() : 0xFFFFU;
+}
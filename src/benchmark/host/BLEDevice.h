@@ -0,0 +1,180 @@
+/**
+ * @file BLEDevice.h
+ * @brief Host stand-in for the ESP32 BLE library used by the sketch.
+ * @author Humza Ali
+ *
+ * Mirrors the parts of the BLE library used by BLE.cpp and the services
+ * built on it. Nothing is sent over the air: the host* members let a host
+ * program act as the central (connect, subscribe, write), and the handlers
+ * set with \ref hostSetNotifyHandler and \ref hostSetSendablePacketsHandler
+ * receive the notifications and model the controller TX buffers. Defined
+ * in BLEDevice.cpp.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class BLECharacteristic;
+class BLEServer;
+
+class BLEUUID {
+public:
+    BLEUUID() {}
+    BLEUUID(const char* uuid) : uuid(uuid) {}
+    BLEUUID(const std::string& uuid) : uuid(uuid) {}
+    /** 16 bit UUIDs are expanded with the Bluetooth base UUID. */
+    BLEUUID(uint16_t uuid);
+    bool equals(const BLEUUID& other) const { return uuid == other.uuid; }
+    std::string toString(void) const { return uuid; }
+
+private:
+    std::string uuid;
+};
+
+class BLEDescriptor;
+
+class BLEDescriptorCallbacks {
+public:
+    virtual ~BLEDescriptorCallbacks() {}
+    virtual void onWrite(BLEDescriptor* pDescriptor) { (void)pDescriptor; }
+};
+
+class BLEDescriptor {
+public:
+    BLEDescriptor(BLEUUID uuid) : uuid(uuid) {}
+    virtual ~BLEDescriptor() {}
+    BLEUUID getUUID(void) const { return uuid; }
+    void setCallbacks(BLEDescriptorCallbacks* pCallbacks) { this->pCallbacks = pCallbacks; }
+
+protected:
+    BLEUUID uuid;
+    BLEDescriptorCallbacks* pCallbacks = nullptr;
+};
+
+/** Client Characteristic Configuration Descriptor (CCCD). */
+class BLE2902 : public BLEDescriptor {
+public:
+    BLE2902() : BLEDescriptor(BLEUUID((uint16_t)0x2902)) {}
+    bool getNotifications(void) const { return notifications; }
+    void setNotifications(bool enabled) { notifications = enabled; }
+    /** @brief Writes the CCCD as the central would. */
+    void hostWrite(bool enabled);
+
+private:
+    bool notifications = false;
+};
+
+class BLECharacteristicCallbacks {
+public:
+    virtual ~BLECharacteristicCallbacks() {}
+    virtual void onWrite(BLECharacteristic* pCharacteristic) { (void)pCharacteristic; }
+};
+
+class BLECharacteristic {
+public:
+    static const uint32_t PROPERTY_READ     = 1U << 0;
+    static const uint32_t PROPERTY_WRITE    = 1U << 1;
+    static const uint32_t PROPERTY_NOTIFY   = 1U << 2;
+    static const uint32_t PROPERTY_BROADCAST = 1U << 3;
+    static const uint32_t PROPERTY_INDICATE = 1U << 4;
+    static const uint32_t PROPERTY_WRITE_NR = 1U << 5;
+
+    BLECharacteristic(BLEUUID uuid, uint32_t properties) : uuid(uuid), properties(properties) {}
+    BLEUUID getUUID(void) const { return uuid; }
+    uint32_t getProperties(void) const { return properties; }
+    void setValue(uint8_t* pData, size_t length) { value.assign(pData, pData + length); }
+    void setValue(const std::string& data) { value.assign(data.begin(), data.end()); }
+    uint8_t* getData(void) { return value.data(); }
+    size_t getLength(void) const { return value.size(); }
+    void setCallbacks(BLECharacteristicCallbacks* pCallbacks) { this->pCallbacks = pCallbacks; }
+    void addDescriptor(BLEDescriptor* pDescriptor) { descriptors.push_back(pDescriptor); }
+    BLEDescriptor* getDescriptorByUUID(BLEUUID descriptorUuid);
+    /** @brief Hands the value to the notify handler, see \ref hostSetNotifyHandler. */
+    void notify(void);
+    /** @brief Writes the value as the central would. */
+    void hostWrite(const uint8_t* pData, size_t length);
+
+private:
+    BLEUUID uuid;
+    uint32_t properties;
+    std::vector<uint8_t> value;
+    std::vector<BLEDescriptor*> descriptors;
+    BLECharacteristicCallbacks* pCallbacks = nullptr;
+};
+
+class BLEService {
+public:
+    BLEService(BLEUUID uuid) : uuid(uuid) {}
+    BLECharacteristic* createCharacteristic(const char* characteristicUuid, uint32_t properties);
+    BLECharacteristic* createCharacteristic(BLEUUID characteristicUuid, uint32_t properties);
+    void start(void) {}
+    BLEUUID getUUID(void) const { return uuid; }
+    /** Characteristics created on the service. */
+    std::vector<BLECharacteristic*> characteristics;
+
+private:
+    BLEUUID uuid;
+};
+
+class BLEServerCallbacks {
+public:
+    virtual ~BLEServerCallbacks() {}
+    virtual void onConnect(BLEServer* pServer) { (void)pServer; }
+    virtual void onDisconnect(BLEServer* pServer) { (void)pServer; }
+};
+
+class BLEServer {
+public:
+    void setCallbacks(BLEServerCallbacks* pCallbacks) { this->pCallbacks = pCallbacks; }
+    BLEService* createService(BLEUUID uuid, uint32_t numHandles = 15U);
+    uint16_t getConnId(void) const { return 0U; }
+    uint16_t getPeerMTU(uint16_t connId) const { (void)connId; return peerMtu; }
+    /** @brief Connects a central that negotiated an ATT MTU. */
+    void hostConnect(uint16_t mtu);
+    /** @brief Disconnects the central. */
+    void hostDisconnect(void);
+    /** Services created on the server. */
+    std::vector<BLEService*> services;
+
+private:
+    BLEServerCallbacks* pCallbacks = nullptr;
+    uint16_t peerMtu = 23U;
+};
+
+class BLEAdvertising {
+public:
+    void addServiceUUID(const char* uuid) { (void)uuid; }
+    void addServiceUUID(BLEUUID uuid) { (void)uuid; }
+    void setAppearance(uint16_t appearance) { (void)appearance; }
+    void setScanResponse(bool enabled) { (void)enabled; }
+    void setMinPreferred(uint16_t interval) { (void)interval; }
+};
+
+class BLEDevice {
+public:
+    static void init(const std::string& deviceName) { (void)deviceName; }
+    static BLEServer* createServer(void);
+    static BLEAdvertising* getAdvertising(void);
+    static void startAdvertising(void) {}
+    /** @brief Returns the server created by \ref createServer. */
+    static BLEServer* hostGetServer(void);
+};
+
+/**
+ * @brief Sets the handler called with every notification sent, in place of
+ *        the radio.
+ */
+void hostSetNotifyHandler(std::function<void(BLECharacteristic*)> handler);
+
+/**
+ * @brief Sets the handler answering esp_ble_get_cur_sendable_packets_num(),
+ *        which models the free controller TX buffers. Buffers are always
+ *        free without one.
+ */
+void hostSetSendablePacketsHandler(std::function<uint16_t(void)> handler);
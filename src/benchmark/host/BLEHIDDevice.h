@@ -0,0 +1,34 @@
+/**
+ * @file BLEHIDDevice.h
+ * @brief Host stand-in for the ESP32 BLE library, see BLEDevice.h.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include "BLEDevice.h"
+#include "BLE2902.h"
+
+/** GAP appearance of a gamepad. */
+#define HID_GAMEPAD 0x03C4
+
+class BLEHIDDevice {
+public:
+    BLEHIDDevice(BLEServer* pServer);
+    /** @brief Creates an input report characteristic with its CCCD. */
+    BLECharacteristic* inputReport(uint8_t reportId);
+    BLECharacteristic* manufacturer(void) { return pManufacturer; }
+    void pnp(uint8_t sig, uint16_t vid, uint16_t pid, uint16_t version)
+    {
+        (void)sig; (void)vid; (void)pid; (void)version;
+    }
+    void hidInfo(uint8_t country, uint8_t flags) { (void)country; (void)flags; }
+    void reportMap(uint8_t* pMap, uint16_t length) { (void)pMap; (void)length; }
+    void setBatteryLevel(uint8_t level) { (void)level; }
+    BLEService* hidService(void) { return pHidService; }
+    void startServices(void) {}
+
+private:
+    BLEService* pHidService;
+    BLECharacteristic* pManufacturer;
+};
@@ -0,0 +1,16 @@
+/**
+ * @file BLESecurity.h
+ * @brief Host stand-in for the ESP32 BLE library, see BLEDevice.h.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include <esp_gap_ble_api.h>
+
+#include "BLEDevice.h"
+
+class BLESecurity {
+public:
+    void setAuthenticationMode(esp_ble_auth_req_t authReq) { (void)authReq; }
+};
@@ -0,0 +1,151 @@
+/**
+ * @file FastIMU.cpp
+ * @brief Host stand-in for the FastIMU library used by the benchmarks.
+ * @author Humza Ali
+ */
+
+#include "FastIMU.h"
+#include "Wire.h"
+
+/** Registers of the MPU family used by the simulated IMUs. */
+#define MPU_GYRO_CONFIG_REGISTER  0x1BU
+#define MPU_ACCEL_CONFIG_REGISTER 0x1CU
+#define MPU_DATA_REGISTER         0x3BU
+#define MPU_DATA_LENGTH           14U
+
+/** Next sample of the simulated register bursts, by address. */
+static uint16_t sampleIndices[128];
+
+static HostImuSource_t imuSource;
+
+/** Simulated accel, temperature and gyro registers of a few samples. */
+static volatile uint8_t sensorRegisters[4][MPU_DATA_LENGTH] = {
+    { 0x00, 0x10, 0xFF, 0xF0, 0x40, 0x00, 0x0A, 0x00, 0x00, 0x20, 0xFF, 0xE0, 0x00, 0x04 },
+    { 0x00, 0x12, 0xFF, 0xEE, 0x3F, 0xF0, 0x0A, 0x01, 0x00, 0x22, 0xFF, 0xDE, 0x00, 0x05 },
+    { 0xFF, 0xF0, 0x00, 0x10, 0x40, 0x10, 0x0A, 0x02, 0xFF, 0xE0, 0x00, 0x20, 0xFF, 0xFC },
+    { 0xFF, 0xEE, 0x00, 0x12, 0x40, 0x08, 0x0A, 0x03, 0xFF, 0xDE, 0x00, 0x22, 0xFF, 0xFB },
+};
+
+/** Sensitivities of the MPU ranges, by configuration value (bits 4:3). */
+static const float accelLsbPerG[4] = { 16384.0f, 8192.0f, 4096.0f, 2048.0f };
+static const float gyroLsbPerDps[4] = { 131.0f, 65.5f, 32.8f, 16.4f };
+
+/** @brief Writes a value as a saturated big endian word. */
+static void encodeWord(uint8_t* pData, float value)
+{
+    const float clamped = (value > 32767.0f) ? 32767.0f : ((value < -32768.0f) ? -32768.0f : value);
+    const int16_t word = (int16_t)clamped;
+    pData[0] = (uint8_t)((uint16_t)word >> 8);
+    pData[1] = (uint8_t)word;
+}
+
+void hostRefreshImuData(uint8_t address, uint8_t* pRegisters)
+{
+    uint8_t* pData = &pRegisters[MPU_DATA_REGISTER];
+    AccelData accel;
+    GyroData gyro;
+    if (imuSource && imuSource(address, &accel, &gyro)) {
+        const float accelScale = accelLsbPerG[(pRegisters[MPU_ACCEL_CONFIG_REGISTER] >> 3) & 3U];
+        const float gyroScale = gyroLsbPerDps[(pRegisters[MPU_GYRO_CONFIG_REGISTER] >> 3) & 3U];
+        encodeWord(&pData[0], accel.accelX * accelScale);
+        encodeWord(&pData[2], accel.accelY * accelScale);
+        encodeWord(&pData[4], accel.accelZ * accelScale);
+        encodeWord(&pData[8], gyro.gyroX * gyroScale);
+        encodeWord(&pData[10], gyro.gyroY * gyroScale);
+        encodeWord(&pData[12], gyro.gyroZ * gyroScale);
+        return;
+    }
+    volatile uint8_t* pSample = sensorRegisters[sampleIndices[address]++ & 3U];
+    for (uint8_t i = 0U; i < MPU_DATA_LENGTH; i++) {
+        pData[i] = pSample[i];
+    }
+}
+
+void hostSetImuSource(HostImuSource_t source)
+{
+    imuSource = source;
+}
+
+/** @brief Returns the configuration value (bits 4:3) of an MPU range. */
+static uint8_t rangeConfig(int range, int lowestRange)
+{
+    uint8_t config = 0U;
+    while ((config < 3U) && ((lowestRange << config) < range)) {
+        config++;
+    }
+    return (uint8_t)(config << 3);
+}
+
+/** @brief Writes a register of the simulated IMU, returns 0 if acknowledged. */
+static int writeRegister(uint8_t address, uint8_t registerAddress, uint8_t value)
+{
+    Wire.beginTransmission(address);
+    Wire.write(registerAddress);
+    Wire.write(value);
+    return (Wire.endTransmission() == 0U) ? 0 : -1;
+}
+
+int HostMpu::init(calData cal, uint8_t address)
+{
+    (void)cal;
+    this->address = address;
+    // FastIMU starts the MPUs at +/-16 g and +/-2000 dps
+    aRes = 16.0f / 32768.0f;
+    gRes = 2000.0f / 32768.0f;
+    if ((writeRegister(address, MPU_ACCEL_CONFIG_REGISTER, rangeConfig(16, 2)) != 0) ||
+        (writeRegister(address, MPU_GYRO_CONFIG_REGISTER, rangeConfig(2000, 250)) != 0)) {
+        return -1;
+    }
+    return 0;
+}
+
+void HostMpu::update()
+{
+    // Read and decode a 14 byte burst the way the MPU drivers do
+    uint8_t data[MPU_DATA_LENGTH] = { 0U, };
+    uint8_t i = 0U;
+    Wire.beginTransmission(address);
+    Wire.write(MPU_DATA_REGISTER);
+    Wire.endTransmission(false);
+    Wire.requestFrom(address, (uint8_t)MPU_DATA_LENGTH);
+    while (Wire.available() && (i < MPU_DATA_LENGTH)) {
+        data[i++] = (uint8_t)Wire.read();
+    }
+    int16_t raw[7];
+    for (int i = 0; i < 7; i++) {
+        raw[i] = (int16_t)((data[2 * i] << 8) | data[(2 * i) + 1]);
+    }
+    accel.accelX = raw[0] * aRes;
+    accel.accelY = raw[1] * aRes;
+    accel.accelZ = raw[2] * aRes;
+    gyro.gyroX = raw[4] * gRes;
+    gyro.gyroY = raw[5] * gRes;
+    gyro.gyroZ = raw[6] * gRes;
+}
+
+void HostMpu::getAccel(AccelData* out)
+{
+    *out = accel;
+}
+
+void HostMpu::getGyro(GyroData* out)
+{
+    *out = gyro;
+}
+
+int HostMpu::setAccelRange(int range)
+{
+    aRes = (float)range / 32768.0f;
+    return writeRegister(address, MPU_ACCEL_CONFIG_REGISTER, rangeConfig(range, 2));
+}
+
+int HostMpu::setGyroRange(int range)
+{
+    gRes = (float)range / 32768.0f;
+    return writeRegister(address, MPU_GYRO_CONFIG_REGISTER, rangeConfig(range, 250));
+}
+
+void HostMpu::calibrateAccelGyro(calData* cal)
+{
+    (void)cal;
+}
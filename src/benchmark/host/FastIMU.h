@@ -0,0 +1,82 @@
+/**
+ * @file FastIMU.h
+ * @brief Host stand-in for the FastIMU library used by the benchmarks.
+ * @author Humza Ali
+ *
+ * Mirrors the parts of the FastIMU interface used by IMU_Sensor.h. The
+ * drivers read and decode register bursts from the simulated IMUs of the
+ * Wire stand-in, and are defined in FastIMU.cpp so that, as with the real
+ * library, their bodies are not visible to the caller.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+
+struct AccelData {
+    float accelX;
+    float accelY;
+    float accelZ;
+};
+
+struct GyroData {
+    float gyroX;
+    float gyroY;
+    float gyroZ;
+};
+
+struct calData {
+    bool valid;
+    float accelBias[3];
+    float gyroBias[3];
+    float magBias[3];
+    float magScale[3];
+};
+
+class IMUBase {
+public:
+    virtual ~IMUBase() {}
+    virtual int init(calData cal, uint8_t address) = 0;
+    virtual void update() = 0;
+    virtual void getAccel(AccelData* out) = 0;
+    virtual void getGyro(GyroData* out) = 0;
+    virtual int setAccelRange(int range) = 0;
+    virtual int setGyroRange(int range) = 0;
+    virtual void calibrateAccelGyro(calData* cal) = 0;
+};
+
+/**
+ * Supplies the samples of the simulated IMUs in place of the stored
+ * register bursts, e.g. from a recorded trace. Called on every burst read
+ * of the accel and gyro registers with the I2C address of the IMU.
+ * Returns false to fall back to the stored bursts.
+ */
+typedef std::function<bool(uint8_t address, AccelData* pAccel, GyroData* pGyro)> HostImuSource_t;
+
+/** @brief Sets the source of the simulated IMU samples. */
+void hostSetImuSource(HostImuSource_t source);
+
+/** Simulated MPU shared by the host stand-in drivers. */
+class HostMpu : public IMUBase {
+public:
+    int init(calData cal, uint8_t address) override;
+    void update() override;
+    void getAccel(AccelData* out) override;
+    void getGyro(GyroData* out) override;
+    int setAccelRange(int range) override;
+    int setGyroRange(int range) override;
+    void calibrateAccelGyro(calData* cal) override;
+
+protected:
+    uint8_t address = 0U;
+    float aRes = 16.0f / 32768.0f;
+    float gRes = 2000.0f / 32768.0f;
+    AccelData accel = { 0.0f, 0.0f, 0.0f };
+    GyroData gyro = { 0.0f, 0.0f, 0.0f };
+};
+
+class MPU9250 : public HostMpu {};
+class MPU6500 : public HostMpu {};
+class MPU6050 : public HostMpu {};
@@ -0,0 +1,94 @@
+/**
+ * @file Wire.cpp
+ * @brief Host stand-in for the Arduino I2C library used by the benchmarks.
+ * @author Humza Ali
+ *
+ * Kept apart from the FastIMU stand-in so that, as on the device, the
+ * drivers call into the bus without seeing its bodies.
+ */
+
+#include "Wire.h"
+
+/** First accel register of the simulated IMUs, read as one burst. */
+#define MPU_DATA_REGISTER 0x3BU
+/** Number of 7-bit I2C addresses. */
+#define I2C_ADDRESS_COUNT 128U
+
+TwoWire Wire;
+
+/** Registers of the simulated I2C devices, by address. */
+static uint8_t i2cRegisters[I2C_ADDRESS_COUNT][256];
+/** Set for the addresses a simulated device answers at. */
+static bool i2cPresent[I2C_ADDRESS_COUNT];
+
+void hostSetI2cRegister(uint8_t address, uint8_t registerAddress, uint8_t value)
+{
+    i2cPresent[address & 0x7FU] = true;
+    i2cRegisters[address & 0x7FU][registerAddress] = value;
+}
+
+uint8_t hostGetI2cRegister(uint8_t address, uint8_t registerAddress)
+{
+    return i2cRegisters[address & 0x7FU][registerAddress];
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+    this->address = address & 0x7FU;
+    writeCount = 0U;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+    if (writeCount == 0U) {
+        registerAddress = data;
+    } else if (writeCount <= sizeof(writeData)) {
+        writeData[writeCount - 1U] = data;
+    }
+    writeCount++;
+    return 1U;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+    (void)sendStop;
+    if (!i2cPresent[address]) {
+        return 2U;
+    }
+    // Registers written after the first byte, with auto-increment
+    for (uint8_t i = 1U; (i < writeCount) && (i <= sizeof(writeData)); i++) {
+        i2cRegisters[address][(uint8_t)(registerAddress + i - 1U)] = writeData[i - 1U];
+    }
+    writeCount = 0U;
+    return 0U;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity)
+{
+    address &= 0x7FU;
+    if (!i2cPresent[address]) {
+        readLeft = 0U;
+        return 0U;
+    }
+    this->address = address;
+    readRegister = registerAddress;
+    readLeft = quantity;
+    if (readRegister == MPU_DATA_REGISTER) {
+        hostRefreshImuData(address, i2cRegisters[address]);
+    }
+    return quantity;
+}
+
+int TwoWire::available(void)
+{
+    return readLeft;
+}
+
+int TwoWire::read(void)
+{
+    if (readLeft == 0U) {
+        return -1;
+    }
+    readLeft--;
+    return i2cRegisters[address][readRegister++];
+}
@@ -0,0 +1,53 @@
+/**
+ * @file Wire.h
+ * @brief Host stand-in for the Arduino I2C library used by the benchmarks.
+ * @author Humza Ali
+ *
+ * Register reads and writes are modelled: a device answers at an address
+ * once one of its registers is set with \ref hostSetI2cRegister, and every
+ * other address is not acknowledged. A burst read from the accel registers
+ * of a device refreshes them with the next simulated IMU sample, encoded at
+ * the ranges in its configuration registers. Defined in Wire.cpp, the
+ * simulated IMU samples in FastIMU.cpp.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class TwoWire {
+public:
+    void begin() {}
+    void setClock(uint32_t frequency) { (void)frequency; }
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    /** @return 0 on success, 2 if no device answered at the address. */
+    uint8_t endTransmission(bool sendStop = true);
+    /** @return Number of bytes read, 0 if no device answered. */
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    int available(void);
+    int read(void);
+
+private:
+    uint8_t address = 0U;
+    uint8_t registerAddress = 0U;
+    /** Bytes written since beginTransmission(), the first selects the register. */
+    uint8_t writeCount = 0U;
+    /** Register values written since beginTransmission(). */
+    uint8_t writeData[16] = { 0U, };
+    uint8_t readRegister = 0U;
+    uint8_t readLeft = 0U;
+};
+
+extern TwoWire Wire;
+
+/** @brief Sets a register of a simulated I2C device. */
+void hostSetI2cRegister(uint8_t address, uint8_t registerAddress, uint8_t value);
+/** @brief Returns a register of a simulated I2C device. */
+uint8_t hostGetI2cRegister(uint8_t address, uint8_t registerAddress);
+/**
+ * @brief Loads the next simulated IMU sample into the accel, temperature
+ *        and gyro registers of a device. Defined in FastIMU.cpp.
+ */
+void hostRefreshImuData(uint8_t address, uint8_t* pRegisters);
@@ -0,0 +1,19 @@
+/**
+ * @file esp_gap_ble_api.h
+ * @brief Host stand-in for the Bluedroid GAP API, see BLEDevice.h.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef uint8_t esp_ble_auth_req_t;
+
+#define ESP_LE_AUTH_BOND 0x01
+
+/**
+ * @brief Returns the number of packets the controller can still buffer,
+ *        as modelled by the handler set with hostSetSendablePacketsHandler().
+ */
+uint16_t esp_ble_get_cur_sendable_packets_num(uint16_t connid);
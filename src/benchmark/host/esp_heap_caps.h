@@ -0,0 +1,19 @@
+/**
+ * @file esp_heap_caps.h
+ * @brief Host stand-in for the ESP-IDF heap API. There is no PSRAM.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_SPIRAM (1U << 10)
+
+static inline void* heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)size;
+    (void)caps;
+    return NULL;
+}
@@ -0,0 +1,10 @@
+/**
+ * @file esp_idf_version.h
+ * @brief Host stand-in for the ESP-IDF version header.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#define ESP_IDF_VERSION_MAJOR 5
+#define ESP_IDF_VERSION_MINOR 1
@@ -0,0 +1,37 @@
+/**
+ * @file esp_pm.h
+ * @brief Host stand-in for the ESP-IDF power management API.
+ * @author Humza Ali
+ *
+ * Power management is enabled, as in the Arduino core builds. The maximum
+ * frequency configured is applied to the simulated CPU clock in Arduino.h.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_ERR_INVALID_ARG 0x102
+
+typedef enum {
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+typedef struct HostPmLock* esp_pm_lock_handle_t;
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_t;
+
+esp_err_t esp_pm_configure(const void* pConfig);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lockType, int arg, const char* name,
+                             esp_pm_lock_handle_t* pHandle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
@@ -0,0 +1,14 @@
+/**
+ * @file esp_system.h
+ * @brief Host stand-in for the ESP-IDF system API.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+typedef enum {
+    ESP_RST_UNKNOWN = 0,
+    ESP_RST_POWERON = 1,
+} esp_reset_reason_t;
+
+static inline esp_reset_reason_t esp_reset_reason(void) { return ESP_RST_POWERON; }
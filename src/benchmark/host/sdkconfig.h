@@ -0,0 +1,12 @@
+/**
+ * @file sdkconfig.h
+ * @brief Host stand-in for the ESP-IDF configuration of the Arduino core.
+ * @author Humza Ali
+ *
+ * Only the options the sketch checks. The Arduino core builds ESP-IDF with
+ * power management enabled, see esp_pm.h.
+ */
+
+#pragma once
+
+#define CONFIG_PM_ENABLE 1
@@ -0,0 +1,457 @@
+"""
+File: run_benchmarks.py
+Description: Benchmark suite covering the firmware input paths (the sketch
+             compiled for the host in firmware_benchmark.cpp) and the host pipeline
+             (payload decoding, notification callbacks, DSU encoding, DSU
+             request handling and replay to UDP).
+             Results are written as JSON and compared against a stored
+             baseline. Exits with an error if any benchmark got slower than
+             the baseline by more than the tolerance:
+
+                 python run_benchmarks.py                    # run and compare
+                 python run_benchmarks.py --output out.json  # also save results
+                 python run_benchmarks.py --tolerance 0.5    # allow 50% slower
+                 python run_benchmarks.py --update-baseline  # store new baseline
+
+             Right before each run of a benchmark, fixed reference work
+             that never changes is timed too. Results are compared by
+             their time relative to the reference ('relative'), which
+             cancels out the speed of the machine and its slow spells, so
+             a baseline stored on one machine holds on another.
+Author: Humza Ali
+"""
+
+import argparse
+import glob
+import json
+import os
+import platform
+import shutil
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import types
+from binascii import crc32
+
+BENCHMARK_DIR = os.path.dirname(os.path.abspath(__file__))
+SOURCE_DIR = os.path.dirname(BENCHMARK_DIR)
+sys.path.insert(0, os.path.join(SOURCE_DIR, 'python'))
+
+# Nothing here talks to a radio, so Bleak is replaced by a stand-in when it
+# isn't installed
+try:
+    import bleak
+except ImportError:
+    bleak = types.ModuleType('bleak')
+    bleak.BleakScanner = object
+    bleak.BleakClient = object
+    bleak.exc = types.ModuleType('bleak.exc')
+    bleak.exc.BleakError = Exception
+    sys.modules['bleak'] = bleak
+    sys.modules['bleak.exc'] = bleak.exc
+
+from dsu import DSU_Server, DSU_TYPES, DSU_MAX_REQUESTS_PER_WAKEUP
+from pymote_controller import ControllerSession, SLOTS_PER_DEVICE, WIIMOTE_SLOT
+from shared_state import SharedControllerState
+from simulate_devices import simulatedNotifications
+from time_sync import hostTimeUs
+from wire_schema import (
+    WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID,
+    decodeGestureEvent, decodeNunchuckButtonJoystickInput,
+    decodeNunchuckSensorInput, decodeTimeSyncResponse,
+    decodeWiimoteButtonInput, decodeWiimoteSensorInput,
+    encodeGestureEvent, encodeNunchuckButtonJoystickInput,
+    encodeNunchuckSensorInput, encodeTimeSyncResponse,
+    encodeWiimoteButtonInput, encodeWiimoteSensorInput,
+)
+
+# Baseline the results are compared against
+BASELINE_FILE = os.path.join(BENCHMARK_DIR, 'baseline.json')
+# Allowed slowdown relative to the baseline, as a fraction
+DEFAULT_TOLERANCE = 0.25
+# Slowdowns smaller than this are never reported, in ns/op. The shortest
+# firmware benchmarks take a few ns on the host, where timer and frequency jitter alone
+# move them by more than the relative tolerance.
+DEFAULT_NOISE_FLOOR_NS = 5.0
+# Payload of the host reference work
+REFERENCE_STRUCT = struct.Struct('<6hI')
+# Number of runs of each host benchmark, the fastest is reported
+BENCHMARK_RUNS = 5
+# Number of times the suite is run. Spreading the runs of a benchmark over
+# several passes keeps a short burst of load on the machine from skewing it.
+DEFAULT_REPEAT = 3
+# Sources of the firmware benchmark, relative to the source directory. It
+# compiles the sketch in, so it needs every firmware source and host stand-in.
+FIRMWARE_SOURCES = (['benchmark/firmware_benchmark.cpp'] +
+                    sorted(os.path.relpath(p, SOURCE_DIR) for p in
+                           glob.glob(os.path.join(SOURCE_DIR, '[A-Z]*.cpp')) +
+                           glob.glob(os.path.join(BENCHMARK_DIR, 'host', '[A-Z]*.cpp'))))
+
+
+def runFirmwareBenchmarks(iterations):
+    """
+    Builds and runs the firmware kernel benchmarks.
+
+    Params:
+        iterations (int): Iterations per run, or None for the default.
+
+    Return:
+        (list): Benchmark results.
+    """
+    compiler = os.environ.get('CXX', 'g++')
+    if shutil.which(compiler) == None:
+        raise RuntimeError(f"{compiler} not found, set CXX or use --skip-firmware")
+    with tempfile.TemporaryDirectory() as buildDir:
+        binary = os.path.join(buildDir, 'firmware_benchmark')
+        subprocess.run([compiler, '-O2', '-std=gnu++11',
+                        '-I' + os.path.join(BENCHMARK_DIR, 'host'),
+                        '-I' + os.path.join(SOURCE_DIR, 'include')] +
+                       [os.path.join(SOURCE_DIR, s) for s in FIRMWARE_SOURCES] +
+                       ['-o', binary], check=True)
+        command = [binary] + ([str(iterations)] if iterations else [])
+        output = subprocess.run(command, check=True, capture_output=True,
+                                text=True).stdout
+    return json.loads(output)['benchmarks']
+
+
+def referenceWork(payload):
+    """
+    Reference work of the host side: unpacking and arithmetic in the
+    interpreter, like the decoders, but independent of the host sources.
+    """
+    a, b, c, d, e, f, timestamp = REFERENCE_STRUCT.unpack_from(payload)
+    return (a + b + c) * 3 + (d + e + f) * 3 + timestamp
+
+
+def timeRun(run, count):
+    """ Returns the time per operation of one run, in ns. """
+    start = time.perf_counter_ns()
+    run()
+    return (time.perf_counter_ns() - start) / count
+
+
+def measure(run, count):
+    """
+    Runs a benchmark several times, each right after a run of the reference
+    work, and returns the fastest times per operation.
+
+    Params:
+        run (function): Performs count operations.
+        count (int): Number of operations per run.
+
+    Return:
+        (tuple): Time per operation and reference time per operation, in ns.
+    """
+    payload = bytearray(REFERENCE_STRUCT.pack(1, -2, 3, -4, 5, -6, 10000))
+    def reference():
+        for _ in range(count):
+            referenceWork(payload)
+    best = None
+    bestReference = None
+    for _ in range(BENCHMARK_RUNS):
+        referenceNs = timeRun(reference, count)
+        nsPerOp = timeRun(run, count)
+        if (best == None) or (nsPerOp < best):
+            best = nsPerOp
+        if (bestReference == None) or (referenceNs < bestReference):
+            bestReference = referenceNs
+    return best, bestReference
+
+
+def result(name, times):
+    """
+    Returns a benchmark result entry.
+
+    Params:
+        name (String): Benchmark name.
+        times (tuple): Time per operation and reference time per operation,
+                       in ns, as returned by measure().
+    """
+    nsPerOp, referenceNs = times
+    return {'name': name, 'unit': 'ns/op', 'value': round(nsPerOp, 3),
+            'relative': round(nsPerOp / referenceNs, 4)}
+
+
+class UdpSink(object):
+    """
+    DSU client stand-in that receives and counts datagrams on a thread.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self):
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.socket.bind(('127.0.0.1', 0))
+        self.socket.settimeout(0.1)
+        self.address = self.socket.getsockname()
+        self.received = 0
+        self.running = True
+        self.thread = threading.Thread(target=self.receive, daemon=True)
+        self.thread.start()
+
+    def receive(self):
+        while self.running:
+            try:
+                self.socket.recv(1024)
+                self.received += 1
+            except socket.timeout:
+                continue
+
+    def close(self):
+        self.running = False
+        self.thread.join()
+        self.socket.close()
+
+
+def buildDsuRequest(msgType, body=b''):
+    """ Returns a DSU client request with a valid header and CRC. """
+    payload = struct.pack('<I', msgType) + body
+    header = struct.pack('<4s2HII', b"DSUC", 1001, len(payload), 0, 0)
+    return struct.pack('<4s2HII', b"DSUC", 1001, len(payload),
+                       crc32(header + payload), 0) + payload
+
+
+def createSession(sharedState):
+    """
+    Creates a controller session whose clock sync has converged, so sensor
+    samples are timestamped like on a synced device.
+    """
+    session = ControllerSession(0, sharedState)
+    session.clockSync.synced = True
+    session.clockSync.intercept = float(hostTimeUs())
+    return session
+
+
+def runHostBenchmarks(count):
+    """
+    Runs the host pipeline benchmarks.
+
+    Params:
+        count (int): Operations per run.
+
+    Return:
+        (list): Benchmark results.
+    """
+    results = []
+    sharedState = SharedControllerState(f"pymote_bench_{os.getpid()}",
+                                        SLOTS_PER_DEVICE, create=True)
+    sink = UdpSink()
+    server = DSU_Server('127.0.0.1', 0)
+    try:
+        session = createSession(sharedState)
+        callbacks = session.ble.callbacks
+
+        # Wire schema decoding of every payload notified to the host, in
+        # place from the received buffers
+        decodes = [
+            (decodeWiimoteButtonInput, encodeWiimoteButtonInput(0x50, 0x24, 0)),
+            (decodeWiimoteSensorInput, encodeWiimoteSensorInput(0.01, -0.02, 1.0, 0.5,
+                                                                -0.25, 0.125, 10000)),
+            (decodeNunchuckButtonJoystickInput, encodeNunchuckButtonJoystickInput(128, 64, 0x01)),
+            (decodeNunchuckSensorInput, encodeNunchuckSensorInput(0.01, -0.02, 1.0, 10000)),
+            (decodeTimeSyncResponse, encodeTimeSyncResponse(1, 10000, 10250)),
+            (decodeGestureEvent, encodeGestureEvent(1, 0, 720, 10000)),
+        ]
+        decodes = [(decode, bytearray(payload)) for decode, payload in decodes]
+        decodeBatch = [decodes[n % len(decodes)] for n in range(count)]
+        def decodePayloads():
+            for decode, payload in decodeBatch:
+                decode(payload)
+        results.append(result('host.wire_schema_decode',
+                              measure(decodePayloads, count)))
+
+        # Wii Remote sensor notification: decode and publish
+        sensorCallback = callbacks[WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID]
+        payloads = [encodeWiimoteSensorInput(0.01 * n, -0.02, 1.0, 0.5, -0.25,
+                                             0.125, n * 10000)
+                    for n in range(256)]
+        def sensorCallbacks():
+            for n in range(count):
+                sensorCallback(None, payloads[n & 0xFF])
+        results.append(result('host.wiimote_sensor_callback',
+                              measure(sensorCallbacks, count)))
+
+        # Mix of every notification type, as sent by a device
+        notifications = list(simulatedNotifications(0, count))
+        def mixedCallbacks():
+            for uuid, payload in notifications:
+                callbacks[uuid](None, payload)
+        results.append(result('host.notification_callbacks',
+                              measure(mixedCallbacks, count)))
+
+        # DSU pad data encoding and transmission to one client
+        server.p0list[sink.address] = time.time()
+        server.buttons1 = 0x50
+        server.buttons2 = 0x24
+        server.joystickData = (128, 64)
+        server.accelData = (0.01, -0.02, 1.0)
+        server.gyroData = (0.5, -0.25, 0.125)
+        server.motionTimestamp = hostTimeUs()
+        def transmit():
+            for _ in range(count):
+                server.transmitInputData()
+        results.append(result('host.dsu_transmit_input_data',
+                              measure(transmit, count)))
+
+        # Burst of client requests drained in one wakeup, a quarter of
+        # them invalid, as sent by a client flooding the server
+        requests = [buildDsuRequest(DSU_TYPES.DSUC_VersionReq.value),
+                    buildDsuRequest(DSU_TYPES.DSUC_ListPorts.value,
+                                    struct.pack('<I', 1) + bytes([0])),
+                    buildDsuRequest(DSU_TYPES.DSUC_PadDataReq.value,
+                                    struct.pack('<2B6s', 0, 0, bytes(6))),
+                    buildDsuRequest(DSU_TYPES.DSUC_VersionReq.value)[:-1] + b'\x00']
+        burst = [requests[n % len(requests)] for n in range(DSU_MAX_REQUESTS_PER_WAKEUP)]
+        serverAddress = server.dsuSocket.getsockname()
+        def requestFlood():
+            for _ in range(count // len(burst)):
+                for data in burst:
+                    sink.socket.sendto(data, serverAddress)
+                server.communicateWithDsuClient()
+        results.append(result('host.dsu_request_flood',
+                              measure(requestFlood, (count // len(burst)) * len(burst))))
+
+        # Full pipeline: notification, shared state, DSU output, UDP
+        server.attachSharedState(sharedState, WIIMOTE_SLOT)
+        def replay():
+            for uuid, payload in notifications:
+                callbacks[uuid](None, payload)
+                if server.loadSharedState():
+                    server.transmitInputData()
+        results.append(result('host.replay_to_udp',
+                              measure(replay, count)))
+    finally:
+        sink.close()
+        server.dsuSocket.close()
+        sharedState.close()
+    if sink.received == 0:
+        raise RuntimeError("The DSU client stand-in received no packets")
+    return results
+
+
+def fastest(results, newResults):
+    """
+    Merges two sets of results, keeping the fastest value of each benchmark.
+
+    Params:
+        results (list): Benchmark results, possibly empty.
+        newResults (list): Benchmark results of another pass.
+
+    Return:
+        (list): Merged benchmark results.
+    """
+    if not results:
+        return newResults
+    entries = {b['name']: b for b in newResults}
+    return [dict(b, **{key: min(b[key], entries.get(b['name'], b)[key])
+                       for key in ('value', 'relative')})
+            for b in results]
+
+
+def compare(results, baseline, tolerance, noiseFloorNs):
+    """
+    Compares the times relative to the reference work against a baseline.
+    The baseline is printed in ns/op as it would run on this machine now.
+
+    Params:
+        results (list): Benchmark results.
+        baseline (dict): Baseline results.
+        tolerance (float): Allowed slowdown, as a fraction.
+        noiseFloorNs (float): Smallest slowdown reported, in ns/op.
+
+    Return:
+        (list): Names of the benchmarks that regressed.
+    """
+    baselineRelatives = {b['name']: b.get('relative')
+                         for b in baseline.get('benchmarks', [])}
+    regressions = []
+    print(f"{'benchmark':40s} {'ns/op':>12s} {'baseline':>12s} {'change':>8s}")
+    for entry in results:
+        name = entry['name']
+        value = entry['value']
+        baselineRelative = baselineRelatives.get(name)
+        if baselineRelative == None:
+            print(f"{name:40s} {value:12.2f} {'-':>12s} {'new':>8s}")
+            continue
+        change = (entry['relative'] - baselineRelative) / baselineRelative
+        # Baseline time on this machine now
+        expected = value / (1.0 + change)
+        flag = ''
+        if (change > tolerance) and ((value - expected) > noiseFloorNs):
+            regressions.append(name)
+            flag = '  REGRESSION'
+        print(f"{name:40s} {value:12.2f} {expected:12.2f} {change:+8.1%}{flag}")
+    return regressions
+
+
+def main():
+    """ Main function handler. """
+    parser = argparse.ArgumentParser(description="Firmware and host benchmark suite")
+    parser.add_argument('--baseline', default=BASELINE_FILE,
+                        help='baseline results to compare against')
+    parser.add_argument('--output', help='file to write the results to')
+    parser.add_argument('--tolerance', type=float, default=DEFAULT_TOLERANCE,
+                        help='allowed slowdown relative to the baseline, '
+                             'as a fraction')
+    parser.add_argument('--noise-floor', type=float, default=DEFAULT_NOISE_FLOOR_NS,
+                        help='smallest slowdown reported as a regression, '
+                             'in ns/op')
+    parser.add_argument('--update-baseline', action='store_true',
+                        help='store the results as the new baseline')
+    parser.add_argument('--skip-firmware', action='store_true',
+                        help='skip the firmware kernel benchmarks')
+    parser.add_argument('--skip-host', action='store_true',
+                        help='skip the host pipeline benchmarks')
+    parser.add_argument('--repeat', type=int, default=DEFAULT_REPEAT,
+                        help='number of times the suite is run, the fastest '
+                             'result of each benchmark is kept')
+    parser.add_argument('--firmware-iterations', type=int,
+                        help='iterations per firmware benchmark run')
+    parser.add_argument('--host-operations', type=int, default=20000,
+                        help='operations per host benchmark run')
+    args = parser.parse_args()
+
+    benchmarks = []
+    for _ in range(args.repeat):
+        suite = []
+        if not args.skip_firmware:
+            suite += runFirmwareBenchmarks(args.firmware_iterations)
+        if not args.skip_host:
+            suite += runHostBenchmarks(args.host_operations)
+        benchmarks = fastest(benchmarks, suite)
+    results = {
+        'machine': platform.machine(),
+        'python': platform.python_version(),
+        'benchmarks': benchmarks,
+    }
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(results, f, indent=2)
+    if args.update_baseline:
+        with open(args.baseline, 'w') as f:
+            json.dump(results, f, indent=2)
+            f.write('\n')
+        print(f"Stored {len(benchmarks)} results in {args.baseline}")
+        return
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    else:
+        print(f"No baseline at {args.baseline}, nothing to compare against")
+    regressions = compare(benchmarks, baseline, args.tolerance, args.noise_floor)
+    if regressions:
+        print(f"{len(regressions)} benchmarks regressed by more than "
+              f"{args.tolerance:.0%}: {', '.join(regressions)}")
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
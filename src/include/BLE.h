@@ -10,13 +10,38 @@
 #include <BLEUtils.h>
 #include <BLEServer.h>
 #include <BLE2902.h>
+#include <atomic>
 
 #include "generic_types.h"
+#include "HID_Gamepad.h"
 #include "IMU_Sensor.h"
-#include "generic_types.h"
+#include "wire_schema.h"
 
-/** BLE Service UUID */
-#define SERVICE_UUID "06a1ef1c-d8f5-4839-bf3a-cf1deed694d2"
+#if BLE_HID_GAMEPAD_MODE
+#include <BLEHIDDevice.h>
+#include <BLESecurity.h>
+#endif
+
+/** Maximum number of notifying characteristics tracked by \ref BLE. */
+#define BLE_MAX_CHARACTERISTICS 8U
+/**
+ * Attribute handles reserved for the input service: the service
+ * declaration, plus a declaration, value and CCCD per characteristic.
+ */
+#define BLE_SERVICE_HANDLE_COUNT (1U + (3U * BLE_MAX_CHARACTERISTICS))
+
+/**
+ * @enum BLE_Connection_State_t
+ * @brief Connection state of the BLE server.
+ */
+typedef enum {
+    /** No central is connected. */
+    BLE_STATE_DISCONNECTED = 0,
+    /** A central is connected but has not enabled any notifications. */
+    BLE_STATE_CONNECTED    = 1,
+    /** A central is connected and has enabled notifications (CCCD). */
+    BLE_STATE_SUBSCRIBED   = 2,
+} BLE_Connection_State_t;
 
 class BLE 
 {
@@ -49,27 +74,189 @@ public:
      * @param[in] characteristicUuid The designated UUID of the characteristic.
      * @param[in, out] pCharacteristic Pointer to a BLE characteristic object.
      * @param[in, out] pNotifier Pointer to a BLE notifier object.
+     * @param[in] properties Properties of the characteristic. Notify-only
+     *                       by default.
      *
      * @return Status code indicating the result of the call.
      */
     status_t createCharacteristic(const char* characteristicUuid,
                                   BLECharacteristic*& pCharacteristic,
-                                  BLE2902*& pNotifier);
+                                  BLE2902*& pNotifier,
+                                  uint32_t properties = BLECharacteristic::PROPERTY_NOTIFY);
+
+#if BLE_HID_GAMEPAD_MODE
+    /**
+     * @brief Creates the HID-over-GATT gamepad service. Must be called
+     *        before \ref startAdvertising.
+     *
+     * @return Status code indicating the result of the call.
+     */
+    status_t initHidGamepad(void);
+
+    /**
+     * @brief Sends the current \ref hidGamepad state as an input report,
+     *        if it changed since the last report.
+     */
+    void notifyHidReport(void);
+#endif
 
     /**
      * @brief Notifies the data stored in a characteristic.
      *
+     * Never blocks. If the controller has no free TX buffer, the
+     * notification is held back until \ref flushPendingNotifications finds
+     * one, and sends the value the characteristic has by then, so the
+     * newest report wins. Must not be called from the BLE stack tasks.
+     *
      * @param[in] pCharacterisitic Pointer to a BLE characteristic object.
      */
     void notifyCharacterisitic(BLECharacteristic* pCharacteristic);
 
+    /**
+     * @brief Sends the notifications held back for lack of TX buffers, as
+     *        far as the controller has buffers for them. Called once per
+     *        loop pass.
+     */
+    void flushPendingNotifications(void);
+
+    /**
+     * @brief Returns the current connection state.
+     */
+    BLE_Connection_State_t getConnectionState(void) const { return connectionState.load(); };
+
+    /**
+     * @brief Indicates whether a central has enabled notifications on
+     *        at least one characteristic.
+     */
+    bool isSubscribed(void) const { return connectionState.load() == BLE_STATE_SUBSCRIBED; };
+
+    /**
+     * @brief Blocks until a central subscribes or the timeout elapses.
+     *
+     * Used to suspend sampling while no central is listening, without
+     * delaying the first report once one subscribes.
+     *
+     * @param[in] timeoutMs Maximum time to wait, in ms.
+     *
+     * @return True if a central is subscribed.
+     */
+    bool waitForSubscriber(uint32_t timeoutMs);
+
+    /**
+     * @brief Indicates, once, that a central has just subscribed and the
+     *        latest input state should be reported immediately.
+     *
+     * @return True if the controllers should prime their inputs.
+     */
+    bool consumePrimeRequest(void) { return primeRequested.exchange(false); };
+
+    /**
+     * @brief Returns the time from the last connection to the first
+     *        notification sent on it, in us. 0 if not measured yet.
+     */
+    uint32_t getConnectToFirstReportUs(void) const { return connectToFirstReportUs; };
+
+    /**
+     * @brief Returns the time from the last subscription to the first
+     *        notification sent on it, in us. 0 if not measured yet.
+     */
+    uint32_t getSubscribeToFirstReportUs(void) const { return subscribeToFirstReportUs; };
+
+    /**
+     * @brief Handles a central connecting. Called from the BLE stack.
+     */
+    void handleConnect(void);
+
+    /**
+     * @brief Handles a central disconnecting. Called from the BLE stack.
+     */
+    void handleDisconnect(void);
+
+    /**
+     * @brief Handles a central writing a CCCD. Called from the BLE stack.
+     */
+    void handleSubscriptionChange(void);
+
     /** Pointer to a BLE service object. */
     BLEServer* pServer = nullptr;
 
     /** Pointer to a BLE server object. */
     BLEService* pService = nullptr;
 
+    /** Latest gamepad state, reported through the HID service. */
+    HidGamepad hidGamepad;
+
 private:
+    /**
+     * @brief Returns the subscription bit of a characteristic, or 0 if the
+     *        characteristic was not created through \ref createCharacteristic.
+     */
+    uint32_t getSubscriptionBit(BLECharacteristic* pCharacteristic) const;
+
+    /**
+     * @brief Indicates whether the controller has a free TX buffer.
+     */
+    bool hasTxBuffer(void) const;
+
+    /**
+     * @brief Hands a notification to the stack.
+     *
+     * @param[in] pCharacteristic Pointer to a BLE characteristic object.
+     * @param[in] subscriptionBit Subscription bit of the characteristic.
+     */
+    void sendNotification(BLECharacteristic* pCharacteristic, uint32_t subscriptionBit);
+
+    /**
+     * @brief Tracks a characteristic and its CCCD for subscriber checks.
+     *
+     * @param[in] pCharacteristic Pointer to a BLE characteristic object.
+     * @param[in] pNotifier Pointer to the CCCD of the characteristic.
+     * @param[in] persistent Set if the CCCD value is kept across connections,
+     *                       as bonded HID hosts expect.
+     *
+     * @return Status code indicating the result of the call.
+     */
+    status_t trackCharacteristic(BLECharacteristic* pCharacteristic,
+                                 BLE2902* pNotifier, bool persistent);
+
     /** Name of the BLE device. */
     const char* deviceName;
+    /** Current connection state, written from the BLE stack callbacks. */
+    std::atomic<BLE_Connection_State_t> connectionState{BLE_STATE_DISCONNECTED};
+    /** Bit mask of the characteristics with notifications enabled. */
+    std::atomic<uint32_t> subscribedMask{0U};
+    /** Set when a central subscribes, cleared by \ref consumePrimeRequest. */
+    std::atomic<bool> primeRequested{false};
+    /** Set when a central subscribes, cleared by the first notification. */
+    std::atomic<bool> firstReportPending{false};
+    /** Given when a central subscribes, used by \ref waitForSubscriber. */
+    SemaphoreHandle_t subscribeSemaphore = nullptr;
+    /** ATT MTU of the connected central, 0 if unknown. */
+    uint16_t peerMtu = 0U;
+    /** Time of the last connection, in us. */
+    uint32_t connectTimeUs = 0U;
+    /** Time of the last subscription, in us. */
+    uint32_t subscribeTimeUs = 0U;
+    /** Time from the last connection to the first notification, in us. */
+    uint32_t connectToFirstReportUs = 0U;
+    /** Time from the last subscription to the first notification, in us. */
+    uint32_t subscribeToFirstReportUs = 0U;
+    /** Bit mask of the characteristics with a notification held back. */
+    uint32_t pendingMask = 0U;
+    /** Index of the last characteristic sent by \ref flushPendingNotifications. */
+    uint8_t lastFlushedIndex = BLE_MAX_CHARACTERISTICS - 1U;
+    /** Characteristics created through \ref createCharacteristic. */
+    BLECharacteristic* characteristics[BLE_MAX_CHARACTERISTICS] = { nullptr, };
+    /** CCCDs of the characteristics in \ref characteristics. */
+    BLE2902* notifiers[BLE_MAX_CHARACTERISTICS] = { nullptr, };
+    /** Number of characteristics created. */
+    uint8_t characteristicCount = 0U;
+    /** Bit mask of the characteristics whose CCCD persists across connections. */
+    uint32_t persistentMask = 0U;
+#if BLE_HID_GAMEPAD_MODE
+    /** Pointer to the HID device object. */
+    BLEHIDDevice* pHidDevice = nullptr;
+    /** Pointer to the HID input report characteristic object. */
+    BLECharacteristic* pHidInputCharacteristic = nullptr;
+#endif
 };
\ No newline at end of file
@@ -0,0 +1,121 @@
+/**
+ * @file Controller_Inputs.h
+ * @brief Input packing and scaling shared by the controllers.
+ * @author Humza Ali
+ *
+ * These are the per-sample kernels of the input paths. They have no
+ * Arduino or BLE dependencies, so the host benchmarks in src/benchmark
+ * compile the exact code that runs on the device.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "FastIMU.h"
+#include "wire_schema.h"
+
+/** Right shift value to scale down the digital read on the axis pins */
+#define JOYSTICK_SCALE_DOWN_SHIFT 4U
+/**
+ * Minimum change in a scaled joystick axis that is transmitted while the
+ * Nunchuck is idle. Filters out ADC noise on a resting joystick.
+ */
+#define JOYSTICK_IDLE_DEADBAND 2U
+
+/**
+ * @brief Sets or clears the bits of a button in a button input bit field.
+ *        Called from the button IRQ handlers.
+ *
+ * @param[in,out] buttonInput Button input bit field.
+ * @param[in] buttonBits Bits of the button that changed.
+ * @param[in] pressed Indicates whether the button is pressed.
+ */
+template <typename T>
+inline void updateButtonBits(T& buttonInput, T buttonBits, bool pressed)
+{
+    if (pressed) {
+        buttonInput |= buttonBits;
+    } else {
+        buttonInput &= (T)~buttonBits;
+    }
+}
+
+/**
+ * @brief Scales a 12-bit joystick axis reading down to 0-255.
+ *
+ * @param[in] rawValue Analog reading of the axis pin.
+ */
+inline uint8_t scaleJoystickAxis(uint16_t rawValue)
+{
+    return (uint8_t)(rawValue >> JOYSTICK_SCALE_DOWN_SHIFT);
+}
+
+/**
+ * @brief Indicates whether both joystick axes are within the idle deadband
+ *        of the last transmitted values.
+ *
+ * @param[in] last Last transmitted joystick input.
+ * @param[in] xAxisValue Scaled X axis value.
+ * @param[in] yAxisValue Scaled Y axis value.
+ */
+inline bool isJoystickWithinDeadband(const Nunchuck_Button_Joystick_Input_t& last,
+                                     uint8_t xAxisValue, uint8_t yAxisValue)
+{
+    return (abs(xAxisValue - last.joystickX) < (int)JOYSTICK_IDLE_DEADBAND) &&
+           (abs(yAxisValue - last.joystickY) < (int)JOYSTICK_IDLE_DEADBAND);
+}
+
+/**
+ * @brief Packs the Wii Remote button bits into their payload.
+ *
+ * @param[in] buttons DS4 button bits.
+ */
+inline Wiimote_Button_Input_t packWiimoteButtonInput(uint32_t buttons)
+{
+    Wiimote_Button_Input_t payload;
+    payload.buttons1 = (uint8_t)(buttons & 0xFFU);
+    payload.buttons2 = (uint8_t)((buttons >> 8) & 0xFFU);
+    payload.reserved = 0U;
+    return payload;
+}
+
+/**
+ * @brief Packs a Wii Remote accelerometer and gyroscope sample into its
+ *        payload.
+ *
+ * @param[in] accelData Accelerometer data, in g.
+ * @param[in] gyroData Gyroscope data, in dps.
+ * @param[in] sampleTimeUs Device time the sample was taken at, in us.
+ */
+inline Wiimote_Sensor_Input_t packWiimoteSensorInput(const AccelData& accelData,
+                                                     const GyroData& gyroData,
+                                                     uint32_t sampleTimeUs)
+{
+    Wiimote_Sensor_Input_t payload;
+    payload.accelX = accelData.accelX;
+    payload.accelY = accelData.accelY;
+    payload.accelZ = accelData.accelZ;
+    payload.gyroX = gyroData.gyroX;
+    payload.gyroY = gyroData.gyroY;
+    payload.gyroZ = gyroData.gyroZ;
+    payload.timestampUs = sampleTimeUs;
+    return payload;
+}
+
+/**
+ * @brief Packs a Nunchuck accelerometer sample into its payload.
+ *
+ * @param[in] accelData Accelerometer data, in g.
+ * @param[in] sampleTimeUs Device time the sample was taken at, in us.
+ */
+inline Nunchuck_Sensor_Input_t packNunchuckSensorInput(const AccelData& accelData,
+                                                       uint32_t sampleTimeUs)
+{
+    Nunchuck_Sensor_Input_t payload;
+    payload.accelX = accelData.accelX;
+    payload.accelY = accelData.accelY;
+    payload.accelZ = accelData.accelZ;
+    payload.timestampUs = sampleTimeUs;
+    return payload;
+}
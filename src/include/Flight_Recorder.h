@@ -0,0 +1,190 @@
+/**
+ * @file Flight_Recorder.h
+ * @brief On-device flight recorder header file.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "generic_types.h"
+#include "wire_schema.h"
+
+class BLE;
+class BLECharacteristic;
+class BLE2902;
+
+/** Number of events kept by the flight recorder. Must be a power of two. */
+#define FLIGHT_RECORDER_EVENT_COUNT         512U
+/** Set to 1 to keep the events in PSRAM on boards that have it. */
+#define FLIGHT_RECORDER_USE_PSRAM           0
+/** Number of events recorded after a trigger before the recorder freezes. */
+#define FLIGHT_RECORDER_POST_TRIGGER_EVENTS 32U
+/** Number of events per downloaded chunk. */
+#define FLIGHT_RECORDER_CHUNK_EVENTS        60U
+/**
+ * Loop pass duration recorded as an overrun, in us. A pass normally takes
+ * a few ms while active and never waits on the link, so an overrun means
+ * the I2C reads or the BLE stack held the loop up.
+ */
+#define FLIGHT_RECORDER_LOOP_OVERRUN_US     30000U
+/** Event types that freeze the recorder. */
+#define FLIGHT_RECORDER_DEFAULT_TRIGGERS    ((1U << FLIGHT_EVENT_LOOP_OVERRUN) |   \
+                                             (1U << FLIGHT_EVENT_I2C_ERROR) |      \
+                                             (1U << FLIGHT_EVENT_NOTIFY_FAILURE))
+/** Freeze index used while no trigger has fired. */
+#define FLIGHT_RECORDER_NOT_TRIGGERED       0xFFFFFFFFU
+
+static_assert((FLIGHT_RECORDER_EVENT_COUNT & (FLIGHT_RECORDER_EVENT_COUNT - 1U)) == 0U,
+              "FLIGHT_RECORDER_EVENT_COUNT must be a power of two");
+// Chunks are read with long reads, which the stack limits to 512 bytes
+static_assert((sizeof(Flight_Recorder_Chunk_Header_t) +
+               (FLIGHT_RECORDER_CHUNK_EVENTS * sizeof(Flight_Recorder_Event_t))) <= 512U,
+              "Flight recorder chunks must fit in one attribute value");
+
+/**
+ * @class FlightRecorder
+ * @brief Fixed-size ring of compact binary events used to diagnose hitches.
+ *
+ * Recording an event costs an atomic increment and an 8 byte store, so it
+ * can be left enabled in release builds. The recorder keeps running until
+ * one of the trigger events is recorded, then records a few more events
+ * and freezes, so the ring holds the lead-up to the anomaly and what came
+ * right after it. The host downloads the ring in chunks over the flight
+ * recorder characteristic.
+ *
+ * @note Timestamps come from the cycle counter of the core that recorded
+ *       the event. The counters of the two cores are close but not
+ *       synchronized, and wrap every few seconds at full clock speed. They
+ *       count at the CPU frequency, so frequency changes are recorded with
+ *       \ref recordCpuFrequency for the host to convert each stretch at its
+ *       own frequency.
+ */
+class FlightRecorder
+{
+public:
+    /**
+     * @brief Allocates the ring and creates the download characteristic.
+     *
+     * @param[in] pBle Pointer to a BLE object used to create the
+     *                 flight recorder characteristic.
+     *
+     * @return Status code indicating the result of the call.
+     */
+    status_t initFlightRecorder(BLE* pBle);
+
+    /**
+     * @brief Records an event. Safe to call from any task.
+     *
+     * @param[in] type Type of the event.
+     * @param[in] arg Event specific argument.
+     * @param[in] value Event specific value.
+     */
+    void record(Flight_Event_Type_t type, uint8_t arg = 0U, uint16_t value = 0U)
+    {
+        if (frozen.load(std::memory_order_relaxed)) {
+            return;
+        }
+        const uint32_t index = head.fetch_add(1U, std::memory_order_relaxed);
+        Flight_Recorder_Event_t* pEvent = &pEvents[index & (FLIGHT_RECORDER_EVENT_COUNT - 1U)];
+        pEvent->cycles = ESP.getCycleCount();
+        pEvent->type = (uint8_t)type;
+        pEvent->arg = arg;
+        pEvent->value = value;
+        if ((triggerMask & (1U << type)) != 0U) {
+            trigger(type, index);
+        }
+        if (index >= freezeIndex.load(std::memory_order_relaxed)) {
+            frozen.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Records a CPU frequency change. Cycle timestamps count at the
+     *        CPU frequency, so the host needs every change to convert them.
+     *
+     * @param[in] previousMhz CPU frequency before the change, in MHz.
+     * @param[in] newMhz CPU frequency after the change, in MHz.
+     */
+    void recordCpuFrequency(uint32_t previousMhz, uint32_t newMhz)
+    {
+        if (frozen.load(std::memory_order_relaxed)) {
+            return;
+        }
+        record(FLIGHT_EVENT_CPU_FREQ, (uint8_t)previousMhz, (uint16_t)newMhz);
+        cpuFreqMhz = (uint16_t)newMhz;
+    }
+
+    /**
+     * @brief Freezes the recorder immediately.
+     *
+     * @param[in] reason Event type reported as the freeze reason.
+     */
+    void freeze(Flight_Event_Type_t reason);
+
+    /**
+     * @brief Clears the recorder and resumes recording.
+     */
+    void resume(void);
+
+    /** @brief Indicates whether the recorder is frozen. */
+    bool isFrozen(void) const { return frozen.load(); };
+
+    /** @brief Sets the event types that freeze the recorder. */
+    void setTriggerMask(uint32_t mask) { triggerMask = mask; };
+
+    /**
+     * @brief Handles a request written by the host. Called from the BLE stack.
+     *
+     * @param[in] pData Request payload.
+     * @param[in] length Length of the request payload, in bytes.
+     */
+    void handleRequest(const uint8_t* pData, size_t length);
+
+private:
+    /**
+     * @brief Arms the freeze after a trigger event. Only the first trigger
+     *        is kept.
+     */
+    void trigger(Flight_Event_Type_t type, uint32_t index);
+
+    /**
+     * @brief Loads a chunk of the frozen ring into the characteristic value.
+     *
+     * @param[in] chunkIndex Index of the chunk, oldest events first.
+     */
+    void loadChunk(uint16_t chunkIndex);
+
+    /** Ring of recorded events. */
+    Flight_Recorder_Event_t* pEvents = nullptr;
+    /** Total number of events recorded since the last resume. */
+    std::atomic<uint32_t> head{0U};
+    /** Index of the event after which the recorder freezes. */
+    std::atomic<uint32_t> freezeIndex{FLIGHT_RECORDER_NOT_TRIGGERED};
+    /** Set while the recorder is frozen. Frozen until initialized. */
+    std::atomic<bool> frozen{true};
+    /** CPU frequency when the newest event was recorded, in MHz. */
+    uint16_t cpuFreqMhz = 0U;
+    /** Event type that froze the recorder. */
+    uint8_t freezeReason = 0U;
+    /** Bit mask of the event types that freeze the recorder. */
+    uint32_t triggerMask = FLIGHT_RECORDER_DEFAULT_TRIGGERS;
+    /** Pointer to the flight recorder characteristic object. */
+    BLECharacteristic* pRecorderCharacteristic = nullptr;
+    /** Pointer to the notifier object of the characteristic. */
+    BLE2902* pRecorderNotifier = nullptr;
+    /** Chunk being read by the host. */
+    uint8_t chunkBuffer[sizeof(Flight_Recorder_Chunk_Header_t) +
+                        (FLIGHT_RECORDER_CHUNK_EVENTS * sizeof(Flight_Recorder_Event_t))];
+};
+
+#if FLIGHT_RECORDER_ENABLED
+/** Flight recorder shared by the BLE stack callbacks and the input loop. */
+extern FlightRecorder flightRecorder;
+/** Records a flight recorder event. Compiles out when the recorder is disabled. */
+#define FLIGHT_RECORD(type, arg, value) flightRecorder.record((type), (arg), (value))
+#else
+#define FLIGHT_RECORD(type, arg, value) do { } while (0)
+#endif
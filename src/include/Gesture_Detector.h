@@ -0,0 +1,201 @@
+/**
+ * @file Gesture_Detector.h
+ * @brief Swing, shake and flick gesture detector header file.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "wire_schema.h"
+
+/** Default rotation rate that starts a swing, in dps. */
+#define GESTURE_SWING_START_GYRO_DPS      250.0f
+/** Default rotation rate below which a swing has ended, in dps. */
+#define GESTURE_SWING_END_GYRO_DPS        100.0f
+/**
+ * Default fraction of the peak rotation rate the rate has to drop below
+ * before the peak of a swing is reported.
+ */
+#define GESTURE_SWING_PEAK_RATIO          0.8f
+/** Default linear acceleration along one axis that counts towards a shake, in g. */
+#define GESTURE_SHAKE_ACCEL_THRESHOLD_G   0.8f
+/** Default number of direction reversals that make a shake. */
+#define GESTURE_SHAKE_REVERSALS           3U
+/** Default maximum time between two reversals of a shake, in us. */
+#define GESTURE_SHAKE_REVERSAL_TIMEOUT_US 300000U
+/** Default linear acceleration that makes a flick, in g. */
+#define GESTURE_FLICK_ACCEL_THRESHOLD_G   2.5f
+/** Default time after a flick during which no other flick is reported, in us. */
+#define GESTURE_FLICK_REFRACTORY_US       250000U
+/**
+ * Default time after a swing ends during which no flick is reported, in us.
+ * Covers the deceleration at the end of the swing.
+ */
+#define GESTURE_SWING_SETTLE_US           150000U
+/** Maximum number of events reported for one sample. */
+#define GESTURE_MAX_EVENTS_PER_SAMPLE     2U
+
+// All the events of one sample are sent in one notification, which has to
+// fit in the 20 byte payload of the default ATT MTU
+static_assert((GESTURE_MAX_EVENTS_PER_SAMPLE * sizeof(Gesture_Event_t)) <= 20U,
+              "Gesture events of one sample must fit in one default MTU notification");
+
+/**
+ * @struct Gesture_Detector_Config_t
+ * @brief Thresholds used by the \ref GestureDetector.
+ */
+typedef struct {
+    /** Rotation rate that starts a swing, in dps. */
+    float swingStartGyroDps;
+    /** Rotation rate below which a swing has ended, in dps. */
+    float swingEndGyroDps;
+    /** Fraction of the peak rotation rate that ends the peak of a swing. */
+    float swingPeakRatio;
+    /** Linear acceleration along one axis that counts towards a shake, in g. */
+    float shakeAccelThresholdG;
+    /** Number of direction reversals that make a shake. */
+    uint32_t shakeReversals;
+    /** Maximum time between two reversals of a shake, in us. */
+    uint32_t shakeReversalTimeoutUs;
+    /** Linear acceleration that makes a flick, in g. */
+    float flickAccelThresholdG;
+    /** Time after a flick during which no other flick is reported, in us. */
+    uint32_t flickRefractoryUs;
+    /** Time after a swing ends during which no flick is reported, in us. */
+    uint32_t swingSettleUs;
+} Gesture_Detector_Config_t;
+
+/** Default \ref Gesture_Detector_Config_t values. */
+#define GESTURE_DETECTOR_DEFAULT_CONFIG {   \
+    GESTURE_SWING_START_GYRO_DPS,           \
+    GESTURE_SWING_END_GYRO_DPS,             \
+    GESTURE_SWING_PEAK_RATIO,               \
+    GESTURE_SHAKE_ACCEL_THRESHOLD_G,        \
+    GESTURE_SHAKE_REVERSALS,                \
+    GESTURE_SHAKE_REVERSAL_TIMEOUT_US,      \
+    GESTURE_FLICK_ACCEL_THRESHOLD_G,        \
+    GESTURE_FLICK_REFRACTORY_US,            \
+    GESTURE_SWING_SETTLE_US,                \
+}
+
+/**
+ * @enum Swing_State_t
+ * @brief Swing tracking state of a \ref GestureDetector.
+ */
+typedef enum {
+    SWING_STATE_IDLE     = 0, /** No swing in progress. */
+    SWING_STATE_SWINGING = 1, /** Swing started, peak not reached yet. */
+    SWING_STATE_PEAKED   = 2, /** Peak reported, waiting for the swing to end. */
+} Swing_State_t;
+
+/**
+ * @class GestureDetector
+ * @brief Detects swings, shakes and flicks from IMU samples.
+ *
+ * Runs on every sample of one IMU and reports each gesture on the sample it
+ * is recognized at, so the host gets the onset with the exact sample time
+ * instead of somewhere inside the next reporting period.
+ *
+ * - A swing starts when the rotation rate crosses the start threshold. Its
+ *   peak is reported once the rate has dropped back below a fraction of
+ *   the highest rate seen, stamped with the time of the peak sample.
+ * - A shake is a number of direction reversals of the linear acceleration
+ *   along one axis, each within a timeout of the previous one. It is
+ *   stamped with the time of its first stroke.
+ * - A flick is a linear acceleration spike while no swing or shake is in
+ *   progress. A swing starts with the same kind of spike, so a flick is
+ *   only reported once the next sample shows no rotation, stamped with the
+ *   time of the spike. The first stroke of a vigorous shake can still be
+ *   reported as a flick, since the two can't be told apart at onset.
+ *
+ * Linear acceleration is the accelerometer reading minus a gravity
+ * estimate that is only updated while the IMU is near rest.
+ *
+ * It has no Arduino dependencies so it can be validated against recorded
+ * traces on a host machine (see src/benchmark/gesture_validation.py).
+ */
+class GestureDetector
+{
+public:
+    /**
+     * @brief Constructor for the GestureDetector class.
+     *
+     * @param[in] config Thresholds used by the detector.
+     * @param[in] controller Controller reported in the events
+     *                       (0 Wii Remote, 1 Nunchuck).
+     */
+    GestureDetector(const Gesture_Detector_Config_t& config, uint8_t controller)
+        : config(config), controller(controller) {};
+
+    /**
+     * @brief Updates the detector with a new IMU sample.
+     *
+     * @param[in] ax, ay, az Accelerometer reading, in units of g.
+     * @param[in] gx, gy, gz Gyroscope reading, in units of dps.
+     * @param[in] timestampUs Device time the sample was taken at, in us.
+     * @param[out] pEvents Detected events. Must have room for
+     *                     GESTURE_MAX_EVENTS_PER_SAMPLE events.
+     *
+     * @return Number of events detected on this sample.
+     */
+    uint8_t update(float ax, float ay, float az,
+                   float gx, float gy, float gz,
+                   uint32_t timestampUs, Gesture_Event_t* pEvents);
+
+    /** @brief Returns the current swing tracking state. */
+    Swing_State_t getSwingState(void) const { return swingState; };
+
+    /** @brief Indicates whether a shake is in progress. */
+    bool isShaking(void) const { return shaking; };
+
+    /** @brief Updates the thresholds used by the detector. */
+    void setConfig(const Gesture_Detector_Config_t& newConfig) { config = newConfig; };
+
+private:
+    /**
+     * @brief Adds an event to the output of the current sample.
+     */
+    void addEvent(Gesture_Event_t* pEvents, uint8_t& eventCount,
+                  Gesture_Type_t type, float magnitude, uint32_t timestampUs) const;
+
+    /**
+     * @brief Tracks the swing state with the rotation rate of a sample.
+     */
+    void updateSwing(float gyroMag, uint32_t timestampUs,
+                     Gesture_Event_t* pEvents, uint8_t& eventCount);
+
+    /**
+     * @brief Confirms a pending flick or detects a new one.
+     */
+    void updateFlick(float linearMag, float gyroMag, uint32_t timestampUs,
+                     Gesture_Event_t* pEvents, uint8_t& eventCount);
+
+    /**
+     * @brief Counts direction reversals of the linear acceleration.
+     */
+    void updateShake(const float linear[3], uint32_t timestampUs,
+                     Gesture_Event_t* pEvents, uint8_t& eventCount);
+
+    Gesture_Detector_Config_t config; /** Thresholds. */
+    uint8_t controller; /** Controller reported in the events. */
+    bool hasGravity = false; /** Set once the gravity estimate is initialized. */
+    float gravity[3] = { 0.0f, 0.0f, 0.0f }; /** Gravity estimate, in g. */
+    Swing_State_t swingState = SWING_STATE_IDLE; /** Swing tracking state. */
+    float swingPeakDps = 0.0f; /** Highest rotation rate of the current swing. */
+    uint32_t swingPeakUs = 0U; /** Time of the highest rotation rate, in us. */
+    uint32_t swingEndUs = 0U; /** Time the last swing ended, in us. */
+    bool hasSwung = false; /** Set once a swing has ended. */
+    int8_t shakeAxis = -1; /** Axis of the shake being tracked, -1 if none. */
+    int8_t shakeSign = 0; /** Direction of the last stroke of the shake. */
+    uint8_t shakeReversalCount = 0U; /** Reversals of the shake so far. */
+    uint32_t shakeStartUs = 0U; /** Time of the first stroke of the shake, in us. */
+    uint32_t lastReversalUs = 0U; /** Time of the last stroke, in us. */
+    bool shaking = false; /** Set once a shake has been reported. */
+    bool hasFlicked = false; /** Set once a flick has been reported. */
+    uint32_t lastFlickUs = 0U; /** Time of the last flick, in us. */
+    bool flickPending = false; /** Set while a flick waits for confirmation. */
+    float pendingFlickMag = 0.0f; /** Acceleration of the pending flick, in g. */
+    uint32_t pendingFlickUs = 0U; /** Time of the pending flick, in us. */
+};
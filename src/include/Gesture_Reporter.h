@@ -0,0 +1,57 @@
+/**
+ * @file Gesture_Reporter.h
+ * @brief Gesture event notification header file.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include "BLE.h"
+#include "Gesture_Detector.h"
+#include "generic_types.h"
+#include "wire_schema.h"
+
+/**
+ * @class GestureReporter
+ * @brief Sends the events of the \ref GestureDetector objects of both
+ *        controllers over the gesture event characteristic.
+ *
+ * Events are notified as soon as they are detected, ahead of the sensor
+ * sample they were detected on. A notification carries all the events of
+ * one sample as consecutive \ref Gesture_Event_t.
+ */
+class GestureReporter
+{
+public:
+    /**
+     * @brief Constructor for the GestureReporter class.
+     *
+     * @param[in] pBle Pointer to a BLE object used to create the
+     *                 gesture event characteristic.
+     */
+    GestureReporter(BLE* pBle) : pBle(pBle) {};
+
+    /**
+     * @brief Creates the gesture event characteristic.
+     *
+     * @return Status code indicating the result of the call.
+     */
+    status_t initGestureReporter(void);
+
+    /**
+     * @brief Notifies the events detected on one sample.
+     *
+     * @param[in] pEvents Detected events.
+     * @param[in] eventCount Number of events, at most
+     *                       GESTURE_MAX_EVENTS_PER_SAMPLE.
+     */
+    void reportEvents(const Gesture_Event_t* pEvents, uint8_t eventCount);
+
+private:
+    /** Pointer to the BLE object. */
+    BLE* pBle;
+    /** Pointer to the gesture event characteristic object. */
+    BLECharacteristic* pGestureEventCharacteristic = nullptr;
+    /** Pointer to the notifier object of the characteristic. */
+    BLE2902* pGestureEventNotifier = nullptr;
+};
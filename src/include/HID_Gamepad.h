@@ -0,0 +1,110 @@
+/**
+ * @file HID_Gamepad.h
+ * @brief HID-over-GATT gamepad report header file.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "button_mapping.h"
+
+/** Report ID of the gamepad input report. */
+#define HID_GAMEPAD_REPORT_ID        1U
+/** Accelerometer range covered by the report axes, in units of g. */
+#define HID_GAMEPAD_ACCEL_RANGE_G    4.0f
+/** Gyroscope range covered by the report axes, in units of dps. */
+#define HID_GAMEPAD_GYRO_RANGE_DPS   2000.0f
+/** Logical maximum of the motion axes in the report descriptor. */
+#define HID_GAMEPAD_MOTION_AXIS_MAX  32767
+
+/**
+ * @struct HID_Gamepad_Report_t
+ * @brief Gamepad input report, laid out as described by
+ *        \ref HID_GAMEPAD_REPORT_DESCRIPTOR.
+ */
+typedef struct __attribute__((packed)) {
+    /** Buttons 1-16, one bit per \ref Button_Mapping_t value. */
+    uint16_t buttons;
+    /** Buttons 17-18 (DS4_HOME and DS4_PAD_CLICK), 6 bits of padding. */
+    uint8_t  extraButtons;
+    uint8_t  joystickX; /** Nunchuck joystick X axis, 0-255. */
+    uint8_t  joystickY; /** Nunchuck joystick Y axis, 0-255. */
+    int16_t  accel[3];  /** Accelerometer X/Y/Z, scaled to +/-HID_GAMEPAD_ACCEL_RANGE_G. */
+    int16_t  gyro[3];   /** Gyroscope X/Y/Z, scaled to +/-HID_GAMEPAD_GYRO_RANGE_DPS. */
+} HID_Gamepad_Report_t;
+static_assert(sizeof(HID_Gamepad_Report_t) == 17U,
+              "HID_Gamepad_Report_t does not match the report descriptor");
+
+/** HID report descriptor of the gamepad. */
+extern const uint8_t HID_GAMEPAD_REPORT_DESCRIPTOR[];
+/** Size of \ref HID_GAMEPAD_REPORT_DESCRIPTOR, in bytes. */
+extern const size_t HID_GAMEPAD_REPORT_DESCRIPTOR_SIZE;
+
+/**
+ * @class HidGamepad
+ * @brief Holds the latest gamepad state and encodes it into input reports.
+ *
+ * The controllers write their inputs into the gamepad state, and the BLE
+ * class sends the encoded report to the host. This class has no Arduino or
+ * BLE dependencies so the encoding can be checked on a host machine.
+ */
+class HidGamepad
+{
+public:
+    /**
+     * @brief Updates the Wii Remote buttons.
+     *
+     * @param[in] buttons Button bits, see \ref Button_Mapping_t.
+     */
+    void setButtons(uint16_t buttons);
+
+    /**
+     * @brief Updates the Nunchuck buttons.
+     *
+     * @param[in] extraButtons DS4_HOME and DS4_PAD_CLICK bits.
+     */
+    void setExtraButtons(uint8_t extraButtons);
+
+    /**
+     * @brief Updates the Nunchuck joystick.
+     *
+     * @param[in] x Joystick X axis, 0-255.
+     * @param[in] y Joystick Y axis, 0-255.
+     */
+    void setJoystick(uint8_t x, uint8_t y);
+
+    /**
+     * @brief Updates the Wii Remote motion axes.
+     *
+     * @param[in] ax, ay, az Accelerometer reading, in units of g.
+     * @param[in] gx, gy, gz Gyroscope reading, in units of dps.
+     */
+    void setMotion(float ax, float ay, float az, float gx, float gy, float gz);
+
+    /**
+     * @brief Encodes the current state into an input report.
+     *
+     * @param[out] report Report to encode into.
+     *
+     * @return True if the state changed since the last encoded report.
+     */
+    bool encodeReport(HID_Gamepad_Report_t& report);
+
+    /**
+     * @brief Scales a value to a signed report axis, saturating at the
+     *        ends of the range.
+     *
+     * @param[in] value Value to scale.
+     * @param[in] range Value mapped to \ref HID_GAMEPAD_MOTION_AXIS_MAX.
+     *
+     * @return The scaled axis value.
+     */
+    static int16_t scaleMotionAxis(float value, float range);
+
+private:
+    HID_Gamepad_Report_t state = { 0U, }; /** Latest gamepad state. */
+    bool changed = true; /** Set when the state changes. */
+};
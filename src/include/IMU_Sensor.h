@@ -25,10 +25,170 @@
  * Wii Remote in \ref WiiRemote::updateSensorInputs().
  */
 #define ACCEL_GYRO_DATA_SIZE              (size_t)(ACCEL_DATA_STRUCT_SIZE + GYRO_DATA_STRUCT_SIZE)
+/**
+ * Squared accelerometer magnitude below which a reading is treated as a
+ * failed I2C read, in units of g^2. FastIMU does not report bus errors, and
+ * a failed read leaves all zero (or all one) registers, which decode to
+ * almost no acceleration, while a working IMU always measures gravity.
+ */
+#define IMU_READ_FAILURE_ACCEL_SQ_G2      0.01f
+/** Gyroscope range set by FastIMU when an MPU is initialized, in dps. */
+#define IMU_DEFAULT_GYRO_RANGE_DPS        2000
+
+/**
+ * @enum IMU_Type_t
+ * @brief Types of IMU sensors that can be selected at compile time.
+ */
+typedef enum {
+    IMU_TYPE_MPU9250 = 0, /** InvenSense MPU9250 (MPU6500 + AK8963). */
+    IMU_TYPE_MPU6500 = 1, /** InvenSense MPU6500. */
+    IMU_TYPE_MPU6050 = 2, /** InvenSense MPU6050. */
+} IMU_Type_t;
+
+/**
+ * @brief Indicates whether an accelerometer range is supported by the MPU
+ *        family, in units of g.
+ */
+constexpr bool isValidMpuAccelRange(int rangeG)
+{
+    return (rangeG == 2) || (rangeG == 4) || (rangeG == 8) || (rangeG == 16);
+}
+
+/**
+ * @brief Indicates whether a gyroscope range is supported by the MPU
+ *        family, in units of dps.
+ */
+constexpr bool isValidMpuGyroRange(int rangeDps)
+{
+    return (rangeDps == 250) || (rangeDps == 500) || (rangeDps == 1000) || (rangeDps == 2000);
+}
+
+/**
+ * @struct IMU_Traits
+ * @brief Compile-time description of an IMU type: the FastIMU driver,
+ *        its register map and its scaling.
+ */
+template <IMU_Type_t Type>
+struct IMU_Traits;
+
+/** Traits shared by the MPU family, which use the same register map. */
+struct MPU_Traits {
+    /** Register holding the device ID. */
+    static constexpr uint8_t whoAmIRegister = 0x75U;
+    /** Accelerometer configuration register. */
+    static constexpr uint8_t accelConfigRegister = 0x1CU;
+    /** Gyroscope configuration register. */
+    static constexpr uint8_t gyroConfigRegister = 0x1BU;
+    /** First register of the accel, temperature and gyro burst read. */
+    static constexpr uint8_t dataRegister = 0x3BU;
+    /** Length of the accel, temperature and gyro burst read, in bytes. */
+    static constexpr uint8_t dataLength = 14U;
+    /** Offset of the gyro registers in the burst read, in bytes. */
+    static constexpr uint8_t gyroDataOffset = 8U;
+
+    /** @brief Accelerometer configuration value selecting a range (AFS_SEL). */
+    static constexpr uint8_t accelConfig(int rangeG)
+    {
+        return (rangeG == 2) ? 0x00U : (rangeG == 4) ? 0x08U : (rangeG == 8) ? 0x10U : 0x18U;
+    };
+    /** @brief Gyroscope configuration value selecting a range (FS_SEL). */
+    static constexpr uint8_t gyroConfig(int rangeDps)
+    {
+        return (rangeDps == 250) ? 0x00U : (rangeDps == 500) ? 0x08U :
+               (rangeDps == 1000) ? 0x10U : 0x18U;
+    };
+    /** @brief Accelerometer sensitivity for a range, in LSB per g. */
+    static constexpr float accelLsbPerG(int rangeG)
+    {
+        return (rangeG == 2) ? 16384.0f : (rangeG == 4) ? 8192.0f : (rangeG == 8) ? 4096.0f : 2048.0f;
+    };
+    /** @brief Gyroscope sensitivity for a range, in LSB per dps. */
+    static constexpr float gyroLsbPerDps(int rangeDps)
+    {
+        return (rangeDps == 250) ? 131.0f : (rangeDps == 500) ? 65.5f :
+               (rangeDps == 1000) ? 32.8f : 16.4f;
+    };
+};
+
+template <>
+struct IMU_Traits<IMU_TYPE_MPU9250> : MPU_Traits {
+    typedef MPU9250 Driver; /** FastIMU driver class. */
+    static constexpr const char* name = MPU9250_NAME; /** Name of the IMU. */
+    static constexpr uint8_t whoAmI = 0x71U; /** Expected device ID. */
+};
+
+template <>
+struct IMU_Traits<IMU_TYPE_MPU6500> : MPU_Traits {
+    typedef MPU6500 Driver; /** FastIMU driver class. */
+    static constexpr const char* name = MPU6500_NAME; /** Name of the IMU. */
+    static constexpr uint8_t whoAmI = 0x70U; /** Expected device ID. */
+};
+
+template <>
+struct IMU_Traits<IMU_TYPE_MPU6050> : MPU_Traits {
+    typedef MPU6050 Driver; /** FastIMU driver class. */
+    static constexpr const char* name = MPU6050_NAME; /** Name of the IMU. */
+    static constexpr uint8_t whoAmI = 0x68U; /** Expected device ID. */
+};
+
+/**
+ * @brief Checks that the device at an I2C address reports the expected ID,
+ *        so a missing IMU, or one of another type than the build selects,
+ *        is reported at init instead of as bad samples.
+ *
+ * @param[in] deviceAddress The I2C address of the IMU.
+ * @param[in] whoAmIRegister Register holding the device ID.
+ * @param[in] expectedWhoAmI Device ID of the selected IMU type.
+ *
+ * @return STATUS_IMU_INIT_FAILURE if the device did not answer or reported
+ *         another ID, STATUS_COMPLETE otherwise.
+ */
+status_t checkImuWhoAmI(uint8_t deviceAddress, uint8_t whoAmIRegister, uint8_t expectedWhoAmI);
+
+/**
+ * @brief Reads consecutive registers of an I2C device with a repeated start.
+ *
+ * @param[in] deviceAddress The I2C address of the device.
+ * @param[in] firstRegister First register to read.
+ * @param[out] pData Buffer receiving the register values.
+ * @param[in] length Number of registers to read.
+ *
+ * @return True if every register was read.
+ */
+bool readImuRegisters(uint8_t deviceAddress, uint8_t firstRegister, uint8_t* pData, uint8_t length);
+
+/**
+ * @brief Writes a register of an I2C device.
+ *
+ * @param[in] deviceAddress The I2C address of the device.
+ * @param[in] registerAddress Register to write.
+ * @param[in] value Value to write.
+ *
+ * @return STATUS_IMU_INIT_FAILURE if the device did not acknowledge the
+ *         write, STATUS_COMPLETE otherwise.
+ */
+status_t writeImuRegister(uint8_t deviceAddress, uint8_t registerAddress, uint8_t value);
+
+/**
+ * @brief Indicates whether an accelerometer reading looks like a failed
+ *        I2C read. See \ref IMU_READ_FAILURE_ACCEL_SQ_G2.
+ *
+ * @param[in] accelData Accelerometer reading, in units of g.
+ */
+inline bool isImuReadFailure(const AccelData& accelData)
+{
+    return ((accelData.accelX * accelData.accelX) +
+            (accelData.accelY * accelData.accelY) +
+            (accelData.accelZ * accelData.accelZ)) < IMU_READ_FAILURE_ACCEL_SQ_G2;
+}
 
 /**
  * @class IMU_Sensor
- * @brief Class representing an Inertial Measurement Unit (IMU) sensor.
+ * @brief Class representing an Inertial Measurement Unit (IMU) sensor whose
+ *        type is selected at runtime by name.
+ *
+ * Every read goes through a virtual call on \ref IMU. Prefer
+ * \ref StaticIMU_Sensor when the sensor type is known at compile time.
  */
 class IMU_Sensor
 {
@@ -54,17 +214,24 @@ public:
      *       There are other sensors supported in the FastIMU library, but
      *       these are the most commonly used ones. Many of the MPUs also
      *       have multiple MPUs supported on one module as well.
+     *
+     *       An unknown name leaves \ref IMU NULL, which is reported by
+     *       \ref initImuSensor.
      */
     IMU_Sensor(uint8_t deviceAddress, int accelRange, const char* imuSensorName)
         : deviceAddress(deviceAddress), accelRange(accelRange) {
         if (!strcmp(imuSensorName, MPU9250_NAME)) {
             IMU = new MPU9250();
+            whoAmI = IMU_Traits<IMU_TYPE_MPU9250>::whoAmI;
         } else if (!strcmp(imuSensorName, MPU6500_NAME)) {
             IMU = new MPU6500();
+            whoAmI = IMU_Traits<IMU_TYPE_MPU6500>::whoAmI;
         } else if (!strcmp(imuSensorName, MPU6050_NAME)) {
             IMU = new MPU6050();
+            whoAmI = IMU_Traits<IMU_TYPE_MPU6050>::whoAmI;
         } else {
             IMU = nullptr;
+            whoAmI = 0U;
         }
     }
 
@@ -80,6 +247,18 @@ public:
      */
     status_t initImuSensor();
 
+    /** @brief Indicates whether a driver was created for the IMU. */
+    bool isReady(void) const { return IMU != nullptr; };
+
+    /** @brief Reads a new sample from the IMU. */
+    void update(void) { IMU->update(); };
+
+    /** @brief Returns the accelerometer data of the last sample, in g. */
+    void getAccel(AccelData* pAccelData) { IMU->getAccel(pAccelData); };
+
+    /** @brief Returns the gyroscope data of the last sample, in dps. */
+    void getGyro(GyroData* pGyroData) { IMU->getGyro(pGyroData); };
+
 #if DEBUG
     /**
      * @brief Prints sensor data recorded from \ref IMU.
@@ -94,4 +273,150 @@ public:
 private:
     uint8_t deviceAddress; /** The I2C address of the equipped IMU. */
     int accelRange; /** The accelorometer range of the IMU, in units of g. */
-};
\ No newline at end of file
+    uint8_t whoAmI; /** Device ID of the named IMU type. */
+};
+
+/**
+ * @class StaticIMU_Sensor
+ * @brief IMU sensor whose type and ranges are selected at compile time.
+ *
+ * FastIMU only brings the IMU up. The ranges are then written from the
+ * constexpr register map, and every sample is one burst read of the accel,
+ * temperature and gyro registers, decoded inline and scaled by constants
+ * of the selected ranges. So the sample path has no virtual call, no heap
+ * allocated driver and no runtime scale. Unsupported ranges fail to
+ * compile.
+ *
+ * @tparam Type Type of the equipped IMU.
+ * @tparam AccelRangeG Accelerometer range, in units of g.
+ * @tparam GyroRangeDps Gyroscope range, in units of dps.
+ */
+template <IMU_Type_t Type, int AccelRangeG, int GyroRangeDps = IMU_DEFAULT_GYRO_RANGE_DPS>
+class StaticIMU_Sensor
+{
+    static_assert(isValidMpuAccelRange(AccelRangeG),
+                  "Accelerometer range must be 2, 4, 8 or 16 g");
+    static_assert(isValidMpuGyroRange(GyroRangeDps),
+                  "Gyroscope range must be 250, 500, 1000 or 2000 dps");
+
+public:
+    /** Compile-time description of the equipped IMU. */
+    typedef IMU_Traits<Type> Traits;
+    /** FastIMU driver class of the equipped IMU. */
+    typedef typename Traits::Driver Driver;
+
+    /** Accelerometer resolution, in g per LSB. */
+    static constexpr float accelGPerLsb = 1.0f / Traits::accelLsbPerG(AccelRangeG);
+    /** Gyroscope resolution, in dps per LSB. */
+    static constexpr float gyroDpsPerLsb = 1.0f / Traits::gyroLsbPerDps(GyroRangeDps);
+
+    /**
+     * @brief Constructor for the StaticIMU_Sensor class.
+     *
+     * @param[in] deviceAddress The I2C address of the equipped IMU device
+     */
+    StaticIMU_Sensor(uint8_t deviceAddress) : deviceAddress(deviceAddress) {};
+
+    /**
+     * @brief Initializes the IMU sensor.
+     *
+     * @return Status code indicating the result of the call.
+     */
+    status_t initImuSensor()
+    {
+        Wire.begin();
+        Wire.setClock(400000);
+        if (checkImuWhoAmI(deviceAddress, Traits::whoAmIRegister, Traits::whoAmI) != STATUS_COMPLETE) {
+            return STATUS_IMU_INIT_FAILURE;
+        }
+        calData calib = { 0, };
+        // Wake and reset the IMU, and set its clock and filters
+        if (imu.Driver::init(calib, deviceAddress) != 0) {
+            #if DEBUG
+            Serial.print("Could not initialize ");
+            Serial.print(Traits::name);
+            Serial.print(" with address:");
+            Serial.println(deviceAddress);
+            #endif
+            return STATUS_IMU_INIT_FAILURE;
+        }
+        if ((writeImuRegister(deviceAddress, Traits::accelConfigRegister,
+                              Traits::accelConfig(AccelRangeG)) != STATUS_COMPLETE) ||
+            (writeImuRegister(deviceAddress, Traits::gyroConfigRegister,
+                              Traits::gyroConfig(GyroRangeDps)) != STATUS_COMPLETE)) {
+            #if DEBUG
+            Serial.println("Could not set the IMU ranges");
+            #endif
+            return STATUS_IMU_INIT_FAILURE;
+        }
+        return STATUS_COMPLETE;
+    }
+
+    /** @brief Always true, the driver is created with the sensor. */
+    constexpr bool isReady(void) const { return true; };
+
+    /**
+     * @brief Reads a new sample from the IMU.
+     *
+     * A short read leaves an all zero sample, which \ref isImuReadFailure
+     * reports like any other failed read.
+     */
+    void update(void)
+    {
+        uint8_t data[Traits::dataLength];
+        if (!readImuRegisters(deviceAddress, Traits::dataRegister, data, Traits::dataLength)) {
+            accel = { 0.0f, 0.0f, 0.0f };
+            gyro = { 0.0f, 0.0f, 0.0f };
+            return;
+        }
+        // Big endian words, temperature in between
+        accel.accelX = toWord(&data[0]) * accelGPerLsb;
+        accel.accelY = toWord(&data[2]) * accelGPerLsb;
+        accel.accelZ = toWord(&data[4]) * accelGPerLsb;
+        gyro.gyroX = toWord(&data[Traits::gyroDataOffset]) * gyroDpsPerLsb;
+        gyro.gyroY = toWord(&data[Traits::gyroDataOffset + 2U]) * gyroDpsPerLsb;
+        gyro.gyroZ = toWord(&data[Traits::gyroDataOffset + 4U]) * gyroDpsPerLsb;
+    };
+
+    /** @brief Returns the accelerometer data of the last sample, in g. */
+    void getAccel(AccelData* pAccelData) { *pAccelData = accel; };
+
+    /** @brief Returns the gyroscope data of the last sample, in dps. */
+    void getGyro(GyroData* pGyroData) { *pGyroData = gyro; };
+
+#if DEBUG
+    /**
+     * @brief Prints sensor data recorded from the IMU.
+     *
+     * @note Should only be called when using a debug build.
+     */
+    void printSensorData()
+    {
+        AccelData accelData;
+        GyroData gyroData;
+        update();
+        getAccel(&accelData);
+        getGyro(&gyroData);
+        Serial.print(accelData.accelX);
+        Serial.print("\t");
+        Serial.print(accelData.accelY);
+        Serial.print("\t");
+        Serial.print(accelData.accelZ);
+        Serial.print("\t");
+        Serial.print(gyroData.gyroX);
+        Serial.print("\t");
+        Serial.print(gyroData.gyroY);
+        Serial.print("\t");
+        Serial.println(gyroData.gyroZ);
+    }
+#endif
+
+private:
+    /** @brief Returns the signed big endian word of two registers. */
+    static int16_t toWord(const uint8_t* pData) { return (int16_t)((pData[0] << 8) | pData[1]); };
+
+    Driver imu; /** Driver used to bring the equipped IMU up. */
+    uint8_t deviceAddress; /** The I2C address of the equipped IMU. */
+    AccelData accel = { 0.0f, 0.0f, 0.0f }; /** Accelerometer data of the last sample, in g. */
+    GyroData gyro = { 0.0f, 0.0f, 0.0f }; /** Gyroscope data of the last sample, in dps. */
+};
@@ -0,0 +1,167 @@
+/**
+ * @file Motion_Rate_Controller.h
+ * @brief Motion-adaptive sampling and reporting rate controller header file.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/** Default stillness threshold of the accelerometer magnitude, in units of g. */
+#define RATE_STILL_ACCEL_THRESHOLD_G     0.05f
+/** Default stillness threshold of the gyroscope magnitude, in units of dps. */
+#define RATE_STILL_GYRO_THRESHOLD_DPS    3.0f
+/** Default wake threshold of the accelerometer magnitude, in units of g. */
+#define RATE_WAKE_ACCEL_THRESHOLD_G      0.10f
+/** Default wake threshold of the gyroscope magnitude, in units of dps. */
+#define RATE_WAKE_GYRO_THRESHOLD_DPS     8.0f
+/** Default time the controller must be still before going idle, in ms. */
+#define RATE_STILL_TIME_MS               2000U
+/** Default sampling period while the controller is moving, in ms. */
+#define RATE_ACTIVE_PERIOD_MS            10U
+/** Default sampling period while the controller is idle, in ms. */
+#define RATE_IDLE_SAMPLE_PERIOD_MS       50U
+/** Default keepalive reporting period while the controller is idle, in ms. */
+#define RATE_KEEPALIVE_PERIOD_MS         1000U
+
+/**
+ * @struct Rate_Controller_Config_t
+ * @brief Thresholds and periods used by the \ref MotionRateController.
+ *
+ * The still thresholds are used to decide that the controller has stopped
+ * moving, and the (larger) wake thresholds are used to decide that an idle
+ * controller has started moving again. The gap between the two acts as
+ * hysteresis so that sensor noise does not toggle the reporting rate.
+ */
+typedef struct {
+    /** Max deviation of |accel| from 1g to be considered still, in g. */
+    float stillAccelThreshold;
+    /** Max |gyro| to be considered still, in dps. */
+    float stillGyroThreshold;
+    /** Deviation of |accel| from 1g that wakes an idle controller, in g. */
+    float wakeAccelThreshold;
+    /** |gyro| that wakes an idle controller, in dps. */
+    float wakeGyroThreshold;
+    /** Time the controller must remain still before going idle, in ms. */
+    uint32_t stillTimeMs;
+    /** Sampling and reporting period while active, in ms. */
+    uint32_t activePeriodMs;
+    /** Sampling period while idle, in ms. */
+    uint32_t idleSamplePeriodMs;
+    /** Reporting period while idle, in ms. */
+    uint32_t keepalivePeriodMs;
+} Rate_Controller_Config_t;
+
+/** Default \ref Rate_Controller_Config_t values. */
+#define RATE_CONTROLLER_DEFAULT_CONFIG {    \
+    RATE_STILL_ACCEL_THRESHOLD_G,           \
+    RATE_STILL_GYRO_THRESHOLD_DPS,          \
+    RATE_WAKE_ACCEL_THRESHOLD_G,            \
+    RATE_WAKE_GYRO_THRESHOLD_DPS,           \
+    RATE_STILL_TIME_MS,                     \
+    RATE_ACTIVE_PERIOD_MS,                  \
+    RATE_IDLE_SAMPLE_PERIOD_MS,             \
+    RATE_KEEPALIVE_PERIOD_MS,               \
+}
+
+/**
+ * @enum Rate_State_t
+ * @brief Reporting state of a \ref MotionRateController.
+ */
+typedef enum {
+    RATE_STATE_ACTIVE = 0, /** Controller is moving, sample at full rate. */
+    RATE_STATE_IDLE   = 1, /** Controller is still, sample at keepalive rate. */
+} Rate_State_t;
+
+/**
+ * @class MotionRateController
+ * @brief Decides when a controller should sample its IMU and report inputs.
+ *
+ * The rate controller drops to a low keepalive rate while the IMU reports
+ * no motion, and returns to the full rate on the first sample that exceeds
+ * the wake thresholds. It has no Arduino dependencies so the same logic can
+ * be driven from recorded traces on a host machine.
+ */
+class MotionRateController
+{
+public:
+    /**
+     * @brief Constructor for the MotionRateController class.
+     *
+     * @param[in] config Thresholds and periods used by the controller.
+     */
+    MotionRateController(const Rate_Controller_Config_t& config)
+        : config(config) {};
+
+    /**
+     * @brief Indicates whether the IMU should be sampled.
+     *
+     * @param[in] nowMs Current time, in ms.
+     *
+     * @return True if a sampling period has elapsed since the last sample.
+     */
+    bool isSampleDue(uint32_t nowMs) const;
+
+    /**
+     * @brief Updates the controller state with a new IMU sample.
+     *
+     * @param[in] ax, ay, az Accelerometer reading, in units of g.
+     * @param[in] gx, gy, gz Gyroscope reading, in units of dps.
+     * @param[in] nowMs Time the sample was taken, in ms.
+     *
+     * @return True if the sample should be reported.
+     */
+    bool update(float ax, float ay, float az,
+                float gx, float gy, float gz, uint32_t nowMs);
+
+    /**
+     * @brief Returns the controller to the active state, e.g. on a
+     *        button press.
+     *
+     * @param[in] nowMs Current time, in ms.
+     */
+    void wake(uint32_t nowMs);
+
+    /**
+     * @brief Forces the next sample to be taken and reported regardless
+     *        of the current state.
+     */
+    void forceReport(void) { reportForced = true; };
+
+    /** @brief Returns the current reporting state. */
+    Rate_State_t getState(void) const { return state; };
+
+    /** @brief Returns the sampling period of the current state, in ms. */
+    uint32_t getSamplePeriodMs(void) const
+    {
+        return (state == RATE_STATE_ACTIVE) ? config.activePeriodMs : config.idleSamplePeriodMs;
+    };
+
+    /** @brief Returns the number of samples taken. */
+    uint32_t getSampleCount(void) const { return sampleCount; };
+
+    /** @brief Returns the number of samples reported. */
+    uint32_t getReportCount(void) const { return reportCount; };
+
+    /** @brief Updates the thresholds and periods used by the controller. */
+    void setConfig(const Rate_Controller_Config_t& newConfig) { config = newConfig; };
+
+private:
+    /**
+     * @brief Indicates whether a sample exceeds the given thresholds.
+     */
+    static bool isMoving(float ax, float ay, float az,
+                         float gx, float gy, float gz,
+                         float accelThreshold, float gyroThreshold);
+
+    Rate_Controller_Config_t config; /** Thresholds and periods. */
+    Rate_State_t state = RATE_STATE_ACTIVE; /** Current reporting state. */
+    bool hasSampled = false; /** Set once the first sample has been taken. */
+    bool reportForced = false; /** Forces the next sample to be reported. */
+    uint32_t lastSampleMs = 0U; /** Time of the last sample, in ms. */
+    uint32_t lastReportMs = 0U; /** Time of the last report, in ms. */
+    uint32_t lastMotionMs = 0U; /** Time motion was last seen, in ms. */
+    uint32_t sampleCount = 0U; /** Number of samples taken. */
+    uint32_t reportCount = 0U; /** Number of samples reported. */
+};
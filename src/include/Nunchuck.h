@@ -6,40 +6,45 @@
 
 #pragma once
 
+#include <map>
+
 #include "BaseController.h"
+#include "Controller_Inputs.h"
+#include "button_mapping.h"
 #include "BLE.h"
 #include "IMU_Sensor.h"
+#include "Motion_Rate_Controller.h"
+#include "Gesture_Detector.h"
+#include "Gesture_Reporter.h"
+#include "wire_schema.h"
 #include "generic_types.h"
 
-// These two buttons are the only two buttons not included as
-// the buttons1 and buttons2 inputs in dsu.py, so we'll use
-// these as the c and z buttons on the nunchuck.
-// (Yes, it makes sense to use DS4_HOME for the the Wii Remote
-//  Home button, but these two buttons not having a mapping
-//  makes it more convenient for the nunchuck buttons lol)
+// The C and Z buttons map to DS4_HOME and DS4_PAD_CLICK, see button_mapping.h
 #define BUTTON_C_PIN  (Pins_t)18U /** Nunchuck Button C Pin */
 #define BUTTON_Z_PIN  (Pins_t)5U  /** Nunchuck Button Z Pin */
 
-// These are self defined bit values, not part of the buttons1
-// and buttons2 variables as noted in the comment above.
-#define DS4_HOME      0x01U /** DS4 Home Bit Value */
-#define DS4_PAD_CLICK 0x02U /** DS4 Pad Click Bit Value */
-
 #define JOYSTICK_VRX_PIN (Pins_t)39U /** Joystick X-Axis Pin */
 #define JOYSTICK_VRY_PIN (Pins_t)35U /** Joystick Y-Axis Pin */
 
-/** Right shift value to scale down the digital read on the axis pins */
-#define JOYSTICK_SCALE_DOWN_SHIFT 4U
-/** Size of the Button + Joystick payload */
-#define BUTTON_JOYSTICK_DATA_SIZE 3U
+// The joystick scaling and idle deadband are defined in Controller_Inputs.h
 
-/** Nunchuck Button + Joystick Input Characteristic UUID */
-#define NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID  "3327921d-e3b3-43ff-b724-a706fae760d3"
-/** Nunchuck Sensor Input Characteristic UUID */
-#define NUNCHUCK_SENSOR_INPUT_CHARACTERISTIC_UUID           "be11ecb2-1c60-4411-9385-0436b247c5bb"
+// The characteristic UUIDs and payload layouts are defined in wire_schema.h
 
-/** Nunchuck Accelorometer Range */
-#define NUNCHUCK_ACCELOROMETER_RANGE 2
+/**
+ * Nunchuck Accelorometer Range. Flicks peak above 2 g, see
+ * GESTURE_FLICK_ACCEL_THRESHOLD_G.
+ */
+#define NUNCHUCK_ACCELOROMETER_RANGE 4
+/** Nunchuck IMU Type */
+#define NUNCHUCK_IMU_TYPE IMU_TYPE_MPU9250
+
+#if IMU_STATIC_DISPATCH
+/** IMU sensor equipped on the Nunchuck, selected at compile time. */
+typedef StaticIMU_Sensor<NUNCHUCK_IMU_TYPE, NUNCHUCK_ACCELOROMETER_RANGE> Nunchuck_IMU_t;
+#else
+/** IMU sensor equipped on the Nunchuck, selected at runtime. */
+typedef IMU_Sensor Nunchuck_IMU_t;
+#endif
 
 /**
  * @class Nunchuck
@@ -61,9 +66,24 @@ public:
      * @param[in] pNunchuckImu Pointer to an IMU sensor object that reads
      *                         sensor data from the IMU sensor equipped on the
      *                         Nunchuck.
+     * @param[in] pRateController Pointer to a rate controller object used to
+     *                            reduce the sampling and reporting rate while
+     *                            the Nunchuck is still. If NULL, inputs are
+     *                            sampled and reported on every update.
+     * @param[in] pGestureDetector Pointer to a gesture detector object run on
+     *                             every IMU sample. If NULL, no gestures are
+     *                             detected.
+     * @param[in] pGestureReporter Pointer to the reporter object that sends
+     *                             the detected gestures.
      */
-    Nunchuck(BLE* pBle, IMU_Sensor* pNunchuckImu)
-        : pBle(pBle), pNunchuckImu(pNunchuckImu) {};
+    Nunchuck(BLE* pBle, Nunchuck_IMU_t* pNunchuckImu,
+             MotionRateController* pRateController = nullptr,
+             GestureDetector* pGestureDetector = nullptr,
+             GestureReporter* pGestureReporter = nullptr)
+        : pBle(pBle), pNunchuckImu(pNunchuckImu),
+          pRateController(pRateController),
+          pGestureDetector(pGestureDetector),
+          pGestureReporter(pGestureReporter) {};
 
     /**
      * @brief Deconstructor for the Nunchuck class.
@@ -136,5 +156,16 @@ private:
      * A pointer to an IMU sensor object for initializing an IMU sensor and
      * reading accelorometer data.
      */
-    IMU_Sensor* pNunchuckImu;
+    Nunchuck_IMU_t* pNunchuckImu;
+    /**
+     * Pointer to a rate controller object used to adapt the sampling and
+     * reporting rate to the motion of the Nunchuck.
+     */
+    MotionRateController* pRateController;
+    /** Pointer to a gesture detector object run on every IMU sample. */
+    GestureDetector* pGestureDetector;
+    /** Pointer to the reporter object that sends the detected gestures. */
+    GestureReporter* pGestureReporter;
+    /** Last button + joystick payload transmitted. */
+    Nunchuck_Button_Joystick_Input_t lastButtonJoystickInputs = { 0U, };
 };
\ No newline at end of file
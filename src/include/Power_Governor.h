@@ -0,0 +1,172 @@
+/**
+ * @file Power_Governor.h
+ * @brief Load-aware CPU frequency governor header file.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/** Number of CPU frequency levels the governor steps between. */
+#define POWER_GOVERNOR_LEVEL_COUNT 3U
+/**
+ * CPU frequency levels, lowest first, in MHz. The APB clock stays at
+ * 80MHz on all of them, so the BLE controller and the I2C/ADC peripherals
+ * keep their timing.
+ */
+#define POWER_GOVERNOR_LEVELS_MHZ { 80U, 160U, 240U }
+
+/**
+ * Default fraction of the sampling deadline the busiest loop pass may take
+ * at the next lower level before stepping down.
+ */
+#define POWER_DOWN_UTILIZATION    0.5f
+/** Default fraction of the sampling deadline a loop pass may take before stepping up. */
+#define POWER_UP_UTILIZATION      0.8f
+/**
+ * Default sample period jitter budget, in us. Samples are scheduled from
+ * the previous sample, so a step down stretches a sample period by how much
+ * longer the sample waits behind the rest of its loop pass, plus the stall.
+ * Steps down are kept under it.
+ */
+#define POWER_JITTER_BUDGET_US    2000U
+/** Default time the CPU stalls while its frequency changes, in us. */
+#define POWER_SWITCH_COST_US      100U
+/** Default time the load must stay low before stepping down, in ms. */
+#define POWER_DOWN_WINDOW_MS      1000U
+/** Default time after stepping up during which no step down happens, in ms. */
+#define POWER_UP_HOLDOFF_MS       3000U
+
+/**
+ * @struct Power_Governor_Config_t
+ * @brief Thresholds used by the \ref PowerGovernor.
+ */
+typedef struct {
+    /** Fraction of the deadline the predicted load must stay under to step down. */
+    float downUtilization;
+    /** Fraction of the deadline a loop pass may take before stepping up. */
+    float upUtilization;
+    /** Sample period jitter budget, in us. */
+    uint32_t jitterBudgetUs;
+    /** Time the CPU stalls while its frequency changes, in us. */
+    uint32_t switchCostUs;
+    /** Time the load must stay low before stepping down, in ms. */
+    uint32_t downWindowMs;
+    /** Time after stepping up during which no step down happens, in ms. */
+    uint32_t upHoldoffMs;
+} Power_Governor_Config_t;
+
+/** Default \ref Power_Governor_Config_t values. */
+#define POWER_GOVERNOR_DEFAULT_CONFIG {     \
+    POWER_DOWN_UTILIZATION,                 \
+    POWER_UP_UTILIZATION,                   \
+    POWER_JITTER_BUDGET_US,                 \
+    POWER_SWITCH_COST_US,                   \
+    POWER_DOWN_WINDOW_MS,                   \
+    POWER_UP_HOLDOFF_MS,                    \
+}
+
+/**
+ * @class PowerGovernor
+ * @brief Picks the CPU frequency level from the measured loop load.
+ *
+ * Every loop pass reports how long it took, how long a sample could have
+ * waited behind the rest of it, and the sampling deadline it has to meet.
+ * The governor steps straight up to the highest level as soon as a pass
+ * gets close to the deadline, or the deadline gets shorter because the
+ * sampling rate went up. It steps down one level at a time once the
+ * busiest pass of a whole window would still have fit the deadline at the
+ * lower level, and the longest wait would grow by less than the jitter
+ * budget, switch stall included. Loop time is scaled by the frequency
+ * ratio to predict it at another level, which overestimates it since I2C
+ * and BLE time don't scale with the CPU clock.
+ *
+ * It has no Arduino dependencies so it can be driven by a simulated load
+ * trace on a host machine (see src/benchmark/governor_simulation.cpp).
+ */
+class PowerGovernor
+{
+public:
+    /**
+     * @brief Constructor for the PowerGovernor class. Starts at the highest
+     *        level.
+     *
+     * @param[in] config Thresholds used by the governor.
+     */
+    PowerGovernor(const Power_Governor_Config_t& config)
+        : config(config) {};
+
+    /**
+     * @brief Updates the governor with a loop pass.
+     *
+     * @param[in] busyUs Time the loop pass took, in us.
+     * @param[in] waitUs Longest a sample could have waited behind the rest
+     *                   of the pass, in us: the pass without the shortest
+     *                   sample taken in it, or the whole pass if a
+     *                   controller wasn't sampled.
+     * @param[in] deadlineUs Sampling period the loop has to keep up with,
+     *                       in us.
+     * @param[in] nowMs Current time, in ms.
+     *
+     * @return True if the frequency level changed.
+     */
+    bool update(uint32_t busyUs, uint32_t waitUs, uint32_t deadlineUs, uint32_t nowMs);
+
+    /**
+     * @brief Steps up to the highest level ahead of a load increase, e.g.
+     *        when a central subscribes. Holds it off a step down for the up
+     *        holdoff.
+     *
+     * @param[in] nowMs Current time, in ms.
+     *
+     * @return True if the frequency level changed.
+     */
+    bool boost(uint32_t nowMs);
+
+    /**
+     * @brief Drops to the lowest level while the loop has no sampling
+     *        deadline, e.g. while nobody is subscribed.
+     *
+     * @param[in] nowMs Current time, in ms.
+     *
+     * @return True if the frequency level changed.
+     */
+    bool idle(uint32_t nowMs);
+
+    /** @brief Returns the current frequency level, 0 being the lowest. */
+    uint8_t getLevel(void) const { return level; };
+
+    /** @brief Returns the CPU frequency of the current level, in MHz. */
+    uint32_t getFrequencyMhz(void) const { return levelsMhz[level]; };
+
+    /** @brief Returns the number of frequency changes. */
+    uint32_t getSwitchCount(void) const { return switchCount; };
+
+    /** @brief Updates the thresholds used by the governor. */
+    void setConfig(const Power_Governor_Config_t& newConfig) { config = newConfig; };
+
+private:
+    /**
+     * @brief Switches to a new level and restarts the step down window.
+     */
+    bool setLevel(uint8_t newLevel, uint32_t nowMs);
+
+    /**
+     * @brief Predicts how long a pass would take at another level.
+     */
+    uint32_t predictBusyUs(uint32_t busyUs, uint8_t toLevel) const;
+
+    static const uint32_t levelsMhz[POWER_GOVERNOR_LEVEL_COUNT]; /** Frequency levels. */
+    Power_Governor_Config_t config; /** Thresholds. */
+    uint8_t level = POWER_GOVERNOR_LEVEL_COUNT - 1U; /** Current frequency level. */
+    bool hasWindow = false; /** Set once the step down window has started. */
+    uint32_t windowStartMs = 0U; /** Start of the step down window, in ms. */
+    uint32_t windowPeakBusyUs = 0U; /** Busiest pass of the window, in us. */
+    uint32_t windowPeakWaitUs = 0U; /** Longest wait of the window, in us. */
+    uint32_t windowDeadlineUs = 0U; /** Shortest deadline of the window, in us. */
+    uint32_t lastDeadlineUs = 0U; /** Deadline of the previous pass, in us. */
+    uint32_t lastUpMs = 0U; /** Time of the last step up, in ms. */
+    bool hasSteppedUp = false; /** Set once the governor has stepped up. */
+    uint32_t switchCount = 0U; /** Number of frequency changes. */
+};
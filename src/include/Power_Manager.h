@@ -0,0 +1,76 @@
+/**
+ * @file Power_Manager.h
+ * @brief CPU frequency control header file.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include "Arduino.h"
+#include "sdkconfig.h"
+#include "generic_types.h"
+
+#if CONFIG_PM_ENABLE
+#include "esp_idf_version.h"
+#include "esp_pm.h"
+#endif
+
+// setCpuFrequencyMhz() switches the clock under the running BLE controller
+// and the I2C/ADC drivers without taking any lock, so the governor only
+// changes the frequency through the ESP-IDF power management
+#if POWER_GOVERNOR_ENABLED && !CONFIG_PM_ENABLE
+#error "POWER_GOVERNOR_ENABLED needs ESP-IDF power management (CONFIG_PM_ENABLE) in the core's sdkconfig"
+#endif
+
+/** Lowest CPU frequency the BLE controller runs at, in MHz. */
+#define POWER_MIN_FREQUENCY_MHZ 80U
+
+/**
+ * @class PowerManager
+ * @brief Applies the CPU frequency picked by the \ref PowerGovernor.
+ *
+ * The frequency is set through esp_pm_configure() as the maximum the PM may
+ * run at, and two PM locks are held while sampling: ESP_PM_CPU_FREQ_MAX
+ * keeps the CPU at that maximum, and ESP_PM_APB_FREQ_MAX keeps the APB
+ * clock at 80MHz so the I2C and ADC drivers keep their timing. The BLE
+ * stack takes its own locks.
+ *
+ * @note Requires ESP-IDF power management (CONFIG_PM_ENABLE), which the
+ *       Arduino core enables. Without it every call fails with
+ *       STATUS_POWER_CONFIG_FAILURE, and POWER_GOVERNOR_ENABLED doesn't
+ *       compile.
+ */
+class PowerManager
+{
+public:
+    /**
+     * @brief Creates the PM locks and sets the initial frequency.
+     *
+     * @param[in] frequencyMhz Initial CPU frequency, in MHz.
+     *
+     * @return Status code indicating the result of the call.
+     */
+    status_t initPowerManager(uint32_t frequencyMhz);
+
+    /**
+     * @brief Sets the CPU frequency.
+     *
+     * @param[in] frequencyMhz CPU frequency, in MHz. One of
+     *                         POWER_GOVERNOR_LEVELS_MHZ.
+     *
+     * @return Status code indicating the result of the call.
+     */
+    status_t setFrequencyMhz(uint32_t frequencyMhz);
+
+    /** @brief Returns the CPU frequency that was last set, in MHz. */
+    uint32_t getFrequencyMhz(void) const { return frequencyMhz; };
+
+private:
+    uint32_t frequencyMhz = 0U; /** CPU frequency that was last set, in MHz. */
+#if CONFIG_PM_ENABLE
+    /** Keeps the CPU at the configured maximum frequency. */
+    esp_pm_lock_handle_t cpuFrequencyLock = nullptr;
+    /** Keeps the APB clock at 80MHz for the I2C and ADC drivers. */
+    esp_pm_lock_handle_t apbFrequencyLock = nullptr;
+#endif
+};
@@ -0,0 +1,58 @@
+/**
+ * @file Time_Sync.h
+ * @brief Device-to-host clock synchronization header file.
+ * @author Humza Ali
+ */
+
+#pragma once
+
+#include "BLE.h"
+#include "generic_types.h"
+#include "wire_schema.h"
+
+/**
+ * @class TimeSync
+ * @brief Answers NTP style ping-pong requests from the host.
+ *
+ * The host writes a \ref Time_Sync_Request_t and records its send time (t1)
+ * and the time the response arrives (t4). The device stamps the receive
+ * time (t2) and the transmit time (t3) in \ref Time_Sync_Response_t, which
+ * gives the host the offset and round trip time of each exchange. Input
+ * samples carry the device time they were taken at, so the host can map
+ * them onto its own clock.
+ */
+class TimeSync
+{
+public:
+    /**
+     * @brief Constructor for the TimeSync class.
+     *
+     * @param[in] pBle Pointer to a BLE object used to create the
+     *                 time sync characteristic.
+     */
+    TimeSync(BLE* pBle) : pBle(pBle) {};
+
+    /**
+     * @brief Creates the time sync characteristic.
+     *
+     * @return Status code indicating the result of the call.
+     */
+    status_t initTimeSync(void);
+
+    /**
+     * @brief Handles a time sync request written by the host. Called from
+     *        the BLE stack.
+     *
+     * @param[in] pData Request payload.
+     * @param[in] length Length of the request payload, in bytes.
+     * @param[in] receiveTimeUs Device time the request was received, in us.
+     */
+    void handleRequest(const uint8_t* pData, size_t length, uint32_t receiveTimeUs);
+
+private:
+    BLE* pBle = nullptr; /** Pointer to a BLE object */
+    /** Pointer to the time sync characteristic object. */
+    BLECharacteristic* pTimeSyncCharacteristic = nullptr;
+    /** Pointer to a notifier object for time sync responses. */
+    BLE2902* pTimeSyncNotifier = nullptr;
+};
@@ -6,32 +6,16 @@
 
 #pragma once
 
+#include <map>
+
 #include "BLE.h"
 #include "IMU_Sensor.h"
 #include "BaseController.h"
-
-/**
- * @enum Button_Mapping_t
- * @brief Contains bit mapping for DS4 inputs transmitted through a DSU server
- */
-typedef enum Button_Mapping {
-    DS4_SHARE    = 0x0001U, /** DS4 Share Button Bit Value */
-    DS4_L3       = 0x0002U, /** DS4 L3 Button Bit Value */
-    DS4_R3       = 0x0004U, /** DS4 R3 Button Bit Value */
-    DS4_OPTIONS  = 0x0008U, /** DS4 Options Button Bit Value */
-    DS4_UP       = 0x0010U, /** DS4 D-Pad Up Bit Value */
-    DS4_RIGHT    = 0x0020U, /** DS4 D-Pad Right Bit Value */
-    DS4_DOWN     = 0x0040U, /** DS4 D-Pad Down Bit Value */
-    DS4_LEFT     = 0x0080U, /** DS4 D-Pad Left Bit Value */
-    DS4_L2       = 0x0100U, /** DS4 L2 Button Bit Value */
-    DS4_R2       = 0x0200U, /** DS4 R2 Button Bit Value */
-    DS4_L1       = 0x0400U, /** DS4 L1 Button Bit Value */
-    DS4_R1       = 0x0800U, /** DS4 R1 Button Bit Value */
-    DS4_TRIANGLE = 0x1000U, /** DS4 Triangle Button Bit Value */
-    DS4_CIRCLE   = 0x2000U, /** DS4 Circle Button Bit Value */
-    DS4_CROSS    = 0x4000U, /** DS4 Cross Button Bit Value */
-    DS4_SQUARE   = 0x8000U, /** DS4 Square Button Bit Value */
-} Button_Mapping_t;
+#include "button_mapping.h"
+#include "Motion_Rate_Controller.h"
+#include "Gesture_Detector.h"
+#include "Gesture_Reporter.h"
+#include "wire_schema.h"
 
 /** GPIO pin mappings for the Wii Remote buttons. */
 #define BUTTON_A_PIN     (Pins_t)32U /** Wii Remote Button A Pin */
@@ -46,13 +30,23 @@ typedef enum Button_Mapping {
 #define DPAD_LEFT_PIN    (Pins_t)17U /** Wii Remote D-Pad Left Pin */
 #define DPAD_RIGHT_PIN   (Pins_t)34U /** Wii Remote D-Pad Right Pin */
 
-/** Wii Remote Button Input Characteristic UUID */
-#define WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID  "7e3092ce-5b65-44c7-afef-c7722ef964b3"
-/** Wii Remote Sensor Input Characteristic UUID */
-#define WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID  "eb854de2-f0b3-48bf-90ca-1f2a85ef29c8"
+// The characteristic UUIDs and payload layouts are defined in wire_schema.h
 
-/** Wii Remote Accelorometer Range */
-#define WIIMOTE_ACCELOROMETER_RANGE 2
+/**
+ * Wii Remote Accelorometer Range. Flicks peak above 2 g, see
+ * GESTURE_FLICK_ACCEL_THRESHOLD_G.
+ */
+#define WIIMOTE_ACCELOROMETER_RANGE 4
+/** Wii Remote IMU Type */
+#define WIIMOTE_IMU_TYPE IMU_TYPE_MPU6500
+
+#if IMU_STATIC_DISPATCH
+/** IMU sensor equipped on the Wii Remote, selected at compile time. */
+typedef StaticIMU_Sensor<WIIMOTE_IMU_TYPE, WIIMOTE_ACCELOROMETER_RANGE> WiiRemote_IMU_t;
+#else
+/** IMU sensor equipped on the Wii Remote, selected at runtime. */
+typedef IMU_Sensor WiiRemote_IMU_t;
+#endif
 
 /**
  * @class WiiRemote
@@ -74,9 +68,24 @@ public:
      * @param[in] pWiiRemoteImu Pointer to an IMU sensor object that reads
      *                          sensor data from the IMU sensor equipped on the
      *                          Wii Remote.
+     * @param[in] pRateController Pointer to a rate controller object used to
+     *                            reduce the sampling and reporting rate while
+     *                            the Wii Remote is still. If NULL, inputs are
+     *                            sampled and reported on every update.
+     * @param[in] pGestureDetector Pointer to a gesture detector object run on
+     *                             every IMU sample. If NULL, no gestures are
+     *                             detected.
+     * @param[in] pGestureReporter Pointer to the reporter object that sends
+     *                             the detected gestures.
      */
-    WiiRemote(BLE* pBle, IMU_Sensor* pWiiRemoteImu)
-        : pBle(pBle), pWiiRemoteImu(pWiiRemoteImu) {};
+    WiiRemote(BLE* pBle, WiiRemote_IMU_t* pWiiRemoteImu,
+              MotionRateController* pRateController = nullptr,
+              GestureDetector* pGestureDetector = nullptr,
+              GestureReporter* pGestureReporter = nullptr)
+        : pBle(pBle), pWiiRemoteImu(pWiiRemoteImu),
+          pRateController(pRateController),
+          pGestureDetector(pGestureDetector),
+          pGestureReporter(pGestureReporter) {};
     
     /**
      * @brief Deconstructor for the WiiRemote class.
@@ -143,5 +152,16 @@ private:
      * Pointer to an IMU sensor object for initializing an IMU sensor
      * and reading accelorometer and gyroscope data.
      */
-    IMU_Sensor* pWiiRemoteImu;
+    WiiRemote_IMU_t* pWiiRemoteImu;
+    /**
+     * Pointer to a rate controller object used to adapt the sampling and
+     * reporting rate to the motion of the Wii Remote.
+     */
+    MotionRateController* pRateController;
+    /** Pointer to a gesture detector object run on every IMU sample. */
+    GestureDetector* pGestureDetector;
+    /** Pointer to the reporter object that sends the detected gestures. */
+    GestureReporter* pGestureReporter;
+    /** Last button input value transmitted. */
+    uint32_t lastButtonInput = 0U;
 };
\ No newline at end of file
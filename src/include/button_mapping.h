@@ -1,7 +1,42 @@
 /**
  * @file button_mapping.h
- * @brief Header file containing generic defines and typedefs.
+ * @brief DS4 button bits shared by the controllers, the HID gamepad report
+ *        and the host tests.
  * @author Humza Ali
  */
 
-#include "Arduino.h"
\ No newline at end of file
+#pragma once
+
+/**
+ * @enum Button_Mapping_t
+ * @brief Contains bit mapping for DS4 inputs transmitted through a DSU server
+ */
+typedef enum Button_Mapping {
+    DS4_SHARE    = 0x0001U, /** DS4 Share Button Bit Value */
+    DS4_L3       = 0x0002U, /** DS4 L3 Button Bit Value */
+    DS4_R3       = 0x0004U, /** DS4 R3 Button Bit Value */
+    DS4_OPTIONS  = 0x0008U, /** DS4 Options Button Bit Value */
+    DS4_UP       = 0x0010U, /** DS4 D-Pad Up Bit Value */
+    DS4_RIGHT    = 0x0020U, /** DS4 D-Pad Right Bit Value */
+    DS4_DOWN     = 0x0040U, /** DS4 D-Pad Down Bit Value */
+    DS4_LEFT     = 0x0080U, /** DS4 D-Pad Left Bit Value */
+    DS4_L2       = 0x0100U, /** DS4 L2 Button Bit Value */
+    DS4_R2       = 0x0200U, /** DS4 R2 Button Bit Value */
+    DS4_L1       = 0x0400U, /** DS4 L1 Button Bit Value */
+    DS4_R1       = 0x0800U, /** DS4 R1 Button Bit Value */
+    DS4_TRIANGLE = 0x1000U, /** DS4 Triangle Button Bit Value */
+    DS4_CIRCLE   = 0x2000U, /** DS4 Circle Button Bit Value */
+    DS4_CROSS    = 0x4000U, /** DS4 Cross Button Bit Value */
+    DS4_SQUARE   = 0x8000U, /** DS4 Square Button Bit Value */
+} Button_Mapping_t;
+
+// These two buttons are the only two buttons not included as
+// the buttons1 and buttons2 inputs in dsu.py, so we'll use
+// these as the c and z buttons on the nunchuck.
+// (Yes, it makes sense to use DS4_HOME for the the Wii Remote
+//  Home button, but these two buttons not having a mapping
+//  makes it more convenient for the nunchuck buttons lol)
+// These are self defined bit values, not part of the buttons1
+// and buttons2 variables as noted in the comment above.
+#define DS4_HOME      0x01U /** DS4 Home Bit Value */
+#define DS4_PAD_CLICK 0x02U /** DS4 Pad Click Bit Value */
@@ -12,11 +12,15 @@
  */
 typedef enum {
     /** Indicates a failure in initializing an IMU. */
-    STATUS_IMU_INIT_FAILURE = -1,
+    STATUS_IMU_INIT_FAILURE     = -1,
     /** Indicates completion of a task. */
-    STATUS_COMPLETE         = 0,
+    STATUS_COMPLETE             = 0,
     /** Indicates a NULL pointer that should've been set. */
-    STATUS_NULL_POINTER     = 1,
+    STATUS_NULL_POINTER         = 1,
+    /** Indicates that a fixed-size resource has been exhausted. */
+    STATUS_NO_RESOURCES         = 2,
+    /** Indicates that the CPU frequency could not be configured. */
+    STATUS_POWER_CONFIG_FAILURE = 3,
 } status_t;
 
 // Set to 1 to print logs through Serial output
@@ -26,5 +30,34 @@ typedef enum {
 #define DEBUG 0
 #endif
 
+// Set to 1 to also expose a standard HID-over-GATT gamepad service, which
+// the host OS consumes directly without the Python DSU bridge. The custom
+// input service used by the DSU bridge stays available. Can also be set
+// from the build flags, as the host builds of link_sim.py do.
+#ifndef BLE_HID_GAMEPAD_MODE
+#define BLE_HID_GAMEPAD_MODE 0
+#endif
+
+// Set to 1 to record timing anomalies (loop overruns, IMU read errors,
+// notification failures, connection changes) in an in-RAM ring that the host
+// can download over BLE. See Flight_Recorder.h.
+#define FLIGHT_RECORDER_ENABLED 1
+
+// Set to 1 to detect swings, shakes and flicks on every IMU sample and notify
+// them as soon as they are detected, ahead of the motion stream. See
+// Gesture_Detector.h.
+#define GESTURE_EVENTS_ENABLED 1
+
+// Set to 1 to select the IMU drivers at compile time (StaticIMU_Sensor), so
+// the sampling calls are dispatched statically. Set to 0 to fall back to
+// selecting them at runtime by name (IMU_Sensor).
+#define IMU_STATIC_DISPATCH 1
+
+// Set to 1 to step the CPU frequency between 80, 160 and 240MHz with the
+// measured loop load, keeping the sample jitter of each change within a
+// budget. Needs ESP-IDF power management (CONFIG_PM_ENABLE). See
+// Power_Governor.h.
+#define POWER_GOVERNOR_ENABLED 1
+
 /** Typedef used for representing GPIO pin numbers.  */
 typedef uint8_t Pins_t;
\ No newline at end of file
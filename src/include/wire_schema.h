@@ -0,0 +1,211 @@
+/**
+ * @file wire_schema.h
+ * @brief BLE payload definitions shared with the host.
+ * @author Humza Ali
+ *
+ * @note Generated from src/schema/wire_schema.json by
+ *       src/schema/gen_wire_schema.py. Do not edit by hand.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/** Version of the wire schema. */
+#define WIRE_SCHEMA_VERSION 4U
+
+/** BLE Service UUID */
+#define SERVICE_UUID "06a1ef1c-d8f5-4839-bf3a-cf1deed694d2"
+
+/** Wiimote Button Input Characteristic UUID */
+#define WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID "7e3092ce-5b65-44c7-afef-c7722ef964b3"
+/** Wiimote Sensor Input Characteristic UUID */
+#define WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID "eb854de2-f0b3-48bf-90ca-1f2a85ef29c8"
+/** Nunchuck Button Joystick Input Characteristic UUID */
+#define NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID "3327921d-e3b3-43ff-b724-a706fae760d3"
+/** Nunchuck Sensor Input Characteristic UUID */
+#define NUNCHUCK_SENSOR_INPUT_CHARACTERISTIC_UUID "be11ecb2-1c60-4411-9385-0436b247c5bb"
+/** Time Sync Characteristic UUID */
+#define TIME_SYNC_CHARACTERISTIC_UUID "a5b8c9d2-4f1e-4c3a-9b7d-2e6f8a1c0d3b"
+/** Flight Recorder Characteristic UUID */
+#define FLIGHT_RECORDER_CHARACTERISTIC_UUID "c3f1a6e4-7d2b-4e8a-9f5c-1b0d2e3f4a5b"
+/** Gesture Event Characteristic UUID */
+#define GESTURE_EVENT_CHARACTERISTIC_UUID "e876b2cb-466d-4131-a99b-ec88ab7f0b49"
+
+/**
+ * @enum Flight_Event_Type_t
+ * @brief Type of a flight recorder event.
+ */
+typedef enum {
+    FLIGHT_EVENT_BOOT            = 0, /** Recorder started. value: reset reason. */
+    FLIGHT_EVENT_LOOP_OVERRUN    = 1, /** Loop pass took too long. value: duration, in ms. */
+    FLIGHT_EVENT_I2C_ERROR       = 2, /** IMU read returned no data. arg: controller (0 Wii Remote, 1 Nunchuck). */
+    FLIGHT_EVENT_NOTIFY_FAILURE  = 3, /** Notification not sent. arg: characteristic index, value: Flight_Notify_Failure_t. */
+    FLIGHT_EVENT_QUEUE_SATURATED = 4, /** Notification held back, no BLE TX buffers left. arg: characteristic index. */
+    FLIGHT_EVENT_CONNECT         = 5, /** Central connected. value: connection ID. */
+    FLIGHT_EVENT_DISCONNECT      = 6, /** Central disconnected. */
+    FLIGHT_EVENT_SUBSCRIBE       = 7, /** Subscriptions changed. arg: subscribed characteristic mask, value: peer MTU. */
+    FLIGHT_EVENT_FREEZE          = 8, /** Recorder frozen by the host. */
+    FLIGHT_EVENT_CPU_FREQ        = 9, /** CPU frequency changed. arg: previous frequency, value: new frequency, in MHz. */
+} Flight_Event_Type_t;
+
+/**
+ * @enum Flight_Notify_Failure_t
+ * @brief Reason a notification was not sent.
+ */
+typedef enum {
+    FLIGHT_NOTIFY_NULL_CHARACTERISTIC = 1, /** Characteristic was never created. */
+    FLIGHT_NOTIFY_TRUNCATED           = 2, /** Value is larger than the peer MTU allows. */
+} Flight_Notify_Failure_t;
+
+/**
+ * @enum Flight_Recorder_Command_t
+ * @brief Command written by the host to the flight recorder characteristic.
+ */
+typedef enum {
+    FLIGHT_RECORDER_COMMAND_READ_CHUNK = 0, /** Freeze and load a chunk of events for reading. */
+    FLIGHT_RECORDER_COMMAND_FREEZE     = 1, /** Freeze the recorder. */
+    FLIGHT_RECORDER_COMMAND_RESUME     = 2, /** Clear the recorder and resume recording. */
+} Flight_Recorder_Command_t;
+
+/**
+ * @enum Gesture_Type_t
+ * @brief Type of a detected gesture.
+ */
+typedef enum {
+    GESTURE_SWING_START = 0, /** Rotation rate crossed the swing threshold. magnitude: rotation rate, in dps. */
+    GESTURE_SWING_PEAK  = 1, /** Rotation rate of a swing peaked. magnitude: peak rotation rate, in dps. */
+    GESTURE_SHAKE       = 2, /** Acceleration reversed direction repeatedly. magnitude: number of reversals. */
+    GESTURE_FLICK       = 3, /** Sharp linear acceleration without a swing. magnitude: acceleration, in mg. */
+} Gesture_Type_t;
+
+/**
+ * @struct Wiimote_Button_Input_t
+ * @brief Wii Remote DS4 button bits (see Button_Mapping_t).
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  buttons1; /** DS4 buttons1 byte (Share, L3, R3, Options, D-Pad). */
+    uint8_t  buttons2; /** DS4 buttons2 byte (L2, R2, L1, R1, face buttons). */
+    uint16_t reserved; /** Unused, always 0. */
+} Wiimote_Button_Input_t;
+static_assert(sizeof(Wiimote_Button_Input_t) == 4U,
+              "Wiimote_Button_Input_t does not match the wire schema");
+
+/**
+ * @struct Wiimote_Sensor_Input_t
+ * @brief Wii Remote accelerometer and gyroscope sample.
+ */
+typedef struct __attribute__((packed)) {
+    float    accelX;      /** Accelerometer X, in g. */
+    float    accelY;      /** Accelerometer Y, in g. */
+    float    accelZ;      /** Accelerometer Z, in g. */
+    float    gyroX;       /** Gyroscope X, in dps. */
+    float    gyroY;       /** Gyroscope Y, in dps. */
+    float    gyroZ;       /** Gyroscope Z, in dps. */
+    uint32_t timestampUs; /** Device time the sample was taken, in us. */
+} Wiimote_Sensor_Input_t;
+static_assert(sizeof(Wiimote_Sensor_Input_t) == 28U,
+              "Wiimote_Sensor_Input_t does not match the wire schema");
+
+/**
+ * @struct Nunchuck_Button_Joystick_Input_t
+ * @brief Nunchuck joystick axes and C/Z button bits.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t joystickX; /** Joystick X axis, 0-255. */
+    uint8_t joystickY; /** Joystick Y axis, 0-255. */
+    uint8_t buttons;   /** DS4_HOME (C) and DS4_PAD_CLICK (Z) bits. */
+} Nunchuck_Button_Joystick_Input_t;
+static_assert(sizeof(Nunchuck_Button_Joystick_Input_t) == 3U,
+              "Nunchuck_Button_Joystick_Input_t does not match the wire schema");
+
+/**
+ * @struct Nunchuck_Sensor_Input_t
+ * @brief Nunchuck accelerometer sample.
+ */
+typedef struct __attribute__((packed)) {
+    float    accelX;      /** Accelerometer X, in g. */
+    float    accelY;      /** Accelerometer Y, in g. */
+    float    accelZ;      /** Accelerometer Z, in g. */
+    uint32_t timestampUs; /** Device time the sample was taken, in us. */
+} Nunchuck_Sensor_Input_t;
+static_assert(sizeof(Nunchuck_Sensor_Input_t) == 16U,
+              "Nunchuck_Sensor_Input_t does not match the wire schema");
+
+/**
+ * @struct Time_Sync_Request_t
+ * @brief Written by the host to start a time sync exchange.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t sequence; /** Sequence number chosen by the host. */
+} Time_Sync_Request_t;
+static_assert(sizeof(Time_Sync_Request_t) == 4U,
+              "Time_Sync_Request_t does not match the wire schema");
+
+/**
+ * @struct Time_Sync_Response_t
+ * @brief Notified back to the host for a time sync exchange.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t sequence;       /** Sequence number of the request. */
+    uint32_t receiveTimeUs;  /** Device time the request was received, in us. */
+    uint32_t transmitTimeUs; /** Device time the response was sent, in us. */
+} Time_Sync_Response_t;
+static_assert(sizeof(Time_Sync_Response_t) == 12U,
+              "Time_Sync_Response_t does not match the wire schema");
+
+/**
+ * @struct Flight_Recorder_Request_t
+ * @brief Written by the host to control the flight recorder.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  command;    /** Flight_Recorder_Command_t. */
+    uint8_t  reserved;   /** Unused, always 0. */
+    uint16_t chunkIndex; /** Chunk to load for FLIGHT_RECORDER_COMMAND_READ_CHUNK. */
+} Flight_Recorder_Request_t;
+static_assert(sizeof(Flight_Recorder_Request_t) == 4U,
+              "Flight_Recorder_Request_t does not match the wire schema");
+
+/**
+ * @struct Flight_Recorder_Chunk_Header_t
+ * @brief Read from the flight recorder characteristic, followed by eventCount Flight_Recorder_Event_t.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t chunkIndex;   /** Index of this chunk. */
+    uint16_t chunkCount;   /** Number of chunks in the recording. */
+    uint16_t eventCount;   /** Number of events in this chunk. */
+    uint16_t cpuFreqMhz;   /** CPU frequency when the newest kept event was recorded, in MHz. Earlier ones follow from the CPU_FREQ events. */
+    uint32_t totalEvents;  /** Events recorded since the last resume, including overwritten ones. */
+    uint8_t  frozen;       /** 1 if the recorder is frozen. */
+    uint8_t  freezeReason; /** Flight_Event_Type_t that froze the recorder. */
+    uint16_t reserved;     /** Unused, always 0. */
+} Flight_Recorder_Chunk_Header_t;
+static_assert(sizeof(Flight_Recorder_Chunk_Header_t) == 16U,
+              "Flight_Recorder_Chunk_Header_t does not match the wire schema");
+
+/**
+ * @struct Flight_Recorder_Event_t
+ * @brief One flight recorder event.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t cycles; /** CPU cycle counter when the event was recorded. */
+    uint8_t  type;   /** Flight_Event_Type_t. */
+    uint8_t  arg;    /** Event specific argument. */
+    uint16_t value;  /** Event specific value. */
+} Flight_Recorder_Event_t;
+static_assert(sizeof(Flight_Recorder_Event_t) == 8U,
+              "Flight_Recorder_Event_t does not match the wire schema");
+
+/**
+ * @struct Gesture_Event_t
+ * @brief Gesture detected on the device. A notification carries one or more events.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  type;        /** Gesture_Type_t. */
+    uint8_t  controller;  /** Controller the gesture was detected on (0 Wii Remote, 1 Nunchuck). */
+    uint16_t magnitude;   /** Gesture specific magnitude, see Gesture_Type_t. */
+    uint32_t timestampUs; /** Device time of the sample the gesture was detected at, in us. */
+} Gesture_Event_t;
+static_assert(sizeof(Gesture_Event_t) == 8U,
+              "Gesture_Event_t does not match the wire schema");
+
@@ -0,0 +1,336 @@
+"""
+File: button_profile.py
+Description: Remapping profiles from the physical Wii Remote and Nunchuck
+             buttons to the DS4 pad fields sent by DSU_Server. A profile is
+             a JSON file with one section per controller:
+
+                 {
+                     "name": "Default",
+                     "wiimote": {
+                         "buttons": { "A": "CROSS", "B": ["CIRCLE", "R2"] },
+                         "accel": ["-x", "z", "-y"],
+                         "gyro": ["y", "z", "x"]
+                     },
+                     "nunchuck": { "buttons": { "C": "HOME", "Z": "PAD_CLICK" } }
+                 }
+
+             Buttons left out of a section keep their default mapping and
+             buttons mapped to null are disabled. "accel" picks the device
+             axis sent as DSU accel x/y/z and "gyro" the one sent as
+             pitch/yaw/roll, each optionally negated. Sections left out use
+             the default profile.
+
+             Each section is compiled into one 256 entry lookup table per
+             raw button byte (buttons1, buttons2, extraButtons), so the DSU
+             button and pressure bytes of a packet are three lookups.
+             Profiles are kept in src/profiles and reloaded when their file
+             changes, so they can be switched without reflashing or
+             restarting the bridge.
+Author: Humza Ali
+"""
+
+import json
+import os
+import time
+
+# Directory the profiles shipped with the bridge are kept in
+PROFILE_DIR = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))),
+                           'profiles')
+# Profile used when none is given
+DEFAULT_PROFILE_NAME = 'default'
+# Time between checks of the profile file for changes, in seconds
+PROFILE_POLL_INTERVAL = 1.0
+# Controller sections of a profile
+PROFILE_CONTROLLERS = ('wiimote', 'nunchuck')
+
+# Physical buttons, as (raw button byte, bit) pairs. The firmware sends the
+# Wii Remote buttons in the DS4 bit layout set up by
+# WiiRemote::initButtonPins and the Nunchuck buttons in extraButtons.
+PHYSICAL_BUTTONS = {
+    'HOME': (0, 0x01),
+    'MINUS': (0, 0x02),
+    'PLUS': (0, 0x04),
+    'UP': (0, 0x10),
+    'RIGHT': (0, 0x20),
+    'DOWN': (0, 0x40),
+    'LEFT': (0, 0x80),
+    'TWO': (1, 0x10),
+    'B': (1, 0x20),
+    'A': (1, 0x40),
+    'ONE': (1, 0x80),
+    'C': (2, 0x01),
+    'Z': (2, 0x02),
+}
+# Number of raw button bytes
+RAW_BUTTON_BYTES = 3
+
+# Offsets in the DSU pad data of the button block: buttons1, buttons2,
+# home, pad click, then after the sticks the pressure of D-pad left, down,
+# right, up, square, cross, circle, triangle, R1, L1, R2 and L2
+DS4_BUTTON_BYTES = 4
+DS4_PRESSURE_BYTES = 12
+DS4_PRESSED = 0xFF
+
+# DS4 outputs, as (button byte, bit, pressure byte or None)
+DS4_BUTTONS = {
+    'SHARE': (0, 0x01, None),
+    'L3': (0, 0x02, None),
+    'R3': (0, 0x04, None),
+    'OPTIONS': (0, 0x08, None),
+    'UP': (0, 0x10, 3),
+    'RIGHT': (0, 0x20, 2),
+    'DOWN': (0, 0x40, 1),
+    'LEFT': (0, 0x80, 0),
+    'L2': (1, 0x01, 11),
+    'R2': (1, 0x02, 10),
+    'L1': (1, 0x04, 9),
+    'R1': (1, 0x08, 8),
+    'TRIANGLE': (1, 0x10, 7),
+    'CIRCLE': (1, 0x20, 6),
+    'CROSS': (1, 0x40, 5),
+    'SQUARE': (1, 0x80, 4),
+    'HOME': (2, 0x01, None),
+    'PAD_CLICK': (3, 0x01, None),
+}
+
+# Mapping the firmware layout was made for
+DEFAULT_BUTTONS = {
+    'HOME': 'SHARE',
+    'MINUS': 'L3',
+    'PLUS': 'R3',
+    'UP': 'UP',
+    'RIGHT': 'RIGHT',
+    'DOWN': 'DOWN',
+    'LEFT': 'LEFT',
+    'TWO': 'TRIANGLE',
+    'B': 'CIRCLE',
+    'A': 'CROSS',
+    'ONE': 'SQUARE',
+    'C': 'HOME',
+    'Z': 'PAD_CLICK',
+}
+# Invert x and z so moving the remote left moves a character left, and
+# swap y and z since the Wii Remote expects y to point up when it lies
+# flat. Swap these back if the accelerometer points up when the remote is
+# flat.
+DEFAULT_ACCEL_AXES = ['-x', 'z', '-y']
+# Pitch, yaw and roll
+DEFAULT_GYRO_AXES = ['y', 'z', 'x']
+AXIS_INDICES = {'x': 0, 'y': 1, 'z': 2}
+
+
+def outputBits(outputs):
+    """
+    Returns the button block of a set of DS4 outputs, as an int with the
+    button bytes in the low bytes and the pressure bytes above them.
+    """
+    block = 0
+    for name in outputs:
+        buttonByte, bit, pressureByte = DS4_BUTTONS[name]
+        block |= bit << (8 * buttonByte)
+        if pressureByte != None:
+            block |= DS4_PRESSED << (8 * (DS4_BUTTON_BYTES + pressureByte))
+    return block
+
+
+def compileAxes(axes, field):
+    """
+    Compiles an axis list into (index, sign) pairs.
+
+    Params:
+        axes (list): Three axis names, optionally prefixed with '-'.
+        field (String): Name of the field, for errors.
+
+    Return:
+        (tuple): Index and sign of each output axis.
+    """
+    if (not isinstance(axes, list)) or (len(axes) != 3):
+        raise ValueError(f"{field} must list three axes")
+    compiled = []
+    for axis in axes:
+        if not isinstance(axis, str):
+            raise ValueError(f"Axes in {field} must be strings, not {axis!r}")
+        sign = 1.0
+        if axis.startswith('-'):
+            sign = -1.0
+            axis = axis[1:]
+        if axis not in AXIS_INDICES:
+            raise ValueError(f"Unknown axis {axis!r} in {field}")
+        compiled += [AXIS_INDICES[axis], sign]
+    return tuple(compiled)
+
+
+class CompiledProfile(object):
+    """
+    Lookup tables and axis transform of one controller section.
+
+    Attributes:
+        None
+    """
+
+    __slots__ = ('name', 'tables', 'accelAxes', 'gyroAxes')
+
+    def __init__(self, section=None, name=DEFAULT_PROFILE_NAME):
+        """
+        Compiles a controller section of a profile.
+
+        Params:
+            section (dict): Controller section, or None for the default.
+            name (String): Name of the profile.
+        """
+        if section == None:
+            section = {}
+        if not isinstance(section, dict):
+            raise ValueError("A controller section must be an object")
+        unknown = set(section) - {'buttons', 'accel', 'gyro'}
+        if unknown:
+            raise ValueError(f"Unknown profile fields {sorted(unknown)}")
+        buttons = section.get('buttons', {})
+        if not isinstance(buttons, dict):
+            raise ValueError("buttons must be an object")
+        mapping = dict(DEFAULT_BUTTONS)
+        for physical, outputs in buttons.items():
+            if physical not in PHYSICAL_BUTTONS:
+                raise ValueError(f"Unknown button {physical!r}")
+            if outputs == None:
+                outputs = []
+            elif isinstance(outputs, str):
+                outputs = [outputs]
+            elif not isinstance(outputs, list):
+                raise ValueError(f"{physical} must map to a DS4 button, a list of them or null")
+            for output in outputs:
+                if (not isinstance(output, str)) or (output not in DS4_BUTTONS):
+                    raise ValueError(f"Unknown DS4 button {output!r} for {physical}")
+            mapping[physical] = outputs
+        self.name = name
+        # Bits of buttons1 and buttons2 with no physical button behind them
+        # pass through as the DS4 button of the same bit
+        passThrough = [0xFF, 0xFF, 0x00]
+        bitOutputs = [[0] * 8 for _ in range(RAW_BUTTON_BYTES)]
+        for physical, outputs in mapping.items():
+            rawByte, bit = PHYSICAL_BUTTONS[physical]
+            if isinstance(outputs, str):
+                outputs = [outputs]
+            bitOutputs[rawByte][bit.bit_length() - 1] = outputBits(outputs)
+            passThrough[rawByte] &= ~bit
+        for output, (buttonByte, bit, _) in DS4_BUTTONS.items():
+            if (buttonByte < 2) and (passThrough[buttonByte] & bit):
+                bitOutputs[buttonByte][bit.bit_length() - 1] = outputBits([output])
+        self.tables = []
+        for rawByte in range(RAW_BUTTON_BYTES):
+            table = [0] * 256
+            for value in range(1, 256):
+                # Reuse the entry without the lowest set bit
+                low = value & -value
+                table[value] = table[value & ~low] | bitOutputs[rawByte][low.bit_length() - 1]
+            self.tables.append(tuple(table))
+        self.accelAxes = compileAxes(section.get('accel', DEFAULT_ACCEL_AXES), 'accel')
+        self.gyroAxes = compileAxes(section.get('gyro', DEFAULT_GYRO_AXES), 'gyro')
+
+    def lookup(self, buttons1, buttons2, extraButtons):
+        """
+        Looks up the DS4 button and pressure bytes of a set of raw buttons.
+
+        Return:
+            (int): Button bytes in the low bytes, pressure bytes above.
+        """
+        return (self.tables[0][buttons1 & 0xFF] | self.tables[1][buttons2 & 0xFF] |
+                self.tables[2][extraButtons & 0xFF])
+
+
+def loadProfile(nameOrPath):
+    """
+    Loads and compiles a profile.
+
+    Params:
+        nameOrPath (String): Path of a profile file, or the name of one in
+                             PROFILE_DIR.
+
+    Return:
+        (dict): Compiled profile of each controller.
+    """
+    path = profilePath(nameOrPath)
+    with open(path) as f:
+        profile = json.load(f)
+    if not isinstance(profile, dict):
+        raise ValueError(f"{path} is not a profile")
+    name = profile.get('name', os.path.splitext(os.path.basename(path))[0])
+    if not isinstance(name, str):
+        raise ValueError(f"name must be a string in {path}")
+    unknown = set(profile) - {'name'} - set(PROFILE_CONTROLLERS)
+    if unknown:
+        raise ValueError(f"Unknown controllers {sorted(unknown)} in {path}")
+    return {controller: CompiledProfile(profile.get(controller), name)
+            for controller in PROFILE_CONTROLLERS}
+
+
+def profilePath(nameOrPath):
+    """ Returns the file of a profile given by name or path. """
+    if os.path.exists(nameOrPath):
+        return nameOrPath
+    return os.path.join(PROFILE_DIR, nameOrPath + '.json')
+
+
+class ProfileWatcher(object):
+    """
+    Reloads a profile when its file changes, so the mapping can be switched
+    while the bridge runs by editing or replacing the file.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, nameOrPath, onChange, pollInterval=PROFILE_POLL_INTERVAL):
+        """
+        Initializes the watcher.
+
+        Params:
+            nameOrPath (String): Path of a profile file, or the name of one
+                                 in PROFILE_DIR.
+            onChange (function): Called with the compiled profile of each
+                                 controller after every successful load.
+            pollInterval (float): Time between checks of the file, in
+                                  seconds.
+        """
+        self.path = profilePath(nameOrPath)
+        self.onChange = onChange
+        self.pollInterval = pollInterval
+        self.lastModified = None
+
+    def poll(self) -> bool:
+        """
+        Loads the profile if the file changed since the last load. A profile
+        that fails to load is reported and the current one is kept, whatever
+        the error, so a bad edit never stops the watcher.
+
+        Return:
+            (bool): Indicates whether a new profile was loaded.
+        """
+        try:
+            modified = os.stat(self.path).st_mtime_ns
+        except OSError as e:
+            if self.lastModified == None:
+                raise
+            print(f"Profile {self.path} unavailable: {e}")
+            return False
+        if modified == self.lastModified:
+            return False
+        self.lastModified = modified
+        try:
+            profiles = loadProfile(self.path)
+        except (OSError, ValueError) as e:
+            # json.JSONDecodeError is a ValueError
+            print(f"Profile {self.path} not loaded: {e}")
+            return False
+        except Exception as e:
+            print(f"Profile {self.path} not loaded: {type(e).__name__}: {e}")
+            return False
+        print(f"Loaded profile {profiles[PROFILE_CONTROLLERS[0]].name}")
+        self.onChange(profiles)
+        return True
+
+    def run(self):
+        """ Polls the profile file forever. Should be run as a thread. """
+        while True:
+            time.sleep(self.pollInterval)
+            self.poll()
@@ -13,6 +13,36 @@ import time
 import random
 from enum import Enum
 from binascii import crc32
+from button_profile import CompiledProfile, DS4_BUTTON_BYTES, DS4_PRESSURE_BYTES
+
+# Poll interval of the shared memory channel, in seconds
+SHARED_STATE_POLL_INTERVAL = 0.0005
+# Maximum number of client requests handled per wakeup. Anything left is
+# handled on the next wakeup, after the pad data has been sent.
+DSU_MAX_REQUESTS_PER_WAKEUP = 64
+# Largest datagram read from a client, in bytes
+DSU_MAX_PACKET_SIZE = 1024
+# Magic values at the start of client and server packets
+DSU_CLIENT_MAGIC = b"DSUC"
+DSU_SERVER_MAGIC = b"DSUS"
+# Packet header: magic, protocol version, message length, CRC32, id
+DSU_HEADER = struct.Struct('<4s2HII')
+# Packet header followed by the message type
+DSU_REQUEST_HEADER = struct.Struct('<4s2HIII')
+DSU_REQUEST_MIN_SIZE = DSU_REQUEST_HEADER.size
+# Offset of the CRC32 in the header, in bytes
+DSU_CRC_OFFSET = 8
+DSU_ZERO_CRC = bytes(4)
+DSU_UINT32 = struct.Struct('<I')
+# List ports request: number of ports followed by one byte per port
+DSU_LIST_PORTS_MIN_SIZE = DSU_REQUEST_MIN_SIZE + DSU_UINT32.size
+# Pad data request: registration flags, slot and MAC address
+DSU_PAD_DATA_REQ = struct.Struct('<2B6s')
+DSU_PAD_DATA_REQ_SIZE = DSU_REQUEST_MIN_SIZE + DSU_PAD_DATA_REQ.size
+# Number of controller ports a client can ask about
+DSU_PORT_COUNT = 4
+# MAC addresses reported for each controller port
+DSU_PORT_MACS = [f"FPIE0{p}".encode('utf-8') for p in range(DSU_PORT_COUNT)]
 
 
 class DSU_TYPES(Enum):
@@ -30,6 +60,16 @@ class DSU_TYPES(Enum):
     DSUS_PadDataRsp = 0x100002
 
 
+# Pad data response: message type, port info, then pad data
+DSU_PAD_DATA_RSP = struct.pack("<I", DSU_TYPES.DSUS_PadDataRsp.value)
+# Port, state, model, connection type, MAC address, battery, active,
+# packet count
+DSU_PAD_PORT_INFO = struct.Struct("<4B6s2BI")
+# DS4 button bytes, sticks, pressure bytes, touch pad, motion timestamp,
+# accelerometer and gyroscope
+DSU_PAD_DATA = struct.Struct("<%ds4B%ds2B2H2B2HQ6f" % (DS4_BUTTON_BYTES, DS4_PRESSURE_BYTES))
+
+
 class DSU_Server:
     """
     DSU Server class used for providing controller inputs to the
@@ -66,200 +106,289 @@ class DSU_Server:
         self.gyroData = None
         # Nunchuck Joystick input data
         self.joystickData = None
+        # Host time the motion data was sampled at, in us. Set from the
+        # device timestamp once the device clock is synced.
+        self.motionTimestamp = None
+        # Shared memory channel the inputs are read from, if attached
+        self.sharedState = None
+        self.sharedSlot = 0
+        self.sharedSample = None
+        self.lastSequence = None
+        # Button and axis mapping, see button_profile.py
+        self.profile = CompiledProfile()
+        # Number of client requests that were dropped as invalid
+        self.invalidRequests = 0
+        # Client request handlers, by message type
+        self.requestHandlers = {
+            DSU_TYPES.DSUC_VersionReq.value: self.handleVersionRequest,
+            DSU_TYPES.DSUC_ListPorts.value: self.handleListPortsRequest,
+            DSU_TYPES.DSUC_PadDataReq.value: self.handlePadDataRequest,
+        }
+        # Responses that never change are built once
+        self.versionResponse = self.packPacket(struct.pack(
+            "<IH", DSU_TYPES.DSUS_VersionRsp.value, self.protocolVersion))
+        # Controller data the server will provide
+        # (only providing data for player 1)
+        enabled = [True, False, False, False]
+        self.portInfoResponses = {}
+        for p in range(DSU_PORT_COUNT):
+            if enabled[p]:
+                state = 2  # 0=disconnected, 1=reserved, 2=connected
+                model = 2  # 0=none, 1=DS3, 2=DS4
+                connection = 2  # 0=none, 1=usb, 2=bt
+                battery = 5  # 0=none, 1=dying, 2=low, 3=medium, 4=high, 5=full, 0xEE=charging, 0xEF=charged
+                active = 1  # 0=no, 1=yes
+                portinfo = struct.pack("<4B6s2B", p, state, model, connection,
+                                       DSU_PORT_MACS[p], battery, active)
+                self.portInfoResponses[p] = self.packPacket(
+                    struct.pack("<I", DSU_TYPES.DSUS_PortInfo.value) + portinfo)
+
+    def attachSharedState(self, sharedState, slot):
+        """
+        Reads the inputs from a shared memory channel written by another
+        process, instead of having them set on this object.
+
+        Params:
+            sharedState (SharedControllerState): Shared memory channel.
+            slot (int): Controller slot of this server in the channel.
+        """
+        self.sharedState = sharedState
+        self.sharedSlot = slot
+        self.lastSequence = None
+
+    def loadSharedState(self) -> bool:
+        """
+        Loads the latest snapshot from the attached shared memory channel.
+
+        Return:
+            (bool): Indicates whether a new sample was loaded.
+        """
+        if self.sharedState.sequence(self.sharedSlot) == self.lastSequence:
+            return False
+        sequence, sample = self.sharedState.read(self.sharedSlot, self.sharedSample)
+        if sequence == None:
+            return False
+        self.sharedSample = sample
+        self.lastSequence = sequence
+        self.buttons1 = sample.buttons1
+        self.buttons2 = sample.buttons2
+        self.extraButtons = sample.extraButtons
+        self.joystickData = sample.joystickData
+        self.accelData = sample.accelData
+        self.gyroData = sample.gyroData
+        self.motionTimestamp = sample.motionTimestamp
+        return True
+
+    def communicateWithDsuClient(self, timeout=0.0):
+        """
+        Communicate with the DSU Client (in this case Dolphin).
 
-    def communicateWithDsuClient(self):
-        """ Communicate with the DSU Client (in this case Dolphin). """
-        readDescriptors, _, _ = select.select([self.dsuSocket], [], [], 0.0)
-        for rd in readDescriptors:
+        Handles every request that is pending when the socket becomes
+        readable, up to DSU_MAX_REQUESTS_PER_WAKEUP so that a client
+        flooding the server can't hold off the pad data output.
+
+        Params:
+            timeout (float): Maximum time to wait for a client request,
+                             in seconds.
+        """
+        readDescriptors, _, _ = select.select([self.dsuSocket], [], [], timeout)
+        if not readDescriptors:
+            return
+        for _ in range(DSU_MAX_REQUESTS_PER_WAKEUP):
             try:
-                data, address = rd.recvfrom(1024)
-            except:
-                continue
-            
-            # Receive data from DSU client
-            _, self.protocolVersion, msgLen, crc, _ = struct.unpack_from(
-                '<4s2HiI', data)
-            if (msgLen + 16) != len(data):
-                # Expected messaged length and data length do not match
+                data, address = self.dsuSocket.recvfrom(DSU_MAX_PACKET_SIZE)
+            except BlockingIOError:
+                # No more pending requests
+                return
+            except ConnectionResetError:
+                # Windows reports an unreachable client of an earlier
+                # response on the next receive, skip it
                 continue
+            self.handleRequest(data, address)
 
-            # Receive the message type from the client
-            msgtype, = struct.unpack_from('<1I', data, 16)
-            if msgtype == DSU_TYPES.DSUC_VersionReq.value:
-                # Client requesting protocol version from server
-                msg = struct.pack(
-                    "<IH", DSU_TYPES.DSUS_VersionRsp.value, self.protocolVersion)
-                header = struct.pack(
-                    "<4s2HiI", "DSUS", self.protocolVersion, len(msg), 0, self.serverId)
-                rc = crc32(header + msg)
-                header2 = struct.pack(
-                    "<4s2HiI", "DSUS", self.protocolVersion, len(msg), rc, self.serverId)
-                # Transmit data to client
-                self.dsuSocket.sendto(header2+msg, address)
-
-            if msgtype == DSU_TYPES.DSUC_ListPorts.value:
-                # Client requesting controller port info value
-                wpl = []
-                wanted, = struct.unpack_from('<1I', data, 20)
-                if (wanted > 0) and (len(data) > 24):
-                    # Player 1
-                    wpn, = struct.unpack_from('<1B', data, 24)
-                    wpl += [wpn]
-                if (wanted > 1) and (len(data) > 25):
-                    # Player 2
-                    wpn, = struct.unpack_from('<1B', data, 25)
-                    wpl += [wpn]
-                if (wanted > 2) and (len(data) > 26):
-                    # Player 3
-                    wpn, = struct.unpack_from('<1B', data, 26)
-                    wpl += [wpn]
-                if (wanted > 3) and (len(data) > 27):
-                    # Player 4
-                    wpn, = struct.unpack_from('<1B', data, 27)
-                    wpl += [wpn]
-                msg = struct.pack("<I", DSU_TYPES.DSUS_PortInfo.value)
-                # Controller data the server will provide
-                # (only providing data for player 1)
-                enabled = [True, False, False, False]
-                for p in wpl:
-                    if enabled[p]:
-                        # Update port info for enabled controller 
-                        state = 2  # 0=disconnected, 1=reserved, 2=connected
-                        model = 2  # 0=none, 1=DS3, 2=DS4
-                        connection = 2  # 0=none, 1=usb, 2=bt
-                        battery = 5  # 0=none, 1=dying, 2=low, 3=medium, 4=high, 5=full, 0xEE=charging, 0xEF=charged
-                        active = 1  # 0=no, 1=yes
-                        portinfo = struct.pack("<4B6s2B", p, state, model, connection, "FPIE0{}".format(
-                            p).encode('utf-8'), battery, active)
-                        header = struct.pack("<4s2HII", b"DSUS", self.protocolVersion, len(
-                            msg+portinfo), 0, self.serverId)
-                        rc = crc32(header + msg + portinfo)
-                        header2 = struct.pack("<4s2HII", b"DSUS", self.protocolVersion, len(
-                            msg+portinfo), rc, self.serverId)
-                        # Transmit data to client
-                        self.dsuSocket.sendto(header2+msg+portinfo, address)
-
-            if msgtype == DSU_TYPES.DSUC_PadDataReq.value:
-                regflags, slotnum, macaddr = struct.unpack_from(
-                    '<2B6s', data, 20)
-                timestamp = time.time()
-                if True and (regflags == 0 or (regflags & 1 != 0 and slotnum == 0) or (regflags & 2 != 0 and macaddr == "FPIE00")):
-                    self.p0list[address] = timestamp
+    def handleRequest(self, data, address):
+        """
+        Validates a client request and dispatches it to its handler.
+
+        Params:
+            data (bytes): Request datagram.
+            address (tuple): Address of the client.
+
+        Return:
+            (bool): Indicates whether the request was valid.
+        """
+        if len(data) < DSU_REQUEST_MIN_SIZE:
+            self.invalidRequests += 1
+            return False
+        magic, _, msgLen, crc, _, msgType = DSU_REQUEST_HEADER.unpack_from(data)
+        if (magic != DSU_CLIENT_MAGIC) or ((msgLen + DSU_HEADER.size) != len(data)):
+            self.invalidRequests += 1
+            return False
+        # The CRC is computed with its own field zeroed
+        view = memoryview(data)
+        expected = crc32(view[DSU_CRC_OFFSET + DSU_UINT32.size:],
+                         crc32(DSU_ZERO_CRC, crc32(view[:DSU_CRC_OFFSET])))
+        if expected != crc:
+            self.invalidRequests += 1
+            return False
+        handler = self.requestHandlers.get(msgType)
+        if handler == None:
+            self.invalidRequests += 1
+            return False
+        handler(data, address)
+        return True
+
+    def handleVersionRequest(self, data, address):
+        """ Client requesting the protocol version of the server. """
+        self.sendResponse(self.versionResponse, address)
+
+    def handleListPortsRequest(self, data, address):
+        """ Client requesting the info of up to 4 controller ports. """
+        if len(data) < DSU_LIST_PORTS_MIN_SIZE:
+            self.invalidRequests += 1
+            return
+        wanted, = DSU_UINT32.unpack_from(data, DSU_REQUEST_MIN_SIZE)
+        count = min(wanted, DSU_PORT_COUNT, len(data) - DSU_LIST_PORTS_MIN_SIZE)
+        for port in data[DSU_LIST_PORTS_MIN_SIZE:DSU_LIST_PORTS_MIN_SIZE + count]:
+            response = self.portInfoResponses.get(port)
+            if response != None:
+                self.sendResponse(response, address)
+
+    def handlePadDataRequest(self, data, address):
+        """ Client subscribing to the pad data of a controller. """
+        if len(data) < DSU_PAD_DATA_REQ_SIZE:
+            self.invalidRequests += 1
+            return
+        regflags, slotnum, macaddr = DSU_PAD_DATA_REQ.unpack_from(
+            data, DSU_REQUEST_MIN_SIZE)
+        if (regflags == 0) or ((regflags & 1) and (slotnum == 0)) or \
+                ((regflags & 2) and (macaddr == DSU_PORT_MACS[0])):
+            self.p0list[address] = time.time()
+
+    def sendResponse(self, packet, address):
+        """
+        Sends a response to a client request. A response that doesn't fit
+        in the send buffer is dropped, the client asks again.
+
+        Params:
+            packet (bytes): Response packet.
+            address (tuple): Address of the client.
+        """
+        try:
+            self.dsuSocket.sendto(packet, address)
+        except (BlockingIOError, ConnectionResetError):
+            pass
+
+    def packPacket(self, payload) -> bytes:
+        """
+        Prepends a server header with its CRC to a message.
+
+        Params:
+            payload (bytes): Message type followed by the message.
+
+        Return:
+            (bytes): Packet to send to a client.
+        """
+        header = DSU_HEADER.pack(DSU_SERVER_MAGIC, self.protocolVersion,
+                                 len(payload), 0, self.serverId)
+        rc = crc32(payload, crc32(header))
+        return DSU_HEADER.pack(DSU_SERVER_MAGIC, self.protocolVersion,
+                               len(payload), rc, self.serverId) + payload
+
+    def setProfile(self, profile):
+        """
+        Switches the button and axis mapping. Takes effect from the next
+        packet, so it can be called from another thread while the server
+        runs.
+
+        Params:
+            profile (CompiledProfile): Compiled controller section of a
+                                       button profile.
+        """
+        self.profile = profile
 
     def transmitInputData(self):
         """ Transmit input data from Server to a DSU client. """
         # Increment p0count
         self.p0count += 1
-        for ip, port in self.p0list:
-            address = (ip, port)
-
-            # Button input values recorded in buttons1 (Wii Remote)
-            Left = self.buttons1 & 0x80
-            Down = self.buttons1 & 0x40
-            Right = self.buttons1 & 0x20
-            Up = self.buttons1 & 0x10
-            # Button input values recorded in buttons2 (Wii Remote)
-            Square = self.buttons2 & 0x80
-            Cross = self.buttons2 & 0x40
-            Circle = self.buttons2 & 0x20
-            Triangle = self.buttons2 & 0x10
-            R1 = self.buttons2 & 0x8
-            L1 = self.buttons2 & 0x4
-
-            # Button input values recorded in extraButtons (Nunchuck)
-            home = 1 if self.extraButtons & 0x01 else 0
-            padclick = 1 if self.extraButtons & 0x02 else 0
-
-            # Update joystick input data from Nunchuck
-            if self.joystickData != None:
-                leftx = self.joystickData[0]
-                lefty = self.joystickData[1]
-            else:
-                leftx = 0
-                lefty = 0
-            rightx = 0
-            righty = 0
-
-            # Pressure values for buttons pressed. 255 meaning button is
-            # fully pressed and 0 meaning the button is not pressed.
-            left_P = 255 if Left else 0
-            down_P = 255 if Down else 0
-            right_P = 255 if Right else 0
-            up_P = 255 if Up else 0
-            square_P = 255 if Square else 0
-            cross_P = 255 if Cross else 0
-            circle_P = 255 if Circle else 0
-            triangle_P = 255 if Triangle else 0
-            r1_P = 255 if R1 else 0
-            l1_P = 255 if L1 else 0
-
-            # Misc values we don't need
-            r2 = 0  # R pressure
-            l2 = 0  # L pressure
-            pad1touch = 0  # 0=not touched, 1=first active touch
-            pad1id = 0  # global touch counter
-            pad1x = 0  # 0-1919
-            pad1y = 0  # 0-941
-            pad2touch = 0  # 0=not touched, 1=second active touch
-            pad2id = 0  # global touch counter
-            pad2x = 0  # 0-1919
-            pad2y = 0  # 0-941
-
-            # Motion timestamp value
-            motiontimestamp = int(time.time() * 1000000)
-
-            if self.accelData != None:
-                # Update accelorometer data, in units of m/s^2. Dolphin
-                # will automatically convert to units of g. Invert these
-                # values to properly emulate moving in different directions,
-                # (i.e. moving the remote left will move a character left, etc.)
-                ax = (-1 * self.accelData[0])
-                # Swapping the ay and az axes, since the Wii Remote expects the
-                # y-axis to be pointing upwards when the remote is laying flat.
-                # Swap these back if the accelerometer is pointing upwards
-                # when the remote is flat.
-                ay = (self.accelData[2])
-                az = (-1 * self.accelData[1])
-            else:
-                ax = 0
-                ay = 0
-                az = 0
-
-            if self.gyroData != None:
-                # Gyroscope data (only provided from the Wii Remote)
-                roll = self.gyroData[0]
-                pitch = self.gyroData[1]
-                yaw = self.gyroData[2]
-            else:
-                roll = 0
-                pitch = 0
-                yaw = 0
-
-            msg = struct.pack("<I", DSU_TYPES.DSUS_PadDataRsp.value)
-            state = 2 & 0xFF  # 0=disconnected, 1=reserved, 2=connected
-            model = 2 & 0xFF  # 0=none, 1=DS3, 2=DS4
-            connection = 2  # 0=none, 1=usb, 2=bt
-            # 0=none, 1=dying, 2=low, 3=medium, 4=high, 5=full, 0xEE=charging, 0xEF=charged
-            battery = 5 & 0xFF
-            active = 1 & 0xFF  # 0=no, 1=yes
-            port = 0 & 0xFF
-            portinfo = struct.pack("<4B6s2BI", port, state, model, connection, "FPIE00".encode(
-                'utf-8'), battery, active, int(self.p0count) & 0xFFFFFFFF)
-            portdata = struct.pack("<22B2H2B2HQ6f", self.buttons1, self.buttons2, home, padclick, leftx, lefty, rightx, righty, left_P, down_P, right_P, up_P, square_P, cross_P,
-                                   circle_P, triangle_P, r1_P, l1_P, r2, l2, pad1touch, pad1id, pad1x, pad1y, pad2touch, pad2id, pad2x, pad2y, motiontimestamp, ax, ay, az, pitch, yaw, roll)
-            header = struct.pack("<4s2HiI", "DSUS".encode(
-                'utf-8'), self.protocolVersion, len(msg+portinfo+portdata), 0, self.serverId)
-            rc = crc32(header + msg + portinfo + portdata)
-            header2 = struct.pack("<4s2HII", "DSUS".encode(
-                'utf-8'), self.protocolVersion, len(msg+portinfo+portdata), rc, self.serverId)
-            # Transmit controller input data
-            self.dsuSocket.sendto(header2 + msg + portinfo + portdata, address)
+        if not self.p0list:
+            return
+        # Read once, setProfile may swap it from another thread
+        profile = self.profile
+
+        # DS4 button bytes (buttons1, buttons2, home, pad click) and the
+        # pressure of each pressure sensitive button, 255 meaning fully
+        # pressed and 0 not pressed
+        block = (profile.tables[0][self.buttons1 & 0xFF] |
+                 profile.tables[1][self.buttons2 & 0xFF] |
+                 profile.tables[2][self.extraButtons & 0xFF])
+
+        # Update joystick input data from Nunchuck
+        if self.joystickData != None:
+            leftx = self.joystickData[0]
+            lefty = self.joystickData[1]
+        else:
+            leftx = 0
+            lefty = 0
+
+        # Motion timestamp value. Use the synced sample time when there
+        # is one, so BLE batching and jitter don't show up as motion.
+        if self.motionTimestamp != None:
+            motiontimestamp = self.motionTimestamp
+        else:
+            motiontimestamp = time.perf_counter_ns() // 1000
+
+        if self.accelData != None:
+            # Accelerometer data, in units of g, mapped to the DSU axes by
+            # the profile
+            i0, s0, i1, s1, i2, s2 = profile.accelAxes
+            ax = s0 * self.accelData[i0]
+            ay = s1 * self.accelData[i1]
+            az = s2 * self.accelData[i2]
+        else:
+            ax = 0
+            ay = 0
+            az = 0
+
+        if self.gyroData != None:
+            # Gyroscope data mapped to pitch, yaw and roll by the profile
+            i0, s0, i1, s1, i2, s2 = profile.gyroAxes
+            pitch = s0 * self.gyroData[i0]
+            yaw = s1 * self.gyroData[i1]
+            roll = s2 * self.gyroData[i2]
+        else:
+            pitch = 0
+            yaw = 0
+            roll = 0
+
+        # Port 0, connected DS4 over bluetooth, full battery, active
+        portinfo = DSU_PAD_PORT_INFO.pack(
+            0, 2, 2, 2, DSU_PORT_MACS[0], 5, 1, self.p0count & 0xFFFFFFFF)
+        # Right stick, touch pad and the rest are unused
+        portdata = DSU_PAD_DATA.pack(
+            (block & 0xFFFFFFFF).to_bytes(DS4_BUTTON_BYTES, 'little'),
+            leftx, lefty, 0, 0,
+            (block >> (8 * DS4_BUTTON_BYTES)).to_bytes(DS4_PRESSURE_BYTES, 'little'),
+            0, 0, 0, 0, 0, 0, 0, 0, motiontimestamp, ax, ay, az, pitch, yaw, roll)
+        packet = self.packPacket(DSU_PAD_DATA_RSP + portinfo + portdata)
+        # Transmit controller input data to every subscribed client
+        for address in self.p0list:
+            self.dsuSocket.sendto(packet, address)
 
     def update_inputs(self):
         """ 
         Communicate with the client and transmit input data. Should be run in
         the background as a thread.
+
+        When a shared memory channel is attached, input data is only
+        transmitted when a new sample has been published, and the wait for
+        client requests doubles as the poll interval.
         """
         while True:
-            self.communicateWithDsuClient()
-            self.transmitInputData()
+            if self.sharedState == None:
+                self.communicateWithDsuClient()
+                self.transmitInputData()
+            else:
+                self.communicateWithDsuClient(SHARED_STATE_POLL_INTERVAL)
+                if self.loadSharedState():
+                    self.transmitInputData()
@@ -0,0 +1,263 @@
+"""
+File: flight_recorder.py
+Description: Downloads and decodes the on-device flight recorder. The ring is
+             frozen while it is read, and can be resumed afterwards:
+
+                 python flight_recorder.py                  # download and print
+                 python flight_recorder.py --save hitch.bin # also keep the raw chunks
+                 python flight_recorder.py --load hitch.bin # decode a saved download
+                 python flight_recorder.py --resume         # clear and resume recording
+Author: Humza Ali
+"""
+
+import argparse
+import asyncio
+from wire_schema import (
+    SERVICE_UUID,
+    FLIGHT_RECORDER_CHARACTERISTIC_UUID,
+    FLIGHT_RECORDER_CHUNK_HEADER_LENGTH_BYTES,
+    FLIGHT_RECORDER_EVENT_LENGTH_BYTES,
+    FLIGHT_RECORDER_COMMAND_READ_CHUNK,
+    FLIGHT_RECORDER_COMMAND_RESUME,
+    FLIGHT_EVENT_CPU_FREQ,
+    FLIGHT_EVENT_I2C_ERROR,
+    FLIGHT_EVENT_NOTIFY_FAILURE,
+    FLIGHT_EVENT_TYPE_NAMES,
+    FLIGHT_NOTIFY_FAILURE_NAMES,
+    decodeFlightRecorderChunkHeader,
+    decodeFlightRecorderEvent,
+    encodeFlightRecorderRequest,
+)
+
+# Cycle timestamps are 32-bit counters
+CYCLE_COUNTER_WRAP = 1 << 32
+# Names of the controllers in I2C error events
+CONTROLLER_NAMES = {0: 'Wii Remote', 1: 'Nunchuck'}
+
+
+def decodeChunk(data):
+    """
+    Decodes one downloaded chunk.
+
+    Params:
+        data (bytes-like): Value read from the flight recorder characteristic.
+
+    Return:
+        (Tuple): The decoded header as a dict, and a list of
+                 (cycles, type, arg, value) events.
+    """
+    (chunkIndex, chunkCount, eventCount, cpuFreqMhz, totalEvents,
+     frozen, freezeReason, _) = decodeFlightRecorderChunkHeader(data)
+    header = {
+        'chunkIndex': chunkIndex,
+        'chunkCount': chunkCount,
+        'eventCount': eventCount,
+        'cpuFreqMhz': cpuFreqMhz,
+        'totalEvents': totalEvents,
+        'frozen': bool(frozen),
+        'freezeReason': freezeReason,
+    }
+    events = []
+    offset = FLIGHT_RECORDER_CHUNK_HEADER_LENGTH_BYTES
+    for _ in range(eventCount):
+        if offset + FLIGHT_RECORDER_EVENT_LENGTH_BYTES > len(data):
+            break
+        events.append(decodeFlightRecorderEvent(data, offset))
+        offset += FLIGHT_RECORDER_EVENT_LENGTH_BYTES
+    return header, events
+
+
+def toTimeline(events, cpuFreqMhz):
+    """
+    Converts cycle timestamps to times relative to the first event.
+
+    Params:
+        events (list): (cycles, type, arg, value) events, oldest first.
+        cpuFreqMhz (int): CPU frequency when the newest event was recorded,
+                          in MHz, as reported in the chunk header.
+
+    Return:
+        (list): (time in us, type, arg, value) events.
+
+    Note:
+        The counter counts at the CPU frequency, which the governor changes.
+        Walking back from the newest event, each CPU_FREQ event gives the
+        frequency of the stretch before it, so every stretch is converted
+        at its own frequency even if the ring lost the oldest changes. The
+        counter wraps every 2^32 cycles (about 18 s at 240 MHz), so gaps
+        longer than that between two events can't be recovered. Events of
+        the two cores are stamped with different, unsynchronized counters.
+    """
+    if not events:
+        return []
+    # Cycles between each event and the one before it
+    deltas = [0] + [(current[0] - previous[0]) % CYCLE_COUNTER_WRAP
+                    for previous, current in zip(events, events[1:])]
+    # The change is recorded right after switching, so the stretch up to a
+    # CPU_FREQ event ran at its previous frequency
+    durationsUs = [0.0] * len(events)
+    frequencyMhz = cpuFreqMhz
+    for i in range(len(events) - 1, 0, -1):
+        eventType, arg = events[i][1], events[i][2]
+        if eventType == FLIGHT_EVENT_CPU_FREQ:
+            frequencyMhz = arg
+        durationsUs[i] = deltas[i] / frequencyMhz
+    timeline = []
+    timeUs = 0.0
+    for (_, eventType, arg, value), durationUs in zip(events, durationsUs):
+        timeUs += durationUs
+        timeline.append((timeUs, eventType, arg, value))
+    return timeline
+
+
+def describeEvent(eventType, arg, value):
+    """
+    Returns a readable description of an event.
+
+    Params:
+        eventType (int): Flight_Event_Type_t of the event.
+        arg (int): Event specific argument.
+        value (int): Event specific value.
+    """
+    name = FLIGHT_EVENT_TYPE_NAMES.get(eventType, f"UNKNOWN({eventType})")
+    if eventType == FLIGHT_EVENT_I2C_ERROR:
+        return f"{name} {CONTROLLER_NAMES.get(arg, arg)}"
+    if eventType == FLIGHT_EVENT_NOTIFY_FAILURE:
+        reason = FLIGHT_NOTIFY_FAILURE_NAMES.get(value, value)
+        return f"{name} characteristic {arg}: {reason}"
+    if eventType == FLIGHT_EVENT_CPU_FREQ:
+        return f"{name} {arg} -> {value} MHz"
+    return f"{name} arg={arg} value={value}"
+
+
+def printRecording(chunks):
+    """
+    Prints the events of a downloaded recording.
+
+    Params:
+        chunks (list): Raw chunk values, in chunk order.
+    """
+    events = []
+    header = None
+    for data in chunks:
+        header, chunkEvents = decodeChunk(data)
+        events += chunkEvents
+    if header == None:
+        print("Recording is empty.")
+        return
+
+    stored = len(events)
+    print(f"Recorded {header['totalEvents']} events, {stored} kept, "
+          f"CPU at {header['cpuFreqMhz']} MHz when frozen")
+    if header['frozen']:
+        reason = FLIGHT_EVENT_TYPE_NAMES.get(header['freezeReason'], header['freezeReason'])
+        print(f"Frozen by {reason}")
+    for timeUs, eventType, arg, value in toTimeline(events, header['cpuFreqMhz']):
+        print(f"{timeUs / 1000:12.3f} ms  {describeEvent(eventType, arg, value)}")
+
+
+def saveRecording(path, chunks):
+    """
+    Saves the raw chunks of a recording, each prefixed by its length.
+
+    Params:
+        path (String): Output file.
+        chunks (list): Raw chunk values.
+    """
+    with open(path, 'wb') as f:
+        for data in chunks:
+            f.write(len(data).to_bytes(2, 'little'))
+            f.write(bytes(data))
+
+
+def loadRecording(path):
+    """
+    Loads the raw chunks saved by saveRecording().
+
+    Params:
+        path (String): Input file.
+
+    Return:
+        (list): Raw chunk values.
+    """
+    chunks = []
+    with open(path, 'rb') as f:
+        content = f.read()
+    offset = 0
+    while offset + 2 <= len(content):
+        length = int.from_bytes(content[offset:offset + 2], 'little')
+        offset += 2
+        chunks.append(content[offset:offset + length])
+        offset += length
+    return chunks
+
+
+async def download(address, resume):
+    """
+    Downloads the recording from the device.
+
+    Params:
+        address (String): Address of the device, or None to scan for it.
+        resume (bool): Clear and resume the recorder after downloading.
+
+    Return:
+        (list): Raw chunk values.
+    """
+    from bleak import BleakClient, BleakScanner
+
+    if address == None:
+        device = await BleakScanner.find_device_by_filter(
+            lambda d, ad: SERVICE_UUID in [u.lower() for u in ad.service_uuids],
+            timeout=10.0)
+        if device == None:
+            raise RuntimeError("No Wii Remote found")
+        address = device.address
+
+    chunks = []
+    async with BleakClient(address) as client:
+        chunkIndex = 0
+        chunkCount = 1
+        while chunkIndex < chunkCount:
+            await client.write_gatt_char(
+                FLIGHT_RECORDER_CHARACTERISTIC_UUID,
+                encodeFlightRecorderRequest(FLIGHT_RECORDER_COMMAND_READ_CHUNK,
+                                            0, chunkIndex),
+                response=True)
+            data = await client.read_gatt_char(FLIGHT_RECORDER_CHARACTERISTIC_UUID)
+            header, _ = decodeChunk(data)
+            chunkCount = header['chunkCount']
+            if chunkCount > 0:
+                chunks.append(data)
+            elif not chunks:
+                # Keep the header of an empty recording
+                chunks.append(data)
+            chunkIndex += 1
+        if resume:
+            await client.write_gatt_char(
+                FLIGHT_RECORDER_CHARACTERISTIC_UUID,
+                encodeFlightRecorderRequest(FLIGHT_RECORDER_COMMAND_RESUME, 0, 0),
+                response=True)
+    return chunks
+
+
+def main():
+    """ Main function handler. """
+    parser = argparse.ArgumentParser(description="Flight recorder download")
+    parser.add_argument('--address', help='address of the Wii Remote')
+    parser.add_argument('--save', help='file to save the raw download to')
+    parser.add_argument('--load', help='decode a saved download instead')
+    parser.add_argument('--resume', action='store_true',
+                        help='clear and resume the recorder after downloading')
+    args = parser.parse_args()
+
+    if args.load:
+        chunks = loadRecording(args.load)
+    else:
+        chunks = asyncio.run(download(args.address, args.resume))
+        if args.save:
+            saveRecording(args.save, chunks)
+    printRecording(chunks)
+
+
+if __name__ == '__main__':
+    main()
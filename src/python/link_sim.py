@@ -0,0 +1,596 @@
+"""
+File: link_sim.py
+Description: Discrete-event simulator of the BLE link between the Wii Remote
+             firmware and the host. The traffic comes from the firmware
+             itself: the sketch and the firmware sources are built for the
+             host from benchmark/firmware_traffic.cpp and run on a simulated
+             clock, replaying an IMU trace with random button presses and
+             joystick moves, while a simulated central subscribes and runs
+             time sync exchanges. Idle and keepalive reporting, gesture
+             events, time sync responses and (with --hid) HID reports are
+             therefore the firmware's own. The firmware and the link model
+             run in lockstep: whenever BLE::notifyCharacterisitic() asks for
+             a free TX buffer, the answer comes from the link model's queue,
+             so the firmware holds reports back as it does on the device.
+
+             The link model covers the connection interval, packets per
+             connection event, ATT MTU, LL data length and random loss with
+             retransmission. The delivered rate, latency and age of
+             information are reported per characteristic, so reporting
+             strategies can be compared without flashing hardware:
+
+                 python link_sim.py --link default
+                 python link_sim.py --strategy combined --hid
+                 python link_sim.py --sweep
+
+             The 'firmware' strategy sends the notifications as the firmware
+             does. The others regroup them before they reach the link:
+             'combined' sends everything notified in a loop pass as one
+             notification, 'batched' holds sensor samples back until
+             --batch-size of them fit in one. The firmware still holds its own
+             notifications back while no TX buffer is free.
+Author: Humza Ali
+"""
+
+import argparse
+import glob
+import os
+import random
+import shutil
+import subprocess
+import tempfile
+from time_sync import TIME_SYNC_PERIOD, TIME_SYNC_STARTUP_PERIOD, ClockSync
+from wire_schema import decodeWiimoteSensorInput, decodeNunchuckSensorInput
+
+SOURCE_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+# Trace replayed by the simulated IMUs by default
+DEFAULT_TRACE = os.path.join(SOURCE_DIR, 'test', 'traces', 'still_motion.csv')
+
+# ATT notification header (opcode + handle), in bytes
+ATT_HEADER_BYTES = 3
+# L2CAP basic header, in bytes
+L2CAP_HEADER_BYTES = 4
+# LL header, MIC-less, plus preamble, access address and CRC on the 1M PHY
+LL_OVERHEAD_BYTES = 10
+# Inter frame space, in us
+T_IFS_US = 150
+# Empty packet sent back by the central, in us
+EMPTY_PACKET_US = 80
+
+# Characteristics carrying IMU samples, and the decoder of their payload.
+# The sample timestamp is the last field of both.
+SENSOR_STREAMS = {
+    'wiimote_sensor': decodeWiimoteSensorInput,
+    'nunchuck_sensor': decodeNunchuckSensorInput,
+}
+# Notified from the BLE stack without checking for a TX buffer
+TIME_SYNC_STREAM = 'time_sync'
+# Order of the characteristics in the results
+STREAMS = ('wiimote_button', 'wiimote_sensor', 'nunchuck_button',
+           'nunchuck_sensor', 'gesture', 'time_sync', 'hid_report')
+
+# Reporting strategies
+STRATEGY_FIRMWARE = 'firmware'  # As the firmware sends them
+STRATEGY_COMBINED = 'combined'  # Everything notified in a loop pass in one notification
+STRATEGY_BATCHED = 'batched'    # Several sensor samples in one notification
+STRATEGIES = (STRATEGY_FIRMWARE, STRATEGY_COMBINED, STRATEGY_BATCHED)
+
+# Link profiles: connection interval (ms), packets per connection event,
+# ATT MTU, LL data length and packet loss rate
+LINK_PROFILES = {
+    'fast':    {'connIntervalMs': 7.5, 'packetsPerEvent': 6, 'attMtu': 247,
+                'dataLength': 251, 'lossRate': 0.0},
+    'default': {'connIntervalMs': 15.0, 'packetsPerEvent': 4, 'attMtu': 185,
+                'dataLength': 27, 'lossRate': 0.01},
+    'slow':    {'connIntervalMs': 30.0, 'packetsPerEvent': 2, 'attMtu': 23,
+                'dataLength': 27, 'lossRate': 0.01},
+    'lossy':   {'connIntervalMs': 15.0, 'packetsPerEvent': 4, 'attMtu': 185,
+                'dataLength': 27, 'lossRate': 0.10},
+}
+
+
+class FirmwareTraffic(object):
+    """
+    Builds the firmware for the host and starts it on a simulated clock.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, buildDir, hid=False):
+        """
+        Builds firmware_traffic.cpp with every firmware source.
+
+        Params:
+            buildDir (String): Directory to build in.
+            hid (bool): Build with the HID gamepad service enabled.
+        """
+        compiler = os.environ.get('CXX', 'g++')
+        if shutil.which(compiler) == None:
+            raise RuntimeError(f"{compiler} not found, set CXX")
+        sources = ([os.path.join(SOURCE_DIR, 'benchmark', 'firmware_traffic.cpp')] +
+                   sorted(glob.glob(os.path.join(SOURCE_DIR, '[A-Z]*.cpp'))) +
+                   sorted(glob.glob(os.path.join(SOURCE_DIR, 'benchmark', 'host', '*.cpp'))))
+        self.binary = os.path.join(buildDir, 'firmware_traffic_hid' if hid else 'firmware_traffic')
+        subprocess.run([compiler, '-O2', '-std=gnu++11',
+                        f"-DBLE_HID_GAMEPAD_MODE={1 if hid else 0}",
+                        '-I' + os.path.join(SOURCE_DIR, 'benchmark', 'host'),
+                        '-I' + os.path.join(SOURCE_DIR, 'include')] +
+                       sources + ['-o', self.binary], check=True)
+
+    def start(self, durationS, attMtu, trace=DEFAULT_TRACE, buttonRateHz=0.5,
+              joystickRateHz=0.2, seed=1):
+        """
+        Starts the firmware in lockstep mode.
+
+        Params:
+            durationS (float): Simulated time, in seconds.
+            attMtu (int): ATT MTU negotiated by the central.
+            trace (String): IMU trace replayed by both controllers.
+            buttonRateHz (float): Rate of button presses.
+            joystickRateHz (float): Rate of joystick moves.
+            seed (int): Seed of the button and joystick input.
+
+        Return:
+            (Popen): Firmware process, printing its traffic on stdout.
+        """
+        return subprocess.Popen([self.binary, '--lockstep',
+                                 '--trace', trace,
+                                 '--duration', str(durationS),
+                                 '--mtu', str(attMtu),
+                                 '--button-rate-hz', str(buttonRateHz),
+                                 '--joystick-rate-hz', str(joystickRateHz),
+                                 '--sync-period-ms', str(int(TIME_SYNC_PERIOD * 1000)),
+                                 '--sync-startup-period-ms', str(int(TIME_SYNC_STARTUP_PERIOD * 1000)),
+                                 '--sync-startup-exchanges', str(ClockSync().minExchanges),
+                                 '--seed', str(seed)],
+                                stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                text=True, bufsize=1)
+
+
+class LinkProfile(object):
+    """
+    Parameters of the BLE link being simulated.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, connIntervalMs=15.0, packetsPerEvent=4, attMtu=185,
+                 dataLength=27, lossRate=0.01):
+        """
+        Initializes the link profile.
+
+        Params:
+            connIntervalMs (float): Connection interval, in ms.
+            packetsPerEvent (int): Max LL packets the central accepts per
+                                   connection event.
+            attMtu (int): Negotiated ATT MTU, in bytes.
+            dataLength (int): LL data length, in bytes.
+            lossRate (float): Probability that an LL packet is lost and has
+                              to be retransmitted.
+        """
+        self.connIntervalMs = connIntervalMs
+        self.packetsPerEvent = packetsPerEvent
+        self.attMtu = attMtu
+        self.dataLength = dataLength
+        self.lossRate = lossRate
+
+
+class Notification(object):
+    """
+    A notification queued in the stack.
+
+    Attributes:
+        None
+    """
+
+    __slots__ = ('payloadBytes', 'parts', 'packetsLeft', 'packetBytes')
+
+    def __init__(self, payloadBytes, parts, dataLength):
+        """
+        Initializes the notification and splits it into LL packets.
+
+        Params:
+            payloadBytes (int): ATT payload size, in bytes.
+            parts (list): (characteristic, source time in us) of each
+                          firmware notification carried. The source time is
+                          the sample time for IMU samples, and the time the
+                          firmware sent it otherwise.
+            dataLength (int): LL data length, in bytes.
+        """
+        self.payloadBytes = payloadBytes
+        self.parts = parts
+        l2capBytes = payloadBytes + ATT_HEADER_BYTES + L2CAP_HEADER_BYTES
+        self.packetsLeft = -(-l2capBytes // dataLength)
+        self.packetBytes = min(l2capBytes, dataLength)
+
+
+class LinkSimulator(object):
+    """
+    Discrete-event simulator of the BLE link, fed by the firmware traffic.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, link, strategy=STRATEGY_FIRMWARE, txBuffers=12,
+                 batchSize=4, seed=1):
+        """
+        Initializes the simulator.
+
+        Params:
+            link (LinkProfile): BLE link parameters.
+            strategy (String): Reporting strategy, one of STRATEGIES.
+            txBuffers (int): LL packets the controller can buffer. The
+                             firmware holds a notification back while
+                             none is free, and sends the newest value
+                             once one is.
+            batchSize (int): Sensor samples per notification when batched.
+            seed (int): Seed of the random loss.
+        """
+        self.link = link
+        self.strategy = strategy
+        self.txBuffers = txBuffers
+        self.batchSize = batchSize
+        self.random = random.Random(seed)
+        self.queue = []
+        self.queuedPackets = 0
+        # Connection events start at a random phase relative to the loop
+        self.nextEventUs = self.random.random() * link.connIntervalMs * 1000
+        self.pendingPass = []
+        self.pendingBatch = []
+        self.frequencyMhz = None
+        self.frequencySinceUs = 0
+        self.frequencyTimeUs = {}
+        self.firmwareStats = {}
+        # Results
+        self.handedOff = {}
+        self.delivered = {}
+        self.saturated = 0
+        self.noTxBuffer = 0
+        self.droppedTooLarge = 0
+        self.notificationsSent = 0
+        self.packetsSent = 0
+        self.retransmissions = 0
+        self.maxQueuedPackets = 0
+
+    def sendablePackets(self):
+        """ Answers esp_ble_get_cur_sendable_packets_num(). """
+        return max(0, self.txBuffers - self.queuedPackets)
+
+    def handOff(self, nowUs, name, data):
+        """
+        Takes a notification from the firmware.
+
+        Params:
+            nowUs (int): Current time, in us.
+            name (String): Characteristic notified.
+            data (bytes): Payload.
+        """
+        self.handedOff[name] = self.handedOff.get(name, 0) + 1
+        if (name != TIME_SYNC_STREAM) and (self.sendablePackets() == 0):
+            # The firmware notified without a free TX buffer
+            self.saturated += 1
+        decode = SENSOR_STREAMS.get(name)
+        part = (name, decode(data)[-1] if decode else nowUs)
+        if (name == TIME_SYNC_STREAM) or (self.strategy == STRATEGY_FIRMWARE):
+            self.enqueue(len(data), [part])
+        elif self.strategy == STRATEGY_COMBINED:
+            self.pendingPass.append((len(data), part))
+        elif decode:
+            self.pendingBatch.append((len(data), part))
+            if len(self.pendingBatch) >= self.batchSize:
+                self.flush(self.pendingBatch)
+        else:
+            # Only the sensor samples are held back
+            self.enqueue(len(data), [part])
+
+    def endPass(self):
+        """ Handles the end of a loop pass that notified. """
+        if self.strategy == STRATEGY_COMBINED:
+            self.flush(self.pendingPass)
+
+    def flush(self, pending):
+        """ Sends pending notifications as one and clears them. """
+        if pending:
+            self.enqueue(sum(size for size, _ in pending), [part for _, part in pending])
+            pending.clear()
+
+    def enqueue(self, payloadBytes, parts):
+        """
+        Hands a notification to the stack.
+
+        Params:
+            payloadBytes (int): ATT payload size, in bytes.
+            parts (list): Firmware notifications carried, see Notification.
+        """
+        if payloadBytes > (self.link.attMtu - ATT_HEADER_BYTES):
+            # The stack truncates the value, which the host rejects
+            self.droppedTooLarge += 1
+            return
+        notification = Notification(payloadBytes, parts, self.link.dataLength)
+        # Past the controller buffers the notification waits in the host stack
+        self.queue.append(notification)
+        self.queuedPackets += notification.packetsLeft
+        self.maxQueuedPackets = max(self.maxQueuedPackets, self.queuedPackets)
+        self.notificationsSent += 1
+
+    def advance(self, nowUs):
+        """ Runs the connection events up to a time. """
+        while self.nextEventUs <= nowUs:
+            self.runConnectionEvent(self.nextEventUs)
+            self.nextEventUs += self.link.connIntervalMs * 1000
+
+    def runConnectionEvent(self, nowUs):
+        """
+        Simulates one connection event, sending queued packets until the
+        packet limit or the end of the interval is reached.
+
+        Params:
+            nowUs (float): Time the connection event starts, in us.
+        """
+        intervalUs = self.link.connIntervalMs * 1000
+        t = nowUs
+        packets = 0
+        while self.queue and (packets < self.link.packetsPerEvent):
+            notification = self.queue[0]
+            packetUs = ((notification.packetBytes + LL_OVERHEAD_BYTES) * 8 +
+                        T_IFS_US + EMPTY_PACKET_US + T_IFS_US)
+            if (t + packetUs - nowUs) > intervalUs:
+                break
+            t += packetUs
+            packets += 1
+            self.packetsSent += 1
+            if self.random.random() < self.link.lossRate:
+                # Not acknowledged, the same packet is retransmitted
+                self.retransmissions += 1
+                continue
+            notification.packetsLeft -= 1
+            self.queuedPackets -= 1
+            if notification.packetsLeft == 0:
+                self.queue.pop(0)
+                for name, sourceUs in notification.parts:
+                    self.delivered.setdefault(name, []).append((t, sourceUs))
+
+    def setFrequency(self, nowUs, frequencyMhz):
+        """ Tracks the time spent at each CPU frequency. """
+        if self.frequencyMhz != None:
+            self.frequencyTimeUs[self.frequencyMhz] = (
+                self.frequencyTimeUs.get(self.frequencyMhz, 0) + nowUs - self.frequencySinceUs)
+        self.frequencyMhz = frequencyMhz
+        self.frequencySinceUs = nowUs
+
+    def run(self, process):
+        """
+        Runs the simulation along with the firmware until it exits.
+
+        Params:
+            process (Popen): Firmware started by FirmwareTraffic.start().
+
+        Return:
+            (dict): Simulation results, see results().
+        """
+        nowUs = 0
+        for line in process.stdout:
+            fields = line.split()
+            nowUs = int(fields[0])
+            self.advance(nowUs)
+            kind = fields[1]
+            if kind == 'Q':
+                sendablePackets = self.sendablePackets()
+                if sendablePackets == 0:
+                    self.noTxBuffer += 1
+                process.stdin.write(f"{sendablePackets}\n")
+                process.stdin.flush()
+            elif kind == 'N':
+                self.handOff(nowUs, fields[2], bytes.fromhex(fields[3]) if len(fields) > 3 else b'')
+            elif kind == 'P':
+                self.endPass()
+            elif kind == 'F':
+                self.setFrequency(nowUs, int(fields[2]))
+            elif kind == 'E':
+                self.firmwareStats = {k: int(v) for k, v in (f.split('=') for f in fields[2:])}
+        process.stdin.close()
+        if process.wait() != 0:
+            raise RuntimeError(f"firmware_traffic exited with {process.returncode}")
+        self.setFrequency(nowUs, self.frequencyMhz)
+        return self.results(nowUs)
+
+    def results(self, durationUs):
+        """
+        Computes the results of the simulation.
+
+        Params:
+            durationUs (int): Simulated time, in us.
+
+        Return:
+            (dict): Per characteristic rate, latency and (for IMU samples)
+                    age of information percentiles, plus link, TX buffer
+                    and CPU counters.
+        """
+        totalFrequencyUs = sum(self.frequencyTimeUs.values())
+        results = {
+            'saturated': self.saturated,
+            'droppedTooLarge': self.droppedTooLarge,
+            'notifications': self.notificationsSent,
+            'packets': self.packetsSent,
+            'retransmissions': self.retransmissions,
+            'maxQueuedPackets': self.maxQueuedPackets,
+            'noTxBuffer': self.noTxBuffer,
+            'meanCpuMhz': (sum(f * t for f, t in self.frequencyTimeUs.items()) /
+                           totalFrequencyUs) if totalFrequencyUs else None,
+            'streams': {},
+        }
+        durationS = durationUs / 1e6
+        for name in STREAMS:
+            if name not in self.handedOff:
+                continue
+            deliveries = self.delivered.get(name, [])
+            latencies = sorted((d - s) / 1000 for d, s in deliveries)
+            results['streams'][name] = {
+                'handedOff': self.handedOff[name],
+                'delivered': len(deliveries),
+                'rateHz': len(deliveries) / durationS,
+                'latencyMs': percentiles(latencies),
+                'ageMs': (percentiles(ageOfInformation(deliveries, durationUs))
+                          if name in SENSOR_STREAMS else None),
+            }
+        return results
+
+
+def simulate(firmware, link, strategy=STRATEGY_FIRMWARE, durationS=30.0,
+             txBuffers=12, batchSize=4, trace=DEFAULT_TRACE, buttonRateHz=0.5,
+             joystickRateHz=0.2, seed=1):
+    """
+    Runs the firmware against a link.
+
+    Params:
+        firmware (FirmwareTraffic): Firmware built for the host.
+        link (LinkProfile): BLE link parameters.
+        Others: See LinkSimulator and FirmwareTraffic.start().
+
+    Return:
+        (dict): Simulation results, see LinkSimulator.results().
+    """
+    simulator = LinkSimulator(link, strategy, txBuffers, batchSize, seed)
+    process = firmware.start(durationS, link.attMtu, trace, buttonRateHz,
+                             joystickRateHz, seed)
+    return simulator.run(process)
+
+
+def percentiles(values, quantiles=(0.5, 0.9, 0.99)):
+    """
+    Returns percentiles of sorted values.
+
+    Params:
+        values (list): Sorted values.
+        quantiles (Tuple): Quantiles to compute.
+
+    Return:
+        (dict): Value of each quantile, or None if there are no values.
+    """
+    if not values:
+        return {q: None for q in quantiles}
+    return {q: values[min(len(values) - 1, int(q * len(values)))] for q in quantiles}
+
+
+def ageOfInformation(deliveries, durationUs, stepUs=1000):
+    """
+    Samples the age of the freshest delivered sample at regular host times.
+
+    Params:
+        deliveries (list): (delivery time, sample time) pairs, in us,
+                           ordered by delivery time.
+        durationUs (float): Simulated time, in us.
+        stepUs (int): Period the age is sampled at, in us.
+
+    Return:
+        (list): Sorted ages, in ms.
+    """
+    ages = []
+    index = 0
+    freshest = None
+    t = 0
+    while t < durationUs:
+        while (index < len(deliveries)) and (deliveries[index][0] <= t):
+            sampleUs = deliveries[index][1]
+            freshest = sampleUs if freshest == None else max(freshest, sampleUs)
+            index += 1
+        if freshest != None:
+            ages.append((t - freshest) / 1000)
+        t += stepUs
+    ages.sort()
+    return ages
+
+
+def formatMs(value):
+    """ Formats a time in ms for the results table. """
+    return '   -  ' if value == None else f"{value:6.1f}"
+
+
+def printResults(label, results):
+    """
+    Prints one row per characteristic of the results table, and a summary.
+
+    Params:
+        label (String): Configuration label.
+        results (dict): Results of LinkSimulator.run().
+    """
+    for name, r in results['streams'].items():
+        latency = r['latencyMs']
+        age = r['ageMs'] or {0.5: None, 0.99: None}
+        print(f"{label:24s} {name:16s} {r['handedOff']:7d} {r['rateHz']:7.1f} "
+              f"{formatMs(latency[0.5])} {formatMs(latency[0.99])} "
+              f"{formatMs(age[0.5])} {formatMs(age[0.99])}")
+    meanCpuMhz = results['meanCpuMhz']
+    print(f"{label:24s} {results['noTxBuffer']} TX buffer queries found none free, "
+          f"{results['saturated']} sent without one, "
+          f"up to {results['maxQueuedPackets']} packets queued, "
+          f"{results['droppedTooLarge']} larger than the MTU, "
+          f"CPU {'-' if meanCpuMhz == None else f'{meanCpuMhz:.0f}'} MHz on average")
+
+
+def printHeader():
+    """ Prints the header of the results table. """
+    print(f"{'configuration':24s} {'characteristic':16s} {'sent':>7s} {'rate Hz':>7s} "
+          f"{'lat50':>6s} {'lat99':>6s} {'age50':>6s} {'age99':>6s}")
+
+
+def main():
+    """ Main function handler. """
+    parser = argparse.ArgumentParser(description="BLE link simulator")
+    parser.add_argument('--strategy', choices=STRATEGIES, default=STRATEGY_FIRMWARE)
+    parser.add_argument('--link', choices=sorted(LINK_PROFILES), default='default')
+    parser.add_argument('--hid', action='store_true',
+                        help='build the firmware with the HID gamepad service')
+    parser.add_argument('--trace', default=DEFAULT_TRACE,
+                        help='IMU trace replayed by the controllers')
+    parser.add_argument('--button-rate-hz', type=float, default=0.5)
+    parser.add_argument('--joystick-rate-hz', type=float, default=0.2)
+    parser.add_argument('--batch-size', type=int, default=4)
+    parser.add_argument('--tx-buffers', type=int, default=12,
+                        help='LL packets the controller can buffer')
+    parser.add_argument('--conn-interval-ms', type=float)
+    parser.add_argument('--packets-per-event', type=int)
+    parser.add_argument('--mtu', type=int)
+    parser.add_argument('--data-length', type=int)
+    parser.add_argument('--loss', type=float)
+    parser.add_argument('--duration', type=float, default=30.0,
+                        help='simulated time, in seconds')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--sweep', action='store_true',
+                        help='compare every strategy on every link profile')
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as buildDir:
+        firmware = FirmwareTraffic(buildDir, args.hid)
+        options = {'durationS': args.duration, 'txBuffers': args.tx_buffers,
+                   'batchSize': args.batch_size, 'trace': args.trace,
+                   'buttonRateHz': args.button_rate_hz,
+                   'joystickRateHz': args.joystick_rate_hz, 'seed': args.seed}
+        printHeader()
+        if args.sweep:
+            for linkName in sorted(LINK_PROFILES):
+                for strategy in STRATEGIES:
+                    link = LinkProfile(**LINK_PROFILES[linkName])
+                    printResults(f"{linkName}/{strategy}",
+                                 simulate(firmware, link, strategy, **options))
+            return
+
+        profile = dict(LINK_PROFILES[args.link])
+        for key, value in (('connIntervalMs', args.conn_interval_ms),
+                           ('packetsPerEvent', args.packets_per_event),
+                           ('attMtu', args.mtu), ('dataLength', args.data_length),
+                           ('lossRate', args.loss)):
+            if value != None:
+                profile[key] = value
+        results = simulate(firmware, LinkProfile(**profile), args.strategy, **options)
+        printResults(f"{args.link}/{args.strategy}", results)
+        print(f"Notifications sent: {results['notifications']}, "
+              f"packets: {results['packets']}, "
+              f"retransmissions: {results['retransmissions']}")
+
+
+if __name__ == '__main__':
+    main()
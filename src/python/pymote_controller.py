@@ -1,54 +1,210 @@
 """
 File: pymore_controller.py
 Description: Controller file for handling Wii Remote and Nunchuck Inputs.
+             BLE ingest and DSU output run as separate processes that share
+             the latest controller state through shared memory:
+
+                 python pymote_controller.py                 # both
+                 python pymote_controller.py --mode ingest   # BLE only
+                 python pymote_controller.py --mode output   # DSU only
 Author: Humza Ali
 """
 
+import argparse
 import asyncio
-import struct
+import multiprocessing
+import os
+import time
 from bleak import BleakScanner, BleakClient
+from bleak.exc import BleakError
+from button_profile import DEFAULT_PROFILE_NAME, ProfileWatcher
 from dsu import DSU_Server
+from shared_state import (ControllerSample, SharedControllerState,
+                          SHARED_STATE_NAME)
+from collections import deque
+from time_sync import ClockSync, TimeSyncClient, hostTimeUs
+from wire_schema import (
+    SERVICE_UUID,
+    TIME_SYNC_CHARACTERISTIC_UUID,
+    WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID,
+    WIIMOTE_BUTTON_INPUT_LENGTH_BYTES,
+    WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID,
+    WIIMOTE_SENSOR_INPUT_LENGTH_BYTES,
+    NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID,
+    NUNCHUCK_BUTTON_JOYSTICK_INPUT_LENGTH_BYTES,
+    NUNCHUCK_SENSOR_INPUT_CHARACTERISTIC_UUID,
+    NUNCHUCK_SENSOR_INPUT_LENGTH_BYTES,
+    GESTURE_EVENT_CHARACTERISTIC_UUID,
+    GESTURE_EVENT_LENGTH_BYTES,
+    GESTURE_TYPE_NAMES,
+    decodeWiimoteButtonInput,
+    decodeWiimoteSensorInput,
+    decodeNunchuckButtonJoystickInput,
+    decodeNunchuckSensorInput,
+    decodeGestureEvent,
+)
 import threading
 
 
-class Wiimote(DSU_Server):
+# Maximum number of Wii Remotes connected at once
+MAX_DEVICES = 4
+# Shared memory slots of each controller. The controllers of device k use
+# slot + k * SLOTS_PER_DEVICE.
+SLOTS_PER_DEVICE = 2
+WIIMOTE_SLOT = 0
+NUNCHUCK_SLOT = 1
+# DSU server addresses of each controller. The controllers of device k use
+# port + k.
+WIIMOTE_DSU_ADDRESS = ('127.0.0.1', 26760)
+NUNCHUCK_DSU_ADDRESS = ('127.0.0.2', 26760)
+# Period between per-device statistics logs, in seconds
+STATS_LOG_PERIOD = 10.0
+
+
+class DeviceStats(object):
+    """
+    Notification rate, latency and callback cost counters of one device.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, name, windowSize=1024):
+        """
+        Initializes the counters.
+
+        Params:
+            name (String): Name of the device used in logs.
+            windowSize (int): Number of recent latencies kept for percentiles.
+        """
+        self.name = name
+        self.notifications = 0
+        self.callbackTimeNs = 0
+        # Age of each motion sample when it was decoded, in us
+        self.latenciesUs = deque(maxlen=windowSize)
+        self.lastSnapshotTime = time.perf_counter()
+        self.lastSnapshotNotifications = 0
+        self.lastSnapshotCallbackTimeNs = 0
+
+    def recordNotification(self, callbackTimeNs):
+        """
+        Records a handled notification.
+
+        Params:
+            callbackTimeNs (int): Time spent in the callback, in ns.
+        """
+        self.notifications += 1
+        self.callbackTimeNs += callbackTimeNs
+
+    def recordLatency(self, motionTimestamp):
+        """
+        Records the age of a motion sample.
+
+        Params:
+            motionTimestamp (int): Host time the sample was taken at, in us,
+                                   or None if the clock isn't synced yet.
+        """
+        if motionTimestamp != None:
+            self.latenciesUs.append(hostTimeUs() - motionTimestamp)
+
+    def snapshot(self):
+        """
+        Returns the counters since the last snapshot.
+
+        Return:
+            (dict): Notification rate, mean callback cost and latency
+                    percentiles of the device.
+        """
+        now = time.perf_counter()
+        elapsed = now - self.lastSnapshotTime
+        notifications = self.notifications - self.lastSnapshotNotifications
+        callbackTimeNs = self.callbackTimeNs - self.lastSnapshotCallbackTimeNs
+        self.lastSnapshotTime = now
+        self.lastSnapshotNotifications = self.notifications
+        self.lastSnapshotCallbackTimeNs = self.callbackTimeNs
+
+        latencies = sorted(self.latenciesUs)
+        def percentile(q):
+            if not latencies:
+                return None
+            return latencies[min(len(latencies) - 1, int(q * len(latencies)))]
+        return {
+            'rateHz': notifications / elapsed if elapsed > 0 else 0.0,
+            'callbackUs': (callbackTimeNs / notifications / 1000
+                           if notifications else 0.0),
+            'latencyP50Us': percentile(0.5),
+            'latencyP99Us': percentile(0.99),
+        }
+
+    def log(self):
+        """ Prints the counters since the last snapshot. """
+        m = self.snapshot()
+        line = (f"{self.name}: {m['rateHz']:.1f} notifications/s, "
+                f"callback {m['callbackUs']:.1f} us")
+        if m['latencyP50Us'] != None:
+            line += (f", latency p50 {m['latencyP50Us'] / 1000:.1f} ms"
+                     f" p99 {m['latencyP99Us'] / 1000:.1f} ms")
+        print(line)
+
+
+class Wiimote(object):
     """
-    A Wii Remote class for storing inputs to be transmitted through
-    a connected DSU Server.
+    A Wii Remote class for decoding inputs and publishing them to the
+    shared memory slot read by its DSU Server.
 
     Attributes:
-        DSU_Server
+        None
     """
 
-    def __init__(self, ip, port):
+    def __init__(self, sharedState, slot, clockSync, stats=None):
         """ 
-        Initializes the Wiimote and a DSU Server to send the Wiimote inputs.
+        Initializes the Wiimote.
+
+        Params:
+            sharedState (SharedControllerState): Channel the inputs are
+                                                 published to.
+            slot (int): Controller slot of the Wii Remote in the channel.
+            clockSync (ClockSync): Device clock estimate used to map the
+                                   sample timestamps onto the host clock.
+            stats (DeviceStats): Counters the sample latency is recorded
+                                 to, if set.
         """
-        super().__init__(ip, port)
-        self.buttonInputLengthBytes = 2 
-        self.sensorInputLengthBytes = 24
+        self.sharedState = sharedState
+        self.slot = slot
+        self.clockSync = clockSync
+        self.stats = stats
+        # Complete state of the controller, published on every update
+        self.sample = ControllerSample()
+        self.buttonInputLengthBytes = WIIMOTE_BUTTON_INPUT_LENGTH_BYTES
+        self.sensorInputLengthBytes = WIIMOTE_SENSOR_INPUT_LENGTH_BYTES
 
     def buttonInputs(self, inputs):
         """ 
         Updates the Wii Remote button inputs.
 
         Params:
-            inputs (List): The Wii Remote button inputs.
+            inputs (Tuple): The decoded Wii Remote button inputs.
         """
         # Grab the two bytes for each input
-        self.buttons1 = inputs[0]
-        self.buttons2 = inputs[1]
+        self.sample.buttons1, self.sample.buttons2, _ = inputs
+        self.sharedState.write(self.slot, self.sample)
 
-    def sensorInputs(self, accelData, gyroData):
+    def sensorInputs(self, accelData, gyroData, motionTimestamp=None):
         """ 
         Updates the Wii Remote sensor inputs.
 
         Params:
             accelData (Tuple): The Wii Remote accelorometer data.
             gyroData (Tuple): The Wii Remote gyroscope data
+            motionTimestamp (int): Host time the sample was taken at, in us,
+                                   or None if the clock isn't synced yet.
         """
-        self.accelData = accelData
-        self.gyroData = gyroData
+        self.sample.accelData = accelData
+        self.sample.gyroData = gyroData
+        self.sample.motionTimestamp = motionTimestamp
+        self.sharedState.write(self.slot, self.sample)
+        if self.stats != None:
+            self.stats.recordLatency(motionTimestamp)
 
     def wiimote_button_input_cb(self, sender, data):
         """ 
@@ -64,7 +220,7 @@ class Wiimote(DSU_Server):
             print(f"Expected number of bytes: {self.buttonInputLengthBytes}")
             print(f"Received number of bytes: {len(data)}")
             return
-        wiiRemote.buttonInputs(data)
+        self.buttonInputs(decodeWiimoteButtonInput(data))
 
     def wiimote_sensor_input_cb(self, sender, data):
         """ 
@@ -80,54 +236,68 @@ class Wiimote(DSU_Server):
             print(f"Expected number of bytes: {self.sensorInputLengthBytes}")
             print(f"Received number of bytes: {len(data)}")
             return
-        gyroDataStartIndex = int(len(data) / 2)
-        accelData = struct.unpack('<3f', data[:gyroDataStartIndex])
-        gyroData = struct.unpack('<3f', data[gyroDataStartIndex:])
+        ax, ay, az, gx, gy, gz, deviceTimestamp = decodeWiimoteSensorInput(data)
+        motionTimestamp = self.clockSync.toHostTime(deviceTimestamp)
 
-        wiiRemote.sensorInputs(accelData, gyroData)
+        self.sensorInputs((ax, ay, az), (gx, gy, gz), motionTimestamp)
 
 
-class Nunchuck(DSU_Server):
+class Nunchuck(object):
     """
-    A Nunchuck class for storing inputs to be transmitted through
-    a connected DSU Server.
+    A Nunchuck class for decoding inputs and publishing them to the
+    shared memory slot read by its DSU Server.
 
     Attributes:
-        DSU_Server
+        None
     """
 
-    def __init__(self, ip, port):
+    def __init__(self, sharedState, slot, clockSync, stats=None):
         """ 
-        Initializes the Nunchuck and a DSU Server to send the Wiimote inputs.
+        Initializes the Nunchuck.
 
         Params:
-            ip (String): IP address of the DSU server.
-            port (int): Port of the DSU server.
+            sharedState (SharedControllerState): Channel the inputs are
+                                                 published to.
+            slot (int): Controller slot of the Nunchuck in the channel.
+            clockSync (ClockSync): Device clock estimate used to map the
+                                   sample timestamps onto the host clock.
+            stats (DeviceStats): Counters the sample latency is recorded
+                                 to, if set.
         """
-        # Initializes the Nunchuck DSU server
-        super().__init__(ip, port)
-        self.buttonJoystickInputLengthBytes = 3
-        self.sensorInputLengthBytes = 12
+        self.sharedState = sharedState
+        self.slot = slot
+        self.clockSync = clockSync
+        self.stats = stats
+        # Complete state of the controller, published on every update
+        self.sample = ControllerSample()
+        self.buttonJoystickInputLengthBytes = NUNCHUCK_BUTTON_JOYSTICK_INPUT_LENGTH_BYTES
+        self.sensorInputLengthBytes = NUNCHUCK_SENSOR_INPUT_LENGTH_BYTES
 
     def buttonInputs(self, inputs):
         """ 
         Updates the Nunchuck button inputs.
 
         Params:
-            inputs (List): The Nunchuck button inputs.
+            inputs (Tuple): The decoded Nunchuck button and joystick inputs.
         """
-        self.joystickData = (inputs[0], inputs[1])
-        self.extraButtons = inputs[2]
+        joystickX, joystickY, self.sample.extraButtons = inputs
+        self.sample.joystickData = (joystickX, joystickY)
+        self.sharedState.write(self.slot, self.sample)
 
-    def accelDataInputs(self, accelData):
+    def accelDataInputs(self, accelData, motionTimestamp=None):
         """ 
         Updates the Nunchuck sensor inputs.
 
         Params:
             accelData (Tuple): The Wii Remote accelorometer data.
-            gyroData (Tuple): The Wii Remote gyroscope data
+            motionTimestamp (int): Host time the sample was taken at, in us,
+                                   or None if the clock isn't synced yet.
         """
-        self.accelData = accelData
+        self.sample.accelData = accelData
+        self.sample.motionTimestamp = motionTimestamp
+        self.sharedState.write(self.slot, self.sample)
+        if self.stats != None:
+            self.stats.recordLatency(motionTimestamp)
 
     def nunchuck_button_joystick_input_cb(self, sender, data):
         """ 
@@ -143,7 +313,7 @@ class Nunchuck(DSU_Server):
             print(f"Expected number of bytes: {self.buttonJoystickInputLengthBytes}")
             print(f"Received number of bytes: {len(data)}")
             return
-        nunchuck.buttonInputs(data)
+        self.buttonInputs(decodeNunchuckButtonJoystickInput(data))
 
     def nunchuck_sensor_input_cb(self, sender, data):
         """ 
@@ -159,38 +329,151 @@ class Nunchuck(DSU_Server):
             print(f"Expected number of bytes: {self.sensorInputLengthBytes}")
             print(f"Received number of bytes: {len(data)}")
             return
-        accelData = struct.unpack('<3f', data)
-        nunchuck.accelDataInputs(accelData)
+        ax, ay, az, deviceTimestamp = decodeNunchuckSensorInput(data)
+        motionTimestamp = self.clockSync.toHostTime(deviceTimestamp)
+        self.accelDataInputs((ax, ay, az), motionTimestamp)
 
 
-# BLE Service UUID
-SERVICE_UUID = '06a1ef1c-d8f5-4839-bf3a-cf1deed694d2'
-# Wii Remote Input Characteristic UUIDs
-WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID = '7e3092ce-5b65-44c7-afef-c7722ef964b3'
-WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID = 'eb854de2-f0b3-48bf-90ca-1f2a85ef29c8'
-# Nunchuck Input Characteristic UUID
-NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID = "3327921d-e3b3-43ff-b724-a706fae760d3"
-NUNCHUCK_SENSOR_INPUT_CHARACTERISTIC_UUID = "be11ecb2-1c60-4411-9385-0436b247c5bb"
+class Gestures(object):
+    """
+    Decodes the gesture events detected on the device. Events arrive ahead
+    of the motion stream, stamped with the device time of the sample they
+    were detected on.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, name, clockSync, listener=None, historySize=64):
+        """
+        Initializes the gesture decoder.
+
+        Params:
+            name (String): Name of the device used in logs.
+            clockSync (ClockSync): Device clock estimate used to map the
+                                   event timestamps onto the host clock.
+            listener (function): Called with each decoded event, if set.
+            historySize (int): Number of recent events kept.
+        """
+        self.name = name
+        self.clockSync = clockSync
+        self.listener = listener
+        self.events = deque(maxlen=historySize)
+
+    def decodeEvents(self, data):
+        """
+        Decodes the events of one notification.
+
+        Params:
+            data (bytes-like): Received data from the characteristic.
+
+        Return:
+            (list): Events as dicts, with the host time of the sample they
+                    were detected on in us, or None if the clock isn't
+                    synced yet.
+        """
+        events = []
+        for offset in range(0, len(data) - GESTURE_EVENT_LENGTH_BYTES + 1,
+                            GESTURE_EVENT_LENGTH_BYTES):
+            gestureType, controller, magnitude, deviceTimestamp = \
+                decodeGestureEvent(data, offset)
+            events.append({
+                'type': gestureType,
+                'controller': controller,
+                'magnitude': magnitude,
+                'deviceTimestampUs': deviceTimestamp,
+                'timestamp': self.clockSync.toHostTime(deviceTimestamp),
+            })
+        return events
+
+    def gesture_event_cb(self, sender, data):
+        """
+        Callback called by the BLE class with the gesture events of one
+        sample.
+
+        Params:
+            sender(BleakGATTCharacteristicWinRT): Unused positional parameter
+            data (Tuple): Received data from the characteristic, in bytes.
+        """
+        if len(data) < GESTURE_EVENT_LENGTH_BYTES:
+            print("Gesture Event Underflow:")
+            print(f"Expected number of bytes: {GESTURE_EVENT_LENGTH_BYTES}")
+            print(f"Received number of bytes: {len(data)}")
+            return
+        for event in self.decodeEvents(data):
+            self.events.append(event)
+            if self.listener != None:
+                self.listener(event)
+            name = GESTURE_TYPE_NAMES.get(event['type'], event['type'])
+            controller = 'Nunchuck' if event['controller'] == 1 else 'Wii Remote'
+            line = f"{self.name}: {controller} {name} ({event['magnitude']})"
+            if event['timestamp'] != None:
+                ageMs = (hostTimeUs() - event['timestamp']) / 1000
+                line += f", {ageMs:.1f} ms after the sample"
+            print(line)
+
+
+# The BLE service and characteristic UUIDs are defined in wire_schema.py
+
+# File used to remember the addresses of the last connected Wii Remotes,
+# one per line in device order
+DEVICE_CACHE_FILE = os.path.join(os.path.expanduser('~'), '.pymote_device')
+# Timeout of a direct connection attempt to the cached address, in seconds
+DIRECT_CONNECT_TIMEOUT = 5.0
+# Timeout of a scan for the Wii Remote service, in seconds
+SCAN_TIMEOUT = 10.0
+# Minimum and maximum delay between reconnection attempts, in seconds
+RECONNECT_BACKOFF_MIN = 0.5
+RECONNECT_BACKOFF_MAX = 10.0
 
 
 class BLE(object):
     """
-    A BLE class object used to connect to BLE devices.
+    A BLE class object used to connect to one of possibly several BLE
+    devices. Each device gets its own BLE object, and the objects share the
+    set of connected addresses so that no two connect to the same device.
 
     Attributes:
         None
     """
 
-    def __init__(self, bleDeviceName):
+    def __init__(self, bleDeviceName, index=0, cacheFile=DEVICE_CACHE_FILE,
+                 claimedAddresses=None, scanLock=None, stats=None):
         """
         Initializes the BLE class object.
 
         Params:
             bleDeviceName (String): The name of the BLE device 
+            index (int): Index of the device, used to pick its line in the
+                         cache file.
+            cacheFile (String): File used to remember the addresses of the
+                                last connected devices.
+            claimedAddresses (set): Addresses connected to by the other
+                                    BLE objects, shared between them.
+            scanLock (asyncio.Lock): Lock shared between the BLE objects so
+                                     only one scans at a time.
+            stats (DeviceStats): Counters updated by every notification,
+                                 if set.
         """
         self.bleDeviceName = bleDeviceName
+        self.index = index
+        self.label = f"{bleDeviceName} {index + 1}"
         self.bleDevice = None
+        self.address = None
         self.callbacks = {}
+        self.cacheFile = cacheFile
+        self.claimedAddresses = claimedAddresses if claimedAddresses != None else set()
+        self.scanLock = scanLock
+        self.stats = stats
+        # Set by the Bleak client when the link to the device is lost
+        self.disconnectedEvent = None
+        # Start time of the current connection attempt, used to log the
+        # time until the first input is received
+        self.connectStartTime = None
+        self.firstInputPending = False
+        self.isReconnect = False
+        # Time sync client run while connected, if set
+        self.timeSync = None
 
     def addCallback(self, characteristicUuid, callback):
         """
@@ -202,89 +485,444 @@ class BLE(object):
                                          with the callback.
             callback (function): Callback associated with the characterisitic.
         """
-        self.callbacks[characteristicUuid] = callback
+        self.callbacks[characteristicUuid] = self.timedCallback(callback)
+
+    def timedCallback(self, callback):
+        """
+        Wraps a notification callback to log the time from the start of a
+        connection attempt to the first input received.
+
+        Params:
+            callback (function): Callback associated with the characterisitic.
+
+        Return:
+            (function): The wrapped callback.
+        """
+        def wrapper(sender, data):
+            if self.firstInputPending:
+                self.firstInputPending = False
+                elapsed = (time.perf_counter() - self.connectStartTime) * 1000
+                label = "reconnect" if self.isReconnect else "startup"
+                print(f"{self.label}: time to first input after {label}: "
+                      f"{elapsed:.1f} ms")
+            if self.stats == None:
+                callback(sender, data)
+                return
+            start = time.perf_counter_ns()
+            callback(sender, data)
+            self.stats.recordNotification(time.perf_counter_ns() - start)
+        return wrapper
+
+    def loadCachedAddresses(self):
+        """
+        Loads the addresses of the last connected devices.
+
+        Return:
+            (list): The cached addresses, in device order.
+        """
+        try:
+            with open(self.cacheFile, 'r') as f:
+                return [line.strip() for line in f]
+        except OSError:
+            return []
+
+    def loadCachedAddress(self):
+        """
+        Loads the address this device last connected to.
+
+        Return:
+            (String): The cached address, or None if there is none.
+        """
+        addresses = self.loadCachedAddresses()
+        if self.index < len(addresses) and addresses[self.index]:
+            return addresses[self.index]
+        return None
+
+    def saveCachedAddress(self, address):
+        """
+        Saves the address of the connected device for the next startup.
+
+        Params:
+            address (String): Address of the connected device.
+        """
+        addresses = self.loadCachedAddresses()
+        # Another device may have been cached at this address before
+        addresses = ['' if a == address else a for a in addresses]
+        addresses += [''] * (self.index + 1 - len(addresses))
+        addresses[self.index] = address
+        try:
+            with open(self.cacheFile, 'w') as f:
+                f.write('\n'.join(addresses))
+        except OSError as e:
+            print(f"Could not cache device address: {e}")
+
+    def claimAddress(self, address):
+        """
+        Claims an address so the other BLE objects skip it.
+
+        Params:
+            address (String): Address of the device.
+
+        Return:
+            (bool): Indicates whether the address was free.
+        """
+        if address.upper() in self.claimedAddresses:
+            return False
+        self.claimedAddresses.add(address.upper())
+        self.address = address.upper()
+        return True
+
+    def releaseAddress(self):
+        """ Releases the claimed address after the device disconnects. """
+        if self.address != None:
+            self.claimedAddresses.discard(self.address)
+            self.address = None
 
     async def findDevice(self) -> bool:
         """
-        Finds the BLE device based on the name of the device.
+        Finds the BLE device by scanning for the Wii Remote service UUID.
+        The scan stops at the first device advertising the service that
+        isn't already connected to another BLE object.
 
         Return:
             (bool): Indicates whether a device has been found that matches
-                    the BLE device name.
-        """
-        availableBleDevices = await BleakScanner.discover()
-        # Loop through detectable BLE devices
-        for device in availableBleDevices:
-            if device.name == self.bleDeviceName:
-                # If there is a match in the available device names, update
-                # the bleDevice field with device.
-                print(f"Found {device.name}")
-                self.bleDevice = device
-                break
+                    the BLE service UUID or device name.
+        """
+        def matches(device, advertisementData):
+            if device.address.upper() in self.claimedAddresses:
+                return False
+            uuids = [uuid.lower() for uuid in advertisementData.service_uuids]
+            return (SERVICE_UUID in uuids) or (device.name == self.bleDeviceName)
+
+        if self.scanLock != None:
+            # Most backends only support one scan at a time
+            async with self.scanLock:
+                self.bleDevice = await BleakScanner.find_device_by_filter(
+                    matches, timeout=SCAN_TIMEOUT)
+        else:
+            self.bleDevice = await BleakScanner.find_device_by_filter(
+                matches, timeout=SCAN_TIMEOUT)
 
         if self.bleDevice != None:
             # Store the address of the bleDevice. This will be used to
             # receive notifications from the BLE server.
-            address = self.bleDevice.address
-            print(f"Device MAC address: {address}")
+            print(f"{self.label}: found {self.bleDevice.name}")
+            print(f"{self.label}: device MAC address {self.bleDevice.address}")
             return True
         # No device found, return false
         return False
 
+    def onDisconnect(self, client):
+        """
+        Callback called by Bleak when the link to the device is lost.
+
+        Params:
+            client (BleakClient): The disconnected client.
+        """
+        print(f"{self.label} disconnected.")
+        if self.disconnectedEvent != None:
+            self.disconnectedEvent.set()
+
+    async def connect(self):
+        """
+        Connects to the device, trying the cached address first and falling
+        back to a service UUID filtered scan.
+
+        Return:
+            (BleakClient): The connected client, or None if no device
+                           could be connected to.
+        """
+        cachedAddress = self.loadCachedAddress()
+        if (cachedAddress != None) and self.claimAddress(cachedAddress):
+            client = BleakClient(cachedAddress,
+                                 disconnected_callback=self.onDisconnect,
+                                 timeout=DIRECT_CONNECT_TIMEOUT)
+            try:
+                await client.connect()
+                print(f"{self.label}: connected to cached address {cachedAddress}")
+                return client
+            except (BleakError, asyncio.TimeoutError, OSError) as e:
+                print(f"{self.label}: direct connect to {cachedAddress} failed: {e}")
+                self.releaseAddress()
+
+        if not await self.findDevice():
+            return None
+        if not self.claimAddress(self.bleDevice.address):
+            # Claimed by another BLE object while this one was scanning
+            return None
+        client = BleakClient(self.bleDevice,
+                             disconnected_callback=self.onDisconnect)
+        try:
+            await client.connect()
+        except (BleakError, asyncio.TimeoutError, OSError) as e:
+            print(f"{self.label}: connect to {self.bleDevice.address} failed: {e}")
+            self.releaseAddress()
+            return None
+        self.saveCachedAddress(self.bleDevice.address)
+        return client
+
     async def receiveData(self):
-        async with BleakClient(self.bleDevice.address) as client:
-            while True:
+        """
+        Connects to the device and subscribes to every characteristic with
+        a callback. Reconnects with an exponential backoff whenever the link
+        is lost or a connection attempt fails.
+        """
+        backoff = RECONNECT_BACKOFF_MIN
+        # Time to first input is measured from startup or from the link loss,
+        # including any failed attempts in between.
+        self.connectStartTime = time.perf_counter()
+        while True:
+            self.disconnectedEvent = asyncio.Event()
+            client = await self.connect()
+            if client == None:
+                print(f"{self.label}: retrying connection in {backoff:.1f} s")
+                await asyncio.sleep(backoff)
+                backoff = min(backoff * 2, RECONNECT_BACKOFF_MAX)
+                continue
+
+            timeSyncTask = None
+            try:
+                # Subscribe once per connection
+                self.firstInputPending = True
                 for uuid in self.callbacks:
                     await client.start_notify(uuid, self.callbacks[uuid])
-                await asyncio.sleep(10)
+                backoff = RECONNECT_BACKOFF_MIN
+                if self.timeSync != None:
+                    timeSyncTask = asyncio.create_task(self.timeSync.run(client))
+                await self.disconnectedEvent.wait()
+            except (BleakError, OSError) as e:
+                print(f"Lost connection to {self.label}: {e}")
+            finally:
+                if timeSyncTask != None:
+                    timeSyncTask.cancel()
+                    try:
+                        await timeSyncTask
+                    except asyncio.CancelledError:
+                        pass
+                    except Exception as e:
+                        # Failed before the link loss, e.g. on a request
+                        # written as the link went down
+                        print(f"{self.label}: time sync stopped: {e!r}")
+                self.firstInputPending = False
+                self.isReconnect = True
+                self.connectStartTime = time.perf_counter()
+                if client.is_connected:
+                    # A failed disconnect must not end the reconnect loop
+                    try:
+                        await client.disconnect()
+                    except (BleakError, OSError) as e:
+                        print(f"{self.label}: could not disconnect cleanly: {e}")
+                self.releaseAddress()
+
+
+def pinToCpu(cpu):
+    """
+    Pins the current process to a CPU core, where supported.
 
+    Params:
+        cpu (int): Index of the CPU core, or None to leave it unpinned.
+    """
+    if cpu == None:
+        return
+    if hasattr(os, 'sched_setaffinity'):
+        os.sched_setaffinity(0, {cpu})
+    else:
+        print(f"Pinning to CPU {cpu} is not supported on this platform.")
 
-# Declare and initialize Wii Remote and Nunchuck
-wiiRemote = Wiimote('127.0.0.1', 26760)
-nunchuck = Nunchuck('127.0.0.2', 26760)
-# Declare and initialize BLE object
-ble = BLE("Wii Remote")
 
-# Threads to be used to run the Wii Remote and Nunchuck DSU servers
-wiiRemoteDsuThread = None
-nunchuckDsuThread = None
+class ControllerSession(object):
+    """
+    Connection, clock sync and decoded state of one Wii Remote and its
+    Nunchuck. Every callback is bound to the session, so any number of
+    sessions can run side by side on one event loop.
 
+    Attributes:
+        None
+    """
 
-def initControllers():
+    def __init__(self, index, sharedState, claimedAddresses=None,
+                 scanLock=None):
+        """
+        Initializes the session.
+
+        Params:
+            index (int): Index of the device. Selects its shared memory
+                         slots and DSU ports.
+            sharedState (SharedControllerState): Channel the inputs are
+                                                 published to.
+            claimedAddresses (set): Addresses connected to by the other
+                                    sessions, shared between them.
+            scanLock (asyncio.Lock): Lock shared between the sessions so
+                                     only one scans at a time.
+        """
+        self.index = index
+        self.stats = DeviceStats(f"Wii Remote {index + 1}")
+        # The device clock estimate is shared by both controllers
+        self.clockSync = ClockSync()
+        self.timeSync = TimeSyncClient(self.clockSync)
+        self.wiiRemote = Wiimote(sharedState,
+                                 WIIMOTE_SLOT + index * SLOTS_PER_DEVICE,
+                                 self.clockSync, self.stats)
+        self.nunchuck = Nunchuck(sharedState,
+                                 NUNCHUCK_SLOT + index * SLOTS_PER_DEVICE,
+                                 self.clockSync, self.stats)
+        self.gestures = Gestures(f"Wii Remote {index + 1}", self.clockSync)
+        self.ble = BLE("Wii Remote", index, claimedAddresses=claimedAddresses,
+                       scanLock=scanLock, stats=self.stats)
+
+        # Add callbacks used to handle notifications from the assigned
+        # characteristic UUIDs
+        self.ble.addCallback(WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID,
+                             self.wiiRemote.wiimote_button_input_cb)
+        self.ble.addCallback(WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID,
+                             self.wiiRemote.wiimote_sensor_input_cb)
+        self.ble.addCallback(NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID,
+                             self.nunchuck.nunchuck_button_joystick_input_cb)
+        self.ble.addCallback(NUNCHUCK_SENSOR_INPUT_CHARACTERISTIC_UUID,
+                             self.nunchuck.nunchuck_sensor_input_cb)
+        self.ble.addCallback(GESTURE_EVENT_CHARACTERISTIC_UUID,
+                             self.gestures.gesture_event_cb)
+        # Run the device clock sync while connected
+        self.ble.addCallback(TIME_SYNC_CHARACTERISTIC_UUID,
+                             self.timeSync.response_cb)
+        self.ble.timeSync = self.timeSync
+
+    async def run(self):
+        """ Connects to the device and receives its inputs until cancelled. """
+        await self.ble.receiveData()
+
+
+def runOutput(sharedStateName, deviceCount=1, cpu=None, profile=DEFAULT_PROFILE_NAME):
     """
-    Initializes DSU threads and adds callbacks to handle received
-    controller input values.
+    Runs the DSU servers, reading the controller inputs from shared memory.
+
+    Params:
+        sharedStateName (String): Name of the shared memory region.
+        deviceCount (int): Number of Wii Remotes.
+        cpu (int): CPU core to run on, or None to leave it unpinned.
+        profile (String): Button profile name or file. Reloaded when the
+                          file changes.
     """
-    # Create and start the Wii Remote DSU thread. Run it in daemon mode
-    # so that the server runs in the background and so the main program
-    # does not depend on the server completing communication tasks.
-    wiiRemoteDsuThread = threading.Thread(target=wiiRemote.update_inputs)
-    wiiRemoteDsuThread.daemon = True
-    wiiRemoteDsuThread.start()
-
-    # Create and start the Nunchuck DSU thread. Like the Wii Remote
-    # thread, run in daemon mode as a background task.
-    nunchuckDsuThread = threading.Thread(target=nunchuck.update_inputs)
-    nunchuckDsuThread.daemon = True
-    nunchuckDsuThread.start()
-
-    # Add callbacks used to handle notifications from the assigned
-    # characteristic UUIDs
-    ble.addCallback(WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID,
-                    wiiRemote.wiimote_button_input_cb)
-    ble.addCallback(WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID,
-                    wiiRemote.wiimote_sensor_input_cb)
-    ble.addCallback(NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID,
-                    nunchuck.nunchuck_button_joystick_input_cb)
-    ble.addCallback(NUNCHUCK_SENSOR_INPUT_CHARACTERISTIC_UUID,
-                    nunchuck.nunchuck_sensor_input_cb)
-
-
-async def main():
-    """ Main function handler. """
-    initControllers()
-    connectionStatus = await ble.findDevice()
-    assert connectionStatus, "Failed to connect to the Wii Remote."
-    await ble.receiveData()
+    pinToCpu(cpu)
+    # Wait for the ingest process to create the shared memory region
+    while True:
+        try:
+            sharedState = SharedControllerState(
+                sharedStateName, deviceCount * SLOTS_PER_DEVICE)
+            break
+        except FileNotFoundError:
+            time.sleep(0.5)
+
+    dsuServers = []
+    for index in range(deviceCount):
+        wiiRemoteIp, wiiRemotePort = WIIMOTE_DSU_ADDRESS
+        wiiRemoteDsu = DSU_Server(wiiRemoteIp, wiiRemotePort + index)
+        wiiRemoteDsu.attachSharedState(sharedState,
+                                       WIIMOTE_SLOT + index * SLOTS_PER_DEVICE)
+        nunchuckIp, nunchuckPort = NUNCHUCK_DSU_ADDRESS
+        nunchuckDsu = DSU_Server(nunchuckIp, nunchuckPort + index)
+        nunchuckDsu.attachSharedState(sharedState,
+                                      NUNCHUCK_SLOT + index * SLOTS_PER_DEVICE)
+        dsuServers += [wiiRemoteDsu, nunchuckDsu]
+
+    def applyProfile(profiles):
+        for wiiRemoteDsu in dsuServers[0::2]:
+            wiiRemoteDsu.setProfile(profiles['wiimote'])
+        for nunchuckDsu in dsuServers[1::2]:
+            nunchuckDsu.setProfile(profiles['nunchuck'])
+    profileWatcher = ProfileWatcher(profile, applyProfile)
+    profileWatcher.poll()
+    watcherThread = threading.Thread(target=profileWatcher.run)
+    watcherThread.daemon = True
+    watcherThread.start()
+
+    # Run every DSU server but the first in a daemon thread, in the
+    # background of the first.
+    for dsuServer in dsuServers[1:]:
+        dsuThread = threading.Thread(target=dsuServer.update_inputs)
+        dsuThread.daemon = True
+        dsuThread.start()
+    dsuServers[0].update_inputs()
+
+
+async def logStats(sessions, period=STATS_LOG_PERIOD):
+    """
+    Periodically logs the counters of every session.
+
+    Params:
+        sessions (list): Sessions to log.
+        period (float): Period between logs, in seconds.
+    """
+    while True:
+        await asyncio.sleep(period)
+        for session in sessions:
+            session.stats.log()
+
 
-asyncio.run(main())
+async def runIngest(sharedState, deviceCount=1, cpu=None):
+    """
+    Connects to the Wii Remotes and publishes their decoded inputs to shared
+    memory.
+
+    Params:
+        sharedState (SharedControllerState): Channel the inputs are
+                                             published to.
+        deviceCount (int): Number of Wii Remotes to connect to.
+        cpu (int): CPU core to run on, or None to leave it unpinned.
+    """
+    pinToCpu(cpu)
+    claimedAddresses = set()
+    scanLock = asyncio.Lock()
+    sessions = [ControllerSession(index, sharedState, claimedAddresses, scanLock)
+                for index in range(deviceCount)]
+    await asyncio.gather(logStats(sessions),
+                         *[session.run() for session in sessions])
+
+
+def main():
+    """ Main function handler. """
+    parser = argparse.ArgumentParser(description="Wii Remote DSU bridge")
+    parser.add_argument('--mode', choices=('all', 'ingest', 'output'),
+                        default='all',
+                        help='run BLE ingest, DSU output, or both as '
+                             'separate processes')
+    parser.add_argument('--devices', type=int, default=1,
+                        choices=range(1, MAX_DEVICES + 1),
+                        help='number of Wii Remotes to connect to. Device k '
+                             'is served on DSU port 26760 + k.')
+    parser.add_argument('--shm-name', default=SHARED_STATE_NAME,
+                        help='name of the shared memory region')
+    parser.add_argument('--ingest-cpu', type=int, default=None,
+                        help='CPU core to pin the ingest process to')
+    parser.add_argument('--output-cpu', type=int, default=None,
+                        help='CPU core to pin the output process to')
+    parser.add_argument('--profile', default=DEFAULT_PROFILE_NAME,
+                        help='button profile name (in src/profiles) or file. '
+                             'Changes to the file apply while running.')
+    args = parser.parse_args()
+
+    if args.mode == 'output':
+        runOutput(args.shm_name, args.devices, args.output_cpu, args.profile)
+        return
+
+    # The ingest process owns the shared memory region
+    sharedState = SharedControllerState(args.shm_name,
+                                        args.devices * SLOTS_PER_DEVICE,
+                                        create=True)
+    outputProcess = None
+    try:
+        if args.mode == 'all':
+            outputProcess = multiprocessing.Process(
+                target=runOutput,
+                args=(args.shm_name, args.devices, args.output_cpu, args.profile),
+                daemon=True)
+            outputProcess.start()
+        asyncio.run(runIngest(sharedState, args.devices, args.ingest_cpu))
+    finally:
+        if outputProcess != None:
+            outputProcess.terminate()
+        sharedState.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,242 @@
+"""
+File: shared_state.py
+Description: Fixed-layout shared memory channel holding the latest state of
+             each controller. The BLE ingest process writes complete samples
+             and any number of local consumers (DSU output, recorders,
+             visualizers) read consistent snapshots, each slot protected by
+             a seqlock so readers never block the writer.
+Author: Humza Ali
+"""
+
+import os
+import struct
+import sys
+from multiprocessing import shared_memory
+
+# Default name of the shared memory region
+SHARED_STATE_NAME = 'pymote_state'
+# Default number of controller slots (Wii Remote + Nunchuck)
+SHARED_STATE_SLOT_COUNT = 2
+
+# Seqlock sequence number. Odd while the writer is updating the slot.
+SEQUENCE_STRUCT = struct.Struct('<I')
+# Controller sample: buttons1, buttons2, extraButtons, flags, joystick x/y,
+# padding, accel x/y/z, gyro x/y/z, motion timestamp (us)
+SAMPLE_STRUCT = struct.Struct('<4B2B2x6fQ')
+# Slots are padded to a cache line so writers of different slots never
+# share one
+SLOT_SIZE_BYTES = 64
+SAMPLE_OFFSET = SEQUENCE_STRUCT.size
+
+assert SAMPLE_OFFSET + SAMPLE_STRUCT.size <= SLOT_SIZE_BYTES
+
+# Bits of the sample flags byte, set when the matching field is present
+FLAG_JOYSTICK = 0x01
+FLAG_ACCEL = 0x02
+FLAG_GYRO = 0x04
+FLAG_TIMESTAMP = 0x08
+
+# Number of torn reads before a reader gives up on a snapshot
+MAX_READ_RETRIES = 1000
+
+# Regions created by this process, which stay registered with the resource
+# tracker when this process also attaches to them
+createdRegions = set()
+
+
+def attachSharedMemory(name):
+    """
+    Attaches to an existing shared memory region without taking ownership
+    of it.
+
+    Before Python 3.13 every handle is registered with the resource
+    tracker, which unlinks the region when the attaching process exits,
+    even though another process created it and is still using it.
+
+    Params:
+        name (String): Name of the shared memory region.
+
+    Return:
+        (SharedMemory): The attached region.
+    """
+    if sys.version_info >= (3, 13):
+        return shared_memory.SharedMemory(name=name, track=False)
+    memory = shared_memory.SharedMemory(name=name)
+    if (os.name == 'posix') and (name not in createdRegions):
+        # Only POSIX handles are tracked
+        from multiprocessing import resource_tracker
+        resource_tracker.unregister(memory._name, 'shared_memory')
+    return memory
+
+
+class ControllerSample(object):
+    """
+    Complete input state of one controller, using the same fields as
+    DSU_Server.
+
+    Attributes:
+        None
+    """
+
+    __slots__ = ('buttons1', 'buttons2', 'extraButtons', 'joystickData',
+                 'accelData', 'gyroData', 'motionTimestamp')
+
+    def __init__(self):
+        """ Initializes an empty sample. """
+        self.buttons1 = 0
+        self.buttons2 = 0
+        self.extraButtons = 0
+        self.joystickData = None
+        self.accelData = None
+        self.gyroData = None
+        self.motionTimestamp = None
+
+
+class SharedControllerState(object):
+    """
+    Shared memory region with one seqlock protected slot per controller.
+
+    Each slot must have a single writer. The writer bumps the sequence to an
+    odd value, writes the sample in place and bumps it back to even. Readers
+    retry when they see an odd sequence or when it changed during the read,
+    so a snapshot never mixes fields of two samples. Python has no memory
+    fences, so this relies on stores becoming visible in program order, as
+    they do on x86 hosts.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, name=SHARED_STATE_NAME,
+                 slotCount=SHARED_STATE_SLOT_COUNT, create=False):
+        """
+        Creates or attaches to the shared memory region.
+
+        Params:
+            name (String): Name of the shared memory region.
+            slotCount (int): Number of controller slots.
+            create (bool): Create the region instead of attaching to it.
+        """
+        self.slotCount = slotCount
+        size = slotCount * SLOT_SIZE_BYTES
+        if create:
+            try:
+                self.memory = shared_memory.SharedMemory(name=name, create=True,
+                                                         size=size)
+            except FileExistsError:
+                # Left behind by a previous run that didn't clean up
+                self.memory = shared_memory.SharedMemory(name=name)
+                if self.memory.size < size:
+                    # Previous run had fewer devices, start over
+                    self.memory.close()
+                    self.memory.unlink()
+                    self.memory = shared_memory.SharedMemory(
+                        name=name, create=True, size=size)
+            createdRegions.add(name)
+        else:
+            self.memory = attachSharedMemory(name)
+        self.owner = create
+        self.buffer = self.memory.buf
+        if create:
+            self.buffer[:size] = bytes(size)
+
+    def close(self):
+        """ Detaches from the region, and removes it if this created it. """
+        self.buffer = None
+        self.memory.close()
+        if self.owner:
+            createdRegions.discard(self.memory.name)
+            try:
+                self.memory.unlink()
+            except FileNotFoundError:
+                # Already removed by someone else, nothing left to clean up
+                pass
+
+    def sequence(self, slot):
+        """
+        Returns the current sequence number of a slot. Consumers can compare
+        it with the last sequence they read to check for a new sample
+        without decoding it.
+
+        Params:
+            slot (int): Controller slot.
+        """
+        return SEQUENCE_STRUCT.unpack_from(self.buffer, slot * SLOT_SIZE_BYTES)[0]
+
+    def write(self, slot, sample):
+        """
+        Publishes a complete sample to a slot.
+
+        Params:
+            slot (int): Controller slot.
+            sample (ControllerSample): Sample to publish.
+        """
+        base = slot * SLOT_SIZE_BYTES
+        buffer = self.buffer
+        sequence = SEQUENCE_STRUCT.unpack_from(buffer, base)[0]
+
+        flags = 0
+        joystickX = joystickY = 0
+        ax = ay = az = gx = gy = gz = 0.0
+        timestamp = 0
+        if sample.joystickData != None:
+            flags |= FLAG_JOYSTICK
+            joystickX, joystickY = sample.joystickData
+        if sample.accelData != None:
+            flags |= FLAG_ACCEL
+            ax, ay, az = sample.accelData
+        if sample.gyroData != None:
+            flags |= FLAG_GYRO
+            gx, gy, gz = sample.gyroData
+        if sample.motionTimestamp != None:
+            flags |= FLAG_TIMESTAMP
+            timestamp = sample.motionTimestamp
+
+        # Odd sequence marks the slot as being written
+        SEQUENCE_STRUCT.pack_into(buffer, base, (sequence + 1) & 0xFFFFFFFF)
+        SAMPLE_STRUCT.pack_into(buffer, base + SAMPLE_OFFSET,
+                                sample.buttons1, sample.buttons2,
+                                sample.extraButtons, flags,
+                                joystickX, joystickY,
+                                ax, ay, az, gx, gy, gz, timestamp)
+        SEQUENCE_STRUCT.pack_into(buffer, base, (sequence + 2) & 0xFFFFFFFF)
+
+    def read(self, slot, sample=None):
+        """
+        Reads a consistent snapshot of a slot.
+
+        Params:
+            slot (int): Controller slot.
+            sample (ControllerSample): Sample to read into. A new one is
+                                       created if None.
+
+        Return:
+            (Tuple): The sequence number of the snapshot and the sample, or
+                     (None, None) if no consistent snapshot could be read.
+        """
+        base = slot * SLOT_SIZE_BYTES
+        buffer = self.buffer
+        for _ in range(MAX_READ_RETRIES):
+            before = SEQUENCE_STRUCT.unpack_from(buffer, base)[0]
+            if before & 1:
+                # Writer is in the middle of an update
+                continue
+            values = SAMPLE_STRUCT.unpack_from(buffer, base + SAMPLE_OFFSET)
+            after = SEQUENCE_STRUCT.unpack_from(buffer, base)[0]
+            if before == after:
+                break
+        else:
+            return None, None
+
+        (buttons1, buttons2, extraButtons, flags, joystickX, joystickY,
+         ax, ay, az, gx, gy, gz, timestamp) = values
+        if sample == None:
+            sample = ControllerSample()
+        sample.buttons1 = buttons1
+        sample.buttons2 = buttons2
+        sample.extraButtons = extraButtons
+        sample.joystickData = (joystickX, joystickY) if flags & FLAG_JOYSTICK else None
+        sample.accelData = (ax, ay, az) if flags & FLAG_ACCEL else None
+        sample.gyroData = (gx, gy, gz) if flags & FLAG_GYRO else None
+        sample.motionTimestamp = timestamp if flags & FLAG_TIMESTAMP else None
+        return before, sample
@@ -0,0 +1,154 @@
+"""
+File: simulate_devices.py
+Description: Multi-device ingest scaling check. Drives 1 to N simulated Wii
+             Remotes through the same session callbacks used for real
+             devices, interleaving their notifications on one event loop the
+             way Bleak delivers them, and reports the per-controller cost.
+             Exits with an error if the cost grows by more than the allowed
+             ratio between 1 and N devices.
+
+                 python simulate_devices.py --max-devices 4
+Author: Humza Ali
+"""
+
+import argparse
+import asyncio
+import math
+import os
+import sys
+import time
+from pymote_controller import ControllerSession, SLOTS_PER_DEVICE
+from shared_state import SharedControllerState
+from time_sync import hostTimeUs
+from wire_schema import (
+    WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID,
+    WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID,
+    NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID,
+    NUNCHUCK_SENSOR_INPUT_CHARACTERISTIC_UUID,
+    encodeWiimoteButtonInput,
+    encodeWiimoteSensorInput,
+    encodeNunchuckButtonJoystickInput,
+    encodeNunchuckSensorInput,
+)
+
+
+def simulatedNotifications(index, count):
+    """
+    Generates the notifications of one simulated device: mostly motion
+    samples, with a button or joystick change every tenth sample.
+
+    Params:
+        index (int): Index of the device, used to vary the payloads.
+        count (int): Number of notifications to generate.
+
+    Return:
+        (generator): (characteristic UUID, payload) pairs.
+    """
+    deviceTimeUs = index * 1000
+    for n in range(count):
+        deviceTimeUs += 10000
+        phase = (n + index) * 0.05
+        if n % 10 == 0:
+            yield (WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID,
+                   encodeWiimoteButtonInput(n & 0xFF, (n >> 8) & 0xFF, 0))
+        elif n % 10 == 5:
+            yield (NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID,
+                   encodeNunchuckButtonJoystickInput(n & 0xFF, 128, n & 0x3))
+        elif n % 2 == 0:
+            yield (WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID,
+                   encodeWiimoteSensorInput(math.sin(phase), math.cos(phase),
+                                            1.0, 10.0 * math.sin(phase),
+                                            0.0, 0.0,
+                                            deviceTimeUs & 0xFFFFFFFF))
+        else:
+            yield (NUNCHUCK_SENSOR_INPUT_CHARACTERISTIC_UUID,
+                   encodeNunchuckSensorInput(math.cos(phase), 0.0, 1.0,
+                                             deviceTimeUs & 0xFFFFFFFF))
+
+
+async def driveDevices(sessions, notificationsPerDevice):
+    """
+    Delivers the simulated notifications of every session, one device per
+    event loop iteration.
+
+    Params:
+        sessions (list): Sessions to drive.
+        notificationsPerDevice (int): Notifications sent by each device.
+    """
+    async def device(session):
+        callbacks = session.ble.callbacks
+        session.ble.connectStartTime = time.perf_counter()
+        for uuid, payload in simulatedNotifications(session.index,
+                                                    notificationsPerDevice):
+            callbacks[uuid](None, payload)
+            # Yield so the devices interleave like concurrent notifications
+            await asyncio.sleep(0)
+    await asyncio.gather(*[device(session) for session in sessions])
+
+
+def runScaling(deviceCount, notificationsPerDevice):
+    """
+    Measures the per-controller cost with a given number of devices.
+
+    Params:
+        deviceCount (int): Number of simulated devices.
+        notificationsPerDevice (int): Notifications sent by each device.
+
+    Return:
+        (Tuple): Mean wall time per notification and mean callback time per
+                 notification, in us.
+    """
+    name = f"pymote_sim_{os.getpid()}"
+    sharedState = SharedControllerState(name, deviceCount * SLOTS_PER_DEVICE,
+                                        create=True)
+    try:
+        sessions = [ControllerSession(index, sharedState)
+                    for index in range(deviceCount)]
+        for session in sessions:
+            # Pretend the clock sync converged on a fixed offset so that
+            # sensor samples are timestamped and their latency is counted
+            session.clockSync.synced = True
+            session.clockSync.intercept = float(hostTimeUs())
+
+        start = time.perf_counter_ns()
+        asyncio.run(driveDevices(sessions, notificationsPerDevice))
+        elapsedNs = time.perf_counter_ns() - start
+    finally:
+        sharedState.close()
+
+    total = deviceCount * notificationsPerDevice
+    callbackNs = sum(session.stats.callbackTimeNs for session in sessions)
+    return elapsedNs / total / 1000, callbackNs / total / 1000
+
+
+def main():
+    """ Main function handler. """
+    parser = argparse.ArgumentParser(description="Multi-device ingest scaling check")
+    parser.add_argument('--max-devices', type=int, default=4,
+                        help='largest number of simulated devices')
+    parser.add_argument('--notifications', type=int, default=20000,
+                        help='notifications sent by each device')
+    parser.add_argument('--max-ratio', type=float, default=1.5,
+                        help='allowed growth of the per-notification '
+                             'callback cost from 1 to N devices')
+    args = parser.parse_args()
+
+    # Warm up so the first measurement doesn't include import costs
+    runScaling(1, 1000)
+
+    results = {}
+    print("devices  wall us/notification  callback us/notification")
+    for deviceCount in range(1, args.max_devices + 1):
+        wallUs, callbackUs = runScaling(deviceCount, args.notifications)
+        results[deviceCount] = callbackUs
+        print(f"{deviceCount:7d}  {wallUs:20.2f}  {callbackUs:24.2f}")
+
+    ratio = results[args.max_devices] / results[1]
+    print(f"Callback cost ratio {args.max_devices}:1 devices: {ratio:.2f}")
+    if ratio > args.max_ratio:
+        print(f"Per-controller cost grew by more than {args.max_ratio:.2f}x")
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,266 @@
+"""
+File: time_sync.py
+Description: Device-to-host clock synchronization. Estimates the offset and
+             drift of the Wii Remote clock from NTP style ping-pong exchanges
+             over the time sync characteristic, and maps device sample
+             timestamps onto the host clock.
+Author: Humza Ali
+"""
+
+import asyncio
+import time
+from collections import deque
+from wire_schema import (TIME_SYNC_CHARACTERISTIC_UUID,
+                         TIME_SYNC_RESPONSE_LENGTH_BYTES,
+                         decodeTimeSyncResponse, encodeTimeSyncRequest)
+
+# Period between time sync exchanges, in seconds
+TIME_SYNC_PERIOD = 0.5
+# Faster period used until the estimate has enough exchanges, in seconds
+TIME_SYNC_STARTUP_PERIOD = 0.05
+# Device timestamps are micros() values, which wrap at 32 bits
+DEVICE_CLOCK_WRAP = 1 << 32
+
+
+def hostTimeUs():
+    """
+    Returns the host time used for motion timestamps, in us. A monotonic
+    clock is used so that wall clock adjustments don't show up as motion.
+    """
+    return time.perf_counter_ns() // 1000
+
+
+class ClockSync(object):
+    """
+    Estimates the device clock offset and drift relative to the host clock.
+
+    Each exchange gives a host send time (t1), device receive time (t2),
+    device transmit time (t3) and host receive time (t4). The exchanges with
+    the smallest round trip times are the least affected by BLE scheduling,
+    so a line is fit through the midpoints of those to map device time onto
+    host time. All times are passed in, so the estimator can be driven by a
+    simulated clock.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, windowSize=64, minExchanges=4, rttQuantile=0.5):
+        """
+        Initializes the clock sync estimator.
+
+        Params:
+            windowSize (int): Number of recent exchanges kept for the fit.
+            minExchanges (int): Number of exchanges needed before device
+                                times are mapped.
+            rttQuantile (float): Fraction of the exchanges, lowest round trip
+                                 time first, used for the fit.
+        """
+        self.windowSize = windowSize
+        self.minExchanges = minExchanges
+        self.rttQuantile = rttQuantile
+        self.reset()
+
+    def reset(self):
+        """ Clears the estimate, e.g. after the device reconnects. """
+        self.exchanges = deque(maxlen=self.windowSize)
+        self.lastDeviceTime = None
+        self.deviceWraps = 0
+        # host = intercept + slope * (device - deviceRef)
+        self.deviceRef = 0
+        self.intercept = 0.0
+        self.slope = 1.0
+        self.synced = False
+        # Accuracy metrics
+        self.lastRttUs = None
+        self.minRttUs = None
+        self.residualUs = None
+
+    def unwrap(self, deviceTimeUs):
+        """
+        Extends a 32-bit device timestamp to a monotonically increasing one.
+
+        Params:
+            deviceTimeUs (int): Raw device timestamp, in us.
+
+        Return:
+            (int): The unwrapped device timestamp, in us.
+        """
+        if self.lastDeviceTime != None:
+            lastRaw = self.lastDeviceTime % DEVICE_CLOCK_WRAP
+            # A jump backwards by more than half the range is a wrap
+            if (lastRaw - deviceTimeUs) > (DEVICE_CLOCK_WRAP // 2):
+                self.deviceWraps += 1
+            elif (deviceTimeUs - lastRaw) > (DEVICE_CLOCK_WRAP // 2):
+                # Late sample from before the last wrap
+                return (self.deviceWraps - 1) * DEVICE_CLOCK_WRAP + deviceTimeUs
+        unwrapped = self.deviceWraps * DEVICE_CLOCK_WRAP + deviceTimeUs
+        if (self.lastDeviceTime == None) or (unwrapped > self.lastDeviceTime):
+            self.lastDeviceTime = unwrapped
+        return unwrapped
+
+    def addExchange(self, t1, t2, t3, t4):
+        """
+        Adds a completed time sync exchange and updates the estimate.
+
+        Params:
+            t1 (int): Host time the request was sent, in us.
+            t2 (int): Raw device time the request was received, in us.
+            t3 (int): Raw device time the response was sent, in us.
+            t4 (int): Host time the response was received, in us.
+        """
+        t2 = self.unwrap(t2)
+        t3 = self.unwrap(t3)
+        rtt = (t4 - t1) - (t3 - t2)
+        if rtt < 0:
+            # Not physically possible, drop it
+            return
+        hostMid = (t1 + t4) / 2.0
+        deviceMid = (t2 + t3) / 2.0
+        self.exchanges.append((deviceMid, hostMid, rtt))
+        self.lastRttUs = rtt
+        self.minRttUs = rtt if self.minRttUs == None else min(self.minRttUs, rtt)
+        self.fit()
+
+    def fit(self):
+        """ Fits host time against device time over the best exchanges. """
+        if len(self.exchanges) < self.minExchanges:
+            return
+        ordered = sorted(self.exchanges, key=lambda e: e[2])
+        count = max(self.minExchanges // 2, int(len(ordered) * self.rttQuantile))
+        best = ordered[:max(count, 2)]
+
+        # Center the device times to keep the fit well conditioned
+        self.deviceRef = best[0][0]
+        xs = [e[0] - self.deviceRef for e in best]
+        ys = [e[1] for e in best]
+        n = len(best)
+        meanX = sum(xs) / n
+        meanY = sum(ys) / n
+        varX = sum((x - meanX) ** 2 for x in xs)
+        if varX > 0:
+            covXY = sum((x - meanX) * (y - meanY) for x, y in zip(xs, ys))
+            self.slope = covXY / varX
+        else:
+            self.slope = 1.0
+        self.intercept = meanY - self.slope * meanX
+        residuals = [y - (self.intercept + self.slope * x) for x, y in zip(xs, ys)]
+        self.residualUs = (sum(r * r for r in residuals) / n) ** 0.5
+        self.synced = True
+
+    def toHostTime(self, deviceTimeUs):
+        """
+        Maps a raw device timestamp onto the host clock.
+
+        Params:
+            deviceTimeUs (int): Raw device timestamp, in us.
+
+        Return:
+            (int): The host time of the sample, in us, or None if the
+                   estimate isn't ready yet.
+        """
+        unwrapped = self.unwrap(deviceTimeUs)
+        if not self.synced:
+            return None
+        return int(self.intercept + self.slope * (unwrapped - self.deviceRef))
+
+    def offsetUs(self):
+        """ Returns the host minus device offset at the reference point, in us. """
+        return self.intercept - self.deviceRef
+
+    def driftPpm(self):
+        """ Returns the drift of the device clock relative to the host, in ppm. """
+        return (1.0 / self.slope - 1.0) * 1e6 if self.slope != 0 else 0.0
+
+    def metrics(self):
+        """
+        Returns the accuracy metrics of the estimate.
+
+        Return:
+            (dict): Offset, drift, round trip times and fit residual.
+        """
+        return {
+            'synced': self.synced,
+            'exchanges': len(self.exchanges),
+            'offsetUs': self.offsetUs(),
+            'driftPpm': self.driftPpm(),
+            'lastRttUs': self.lastRttUs,
+            'minRttUs': self.minRttUs,
+            'residualUs': self.residualUs,
+        }
+
+
+class TimeSyncClient(object):
+    """
+    Runs time sync exchanges with the device over a connected Bleak client.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, clockSync, period=TIME_SYNC_PERIOD,
+                 startupPeriod=TIME_SYNC_STARTUP_PERIOD, logPeriod=10.0):
+        """
+        Initializes the time sync client.
+
+        Params:
+            clockSync (ClockSync): Estimator updated with each exchange.
+            period (float): Period between exchanges, in seconds.
+            startupPeriod (float): Period used until the estimate is ready.
+            logPeriod (float): Period between accuracy logs, in seconds.
+        """
+        self.clockSync = clockSync
+        self.period = period
+        self.startupPeriod = startupPeriod
+        self.logPeriod = logPeriod
+        self.sequence = 0
+        # Host send times of outstanding requests, keyed by sequence
+        self.pending = {}
+
+    def response_cb(self, sender, data):
+        """
+        Callback called by the BLE class with a time sync response.
+
+        Params:
+            sender (BleakGATTCharacteristic): Unused positional parameter
+            data (bytearray): Received data from the characteristic, in bytes.
+        """
+        t4 = hostTimeUs()
+        if len(data) < TIME_SYNC_RESPONSE_LENGTH_BYTES:
+            return
+        sequence, t2, t3 = decodeTimeSyncResponse(data)
+        t1 = self.pending.pop(sequence, None)
+        if t1 != None:
+            self.clockSync.addExchange(t1, t2, t3, t4)
+
+    async def run(self, client):
+        """
+        Sends time sync requests until cancelled. Should be run as a task
+        while the client is connected.
+
+        Params:
+            client (BleakClient): Connected client.
+        """
+        self.clockSync.reset()
+        self.pending.clear()
+        lastLog = time.monotonic()
+        while True:
+            self.sequence = (self.sequence + 1) & 0xFFFFFFFF
+            request = encodeTimeSyncRequest(self.sequence)
+            self.pending[self.sequence] = hostTimeUs()
+            # Drop requests that were never answered
+            if len(self.pending) > 16:
+                self.pending.pop(next(iter(self.pending)))
+            await client.write_gatt_char(TIME_SYNC_CHARACTERISTIC_UUID,
+                                         request, response=False)
+
+            if (time.monotonic() - lastLog) >= self.logPeriod:
+                lastLog = time.monotonic()
+                m = self.clockSync.metrics()
+                if m['synced']:
+                    print(f"Time sync: drift {m['driftPpm']:.1f} ppm, "
+                          f"min RTT {m['minRttUs'] / 1000:.1f} ms, "
+                          f"residual {m['residualUs']:.0f} us")
+
+            period = self.period if self.clockSync.synced else self.startupPeriod
+            await asyncio.sleep(period)
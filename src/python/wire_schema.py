@@ -0,0 +1,411 @@
+"""
+File: wire_schema.py
+Description: BLE payload definitions shared with the firmware.
+             Generated from src/schema/wire_schema.json by
+             src/schema/gen_wire_schema.py. Do not edit by hand.
+Author: Humza Ali
+"""
+
+import struct
+
+# Version of the wire schema
+WIRE_SCHEMA_VERSION = 4
+
+# BLE Service UUID
+SERVICE_UUID = '06a1ef1c-d8f5-4839-bf3a-cf1deed694d2'
+# Characteristic UUIDs
+WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID = '7e3092ce-5b65-44c7-afef-c7722ef964b3'
+WIIMOTE_SENSOR_INPUT_CHARACTERISTIC_UUID = 'eb854de2-f0b3-48bf-90ca-1f2a85ef29c8'
+NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID = '3327921d-e3b3-43ff-b724-a706fae760d3'
+NUNCHUCK_SENSOR_INPUT_CHARACTERISTIC_UUID = 'be11ecb2-1c60-4411-9385-0436b247c5bb'
+TIME_SYNC_CHARACTERISTIC_UUID = 'a5b8c9d2-4f1e-4c3a-9b7d-2e6f8a1c0d3b'
+FLIGHT_RECORDER_CHARACTERISTIC_UUID = 'c3f1a6e4-7d2b-4e8a-9f5c-1b0d2e3f4a5b'
+GESTURE_EVENT_CHARACTERISTIC_UUID = 'e876b2cb-466d-4131-a99b-ec88ab7f0b49'
+
+
+# Type of a flight recorder event.
+FLIGHT_EVENT_BOOT = 0
+FLIGHT_EVENT_LOOP_OVERRUN = 1
+FLIGHT_EVENT_I2C_ERROR = 2
+FLIGHT_EVENT_NOTIFY_FAILURE = 3
+FLIGHT_EVENT_QUEUE_SATURATED = 4
+FLIGHT_EVENT_CONNECT = 5
+FLIGHT_EVENT_DISCONNECT = 6
+FLIGHT_EVENT_SUBSCRIBE = 7
+FLIGHT_EVENT_FREEZE = 8
+FLIGHT_EVENT_CPU_FREQ = 9
+FLIGHT_EVENT_TYPE_NAMES = {
+    0: 'BOOT',
+    1: 'LOOP_OVERRUN',
+    2: 'I2C_ERROR',
+    3: 'NOTIFY_FAILURE',
+    4: 'QUEUE_SATURATED',
+    5: 'CONNECT',
+    6: 'DISCONNECT',
+    7: 'SUBSCRIBE',
+    8: 'FREEZE',
+    9: 'CPU_FREQ',
+}
+
+
+# Reason a notification was not sent.
+FLIGHT_NOTIFY_NULL_CHARACTERISTIC = 1
+FLIGHT_NOTIFY_TRUNCATED = 2
+FLIGHT_NOTIFY_FAILURE_NAMES = {
+    1: 'NULL_CHARACTERISTIC',
+    2: 'TRUNCATED',
+}
+
+
+# Command written by the host to the flight recorder characteristic.
+FLIGHT_RECORDER_COMMAND_READ_CHUNK = 0
+FLIGHT_RECORDER_COMMAND_FREEZE = 1
+FLIGHT_RECORDER_COMMAND_RESUME = 2
+FLIGHT_RECORDER_COMMAND_NAMES = {
+    0: 'READ_CHUNK',
+    1: 'FREEZE',
+    2: 'RESUME',
+}
+
+
+# Type of a detected gesture.
+GESTURE_SWING_START = 0
+GESTURE_SWING_PEAK = 1
+GESTURE_SHAKE = 2
+GESTURE_FLICK = 3
+GESTURE_TYPE_NAMES = {
+    0: 'SWING_START',
+    1: 'SWING_PEAK',
+    2: 'SHAKE',
+    3: 'FLICK',
+}
+
+
+# Wii Remote DS4 button bits (see Button_Mapping_t).
+WIIMOTE_BUTTON_INPUT_STRUCT = struct.Struct('<BBH')
+WIIMOTE_BUTTON_INPUT_LENGTH_BYTES = 4
+WIIMOTE_BUTTON_INPUT_FIELDS = ('buttons1', 'buttons2', 'reserved',)
+
+
+def decodeWiimoteButtonInput(data, offset=0):
+    """
+    Decodes a Wiimote_Button_Input payload in place, without copying.
+
+    Params:
+        data (bytes-like): Received payload (bytes, bytearray or memoryview).
+        offset (int): Offset of the payload in data.
+
+    Return:
+        (Tuple): The decoded fields, in the order of WIIMOTE_BUTTON_INPUT_FIELDS.
+    """
+    return WIIMOTE_BUTTON_INPUT_STRUCT.unpack_from(data, offset)
+
+
+def encodeWiimoteButtonInput(*fields):
+    """
+    Encodes a Wiimote_Button_Input payload, as packed by the firmware.
+
+    Params:
+        fields: Field values, in the order of WIIMOTE_BUTTON_INPUT_FIELDS.
+
+    Return:
+        (bytes): The encoded payload.
+    """
+    return WIIMOTE_BUTTON_INPUT_STRUCT.pack(*fields)
+
+
+# Wii Remote accelerometer and gyroscope sample.
+WIIMOTE_SENSOR_INPUT_STRUCT = struct.Struct('<ffffffI')
+WIIMOTE_SENSOR_INPUT_LENGTH_BYTES = 28
+WIIMOTE_SENSOR_INPUT_FIELDS = ('accelX', 'accelY', 'accelZ', 'gyroX', 'gyroY', 'gyroZ', 'timestampUs',)
+
+
+def decodeWiimoteSensorInput(data, offset=0):
+    """
+    Decodes a Wiimote_Sensor_Input payload in place, without copying.
+
+    Params:
+        data (bytes-like): Received payload (bytes, bytearray or memoryview).
+        offset (int): Offset of the payload in data.
+
+    Return:
+        (Tuple): The decoded fields, in the order of WIIMOTE_SENSOR_INPUT_FIELDS.
+    """
+    return WIIMOTE_SENSOR_INPUT_STRUCT.unpack_from(data, offset)
+
+
+def encodeWiimoteSensorInput(*fields):
+    """
+    Encodes a Wiimote_Sensor_Input payload, as packed by the firmware.
+
+    Params:
+        fields: Field values, in the order of WIIMOTE_SENSOR_INPUT_FIELDS.
+
+    Return:
+        (bytes): The encoded payload.
+    """
+    return WIIMOTE_SENSOR_INPUT_STRUCT.pack(*fields)
+
+
+# Nunchuck joystick axes and C/Z button bits.
+NUNCHUCK_BUTTON_JOYSTICK_INPUT_STRUCT = struct.Struct('<BBB')
+NUNCHUCK_BUTTON_JOYSTICK_INPUT_LENGTH_BYTES = 3
+NUNCHUCK_BUTTON_JOYSTICK_INPUT_FIELDS = ('joystickX', 'joystickY', 'buttons',)
+
+
+def decodeNunchuckButtonJoystickInput(data, offset=0):
+    """
+    Decodes a Nunchuck_Button_Joystick_Input payload in place, without copying.
+
+    Params:
+        data (bytes-like): Received payload (bytes, bytearray or memoryview).
+        offset (int): Offset of the payload in data.
+
+    Return:
+        (Tuple): The decoded fields, in the order of NUNCHUCK_BUTTON_JOYSTICK_INPUT_FIELDS.
+    """
+    return NUNCHUCK_BUTTON_JOYSTICK_INPUT_STRUCT.unpack_from(data, offset)
+
+
+def encodeNunchuckButtonJoystickInput(*fields):
+    """
+    Encodes a Nunchuck_Button_Joystick_Input payload, as packed by the firmware.
+
+    Params:
+        fields: Field values, in the order of NUNCHUCK_BUTTON_JOYSTICK_INPUT_FIELDS.
+
+    Return:
+        (bytes): The encoded payload.
+    """
+    return NUNCHUCK_BUTTON_JOYSTICK_INPUT_STRUCT.pack(*fields)
+
+
+# Nunchuck accelerometer sample.
+NUNCHUCK_SENSOR_INPUT_STRUCT = struct.Struct('<fffI')
+NUNCHUCK_SENSOR_INPUT_LENGTH_BYTES = 16
+NUNCHUCK_SENSOR_INPUT_FIELDS = ('accelX', 'accelY', 'accelZ', 'timestampUs',)
+
+
+def decodeNunchuckSensorInput(data, offset=0):
+    """
+    Decodes a Nunchuck_Sensor_Input payload in place, without copying.
+
+    Params:
+        data (bytes-like): Received payload (bytes, bytearray or memoryview).
+        offset (int): Offset of the payload in data.
+
+    Return:
+        (Tuple): The decoded fields, in the order of NUNCHUCK_SENSOR_INPUT_FIELDS.
+    """
+    return NUNCHUCK_SENSOR_INPUT_STRUCT.unpack_from(data, offset)
+
+
+def encodeNunchuckSensorInput(*fields):
+    """
+    Encodes a Nunchuck_Sensor_Input payload, as packed by the firmware.
+
+    Params:
+        fields: Field values, in the order of NUNCHUCK_SENSOR_INPUT_FIELDS.
+
+    Return:
+        (bytes): The encoded payload.
+    """
+    return NUNCHUCK_SENSOR_INPUT_STRUCT.pack(*fields)
+
+
+# Written by the host to start a time sync exchange.
+TIME_SYNC_REQUEST_STRUCT = struct.Struct('<I')
+TIME_SYNC_REQUEST_LENGTH_BYTES = 4
+TIME_SYNC_REQUEST_FIELDS = ('sequence',)
+
+
+def decodeTimeSyncRequest(data, offset=0):
+    """
+    Decodes a Time_Sync_Request payload in place, without copying.
+
+    Params:
+        data (bytes-like): Received payload (bytes, bytearray or memoryview).
+        offset (int): Offset of the payload in data.
+
+    Return:
+        (Tuple): The decoded fields, in the order of TIME_SYNC_REQUEST_FIELDS.
+    """
+    return TIME_SYNC_REQUEST_STRUCT.unpack_from(data, offset)
+
+
+def encodeTimeSyncRequest(*fields):
+    """
+    Encodes a Time_Sync_Request payload, as packed by the firmware.
+
+    Params:
+        fields: Field values, in the order of TIME_SYNC_REQUEST_FIELDS.
+
+    Return:
+        (bytes): The encoded payload.
+    """
+    return TIME_SYNC_REQUEST_STRUCT.pack(*fields)
+
+
+# Notified back to the host for a time sync exchange.
+TIME_SYNC_RESPONSE_STRUCT = struct.Struct('<III')
+TIME_SYNC_RESPONSE_LENGTH_BYTES = 12
+TIME_SYNC_RESPONSE_FIELDS = ('sequence', 'receiveTimeUs', 'transmitTimeUs',)
+
+
+def decodeTimeSyncResponse(data, offset=0):
+    """
+    Decodes a Time_Sync_Response payload in place, without copying.
+
+    Params:
+        data (bytes-like): Received payload (bytes, bytearray or memoryview).
+        offset (int): Offset of the payload in data.
+
+    Return:
+        (Tuple): The decoded fields, in the order of TIME_SYNC_RESPONSE_FIELDS.
+    """
+    return TIME_SYNC_RESPONSE_STRUCT.unpack_from(data, offset)
+
+
+def encodeTimeSyncResponse(*fields):
+    """
+    Encodes a Time_Sync_Response payload, as packed by the firmware.
+
+    Params:
+        fields: Field values, in the order of TIME_SYNC_RESPONSE_FIELDS.
+
+    Return:
+        (bytes): The encoded payload.
+    """
+    return TIME_SYNC_RESPONSE_STRUCT.pack(*fields)
+
+
+# Written by the host to control the flight recorder.
+FLIGHT_RECORDER_REQUEST_STRUCT = struct.Struct('<BBH')
+FLIGHT_RECORDER_REQUEST_LENGTH_BYTES = 4
+FLIGHT_RECORDER_REQUEST_FIELDS = ('command', 'reserved', 'chunkIndex',)
+
+
+def decodeFlightRecorderRequest(data, offset=0):
+    """
+    Decodes a Flight_Recorder_Request payload in place, without copying.
+
+    Params:
+        data (bytes-like): Received payload (bytes, bytearray or memoryview).
+        offset (int): Offset of the payload in data.
+
+    Return:
+        (Tuple): The decoded fields, in the order of FLIGHT_RECORDER_REQUEST_FIELDS.
+    """
+    return FLIGHT_RECORDER_REQUEST_STRUCT.unpack_from(data, offset)
+
+
+def encodeFlightRecorderRequest(*fields):
+    """
+    Encodes a Flight_Recorder_Request payload, as packed by the firmware.
+
+    Params:
+        fields: Field values, in the order of FLIGHT_RECORDER_REQUEST_FIELDS.
+
+    Return:
+        (bytes): The encoded payload.
+    """
+    return FLIGHT_RECORDER_REQUEST_STRUCT.pack(*fields)
+
+
+# Read from the flight recorder characteristic, followed by eventCount Flight_Recorder_Event_t.
+FLIGHT_RECORDER_CHUNK_HEADER_STRUCT = struct.Struct('<HHHHIBBH')
+FLIGHT_RECORDER_CHUNK_HEADER_LENGTH_BYTES = 16
+FLIGHT_RECORDER_CHUNK_HEADER_FIELDS = ('chunkIndex', 'chunkCount', 'eventCount', 'cpuFreqMhz', 'totalEvents', 'frozen', 'freezeReason', 'reserved',)
+
+
+def decodeFlightRecorderChunkHeader(data, offset=0):
+    """
+    Decodes a Flight_Recorder_Chunk_Header payload in place, without copying.
+
+    Params:
+        data (bytes-like): Received payload (bytes, bytearray or memoryview).
+        offset (int): Offset of the payload in data.
+
+    Return:
+        (Tuple): The decoded fields, in the order of FLIGHT_RECORDER_CHUNK_HEADER_FIELDS.
+    """
+    return FLIGHT_RECORDER_CHUNK_HEADER_STRUCT.unpack_from(data, offset)
+
+
+def encodeFlightRecorderChunkHeader(*fields):
+    """
+    Encodes a Flight_Recorder_Chunk_Header payload, as packed by the firmware.
+
+    Params:
+        fields: Field values, in the order of FLIGHT_RECORDER_CHUNK_HEADER_FIELDS.
+
+    Return:
+        (bytes): The encoded payload.
+    """
+    return FLIGHT_RECORDER_CHUNK_HEADER_STRUCT.pack(*fields)
+
+
+# One flight recorder event.
+FLIGHT_RECORDER_EVENT_STRUCT = struct.Struct('<IBBH')
+FLIGHT_RECORDER_EVENT_LENGTH_BYTES = 8
+FLIGHT_RECORDER_EVENT_FIELDS = ('cycles', 'type', 'arg', 'value',)
+
+
+def decodeFlightRecorderEvent(data, offset=0):
+    """
+    Decodes a Flight_Recorder_Event payload in place, without copying.
+
+    Params:
+        data (bytes-like): Received payload (bytes, bytearray or memoryview).
+        offset (int): Offset of the payload in data.
+
+    Return:
+        (Tuple): The decoded fields, in the order of FLIGHT_RECORDER_EVENT_FIELDS.
+    """
+    return FLIGHT_RECORDER_EVENT_STRUCT.unpack_from(data, offset)
+
+
+def encodeFlightRecorderEvent(*fields):
+    """
+    Encodes a Flight_Recorder_Event payload, as packed by the firmware.
+
+    Params:
+        fields: Field values, in the order of FLIGHT_RECORDER_EVENT_FIELDS.
+
+    Return:
+        (bytes): The encoded payload.
+    """
+    return FLIGHT_RECORDER_EVENT_STRUCT.pack(*fields)
+
+
+# Gesture detected on the device. A notification carries one or more events.
+GESTURE_EVENT_STRUCT = struct.Struct('<BBHI')
+GESTURE_EVENT_LENGTH_BYTES = 8
+GESTURE_EVENT_FIELDS = ('type', 'controller', 'magnitude', 'timestampUs',)
+
+
+def decodeGestureEvent(data, offset=0):
+    """
+    Decodes a Gesture_Event payload in place, without copying.
+
+    Params:
+        data (bytes-like): Received payload (bytes, bytearray or memoryview).
+        offset (int): Offset of the payload in data.
+
+    Return:
+        (Tuple): The decoded fields, in the order of GESTURE_EVENT_FIELDS.
+    """
+    return GESTURE_EVENT_STRUCT.unpack_from(data, offset)
+
+
+def encodeGestureEvent(*fields):
+    """
+    Encodes a Gesture_Event payload, as packed by the firmware.
+
+    Params:
+        fields: Field values, in the order of GESTURE_EVENT_FIELDS.
+
+    Return:
+        (bytes): The encoded payload.
+    """
+    return GESTURE_EVENT_STRUCT.pack(*fields)
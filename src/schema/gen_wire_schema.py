@@ -0,0 +1,252 @@
+"""
+File: gen_wire_schema.py
+Description: Generates the C++ payload structs and the Python decoders from
+             wire_schema.json, so the firmware and the host share a single
+             definition of every BLE payload. Run after editing the schema:
+
+                 python src/schema/gen_wire_schema.py
+
+             Use --check to verify the generated files are up to date.
+Author: Humza Ali
+"""
+
+import argparse
+import json
+import os
+import struct
+import sys
+
+SCHEMA_DIR = os.path.dirname(os.path.abspath(__file__))
+SRC_DIR = os.path.dirname(SCHEMA_DIR)
+SCHEMA_FILE = os.path.join(SCHEMA_DIR, 'wire_schema.json')
+CPP_OUTPUT_FILE = os.path.join(SRC_DIR, 'include', 'wire_schema.h')
+PYTHON_OUTPUT_FILE = os.path.join(SRC_DIR, 'python', 'wire_schema.py')
+
+# Schema type: (C++ type, struct format character)
+FIELD_TYPES = {
+    'u8':  ('uint8_t',  'B'),
+    'i8':  ('int8_t',   'b'),
+    'u16': ('uint16_t', 'H'),
+    'i16': ('int16_t',  'h'),
+    'u32': ('uint32_t', 'I'),
+    'i32': ('int32_t',  'i'),
+    'f32': ('float',    'f'),
+}
+
+
+def structFormat(message):
+    """
+    Returns the little endian struct format of a message.
+
+    Params:
+        message (dict): Message from the schema.
+    """
+    return '<' + ''.join(FIELD_TYPES[f['type']][1] for f in message['fields'])
+
+
+def camelCase(name):
+    """ Converts a schema message name (Foo_Bar_Baz) to FooBarBaz. """
+    return ''.join(part[:1].upper() + part[1:] for part in name.split('_'))
+
+
+def enumConstant(enum, value):
+    """ Returns the name of an enum constant, e.g. FLIGHT_EVENT_BOOT. """
+    return f"{enum['prefix']}_{value['name']}"
+
+
+def generateCpp(schema):
+    """
+    Generates the C++ header containing the UUIDs and packed payload structs.
+
+    Params:
+        schema (dict): Parsed wire schema.
+    """
+    lines = [
+        '/**',
+        ' * @file wire_schema.h',
+        ' * @brief BLE payload definitions shared with the host.',
+        ' * @author Humza Ali',
+        ' *',
+        ' * @note Generated from src/schema/wire_schema.json by',
+        ' *       src/schema/gen_wire_schema.py. Do not edit by hand.',
+        ' */',
+        '',
+        '#pragma once',
+        '',
+        '#include <stdint.h>',
+        '',
+        '/** Version of the wire schema. */',
+        f"#define WIRE_SCHEMA_VERSION {schema['version']}U",
+        '',
+        '/** BLE Service UUID */',
+        f"#define {schema['service']['name']}_UUID \"{schema['service']['uuid']}\"",
+        '',
+    ]
+    emittedUuids = set()
+    for message in schema['messages']:
+        macro = f"{message['characteristic']}_CHARACTERISTIC_UUID"
+        if macro in emittedUuids:
+            continue
+        emittedUuids.add(macro)
+        lines.append(f"/** {message['characteristic'].replace('_', ' ').title()} Characteristic UUID */")
+        lines.append(f"#define {macro} \"{message['uuid']}\"")
+    lines.append('')
+
+    for enum in schema.get('enums', []):
+        lines.append('/**')
+        lines.append(f" * @enum {enum['name']}_t")
+        lines.append(f" * @brief {enum['description']}")
+        lines.append(' */')
+        lines.append('typedef enum {')
+        nameWidth = max(len(enumConstant(enum, v)) for v in enum['values'])
+        valueWidth = max(len(str(v['value'])) for v in enum['values']) + 1
+        for value in enum['values']:
+            constant = enumConstant(enum, value).ljust(nameWidth)
+            number = (str(value['value']) + ',').ljust(valueWidth)
+            lines.append(f"    {constant} = {number} /** {value['description']} */")
+        lines.append(f"}} {enum['name']}_t;")
+        lines.append('')
+
+    for message in schema['messages']:
+        typeName = f"{message['name']}_t"
+        size = struct.calcsize(structFormat(message))
+        lines.append('/**')
+        lines.append(f' * @struct {typeName}')
+        lines.append(f" * @brief {message['description']}")
+        lines.append(' */')
+        lines.append('typedef struct __attribute__((packed)) {')
+        typeWidth = max(len(FIELD_TYPES[f['type']][0]) for f in message['fields'])
+        nameWidth = max(len(f['name']) for f in message['fields']) + 1
+        for field in message['fields']:
+            cppType = FIELD_TYPES[field['type']][0].ljust(typeWidth)
+            cppName = (field['name'] + ';').ljust(nameWidth)
+            lines.append(f"    {cppType} {cppName} /** {field['description']} */")
+        lines.append(f'}} {typeName};')
+        lines.append(f'static_assert(sizeof({typeName}) == {size}U,')
+        lines.append(f'              "{typeName} does not match the wire schema");')
+        lines.append('')
+    return '\n'.join(lines)
+
+
+def generatePython(schema):
+    """
+    Generates the Python module containing the UUIDs and decoders.
+
+    Params:
+        schema (dict): Parsed wire schema.
+    """
+    lines = [
+        '"""',
+        'File: wire_schema.py',
+        'Description: BLE payload definitions shared with the firmware.',
+        '             Generated from src/schema/wire_schema.json by',
+        '             src/schema/gen_wire_schema.py. Do not edit by hand.',
+        'Author: Humza Ali',
+        '"""',
+        '',
+        'import struct',
+        '',
+        '# Version of the wire schema',
+        f"WIRE_SCHEMA_VERSION = {schema['version']}",
+        '',
+        '# BLE Service UUID',
+        f"{schema['service']['name']}_UUID = '{schema['service']['uuid']}'",
+        '# Characteristic UUIDs',
+    ]
+    emittedUuids = set()
+    for message in schema['messages']:
+        macro = f"{message['characteristic']}_CHARACTERISTIC_UUID"
+        if macro in emittedUuids:
+            continue
+        emittedUuids.add(macro)
+        lines.append(f"{macro} = '{message['uuid']}'")
+
+    for enum in schema.get('enums', []):
+        namesDict = f"{enum['name'].upper()}_NAMES"
+        lines += ['', '', f"# {enum['description']}"]
+        for value in enum['values']:
+            lines.append(f"{enumConstant(enum, value)} = {value['value']}")
+        lines.append(f"{namesDict} = {{")
+        for value in enum['values']:
+            lines.append(f"    {value['value']}: '{value['name']}',")
+        lines.append('}')
+
+    for message in schema['messages']:
+        prefix = message['name'].upper()
+        fmt = structFormat(message)
+        fieldNames = ', '.join(f"'{f['name']}'" for f in message['fields'])
+        name = camelCase(message['name'])
+        lines += [
+            '',
+            '',
+            f"# {message['description']}",
+            f"{prefix}_STRUCT = struct.Struct('{fmt}')",
+            f"{prefix}_LENGTH_BYTES = {struct.calcsize(fmt)}",
+            f"{prefix}_FIELDS = ({fieldNames},)",
+            '',
+            '',
+            f'def decode{name}(data, offset=0):',
+            '    """',
+            f"    Decodes a {message['name']} payload in place, without copying.",
+            '',
+            '    Params:',
+            '        data (bytes-like): Received payload (bytes, bytearray or memoryview).',
+            '        offset (int): Offset of the payload in data.',
+            '',
+            '    Return:',
+            f"        (Tuple): The decoded fields, in the order of {prefix}_FIELDS.",
+            '    """',
+            f'    return {prefix}_STRUCT.unpack_from(data, offset)',
+            '',
+            '',
+            f'def encode{name}(*fields):',
+            '    """',
+            f"    Encodes a {message['name']} payload, as packed by the firmware.",
+            '',
+            '    Params:',
+            f"        fields: Field values, in the order of {prefix}_FIELDS.",
+            '',
+            '    Return:',
+            '        (bytes): The encoded payload.',
+            '    """',
+            f'    return {prefix}_STRUCT.pack(*fields)',
+        ]
+    lines.append('')
+    return '\n'.join(lines)
+
+
+def main():
+    """ Main function handler. """
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[2])
+    parser.add_argument('--check', action='store_true',
+                        help='fail if the generated files are out of date')
+    args = parser.parse_args()
+
+    with open(SCHEMA_FILE, 'r') as f:
+        schema = json.load(f)
+    outputs = {
+        CPP_OUTPUT_FILE: generateCpp(schema) + '\n',
+        PYTHON_OUTPUT_FILE: generatePython(schema),
+    }
+
+    stale = False
+    for path, content in outputs.items():
+        try:
+            with open(path, 'r') as f:
+                current = f.read()
+        except OSError:
+            current = None
+        if current == content:
+            continue
+        if args.check:
+            print(f"{os.path.relpath(path, SRC_DIR)} is out of date")
+            stale = True
+        else:
+            with open(path, 'w', newline='\n') as f:
+                f.write(content)
+            print(f"Generated {os.path.relpath(path, SRC_DIR)}")
+    return 1 if stale else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
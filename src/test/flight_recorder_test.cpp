@@ -0,0 +1,208 @@
+/**
+ * @file flight_recorder_test.cpp
+ * @brief Checks the flight recorder ring, its freeze and its download chunks.
+ * @author Humza Ali
+ *
+ * Built and run through run_tests.py, or by hand from the repository root:
+ *
+ *     g++ -O2 -std=gnu++11 -Isrc/benchmark/host -Isrc/include \
+ *         src/test/flight_recorder_test.cpp src/Flight_Recorder.cpp \
+ *         src/BLE.cpp src/HID_Gamepad.cpp src/benchmark/host/Arduino.cpp \
+ *         src/benchmark/host/BLEDevice.cpp -o flight_recorder_test
+ *     ./flight_recorder_test
+ *
+ * Chunks are downloaded the way flight_recorder.py does it: a request is
+ * written to the flight recorder characteristic and the chunk is read back
+ * from its value.
+ */
+
+#include <vector>
+
+#include "host_test.h"
+#include "Flight_Recorder.h"
+#include "BLE.h"
+
+/**
+ * @struct Downloaded_Chunk_t
+ * @brief Decoded chunk read from the flight recorder characteristic.
+ */
+typedef struct {
+    Flight_Recorder_Chunk_Header_t header;       /** Chunk header. */
+    std::vector<Flight_Recorder_Event_t> events; /** Events of the chunk, oldest first. */
+} Downloaded_Chunk_t;
+
+/** @brief Returns the flight recorder characteristic created on the server. */
+static BLECharacteristic* findCharacteristic(void)
+{
+    const BLEUUID uuid(FLIGHT_RECORDER_CHARACTERISTIC_UUID);
+    for (BLEService* pService : BLEDevice::hostGetServer()->services) {
+        for (BLECharacteristic* pCharacteristic : pService->characteristics) {
+            if (pCharacteristic->getUUID().equals(uuid)) {
+                return pCharacteristic;
+            }
+        }
+    }
+    return nullptr;
+}
+
+/** @brief Writes a request to the flight recorder characteristic. */
+static void writeRequest(BLECharacteristic* pCharacteristic, uint8_t command, uint16_t chunkIndex)
+{
+    Flight_Recorder_Request_t request = { command, 0U, chunkIndex };
+    pCharacteristic->hostWrite((const uint8_t*)&request, sizeof(request));
+}
+
+/** @brief Requests and reads one chunk. */
+static Downloaded_Chunk_t readChunk(BLECharacteristic* pCharacteristic, uint16_t chunkIndex)
+{
+    writeRequest(pCharacteristic, FLIGHT_RECORDER_COMMAND_READ_CHUNK, chunkIndex);
+    Downloaded_Chunk_t chunk;
+    memset(&chunk.header, 0, sizeof(chunk.header));
+    CHECK(pCharacteristic->getLength() >= sizeof(chunk.header));
+    if (pCharacteristic->getLength() < sizeof(chunk.header)) {
+        return chunk;
+    }
+    memcpy(&chunk.header, pCharacteristic->getData(), sizeof(chunk.header));
+    CHECK_EQUAL(sizeof(chunk.header) + (chunk.header.eventCount * sizeof(Flight_Recorder_Event_t)),
+                pCharacteristic->getLength());
+    chunk.events.resize(chunk.header.eventCount);
+    memcpy(chunk.events.data(), pCharacteristic->getData() + sizeof(chunk.header),
+           chunk.header.eventCount * sizeof(Flight_Recorder_Event_t));
+    return chunk;
+}
+
+/** @brief Downloads every chunk and returns the events, oldest first. */
+static std::vector<Flight_Recorder_Event_t> download(BLECharacteristic* pCharacteristic,
+                                                     Flight_Recorder_Chunk_Header_t& lastHeader)
+{
+    std::vector<Flight_Recorder_Event_t> events;
+    uint16_t chunkCount = 1U;
+    for (uint16_t chunkIndex = 0U; chunkIndex < chunkCount; chunkIndex++) {
+        Downloaded_Chunk_t chunk = readChunk(pCharacteristic, chunkIndex);
+        CHECK_EQUAL(chunkIndex, chunk.header.chunkIndex);
+        CHECK_EQUAL(1U, chunk.header.frozen);
+        if (chunkIndex > 0U) {
+            // The ring doesn't move while it is read
+            CHECK_EQUAL(chunkCount, chunk.header.chunkCount);
+            CHECK_EQUAL(lastHeader.totalEvents, chunk.header.totalEvents);
+        }
+        chunkCount = chunk.header.chunkCount;
+        lastHeader = chunk.header;
+        events.insert(events.end(), chunk.events.begin(), chunk.events.end());
+    }
+    return events;
+}
+
+int main(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    BLE ble("Wii Remote");
+    FlightRecorder recorder;
+
+    // Frozen until initialized, so nothing reads an unallocated ring
+    CHECK(recorder.isFrozen());
+    recorder.record(FLIGHT_EVENT_CONNECT);
+    CHECK_EQUAL(STATUS_NULL_POINTER, recorder.initFlightRecorder(nullptr));
+    ble.initBle();
+    CHECK_EQUAL(STATUS_COMPLETE, recorder.initFlightRecorder(&ble));
+    CHECK(!recorder.isFrozen());
+    BLECharacteristic* pCharacteristic = findCharacteristic();
+    CHECK(pCharacteristic != nullptr);
+    if (pCharacteristic == nullptr) {
+        return testResult("flight_recorder_test");
+    }
+
+    // Events without a trigger only fill the ring, which keeps the newest
+    const uint32_t recordedEvents = FLIGHT_RECORDER_EVENT_COUNT + 100U;
+    for (uint32_t i = 1U; i < recordedEvents; i++) {
+        hostAdvanceUs(100U);
+        recorder.record(FLIGHT_EVENT_SUBSCRIBE, (uint8_t)i, (uint16_t)i);
+    }
+    CHECK(!recorder.isFrozen());
+
+    // A trigger records the lead-up and a few events after it
+    recorder.record(FLIGHT_EVENT_LOOP_OVERRUN, 0U, 75U);
+    for (uint32_t i = 0U; i < FLIGHT_RECORDER_POST_TRIGGER_EVENTS; i++) {
+        CHECK(!recorder.isFrozen());
+        recorder.record(FLIGHT_EVENT_CONNECT, 0U, (uint16_t)i);
+    }
+    CHECK(recorder.isFrozen());
+    recorder.record(FLIGHT_EVENT_DISCONNECT);
+
+    Flight_Recorder_Chunk_Header_t header;
+    std::vector<Flight_Recorder_Event_t> events = download(pCharacteristic, header);
+    const uint32_t totalEvents = recordedEvents + 1U + FLIGHT_RECORDER_POST_TRIGGER_EVENTS;
+    CHECK_EQUAL(totalEvents, header.totalEvents);
+    CHECK_EQUAL(FLIGHT_EVENT_LOOP_OVERRUN, header.freezeReason);
+    CHECK_EQUAL((FLIGHT_RECORDER_EVENT_COUNT + FLIGHT_RECORDER_CHUNK_EVENTS - 1U) /
+                FLIGHT_RECORDER_CHUNK_EVENTS, header.chunkCount);
+    CHECK_EQUAL(FLIGHT_RECORDER_EVENT_COUNT, events.size());
+    CHECK_EQUAL(FLIGHT_EVENT_CONNECT, events.back().type);
+    CHECK_EQUAL(FLIGHT_RECORDER_POST_TRIGGER_EVENTS - 1U, events.back().value);
+    const Flight_Recorder_Event_t& overrun =
+        events[FLIGHT_RECORDER_EVENT_COUNT - FLIGHT_RECORDER_POST_TRIGGER_EVENTS - 1U];
+    CHECK_EQUAL(FLIGHT_EVENT_LOOP_OVERRUN, overrun.type);
+    CHECK_EQUAL(75U, overrun.value);
+    // The oldest kept event is the first one the ring didn't overwrite
+    const uint32_t oldestIndex = totalEvents - FLIGHT_RECORDER_EVENT_COUNT;
+    CHECK_EQUAL(FLIGHT_EVENT_SUBSCRIBE, events.front().type);
+    CHECK_EQUAL(oldestIndex, events.front().value);
+    for (size_t i = 1U; i < events.size(); i++) {
+        CHECK(events[i].cycles >= events[i - 1U].cycles);
+    }
+
+    // Chunks past the end are empty, and still report the recording
+    Downloaded_Chunk_t pastEnd = readChunk(pCharacteristic, header.chunkCount);
+    CHECK_EQUAL(0U, pastEnd.header.eventCount);
+    CHECK_EQUAL(header.chunkCount, pastEnd.header.chunkCount);
+
+    // Resuming clears the ring and starts over with a boot event
+    writeRequest(pCharacteristic, FLIGHT_RECORDER_COMMAND_RESUME, 0U);
+    CHECK(!recorder.isFrozen());
+    recorder.record(FLIGHT_EVENT_QUEUE_SATURATED, 2U);
+    // Freezing by hand keeps everything recorded so far
+    writeRequest(pCharacteristic, FLIGHT_RECORDER_COMMAND_FREEZE, 0U);
+    CHECK(recorder.isFrozen());
+    recorder.record(FLIGHT_EVENT_DISCONNECT);
+    events = download(pCharacteristic, header);
+    CHECK_EQUAL(FLIGHT_EVENT_FREEZE, header.freezeReason);
+    CHECK_EQUAL(3U, events.size());
+    if (events.size() == 3U) {
+        CHECK_EQUAL(FLIGHT_EVENT_BOOT, events[0].type);
+        CHECK_EQUAL(FLIGHT_EVENT_QUEUE_SATURATED, events[1].type);
+        CHECK_EQUAL(2U, events[1].arg);
+        CHECK_EQUAL(FLIGHT_EVENT_FREEZE, events[2].type);
+    }
+
+    // Frequency changes are recorded, and the header reports the frequency
+    // of the newest event rather than the one at download time
+    writeRequest(pCharacteristic, FLIGHT_RECORDER_COMMAND_RESUME, 0U);
+    hostAdvanceUs(1000U);
+    recorder.record(FLIGHT_EVENT_CONNECT);
+    setCpuFrequencyMhz(80U);
+    recorder.recordCpuFrequency(240U, 80U);
+    hostAdvanceUs(3000U);
+    recorder.record(FLIGHT_EVENT_SUBSCRIBE);
+    writeRequest(pCharacteristic, FLIGHT_RECORDER_COMMAND_FREEZE, 0U);
+    setCpuFrequencyMhz(160U);
+    recorder.recordCpuFrequency(80U, 160U);
+    events = download(pCharacteristic, header);
+    CHECK_EQUAL(80U, header.cpuFreqMhz);
+    CHECK_EQUAL(5U, events.size());
+    if (events.size() == 5U) {
+        CHECK_EQUAL(FLIGHT_EVENT_CPU_FREQ, events[2].type);
+        CHECK_EQUAL(240U, events[2].arg);
+        CHECK_EQUAL(80U, events[2].value);
+        CHECK_EQUAL(1000U * 240U, events[1].cycles - events[0].cycles);
+        CHECK_EQUAL(3000U * 80U, events[3].cycles - events[2].cycles);
+    }
+    setCpuFrequencyMhz(240U);
+
+    // Short requests are ignored
+    const uint8_t shortRequest = FLIGHT_RECORDER_COMMAND_RESUME;
+    pCharacteristic->hostWrite(&shortRequest, sizeof(shortRequest));
+    CHECK(recorder.isFrozen());
+
+    return testResult("flight_recorder_test");
+}
@@ -0,0 +1,132 @@
+/**
+ * @file gesture_detector_test.cpp
+ * @brief Replays a labeled gesture trace through the GestureDetector.
+ * @author Humza Ali
+ *
+ * Built and run through run_tests.py, or by hand from the repository root:
+ *
+ *     g++ -O2 -std=gnu++11 -Isrc/include src/test/gesture_detector_test.cpp \
+ *         src/Gesture_Detector.cpp -o gesture_detector_test
+ *     ./gesture_detector_test src/test/traces
+ *
+ * gestures.csv comes from the rigid body and sensor model in
+ * traces/generate_traces.py, sampled at the Wii Remote accelerometer range.
+ * Every label must be detected within a window after it, with nothing
+ * detected in between, and every event must be stamped close to the label:
+ * a swing peak with its peak sample and a shake with its first stroke, not
+ * with the sample that confirmed them.
+ */
+
+#include <string>
+#include <vector>
+
+#include "host_test.h"
+#include "Gesture_Detector.h"
+
+/** Time after a label within which a detection of the same type matches it, in us. */
+#define MATCH_WINDOW_US 500000U
+
+/** Largest allowed difference between an event timestamp and its label, in us, by type. */
+static const uint32_t maxStampErrorUs[] = {
+    100000U, /** SWING_START: the rate crosses the threshold after the onset. */
+    20000U,  /** SWING_PEAK: the peak sample, give or take the sensor filter. */
+    60000U,  /** SHAKE: the first stroke crossing the threshold. */
+    30000U,  /** FLICK: the spike crossing the threshold. */
+};
+
+/**
+ * @struct Gesture_Label_t
+ * @brief Labeled gesture of the trace.
+ */
+typedef struct {
+    uint32_t timestampUs; /** Time of the labeled sample, in us. */
+    Gesture_Type_t type;  /** Labeled gesture. */
+    bool matched;         /** Set once a detection matched the label. */
+} Gesture_Label_t;
+
+/** @brief Returns the gesture type of a label, false if it isn't one. */
+static bool labelType(const std::string& label, Gesture_Type_t& type)
+{
+    static const char* names[] = { "SWING_START", "SWING_PEAK", "SHAKE", "FLICK" };
+    for (uint8_t i = 0U; i < 4U; i++) {
+        if (label == names[i]) {
+            type = (Gesture_Type_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    const std::string traceDir = (argc > 1) ? argv[1] : "src/test/traces";
+    const std::vector<Trace_Sample_t> samples = readTrace(traceDir + "/gestures.csv");
+    CHECK(!samples.empty());
+
+    std::vector<Gesture_Label_t> labels;
+    for (const Trace_Sample_t& sample : samples) {
+        Gesture_Type_t type;
+        if (labelType(sample.label, type)) {
+            labels.push_back({ sample.timestampUs, type, false });
+        }
+    }
+    CHECK(labels.size() >= 40U);
+
+    const Gesture_Detector_Config_t config = GESTURE_DETECTOR_DEFAULT_CONFIG;
+    GestureDetector detector(config, 0U);
+    uint32_t detections[4] = { 0U, 0U, 0U, 0U };
+    uint32_t worstStampErrorUs[4] = { 0U, 0U, 0U, 0U };
+    uint32_t falsePositives = 0U;
+    for (const Trace_Sample_t& sample : samples) {
+        Gesture_Event_t events[GESTURE_MAX_EVENTS_PER_SAMPLE];
+        const uint8_t eventCount = detector.update(sample.accel[0], sample.accel[1], sample.accel[2],
+                                                   sample.gyro[0], sample.gyro[1], sample.gyro[2],
+                                                   sample.timestampUs, events);
+        for (uint8_t i = 0U; i < eventCount; i++) {
+            const Gesture_Type_t type = (Gesture_Type_t)events[i].type;
+            CHECK_EQUAL(0U, events[i].controller);
+            // Never stamped after the sample it was reported on
+            CHECK(events[i].timestampUs <= sample.timestampUs);
+            Gesture_Label_t* pMatch = nullptr;
+            for (Gesture_Label_t& label : labels) {
+                if (!label.matched && (label.type == type) &&
+                    (label.timestampUs <= sample.timestampUs) &&
+                    (sample.timestampUs <= label.timestampUs + MATCH_WINDOW_US)) {
+                    pMatch = &label;
+                    break;
+                }
+            }
+            if (pMatch == nullptr) {
+                printf("Unlabeled %u event at %u us\n", (unsigned)type, (unsigned)sample.timestampUs);
+                falsePositives++;
+                continue;
+            }
+            pMatch->matched = true;
+            detections[type]++;
+            const int32_t errorUs = (int32_t)(events[i].timestampUs - pMatch->timestampUs);
+            const uint32_t absErrorUs = (uint32_t)((errorUs < 0) ? -errorUs : errorUs);
+            if (absErrorUs > worstStampErrorUs[type]) {
+                worstStampErrorUs[type] = absErrorUs;
+            }
+        }
+    }
+
+    uint32_t labelCounts[4] = { 0U, 0U, 0U, 0U };
+    for (const Gesture_Label_t& label : labels) {
+        labelCounts[label.type]++;
+        if (!label.matched) {
+            printf("Missed %u labeled at %u us\n", (unsigned)label.type, (unsigned)label.timestampUs);
+        }
+    }
+    for (uint8_t type = 0U; type < 4U; type++) {
+        CHECK(labelCounts[type] > 0U);
+        CHECK_EQUAL(labelCounts[type], detections[type]);
+        CHECK(worstStampErrorUs[type] <= maxStampErrorUs[type]);
+        printf("gestures.csv: type %u, %u/%u detected, timestamp off by up to %.1f ms\n",
+               (unsigned)type, (unsigned)detections[type], (unsigned)labelCounts[type],
+               worstStampErrorUs[type] / 1000.0);
+    }
+    CHECK_EQUAL(0U, falsePositives);
+
+    return testResult("gesture_detector_test");
+}
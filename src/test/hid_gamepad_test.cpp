@@ -0,0 +1,355 @@
+/**
+ * @file hid_gamepad_test.cpp
+ * @brief Checks the HID gamepad report against its report descriptor.
+ * @author Humza Ali
+ *
+ * Built and run through run_tests.py, or by hand from the repository root:
+ *
+ *     g++ -O2 -std=gnu++11 -Isrc/benchmark/host -Isrc/include \
+ *         src/test/hid_gamepad_test.cpp src/HID_Gamepad.cpp -o hid_gamepad_test
+ *     ./hid_gamepad_test
+ *
+ * The descriptor is parsed the way a host HID driver does, and every field
+ * is read back from the encoded report at the bit offset the descriptor
+ * gives it. So a report that packs a button or an axis anywhere the host
+ * doesn't expect it fails here, not in a game.
+ */
+
+#include <string.h>
+#include <vector>
+
+#include "host_test.h"
+#include "Controller_Inputs.h"
+#include "HID_Gamepad.h"
+
+/** Usage pages used by the descriptor. */
+#define HID_USAGE_PAGE_GENERIC_DESKTOP 0x01U
+#define HID_USAGE_PAGE_BUTTON          0x09U
+/** Generic desktop usages used by the descriptor. */
+#define HID_USAGE_X    0x30U
+#define HID_USAGE_Y    0x31U
+#define HID_USAGE_VX   0x40U
+#define HID_USAGE_VBRX 0x43U
+
+/**
+ * @struct Hid_Field_t
+ * @brief One input field of the report, as described by the descriptor.
+ */
+typedef struct {
+    uint16_t usagePage;   /** Usage page of the field. */
+    uint16_t usage;       /** Usage of the field, 0 for padding. */
+    uint32_t bitOffset;   /** Offset of the field in the report, in bits. */
+    uint32_t bitSize;     /** Size of the field, in bits. */
+    int32_t logicalMin;   /** Logical minimum of the field. */
+    int32_t logicalMax;   /** Logical maximum of the field. */
+} Hid_Field_t;
+
+/** @brief Returns the value of a short item, sign extended if asked. */
+static int32_t itemValue(const uint8_t* pData, uint8_t size, bool isSigned)
+{
+    uint32_t value = 0U;
+    for (uint8_t i = 0U; i < size; i++) {
+        value |= (uint32_t)pData[i] << (8U * i);
+    }
+    if (isSigned && (size > 0U) && (size < 4U) && (value & (1U << ((8U * size) - 1U)))) {
+        value |= ~((1U << (8U * size)) - 1U);
+    }
+    return (int32_t)value;
+}
+
+/**
+ * @brief Parses the input fields of a report out of a report descriptor.
+ *
+ * @param[in] reportId Report to parse the fields of.
+ * @param[out] reportBits Total size of the report, in bits, not counting
+ *                        the report ID.
+ */
+static std::vector<Hid_Field_t> parseDescriptor(uint8_t reportId, uint32_t& reportBits)
+{
+    std::vector<Hid_Field_t> fields;
+    uint16_t usagePage = 0U;
+    int32_t logicalMin = 0;
+    int32_t logicalMax = 0;
+    uint32_t reportSize = 0U;
+    uint32_t reportCount = 0U;
+    uint8_t currentReportId = 0U;
+    std::vector<uint16_t> usages;
+    uint16_t usageMin = 0U;
+    uint16_t usageMax = 0U;
+    reportBits = 0U;
+
+    size_t i = 0U;
+    while (i < HID_GAMEPAD_REPORT_DESCRIPTOR_SIZE) {
+        const uint8_t prefix = HID_GAMEPAD_REPORT_DESCRIPTOR[i];
+        const uint8_t size = ((prefix & 0x03U) == 3U) ? 4U : (prefix & 0x03U);
+        const uint8_t tag = prefix & 0xFCU;
+        CHECK((i + 1U + size) <= HID_GAMEPAD_REPORT_DESCRIPTOR_SIZE);
+        const uint8_t* pData = &HID_GAMEPAD_REPORT_DESCRIPTOR[i + 1U];
+        const int32_t value = itemValue(pData, size, false);
+        switch (tag) {
+        case 0x04: usagePage = (uint16_t)value; break;
+        case 0x14: logicalMin = itemValue(pData, size, true); break;
+        case 0x24: logicalMax = itemValue(pData, size, true); break;
+        case 0x74: reportSize = (uint32_t)value; break;
+        case 0x84: currentReportId = (uint8_t)value; break;
+        case 0x94: reportCount = (uint32_t)value; break;
+        case 0x08: usages.push_back((uint16_t)value); break;
+        case 0x18: usageMin = (uint16_t)value; break;
+        case 0x28: usageMax = (uint16_t)value; break;
+        case 0x80: // Input
+            if (currentReportId == reportId) {
+                const bool constant = (value & 0x01) != 0;
+                for (uint32_t n = 0U; n < reportCount; n++) {
+                    Hid_Field_t field;
+                    field.usagePage = usagePage;
+                    if (constant) {
+                        field.usage = 0U;
+                    } else if (!usages.empty()) {
+                        // The last usage repeats for the remaining fields
+                        field.usage = usages[(n < usages.size()) ? n : (usages.size() - 1U)];
+                    } else {
+                        field.usage = (uint16_t)(usageMin + n);
+                        CHECK(field.usage <= usageMax);
+                    }
+                    field.bitOffset = reportBits;
+                    field.bitSize = reportSize;
+                    field.logicalMin = logicalMin;
+                    field.logicalMax = logicalMax;
+                    fields.push_back(field);
+                    reportBits += reportSize;
+                }
+            }
+            // Falls through - main items clear the local items
+        case 0xA0: // Collection
+        case 0xC0: // End Collection
+            usages.clear();
+            usageMin = 0U;
+            usageMax = 0U;
+            break;
+        default:
+            printf("Unexpected item 0x%02x in the report descriptor\n", prefix);
+            testFailures++;
+            break;
+        }
+        i += 1U + size;
+    }
+    return fields;
+}
+
+/** @brief Returns the field with a usage, or nullptr. */
+static const Hid_Field_t* findField(const std::vector<Hid_Field_t>& fields,
+                                    uint16_t usagePage, uint16_t usage)
+{
+    for (const Hid_Field_t& field : fields) {
+        if ((field.usagePage == usagePage) && (field.usage == usage)) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+/** @brief Reads a field out of an encoded report, sign extended if its logical minimum is negative. */
+static int32_t readField(const HID_Gamepad_Report_t& report, const Hid_Field_t& field)
+{
+    const uint8_t* pBytes = (const uint8_t*)&report;
+    uint32_t value = 0U;
+    for (uint32_t bit = 0U; bit < field.bitSize; bit++) {
+        const uint32_t position = field.bitOffset + bit;
+        if (pBytes[position / 8U] & (1U << (position % 8U))) {
+            value |= 1U << bit;
+        }
+    }
+    if ((field.logicalMin < 0) && (field.bitSize < 32U) && (value & (1U << (field.bitSize - 1U)))) {
+        value |= ~((1U << field.bitSize) - 1U);
+    }
+    return (int32_t)value;
+}
+
+/** @brief Encodes a gamepad state and returns the report. */
+static HID_Gamepad_Report_t encode(HidGamepad& gamepad)
+{
+    HID_Gamepad_Report_t report;
+    memset(&report, 0xEE, sizeof(report));
+    gamepad.encodeReport(report);
+    return report;
+}
+
+/**
+ * @brief Checks that the descriptor describes exactly the report struct.
+ */
+static void testDescriptorMatchesReport(const std::vector<Hid_Field_t>& fields, uint32_t reportBits)
+{
+    CHECK_EQUAL(sizeof(HID_Gamepad_Report_t) * 8U, reportBits);
+    // 18 buttons, 6 bits of padding, 2 stick axes and 6 motion axes
+    CHECK_EQUAL(18U + 6U + 2U + 6U, fields.size());
+    for (uint16_t button = 1U; button <= 18U; button++) {
+        const Hid_Field_t* pField = findField(fields, HID_USAGE_PAGE_BUTTON, button);
+        CHECK(pField != nullptr);
+    }
+    for (uint16_t usage = HID_USAGE_X; usage <= HID_USAGE_Y; usage++) {
+        const Hid_Field_t* pField = findField(fields, HID_USAGE_PAGE_GENERIC_DESKTOP, usage);
+        CHECK(pField != nullptr);
+        if (pField != nullptr) {
+            CHECK_EQUAL(8U, pField->bitSize);
+            CHECK_EQUAL(0, pField->logicalMin);
+            CHECK_EQUAL(255, pField->logicalMax);
+        }
+    }
+    for (uint16_t usage = HID_USAGE_VX; usage < (HID_USAGE_VBRX + 3U); usage++) {
+        const Hid_Field_t* pField = findField(fields, HID_USAGE_PAGE_GENERIC_DESKTOP, usage);
+        CHECK(pField != nullptr);
+        if (pField != nullptr) {
+            CHECK_EQUAL(16U, pField->bitSize);
+            CHECK_EQUAL(-HID_GAMEPAD_MOTION_AXIS_MAX, pField->logicalMin);
+            CHECK_EQUAL(HID_GAMEPAD_MOTION_AXIS_MAX, pField->logicalMax);
+        }
+    }
+}
+
+/**
+ * @brief Checks that every button bit lands on its own HID button, and
+ *        only on it.
+ */
+static void testButtons(const std::vector<Hid_Field_t>& fields)
+{
+    // Button n of the report is bit n - 1 of the buttons, then the extra
+    // buttons
+    const uint32_t buttonBits[18] = {
+        DS4_SHARE, DS4_L3, DS4_R3, DS4_OPTIONS, DS4_UP, DS4_RIGHT, DS4_DOWN, DS4_LEFT,
+        DS4_L2, DS4_R2, DS4_L1, DS4_R1, DS4_TRIANGLE, DS4_CIRCLE, DS4_CROSS, DS4_SQUARE,
+        DS4_HOME, DS4_PAD_CLICK,
+    };
+    for (uint16_t pressed = 1U; pressed <= 18U; pressed++) {
+        HidGamepad gamepad;
+        if (pressed <= 16U) {
+            gamepad.setButtons((uint16_t)buttonBits[pressed - 1U]);
+        } else {
+            gamepad.setExtraButtons((uint8_t)buttonBits[pressed - 1U]);
+        }
+        const HID_Gamepad_Report_t report = encode(gamepad);
+        for (uint16_t button = 1U; button <= 18U; button++) {
+            const Hid_Field_t* pField = findField(fields, HID_USAGE_PAGE_BUTTON, button);
+            if (pField != nullptr) {
+                CHECK_EQUAL((button == pressed) ? 1 : 0, readField(report, *pField));
+            }
+        }
+        // Padding stays clear
+        for (const Hid_Field_t& field : fields) {
+            if (field.usage == 0U) {
+                CHECK_EQUAL(0, readField(report, field));
+            }
+        }
+    }
+
+    // Every button at once, and bits outside the report are dropped
+    HidGamepad gamepad;
+    gamepad.setButtons(0xFFFFU);
+    gamepad.setExtraButtons(0xFFU);
+    const HID_Gamepad_Report_t report = encode(gamepad);
+    for (const Hid_Field_t& field : fields) {
+        const bool isButton = (field.usagePage == HID_USAGE_PAGE_BUTTON) && (field.usage != 0U);
+        CHECK_EQUAL(isButton ? 1 : 0, readField(report, field));
+    }
+
+    // The Wii Remote button payload carries the same bits
+    const Wiimote_Button_Input_t payload = packWiimoteButtonInput(0xA55AU);
+    CHECK_EQUAL(0x5AU, payload.buttons1);
+    CHECK_EQUAL(0xA5U, payload.buttons2);
+    CHECK_EQUAL(0U, payload.reserved);
+}
+
+/**
+ * @brief Checks the scaling of the motion axes and the joystick.
+ */
+static void testAxes(const std::vector<Hid_Field_t>& fields)
+{
+    // Full range maps to the logical maximum, rounded to the nearest step
+    // and saturated past it
+    CHECK_EQUAL(0, HidGamepad::scaleMotionAxis(0.0f, HID_GAMEPAD_ACCEL_RANGE_G));
+    CHECK_EQUAL(8192, HidGamepad::scaleMotionAxis(1.0f, HID_GAMEPAD_ACCEL_RANGE_G));
+    CHECK_EQUAL(-8192, HidGamepad::scaleMotionAxis(-1.0f, HID_GAMEPAD_ACCEL_RANGE_G));
+    CHECK_EQUAL(HID_GAMEPAD_MOTION_AXIS_MAX,
+                HidGamepad::scaleMotionAxis(HID_GAMEPAD_ACCEL_RANGE_G, HID_GAMEPAD_ACCEL_RANGE_G));
+    CHECK_EQUAL(HID_GAMEPAD_MOTION_AXIS_MAX,
+                HidGamepad::scaleMotionAxis(100.0f, HID_GAMEPAD_ACCEL_RANGE_G));
+    CHECK_EQUAL(-HID_GAMEPAD_MOTION_AXIS_MAX,
+                HidGamepad::scaleMotionAxis(-100.0f, HID_GAMEPAD_ACCEL_RANGE_G));
+    CHECK_EQUAL(16384, HidGamepad::scaleMotionAxis(1000.0f, HID_GAMEPAD_GYRO_RANGE_DPS));
+    CHECK_EQUAL(-HID_GAMEPAD_MOTION_AXIS_MAX,
+                HidGamepad::scaleMotionAxis(-5000.0f, HID_GAMEPAD_GYRO_RANGE_DPS));
+    // One LSB of the axis is range / 32767
+    const float accelStep = HID_GAMEPAD_ACCEL_RANGE_G / (float)HID_GAMEPAD_MOTION_AXIS_MAX;
+    CHECK_EQUAL(1, HidGamepad::scaleMotionAxis(0.6f * accelStep, HID_GAMEPAD_ACCEL_RANGE_G));
+    CHECK_EQUAL(0, HidGamepad::scaleMotionAxis(0.4f * accelStep, HID_GAMEPAD_ACCEL_RANGE_G));
+    CHECK_EQUAL(-1, HidGamepad::scaleMotionAxis(-0.6f * accelStep, HID_GAMEPAD_ACCEL_RANGE_G));
+
+    // Each motion axis lands on its own usage
+    const float motion[6] = { 0.5f, -1.0f, 2.0f, 250.0f, -500.0f, 1500.0f };
+    HidGamepad gamepad;
+    gamepad.setMotion(motion[0], motion[1], motion[2], motion[3], motion[4], motion[5]);
+    gamepad.setJoystick(scaleJoystickAxis(0x0FFFU), scaleJoystickAxis(0x0800U));
+    const HID_Gamepad_Report_t report = encode(gamepad);
+    for (uint8_t axis = 0U; axis < 6U; axis++) {
+        const Hid_Field_t* pField = findField(fields, HID_USAGE_PAGE_GENERIC_DESKTOP,
+                                              (uint16_t)(HID_USAGE_VX + axis));
+        if (pField == nullptr) {
+            continue;
+        }
+        const float range = (axis < 3U) ? HID_GAMEPAD_ACCEL_RANGE_G : HID_GAMEPAD_GYRO_RANGE_DPS;
+        CHECK_EQUAL(HidGamepad::scaleMotionAxis(motion[axis], range), readField(report, *pField));
+        // The host scales the axis back to within one step
+        CHECK_NEAR(motion[axis], readField(report, *pField) * range / HID_GAMEPAD_MOTION_AXIS_MAX,
+                   range / HID_GAMEPAD_MOTION_AXIS_MAX);
+    }
+
+    // 12-bit ADC readings scale to the full stick range
+    CHECK_EQUAL(0U, scaleJoystickAxis(0U));
+    CHECK_EQUAL(128U, scaleJoystickAxis(0x0800U));
+    CHECK_EQUAL(255U, scaleJoystickAxis(0x0FFFU));
+    const Hid_Field_t* pX = findField(fields, HID_USAGE_PAGE_GENERIC_DESKTOP, HID_USAGE_X);
+    const Hid_Field_t* pY = findField(fields, HID_USAGE_PAGE_GENERIC_DESKTOP, HID_USAGE_Y);
+    if ((pX != nullptr) && (pY != nullptr)) {
+        CHECK_EQUAL(255, readField(report, *pX));
+        CHECK_EQUAL(128, readField(report, *pY));
+    }
+}
+
+/**
+ * @brief Checks that a report is only flagged when the state changed.
+ */
+static void testChangeTracking(void)
+{
+    HidGamepad gamepad;
+    HID_Gamepad_Report_t report;
+    // The first report is always sent
+    CHECK(gamepad.encodeReport(report));
+    CHECK(!gamepad.encodeReport(report));
+    gamepad.setButtons(DS4_CROSS);
+    CHECK(gamepad.encodeReport(report));
+    gamepad.setButtons(DS4_CROSS);
+    gamepad.setExtraButtons(0U);
+    gamepad.setJoystick(0U, 0U);
+    gamepad.setMotion(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    CHECK(!gamepad.encodeReport(report));
+    // Noise under one step of the axis doesn't send a report
+    gamepad.setMotion(1e-5f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    CHECK(!gamepad.encodeReport(report));
+    gamepad.setMotion(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    CHECK(gamepad.encodeReport(report));
+    gamepad.setJoystick(1U, 0U);
+    CHECK(gamepad.encodeReport(report));
+    // Bits outside the extra buttons are not part of the state
+    gamepad.setExtraButtons(0xFCU);
+    CHECK(!gamepad.encodeReport(report));
+}
+
+int main(void)
+{
+    uint32_t reportBits = 0U;
+    const std::vector<Hid_Field_t> fields = parseDescriptor(HID_GAMEPAD_REPORT_ID, reportBits);
+    testDescriptorMatchesReport(fields, reportBits);
+    testButtons(fields);
+    testAxes(fields);
+    testChangeTracking();
+    return testResult("hid_gamepad_test");
+}
@@ -0,0 +1,115 @@
+/**
+ * @file host_test.h
+ * @brief Minimal check macros and trace reader for the host tests.
+ * @author Humza Ali
+ *
+ * Every test is a standalone program built and run by run_tests.py. A
+ * failed check prints where it failed and the test keeps going, so one run
+ * reports every failure. The program exits with an error if any check failed.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/** Number of failed checks. */
+static int testFailures = 0;
+
+/** Fails the test if a condition is false. */
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            testFailures++;                                                 \
+        }                                                                   \
+    } while (0)
+
+/** Fails the test if two integral values differ. */
+#define CHECK_EQUAL(expected, actual)                                       \
+    do {                                                                    \
+        const long long expectedValue = (long long)(expected);              \
+        const long long actualValue = (long long)(actual);                  \
+        if (expectedValue != actualValue) {                                 \
+            printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, \
+                   #actual, actualValue, expectedValue);                    \
+            testFailures++;                                                 \
+        }                                                                   \
+    } while (0)
+
+/** Fails the test if two floating point values differ by more than a tolerance. */
+#define CHECK_NEAR(expected, actual, tolerance)                             \
+    do {                                                                    \
+        const double expectedValue = (double)(expected);                    \
+        const double actualValue = (double)(actual);                        \
+        if (!(std::fabs(expectedValue - actualValue) <= (double)(tolerance))) { \
+            printf("%s:%d: %s is %g, expected %g +/- %g\n", __FILE__, __LINE__, \
+                   #actual, actualValue, expectedValue, (double)(tolerance)); \
+            testFailures++;                                                 \
+        }                                                                   \
+    } while (0)
+
+/** @brief Prints the result of the test and returns its exit code. */
+static inline int testResult(const char* name)
+{
+    if (testFailures == 0) {
+        printf("%s: passed\n", name);
+    } else {
+        printf("%s: %d checks failed\n", name, testFailures);
+    }
+    return (testFailures == 0) ? 0 : 1;
+}
+
+/**
+ * @struct Trace_Sample_t
+ * @brief One sample of a labeled IMU trace.
+ */
+typedef struct {
+    uint32_t timestampUs; /** Device time of the sample, in us. */
+    float accel[3];       /** Acceleration, in g. */
+    float gyro[3];        /** Rotation rate, in dps. */
+    std::string label;    /** Label of the sample, empty if none. */
+} Trace_Sample_t;
+
+/**
+ * @brief Reads a trace in the timestampUs,ax,ay,az,gx,gy,gz,label format
+ *        written by traces/generate_traces.py and gesture_validation.py.
+ *
+ * @param[in] path Path of the trace.
+ *
+ * @return Samples of the trace, empty if it could not be read.
+ */
+static inline std::vector<Trace_Sample_t> readTrace(const std::string& path)
+{
+    std::vector<Trace_Sample_t> samples;
+    FILE* pTrace = fopen(path.c_str(), "r");
+    if (pTrace == nullptr) {
+        printf("Could not open %s\n", path.c_str());
+        testFailures++;
+        return samples;
+    }
+    char line[256];
+    // Skip the header
+    if (fgets(line, sizeof(line), pTrace) != nullptr) {
+        while (fgets(line, sizeof(line), pTrace) != nullptr) {
+            Trace_Sample_t sample;
+            unsigned long timestampUs;
+            char label[64] = { 0 };
+            const int fields = sscanf(line, "%lu,%f,%f,%f,%f,%f,%f,%63[A-Z_]", &timestampUs,
+                                      &sample.accel[0], &sample.accel[1], &sample.accel[2],
+                                      &sample.gyro[0], &sample.gyro[1], &sample.gyro[2], label);
+            if (fields < 7) {
+                continue;
+            }
+            sample.timestampUs = (uint32_t)timestampUs;
+            sample.label = label;
+            samples.push_back(sample);
+        }
+    }
+    fclose(pTrace);
+    return samples;
+}
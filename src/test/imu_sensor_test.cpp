@@ -0,0 +1,140 @@
+/**
+ * @file imu_sensor_test.cpp
+ * @brief Checks that the IMU sensors check the device ID at init, and that
+ *        the static sensor configures and scales the selected ranges.
+ * @author Humza Ali
+ *
+ * Built and run through run_tests.py, or by hand from the repository root:
+ *
+ *     g++ -O2 -std=gnu++11 -Isrc/benchmark/host -Isrc/include \
+ *         src/test/imu_sensor_test.cpp src/IMU_Sensor.cpp \
+ *         src/benchmark/host/FastIMU.cpp src/benchmark/host/Wire.cpp \
+ *         -o imu_sensor_test
+ *     ./imu_sensor_test
+ *
+ * The simulated I2C bus of the host stand-ins answers with the registers
+ * set by the test, so each IMU type is initialized against a missing
+ * device, a device of another type and a device of its own type. Samples
+ * are encoded by the simulated IMU at the ranges written to its
+ * configuration registers, and must decode back to the same values.
+ */
+
+#include "host_test.h"
+#include "IMU_Sensor.h"
+
+/** I2C addresses of the simulated devices. */
+#define MISSING_ADDRESS 0x10U
+#define MPU6050_ADDRESS 0x20U
+#define MPU6500_ADDRESS 0x21U
+#define MPU9250_ADDRESS 0x22U
+
+/** Sample supplied by the simulated IMUs. */
+static const AccelData testAccel = { 0.5f, -1.25f, 3.0f };
+static const GyroData testGyro = { 100.0f, -250.0f, 30.0f };
+
+/** @brief Supplies the test sample to every simulated IMU. */
+static bool readTestSample(uint8_t address, AccelData* pAccel, GyroData* pGyro)
+{
+    (void)address;
+    *pAccel = testAccel;
+    *pGyro = testGyro;
+    return true;
+}
+
+/** @brief Checks that a sensor reads the test sample back, within a resolution. */
+template <typename Sensor>
+static void checkSample(Sensor& sensor, float accelResolution, float gyroResolution)
+{
+    AccelData accelData;
+    GyroData gyroData;
+    sensor.update();
+    sensor.getAccel(&accelData);
+    sensor.getGyro(&gyroData);
+    CHECK_NEAR(testAccel.accelX, accelData.accelX, accelResolution);
+    CHECK_NEAR(testAccel.accelY, accelData.accelY, accelResolution);
+    CHECK_NEAR(testAccel.accelZ, accelData.accelZ, accelResolution);
+    CHECK_NEAR(testGyro.gyroX, gyroData.gyroX, gyroResolution);
+    CHECK_NEAR(testGyro.gyroY, gyroData.gyroY, gyroResolution);
+    CHECK_NEAR(testGyro.gyroZ, gyroData.gyroZ, gyroResolution);
+}
+
+/** @brief Checks a sensor type that is selected at compile time. */
+template <IMU_Type_t Type>
+static void checkStaticSensor(uint8_t ownAddress, uint8_t otherAddress)
+{
+    StaticIMU_Sensor<Type, 4> missing(MISSING_ADDRESS);
+    StaticIMU_Sensor<Type, 4> other(otherAddress);
+    StaticIMU_Sensor<Type, 4> own(ownAddress);
+    CHECK_EQUAL(STATUS_IMU_INIT_FAILURE, missing.initImuSensor());
+    CHECK_EQUAL(STATUS_IMU_INIT_FAILURE, other.initImuSensor());
+    CHECK_EQUAL(STATUS_COMPLETE, own.initImuSensor());
+}
+
+/** @brief Checks the ranges a static sensor configures and the scaling of its samples. */
+template <int AccelRangeG, int GyroRangeDps>
+static void checkStaticRanges(uint8_t address, uint8_t accelConfig, uint8_t gyroConfig)
+{
+    typedef StaticIMU_Sensor<IMU_TYPE_MPU6500, AccelRangeG, GyroRangeDps> Sensor;
+    Sensor sensor(address);
+    CHECK_EQUAL(STATUS_COMPLETE, sensor.initImuSensor());
+    CHECK_EQUAL(accelConfig, hostGetI2cRegister(address, MPU_Traits::accelConfigRegister));
+    CHECK_EQUAL(gyroConfig, hostGetI2cRegister(address, MPU_Traits::gyroConfigRegister));
+    // Within one LSB
+    checkSample(sensor, Sensor::accelGPerLsb, Sensor::gyroDpsPerLsb);
+}
+
+/** @brief Checks a sensor type that is selected at runtime by name. */
+static void checkRuntimeSensor(const char* name, uint8_t ownAddress, uint8_t otherAddress)
+{
+    IMU_Sensor missing(MISSING_ADDRESS, 4, name);
+    IMU_Sensor other(otherAddress, 4, name);
+    IMU_Sensor own(ownAddress, 4, name);
+    CHECK_EQUAL(STATUS_IMU_INIT_FAILURE, missing.initImuSensor());
+    CHECK_EQUAL(STATUS_IMU_INIT_FAILURE, other.initImuSensor());
+    CHECK_EQUAL(STATUS_COMPLETE, own.initImuSensor());
+}
+
+int main(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    hostSetI2cRegister(MPU6050_ADDRESS, MPU_Traits::whoAmIRegister, 0x68U);
+    hostSetI2cRegister(MPU6500_ADDRESS, MPU_Traits::whoAmIRegister, 0x70U);
+    hostSetI2cRegister(MPU9250_ADDRESS, MPU_Traits::whoAmIRegister, 0x71U);
+
+    checkStaticSensor<IMU_TYPE_MPU6050>(MPU6050_ADDRESS, MPU6500_ADDRESS);
+    checkStaticSensor<IMU_TYPE_MPU6500>(MPU6500_ADDRESS, MPU9250_ADDRESS);
+    checkStaticSensor<IMU_TYPE_MPU9250>(MPU9250_ADDRESS, MPU6050_ADDRESS);
+    checkRuntimeSensor(MPU6050_NAME, MPU6050_ADDRESS, MPU9250_ADDRESS);
+    checkRuntimeSensor(MPU6500_NAME, MPU6500_ADDRESS, MPU6050_ADDRESS);
+    checkRuntimeSensor(MPU9250_NAME, MPU9250_ADDRESS, MPU6500_ADDRESS);
+
+    // An unknown name has no driver to check the device with
+    IMU_Sensor unknown(MPU6500_ADDRESS, 4, "BMI160");
+    CHECK_EQUAL(STATUS_NULL_POINTER, unknown.initImuSensor());
+
+    // The ranges are written from the register map and the samples scaled
+    // by its sensitivities
+    hostSetImuSource(readTestSample);
+    checkStaticRanges<4, 500>(MPU6500_ADDRESS, 0x08U, 0x08U);
+    checkStaticRanges<8, 1000>(MPU6500_ADDRESS, 0x10U, 0x10U);
+    checkStaticRanges<16, 2000>(MPU6500_ADDRESS, 0x18U, 0x18U);
+    static_assert(StaticIMU_Sensor<IMU_TYPE_MPU6500, 2, 250>::accelGPerLsb == 1.0f / 16384.0f,
+                  "+/-2 g is 16384 LSB/g");
+    static_assert(StaticIMU_Sensor<IMU_TYPE_MPU6500, 2, 250>::gyroDpsPerLsb == 1.0f / 131.0f,
+                  "+/-250 dps is 131 LSB/dps");
+    // The runtime sensor reads the same sample through FastIMU, whose
+    // resolution is the range over 32768 rather than the datasheet one
+    IMU_Sensor runtime(MPU6500_ADDRESS, 8, MPU6500_NAME);
+    CHECK_EQUAL(STATUS_COMPLETE, runtime.initImuSensor());
+    checkSample(runtime, 0.01f, 1.0f);
+
+    // A read nobody answers leaves a sample reported as a failed read
+    StaticIMU_Sensor<IMU_TYPE_MPU6500, 4> missing(MISSING_ADDRESS);
+    AccelData accelData = { 1.0f, 1.0f, 1.0f };
+    missing.update();
+    missing.getAccel(&accelData);
+    CHECK(isImuReadFailure(accelData));
+
+    return testResult("imu_sensor_test");
+}
@@ -0,0 +1,214 @@
+/**
+ * @file motion_rate_controller_test.cpp
+ * @brief Replays still/motion IMU traces through the MotionRateController.
+ * @author Humza Ali
+ *
+ * Built and run through run_tests.py, or by hand from the repository root:
+ *
+ *     g++ -O2 -std=gnu++11 -Isrc/include src/test/motion_rate_controller_test.cpp \
+ *         src/Motion_Rate_Controller.cpp -o motion_rate_controller_test
+ *     ./motion_rate_controller_test src/test/traces
+ *
+ * The trace is sampled the way the firmware loop does: a trace sample is
+ * only passed to the controller when isSampleDue() says so. Every MOTION
+ * label follows a rest long enough for the controller to go idle. The test
+ * checks that the controller is idle at every onset, that it wakes on the
+ * first sample it takes once the motion crosses the wake thresholds, and
+ * that idle keepalives keep coming. It prints the transition latency and
+ * the reduction in reports against reporting every trace sample.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "host_test.h"
+#include "Motion_Rate_Controller.h"
+
+/**
+ * @struct Replay_Result_t
+ * @brief Outcome of a trace replay.
+ */
+typedef struct {
+    uint32_t sampleCount;                  /** Samples taken by the controller. */
+    uint32_t reportCount;                  /** Samples reported. */
+    std::vector<uint32_t> labelLatencyUs;  /** Label to wake, per onset, in us. */
+    std::vector<uint32_t> motionLatencyUs; /** Wake threshold crossing to wake, per onset, in us. */
+    uint32_t longestReportGapUs;           /** Longest time without a report, in us. */
+} Replay_Result_t;
+
+/** @brief Indicates whether a trace sample exceeds the wake thresholds. */
+static bool exceedsWakeThresholds(const Trace_Sample_t& sample, const Rate_Controller_Config_t& config)
+{
+    const float accelMag = std::sqrt((sample.accel[0] * sample.accel[0]) +
+                                     (sample.accel[1] * sample.accel[1]) +
+                                     (sample.accel[2] * sample.accel[2]));
+    const float gyroMag = std::sqrt((sample.gyro[0] * sample.gyro[0]) +
+                                    (sample.gyro[1] * sample.gyro[1]) +
+                                    (sample.gyro[2] * sample.gyro[2]));
+    return (std::fabs(accelMag - 1.0f) > config.wakeAccelThreshold) ||
+           (gyroMag > config.wakeGyroThreshold);
+}
+
+/**
+ * @brief Replays a trace through a controller.
+ *
+ * @param[in] trace Samples of the trace.
+ * @param[in] config Thresholds and periods of the controller.
+ * @param[in] offsetMs Added to every sample time, to move millis() wrapping
+ *                     around into the trace.
+ */
+static Replay_Result_t replay(const std::vector<Trace_Sample_t>& trace,
+                              const Rate_Controller_Config_t& config, uint32_t offsetMs)
+{
+    MotionRateController controller(config);
+    Replay_Result_t result = {};
+    uint32_t lastReportUs = trace.empty() ? 0U : trace[0].timestampUs;
+    // Onset being tracked, and the trace sample that crossed the wake
+    // thresholds after it
+    bool onsetPending = false;
+    size_t onsetIndex = 0U;
+    bool motionSeen = false;
+    size_t motionIndex = 0U;
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        const Trace_Sample_t& sample = trace[i];
+        if (sample.label == "MOTION") {
+            // Every movement follows a rest longer than the still time
+            CHECK(controller.getState() == RATE_STATE_IDLE);
+            onsetPending = true;
+            onsetIndex = i;
+            motionSeen = false;
+        }
+        if (onsetPending && !motionSeen && exceedsWakeThresholds(sample, config)) {
+            motionSeen = true;
+            motionIndex = i;
+        }
+
+        const uint32_t nowMs = (sample.timestampUs / 1000U) + offsetMs;
+        if (!controller.isSampleDue(nowMs)) {
+            continue;
+        }
+        const Rate_State_t stateBefore = controller.getState();
+        const bool reported = controller.update(sample.accel[0], sample.accel[1], sample.accel[2],
+                                                sample.gyro[0], sample.gyro[1], sample.gyro[2],
+                                                nowMs);
+        if (reported) {
+            result.longestReportGapUs = std::max(result.longestReportGapUs,
+                                                 sample.timestampUs - lastReportUs);
+            lastReportUs = sample.timestampUs;
+        }
+        if (!onsetPending || !motionSeen) {
+            // Rest, or motion still under the wake thresholds, must not
+            // wake the controller
+            CHECK(!((stateBefore == RATE_STATE_IDLE) &&
+                    (controller.getState() == RATE_STATE_ACTIVE)));
+            continue;
+        }
+        // First sample taken since the motion crossed the wake thresholds:
+        // the controller wakes on it and reports it
+        CHECK(stateBefore == RATE_STATE_IDLE);
+        CHECK(controller.getState() == RATE_STATE_ACTIVE);
+        CHECK(reported);
+        result.labelLatencyUs.push_back(sample.timestampUs - trace[onsetIndex].timestampUs);
+        result.motionLatencyUs.push_back(sample.timestampUs - trace[motionIndex].timestampUs);
+        onsetPending = false;
+    }
+    CHECK(!onsetPending);
+    result.sampleCount = controller.getSampleCount();
+    result.reportCount = controller.getReportCount();
+    return result;
+}
+
+/** @brief Returns a percentile of a list of values. */
+static uint32_t percentile(std::vector<uint32_t> values, double q)
+{
+    if (values.empty()) {
+        return 0U;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1U, (size_t)(q * values.size()))];
+}
+
+/**
+ * @brief Checks the controller against a still/motion trace and prints the
+ *        transition latency and report reduction.
+ */
+static void testStillMotionTrace(const std::string& traceDir)
+{
+    const std::vector<Trace_Sample_t> trace = readTrace(traceDir + "/still_motion.csv");
+    CHECK(!trace.empty());
+    if (trace.empty()) {
+        return;
+    }
+    const Rate_Controller_Config_t config = RATE_CONTROLLER_DEFAULT_CONFIG;
+    const Replay_Result_t result = replay(trace, config, 0U);
+    const size_t onsets = std::count_if(trace.begin(), trace.end(), [](const Trace_Sample_t& s) {
+        return s.label == "MOTION";
+    });
+    CHECK(onsets > 0U);
+    CHECK_EQUAL(onsets, result.motionLatencyUs.size());
+
+    // The trace is sampled every 10 ms, so an idle sample is taken within
+    // one idle period plus one trace period of the threshold crossing
+    const uint32_t tracePeriodUs = (trace.back().timestampUs - trace.front().timestampUs) /
+                                   (uint32_t)(trace.size() - 1U);
+    const uint32_t maxWakeUs = (config.idleSamplePeriodMs * 1000U) + tracePeriodUs + 1000U;
+    CHECK(percentile(result.motionLatencyUs, 1.0) <= maxWakeUs);
+    // Keepalives keep coming while idle
+    CHECK(result.longestReportGapUs <= ((config.keepalivePeriodMs + config.idleSamplePeriodMs) * 1000U) +
+                                       tracePeriodUs + 1000U);
+
+    // Without the controller every trace sample is reported. The rests of
+    // the trace only last about a second past the still time, so longer
+    // rests in actual play cut more.
+    const double reduction = 1.0 - ((double)result.reportCount / (double)trace.size());
+    CHECK(reduction >= 0.4);
+    printf("still_motion.csv: %zu onsets, wake latency from onset p50 %.1f ms max %.1f ms, "
+           "from threshold crossing max %.1f ms\n",
+           onsets, percentile(result.labelLatencyUs, 0.5) / 1000.0,
+           percentile(result.labelLatencyUs, 1.0) / 1000.0,
+           percentile(result.motionLatencyUs, 1.0) / 1000.0);
+    printf("still_motion.csv: %zu trace samples, %u taken, %u reported (%.0f%% fewer reports)\n",
+           trace.size(), (unsigned)result.sampleCount, (unsigned)result.reportCount,
+           reduction * 100.0);
+
+    // millis() wrapping around mid-trace doesn't change anything
+    const uint32_t middleMs = trace[trace.size() / 2U].timestampUs / 1000U;
+    const Replay_Result_t wrapped = replay(trace, config, 0xFFFFFFFFU - middleMs);
+    CHECK_EQUAL(result.sampleCount, wrapped.sampleCount);
+    CHECK_EQUAL(result.reportCount, wrapped.reportCount);
+}
+
+/**
+ * @brief Checks that a button press wakes an idle controller and that its
+ *        next sample is taken and reported right away.
+ */
+static void testWakeOnButton(void)
+{
+    const Rate_Controller_Config_t config = RATE_CONTROLLER_DEFAULT_CONFIG;
+    MotionRateController controller(config);
+    uint32_t nowMs = 0U;
+    while (controller.getState() != RATE_STATE_IDLE) {
+        controller.update(0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, nowMs);
+        nowMs += config.activePeriodMs;
+        CHECK(nowMs <= (config.stillTimeMs + (2U * config.activePeriodMs)));
+        if (nowMs > (config.stillTimeMs + (2U * config.activePeriodMs))) {
+            return;
+        }
+    }
+    controller.update(0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, nowMs);
+    CHECK(!controller.isSampleDue(nowMs + 1U));
+    controller.wake(nowMs + 1U);
+    CHECK(controller.getState() == RATE_STATE_ACTIVE);
+    CHECK(controller.isSampleDue(nowMs + 1U));
+    CHECK(controller.update(0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, nowMs + 1U));
+}
+
+int main(int argc, char** argv)
+{
+    const std::string traceDir = (argc > 1) ? argv[1] : "src/test/traces";
+    testStillMotionTrace(traceDir);
+    testWakeOnButton();
+    return testResult("motion_rate_controller_test");
+}
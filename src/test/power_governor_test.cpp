@@ -0,0 +1,146 @@
+/**
+ * @file power_governor_test.cpp
+ * @brief Checks the decisions of the PowerGovernor.
+ * @author Humza Ali
+ *
+ * Built and run through run_tests.py, or by hand from the repository root:
+ *
+ *     g++ -O2 -std=gnu++11 -Isrc/include src/test/power_governor_test.cpp \
+ *         src/Power_Governor.cpp -o power_governor_test
+ *     ./power_governor_test
+ *
+ * The loop is fed fixed passes every 10 ms with the default thresholds, so
+ * each check knows when a step is due. governor_simulation.cpp covers the
+ * current and jitter over a whole play session.
+ */
+
+#include "host_test.h"
+#include "Power_Governor.h"
+
+/** Time between two loop passes, in ms. */
+#define PASS_PERIOD_MS 10U
+/** Sampling deadline of the passes, in us. */
+#define DEADLINE_US    10000U
+
+/**
+ * @struct Loop_Pass_t
+ * @brief Loop pass fed to the governor.
+ */
+typedef struct {
+    uint32_t busyUs;     /** Time the pass took at the current level, in us. */
+    uint32_t waitUs;     /** Longest wait behind the rest of the pass, in us. */
+    uint32_t deadlineUs; /** Sampling deadline, in us. */
+} Loop_Pass_t;
+
+/**
+ * @brief Feeds the same pass every PASS_PERIOD_MS until the level changes
+ *        or the time is up.
+ *
+ * @return Time of the level change, or endMs if it didn't change.
+ */
+static uint32_t runUntilChange(PowerGovernor& governor, const Loop_Pass_t& pass,
+                               uint32_t& nowMs, uint32_t durationMs)
+{
+    const uint32_t endMs = nowMs + durationMs;
+    while (nowMs != endMs) {
+        nowMs += PASS_PERIOD_MS;
+        if (governor.update(pass.busyUs, pass.waitUs, pass.deadlineUs, nowMs)) {
+            return nowMs;
+        }
+    }
+    return endMs;
+}
+
+int main(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    const Power_Governor_Config_t config = POWER_GOVERNOR_DEFAULT_CONFIG;
+    const uint8_t topLevel = POWER_GOVERNOR_LEVEL_COUNT - 1U;
+    const Loop_Pass_t light = { 1000U, 500U, DEADLINE_US };
+    const Loop_Pass_t heavy = { 9000U, 8000U, DEADLINE_US };
+    uint32_t nowMs = 0U;
+
+    // Starts at the top, then steps down one level per window while resting
+    PowerGovernor governor(config);
+    CHECK_EQUAL(topLevel, governor.getLevel());
+    CHECK_EQUAL(240U, governor.getFrequencyMhz());
+    uint32_t changeMs = runUntilChange(governor, light, nowMs, 5000U);
+    // The window starts with the first pass
+    CHECK_EQUAL(config.downWindowMs + PASS_PERIOD_MS, changeMs);
+    CHECK_EQUAL(160U, governor.getFrequencyMhz());
+    // and restarts with the first pass at the new level
+    changeMs = runUntilChange(governor, light, nowMs, 5000U);
+    CHECK_EQUAL(2U * (config.downWindowMs + PASS_PERIOD_MS), changeMs);
+    CHECK_EQUAL(80U, governor.getFrequencyMhz());
+    uint32_t startMs = nowMs;
+    CHECK_EQUAL(startMs + 5000U, runUntilChange(governor, light, nowMs, 5000U));
+    CHECK_EQUAL(0U, governor.getLevel());
+    CHECK_EQUAL(2U, governor.getSwitchCount());
+
+    // A pass close to the deadline steps straight to the top
+    CHECK(governor.update(heavy.busyUs, heavy.waitUs, heavy.deadlineUs, nowMs += PASS_PERIOD_MS));
+    CHECK_EQUAL(topLevel, governor.getLevel());
+    const uint32_t upMs = nowMs;
+    // and holds it through the holdoff, even once the load is gone
+    changeMs = runUntilChange(governor, light, nowMs, 10000U);
+    CHECK(changeMs - upMs >= config.upHoldoffMs);
+    CHECK(changeMs - upMs <= config.upHoldoffMs + config.downWindowMs + PASS_PERIOD_MS);
+    CHECK_EQUAL(1U, governor.getLevel());
+
+    // A shorter deadline boosts before any pass shows the load
+    PowerGovernor rateGovernor(config);
+    nowMs = 0U;
+    rateGovernor.idle(nowMs);
+    CHECK_EQUAL(0U, rateGovernor.getLevel());
+    const Loop_Pass_t slow = { 1000U, 500U, 4U * DEADLINE_US };
+    CHECK_EQUAL(1000U, runUntilChange(rateGovernor, slow, nowMs, 1000U));
+    CHECK(rateGovernor.update(light.busyUs, light.waitUs, light.deadlineUs, nowMs += PASS_PERIOD_MS));
+    CHECK_EQUAL(topLevel, rateGovernor.getLevel());
+    const uint32_t boostMs = nowMs;
+    changeMs = runUntilChange(rateGovernor, light, nowMs, 10000U);
+    CHECK(changeMs - boostMs >= config.upHoldoffMs);
+    CHECK_EQUAL(1U, rateGovernor.getLevel());
+    // A boost at the top level restarts the holdoff too
+    CHECK(rateGovernor.boost(nowMs));
+    startMs = nowMs;
+    CHECK_EQUAL(startMs + 2000U, runUntilChange(rateGovernor, light, nowMs, 2000U));
+    CHECK(!rateGovernor.boost(nowMs));
+    const uint32_t reboostMs = nowMs;
+    changeMs = runUntilChange(rateGovernor, light, nowMs, 10000U);
+    CHECK(changeMs - reboostMs >= config.upHoldoffMs);
+    CHECK_EQUAL(1U, rateGovernor.getLevel());
+
+    // A step down is refused when it would stretch a sample period by more
+    // than the jitter budget, even if the pass still fits the deadline. At
+    // 160 MHz a 1950 us wait grows to 3900 us at 80 MHz.
+    const Loop_Pass_t longWait = { 2000U, 1950U, 4U * DEADLINE_US };
+    const Loop_Pass_t shortWait = { 2000U, 1800U, 4U * DEADLINE_US };
+    PowerGovernor jitterGovernor(config);
+    nowMs = 0U;
+    CHECK(runUntilChange(jitterGovernor, longWait, nowMs, 5000U) < 5000U);
+    CHECK_EQUAL(1U, jitterGovernor.getLevel());
+    startMs = nowMs;
+    CHECK_EQUAL(startMs + 5000U, runUntilChange(jitterGovernor, longWait, nowMs, 5000U));
+    CHECK_EQUAL(1U, jitterGovernor.getLevel());
+    // An 1800 us wait grows by 1800 us, which fits with the 100 us stall
+    startMs = nowMs;
+    CHECK(runUntilChange(jitterGovernor, shortWait, nowMs, 5000U) < startMs + 5000U);
+    CHECK_EQUAL(0U, jitterGovernor.getLevel());
+
+    // A pass that only fits the deadline at the current level holds it
+    const Loop_Pass_t busy = { 3500U, 500U, DEADLINE_US };
+    PowerGovernor busyGovernor(config);
+    nowMs = 0U;
+    CHECK_EQUAL(5000U, runUntilChange(busyGovernor, busy, nowMs, 5000U));
+    CHECK_EQUAL(topLevel, busyGovernor.getLevel());
+
+    // The window survives millis() wrapping around
+    PowerGovernor wrapGovernor(config);
+    nowMs = 0xFFFFFFFFU - 495U;
+    changeMs = runUntilChange(wrapGovernor, light, nowMs, 2000U);
+    CHECK_EQUAL((uint32_t)(0xFFFFFFFFU - 495U + config.downWindowMs + PASS_PERIOD_MS), changeMs);
+    CHECK_EQUAL(1U, wrapGovernor.getLevel());
+
+    return testResult("power_governor_test");
+}
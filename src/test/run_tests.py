@@ -0,0 +1,147 @@
+"""
+File: run_tests.py
+Description: Host test suite. Builds the firmware tests for the host with
+             g++ (against the stand-ins in src/benchmark/host where they
+             need Arduino or FastIMU headers) and runs them, then runs the
+             host Python tests (test_*.py) with unittest. Exits with an
+             error if any test failed:
+
+                 python run_tests.py                  # run everything
+                 python run_tests.py -k rate          # only matching tests
+                 python run_tests.py --skip-firmware  # Python tests only
+
+Author: Humza Ali
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import unittest
+
+TEST_DIR = os.path.dirname(os.path.abspath(__file__))
+SOURCE_DIR = os.path.dirname(TEST_DIR)
+TRACE_DIR = os.path.join(TEST_DIR, 'traces')
+sys.path.insert(0, os.path.join(SOURCE_DIR, 'python'))
+
+# Firmware tests and their sources, relative to the source directory
+FIRMWARE_TESTS = {
+    'flight_recorder_test': [
+        'test/flight_recorder_test.cpp',
+        'Flight_Recorder.cpp',
+        'BLE.cpp',
+        'HID_Gamepad.cpp',
+        'benchmark/host/Arduino.cpp',
+        'benchmark/host/BLEDevice.cpp',
+    ],
+    'gesture_detector_test': [
+        'test/gesture_detector_test.cpp',
+        'Gesture_Detector.cpp',
+    ],
+    'hid_gamepad_test': [
+        'test/hid_gamepad_test.cpp',
+        'HID_Gamepad.cpp',
+    ],
+    'imu_sensor_test': [
+        'test/imu_sensor_test.cpp',
+        'IMU_Sensor.cpp',
+        'benchmark/host/FastIMU.cpp',
+        'benchmark/host/Wire.cpp',
+    ],
+    'motion_rate_controller_test': [
+        'test/motion_rate_controller_test.cpp',
+        'Motion_Rate_Controller.cpp',
+    ],
+    'power_governor_test': [
+        'test/power_governor_test.cpp',
+        'Power_Governor.cpp',
+    ],
+}
+
+
+def buildFirmwareTest(name, buildDir):
+    """ Builds a firmware test and returns the path of its binary. """
+    compiler = os.environ.get('CXX', 'g++')
+    if shutil.which(compiler) == None:
+        raise RuntimeError(f"{compiler} not found, set CXX or use --skip-firmware")
+    binary = os.path.join(buildDir, name)
+    subprocess.run([compiler, '-O2', '-std=gnu++11', '-Wall',
+                    '-I' + os.path.join(SOURCE_DIR, 'benchmark', 'host'),
+                    '-I' + os.path.join(SOURCE_DIR, 'include')] +
+                   [os.path.join(SOURCE_DIR, s) for s in FIRMWARE_TESTS[name]] +
+                   ['-o', binary], check=True)
+    return binary
+
+
+def runFirmwareTests(pattern):
+    """
+    Builds and runs the firmware tests.
+
+    Params:
+        pattern (str): Only run tests whose name contains it, or None.
+
+    Return:
+        (list): Names of the tests that failed.
+    """
+    failures = []
+    with tempfile.TemporaryDirectory() as buildDir:
+        for name in FIRMWARE_TESTS:
+            if pattern and (pattern not in name):
+                continue
+            binary = buildFirmwareTest(name, buildDir)
+            if subprocess.run([binary, TRACE_DIR]).returncode != 0:
+                failures.append(name)
+    return failures
+
+
+def runHostTests(pattern, verbosity):
+    """
+    Runs the host Python tests.
+
+    Params:
+        pattern (str): Only run tests whose id contains it, or None.
+        verbosity (int): unittest verbosity.
+
+    Return:
+        (list): Ids of the tests that failed.
+    """
+    suite = unittest.defaultTestLoader.discover(TEST_DIR, pattern='test_*.py')
+    if pattern:
+        def matching(tests):
+            for test in tests:
+                if isinstance(test, unittest.TestSuite):
+                    yield from matching(test)
+                elif pattern in test.id():
+                    yield test
+        suite = unittest.TestSuite(matching(suite))
+    result = unittest.TextTestRunner(verbosity=verbosity).run(suite)
+    return [test.id() for test, _ in result.failures + result.errors]
+
+
+def main():
+    """ Main function handler. """
+    parser = argparse.ArgumentParser(description="Firmware and host test suite")
+    parser.add_argument('-k', dest='pattern',
+                        help='only run tests whose name contains this')
+    parser.add_argument('--skip-firmware', action='store_true',
+                        help='skip the firmware tests')
+    parser.add_argument('--skip-host', action='store_true',
+                        help='skip the host Python tests')
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help='list every host test')
+    args = parser.parse_args()
+
+    failures = []
+    if not args.skip_firmware:
+        failures += runFirmwareTests(args.pattern)
+    if not args.skip_host:
+        failures += runHostTests(args.pattern, 2 if args.verbose else 1)
+    if failures:
+        print(f"{len(failures)} tests failed: {', '.join(failures)}")
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,129 @@
+"""
+File: test_button_profile.py
+Description: Tests the button remapping profiles: the compiled lookup
+             tables, rejection of malformed profiles and the watcher that
+             reloads them while the bridge runs. Run through run_tests.py,
+             or with python -m unittest from src/python.
+Author: Humza Ali
+"""
+
+import contextlib
+import io
+import json
+import os
+import tempfile
+import unittest
+
+from button_profile import (DS4_BUTTONS, DS4_BUTTON_BYTES, DS4_PRESSED,
+                            PHYSICAL_BUTTONS, PROFILE_CONTROLLERS,
+                            CompiledProfile, ProfileWatcher, loadProfile,
+                            outputBits)
+
+
+def pressed(profile, *names):
+    """ Looks up the DS4 button block of a set of pressed physical buttons. """
+    raw = [0, 0, 0]
+    for name in names:
+        rawByte, bit = PHYSICAL_BUTTONS[name]
+        raw[rawByte] |= bit
+    return profile.lookup(*raw)
+
+
+class TestCompiledProfile(unittest.TestCase):
+
+    def test_default_mapping(self):
+        profile = CompiledProfile()
+        self.assertEqual(pressed(profile), 0)
+        self.assertEqual(pressed(profile, 'A'), outputBits(['CROSS']))
+        self.assertEqual(pressed(profile, 'C', 'Z'), outputBits(['HOME', 'PAD_CLICK']))
+        # D-pad and face buttons carry a pressure byte
+        pressureByte = DS4_BUTTONS['UP'][2]
+        self.assertEqual((pressed(profile, 'UP') >> (8 * (DS4_BUTTON_BYTES + pressureByte))) & 0xFF,
+                         DS4_PRESSED)
+
+    def test_every_combination_is_the_union_of_its_buttons(self):
+        profile = CompiledProfile({'buttons': {'A': ['CIRCLE', 'R2'], 'B': None}})
+        names = sorted(PHYSICAL_BUTTONS)
+        for mask in range(0, 1 << len(names), 37):
+            down = [n for i, n in enumerate(names) if mask & (1 << i)]
+            expected = 0
+            for name in down:
+                expected |= pressed(profile, name)
+            self.assertEqual(pressed(profile, *down), expected, down)
+        self.assertEqual(pressed(profile, 'A'), outputBits(['CIRCLE', 'R2']))
+        self.assertEqual(pressed(profile, 'B'), 0)
+
+    def test_axes(self):
+        profile = CompiledProfile({'accel': ['z', '-x', 'y']})
+        self.assertEqual(profile.accelAxes, (2, 1.0, 0, -1.0, 1, 1.0))
+
+    def test_malformed_sections_raise_value_error(self):
+        for section in (5, 'A', ['buttons'],
+                        {'buttons': ['A', 'CROSS']},
+                        {'buttons': {'A': 5}},
+                        {'buttons': {'A': {'CROSS': True}}},
+                        {'buttons': {'A': [['CROSS']]}},
+                        {'buttons': {'X': 'CROSS'}},
+                        {'buttons': {'A': 'X'}},
+                        {'accel': 'xyz'},
+                        {'accel': ['x', 'y']},
+                        {'accel': [0, 1, 2]},
+                        {'gyro': [['x'], 'y', 'z']},
+                        {'rumble': True}):
+            with self.subTest(section=section):
+                with self.assertRaises(ValueError):
+                    CompiledProfile(section)
+
+
+class TestProfileFiles(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.directory.name, 'profile.json')
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def write(self, content, modifiedNs):
+        with open(self.path, 'w') as f:
+            f.write(content if isinstance(content, str) else json.dumps(content))
+        # Don't depend on the file system timestamp resolution
+        os.utime(self.path, ns=(modifiedNs, modifiedNs))
+
+    def test_shipped_profiles_load(self):
+        for name in ('default', 'nunchuck_triggers'):
+            profiles = loadProfile(name)
+            self.assertEqual(set(profiles), set(PROFILE_CONTROLLERS))
+        self.assertEqual(pressed(loadProfile('nunchuck_triggers')['nunchuck'], 'Z'),
+                         outputBits(['R1']))
+
+    def test_malformed_files_raise_value_error(self):
+        for content in ('{', '[]', {'name': 5}, {'wiimote': 5}, {'pad': {}}):
+            with self.subTest(content=content):
+                self.write(content, 1000000000)
+                with self.assertRaises(ValueError):
+                    loadProfile(self.path)
+
+    def test_watcher_keeps_the_last_good_profile(self):
+        loaded = []
+        self.write({'name': 'First'}, 1000000000)
+        watcher = ProfileWatcher(self.path, loaded.append)
+        with contextlib.redirect_stdout(io.StringIO()):
+            self.assertTrue(watcher.poll())
+            # Unchanged files aren't reloaded
+            self.assertFalse(watcher.poll())
+            # Wrong shapes used to escape as AttributeError and TypeError
+            # and stop the watcher thread
+            for i, content in enumerate(('{"wiimote": []', {'wiimote': {'buttons': []}},
+                                         {'wiimote': {'buttons': {'A': 1}}},
+                                         {'wiimote': {'accel': [1, 2, 3]}}, [1, 2])):
+                self.write(content, 2000000000 + i)
+                self.assertFalse(watcher.poll())
+            self.write({'name': 'Second', 'wiimote': {'buttons': {'A': 'SQUARE'}}}, 3000000000)
+            self.assertTrue(watcher.poll())
+        self.assertEqual([p['wiimote'].name for p in loaded], ['First', 'Second'])
+        self.assertEqual(pressed(loaded[-1]['wiimote'], 'A'), outputBits(['SQUARE']))
+
+
+if __name__ == '__main__':
+    unittest.main()
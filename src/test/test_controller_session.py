@@ -0,0 +1,194 @@
+"""
+File: test_controller_session.py
+Description: Tests several Wii Remotes handled side by side on the host:
+             each session publishes to its own shared memory slots, two
+             sessions never connect to the same remote, every device
+             keeps its own line in the address cache and a link that fails
+             to close doesn't end the reconnect loop. Bleak is replaced by
+             a stand-in when it isn't installed, nothing here talks to a
+             radio. Run through run_tests.py, or with python -m unittest
+             from src/python.
+Author: Humza Ali
+"""
+
+import asyncio
+import contextlib
+import io
+import os
+import sys
+import tempfile
+import types
+import unittest
+from unittest import mock
+
+try:
+    import bleak
+except ImportError:
+    bleak = types.ModuleType('bleak')
+    bleak.BleakScanner = object
+    bleak.BleakClient = object
+    bleak.exc = types.ModuleType('bleak.exc')
+    bleak.exc.BleakError = Exception
+    sys.modules['bleak'] = bleak
+    sys.modules['bleak.exc'] = bleak.exc
+
+from pymote_controller import BLE, ControllerSession, SLOTS_PER_DEVICE
+from shared_state import SharedControllerState
+from simulate_devices import driveDevices, simulatedNotifications
+from wire_schema import (SERVICE_UUID, WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID,
+                         NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID,
+                         encodeWiimoteButtonInput,
+                         encodeNunchuckButtonJoystickInput)
+
+
+class FakeScanner(object):
+    """ Scanner that offers a fixed list of advertising devices in order. """
+
+    devices = []
+
+    @staticmethod
+    async def find_device_by_filter(matches, timeout):
+        for device, advertisementData in FakeScanner.devices:
+            if matches(device, advertisementData):
+                return device
+        return None
+
+
+def advertisement(address, name, serviceUuids):
+    """ Builds a scanned device and its advertisement data. """
+    return (types.SimpleNamespace(address=address, name=name),
+            types.SimpleNamespace(service_uuids=serviceUuids))
+
+
+class TestControllerSessions(unittest.TestCase):
+
+    def setUp(self):
+        self.sharedState = SharedControllerState(f"pymote_test_{os.getpid()}",
+                                                 3 * SLOTS_PER_DEVICE, create=True)
+
+    def tearDown(self):
+        self.sharedState.close()
+
+    def test_sessions_publish_to_their_own_slots(self):
+        sessions = [ControllerSession(index, self.sharedState) for index in range(3)]
+        for session in sessions:
+            callbacks = session.ble.callbacks
+            callbacks[WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID](
+                None, encodeWiimoteButtonInput(0x10 + session.index, 0, 0))
+            callbacks[NUNCHUCK_BUTTON_JOYSTICK_INPUT_CHARACTERISTIC_UUID](
+                None, encodeNunchuckButtonJoystickInput(20 * session.index, 128, 1))
+        for session in sessions:
+            _, wiiRemote = self.sharedState.read(session.index * SLOTS_PER_DEVICE)
+            _, nunchuck = self.sharedState.read(session.index * SLOTS_PER_DEVICE + 1)
+            self.assertEqual(wiiRemote.buttons1, 0x10 + session.index)
+            self.assertEqual(nunchuck.joystickData, (20 * session.index, 128))
+            self.assertEqual(session.stats.notifications, 2)
+
+    def test_interleaved_devices_keep_their_counters(self):
+        sessions = [ControllerSession(index, self.sharedState) for index in range(3)]
+        with contextlib.redirect_stdout(io.StringIO()):
+            asyncio.run(driveDevices(sessions, 200))
+        for session in sessions:
+            self.assertEqual(session.stats.notifications, 200)
+            # The last button change of each device is in its own slot
+            lastButtons = [payload for uuid, payload in simulatedNotifications(session.index, 200)
+                           if uuid == WIIMOTE_BUTTON_INPUT_CHARACTERISTIC_UUID][-1]
+            _, wiiRemote = self.sharedState.read(session.index * SLOTS_PER_DEVICE)
+            self.assertEqual(wiiRemote.buttons1, lastButtons[0])
+
+
+class FakeClient(object):
+    """ Connected client whose link drops and then fails to disconnect. """
+
+    is_connected = True
+
+    async def start_notify(self, uuid, callback):
+        pass
+
+    async def disconnect(self):
+        raise bleak.exc.BleakError("disconnect failed")
+
+
+class FailingTimeSync(object):
+    """ Time sync client whose request fails as the link goes down. """
+
+    async def run(self, client):
+        raise OSError("write failed")
+
+
+class StopReconnecting(Exception):
+    """ Raised by the second connection attempt to end the test. """
+
+
+class TestReconnect(unittest.TestCase):
+
+    def test_failed_disconnect_keeps_reconnecting(self):
+        ble = BLE("Wii Remote", 0, os.devnull)
+        ble.timeSync = FailingTimeSync()
+        attempts = []
+        async def connect():
+            attempts.append(ble.disconnectedEvent)
+            if len(attempts) > 1:
+                raise StopReconnecting()
+            # Drop the link once the time sync task has run
+            asyncio.get_running_loop().call_later(0.01, ble.disconnectedEvent.set)
+            return FakeClient()
+        output = io.StringIO()
+        with mock.patch.object(ble, 'connect', connect), \
+                contextlib.redirect_stdout(output):
+            with self.assertRaises(StopReconnecting):
+                asyncio.run(ble.receiveData())
+        # Both failures were logged, and the loop went on to reconnect
+        self.assertEqual(len(attempts), 2)
+        self.assertIn("time sync stopped", output.getvalue())
+        self.assertIn("could not disconnect cleanly", output.getvalue())
+        self.assertTrue(ble.isReconnect)
+
+
+class TestDeviceSelection(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.cacheFile = os.path.join(self.directory.name, 'devices.txt')
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def test_sessions_never_pick_the_same_remote(self):
+        FakeScanner.devices = [advertisement('aa:00:00:00:00:01', None, [SERVICE_UUID.upper()]),
+                               advertisement('AA:00:00:00:00:02', 'Keyboard', []),
+                               advertisement('AA:00:00:00:00:03', 'Wii Remote', [])]
+        claimed = set()
+        first = BLE("Wii Remote", 0, self.cacheFile, claimed, asyncio.Lock())
+        second = BLE("Wii Remote", 1, self.cacheFile, claimed, asyncio.Lock())
+        third = BLE("Wii Remote", 2, self.cacheFile, claimed, asyncio.Lock())
+        with mock.patch('pymote_controller.BleakScanner', FakeScanner), \
+                contextlib.redirect_stdout(io.StringIO()):
+            self.assertTrue(asyncio.run(first.findDevice()))
+            self.assertTrue(first.claimAddress(first.bleDevice.address))
+            # Claims ignore the case the backend reports addresses in
+            self.assertFalse(second.claimAddress('AA:00:00:00:00:01'))
+            self.assertTrue(asyncio.run(second.findDevice()))
+            self.assertEqual(second.bleDevice.address, 'AA:00:00:00:00:03')
+            self.assertTrue(second.claimAddress(second.bleDevice.address))
+            self.assertFalse(asyncio.run(third.findDevice()))
+            # A disconnected remote can be picked up by another session
+            first.releaseAddress()
+            self.assertTrue(asyncio.run(third.findDevice()))
+            self.assertEqual(third.bleDevice.address, 'aa:00:00:00:00:01')
+
+    def test_each_device_keeps_its_cached_address(self):
+        devices = [BLE("Wii Remote", index, self.cacheFile) for index in range(3)]
+        self.assertEqual(devices[0].loadCachedAddress(), None)
+        devices[2].saveCachedAddress('AA:00:00:00:00:03')
+        devices[0].saveCachedAddress('AA:00:00:00:00:01')
+        self.assertEqual([d.loadCachedAddress() for d in devices],
+                         ['AA:00:00:00:00:01', None, 'AA:00:00:00:00:03'])
+        # A remote that moved to another device is only cached there
+        devices[1].saveCachedAddress('AA:00:00:00:00:03')
+        self.assertEqual([d.loadCachedAddress() for d in devices],
+                         ['AA:00:00:00:00:01', 'AA:00:00:00:00:03', None])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,115 @@
+"""
+File: test_flight_recorder.py
+Description: Tests the flight recorder decoder: chunk decoding, the
+             conversion of cycle timestamps into a timeline and the saved
+             download format. The ring itself is tested on the firmware side
+             by flight_recorder_test.cpp. Run through run_tests.py, or with
+             python -m unittest from src/python.
+Author: Humza Ali
+"""
+
+import contextlib
+import io
+import os
+import tempfile
+import unittest
+
+from flight_recorder import (CYCLE_COUNTER_WRAP, decodeChunk, describeEvent,
+                             loadRecording, printRecording, saveRecording,
+                             toTimeline)
+from wire_schema import (FLIGHT_EVENT_BOOT, FLIGHT_EVENT_CONNECT,
+                         FLIGHT_EVENT_CPU_FREQ, FLIGHT_EVENT_I2C_ERROR,
+                         FLIGHT_EVENT_LOOP_OVERRUN, FLIGHT_EVENT_NOTIFY_FAILURE,
+                         FLIGHT_NOTIFY_TRUNCATED,
+                         encodeFlightRecorderChunkHeader,
+                         encodeFlightRecorderEvent)
+
+
+def encodeChunk(chunkIndex, chunkCount, events, cpuFreqMhz=240, totalEvents=None,
+                freezeReason=FLIGHT_EVENT_LOOP_OVERRUN):
+    """ Encodes a chunk as the firmware loads it into the characteristic. """
+    if totalEvents == None:
+        totalEvents = len(events)
+    data = encodeFlightRecorderChunkHeader(chunkIndex, chunkCount, len(events), cpuFreqMhz,
+                                           totalEvents, 1, freezeReason, 0)
+    for event in events:
+        data += encodeFlightRecorderEvent(*event)
+    return data
+
+
+class TestFlightRecorder(unittest.TestCase):
+
+    def test_decode_chunk(self):
+        events = [(1000, FLIGHT_EVENT_BOOT, 0, 1), (2000, FLIGHT_EVENT_CONNECT, 0, 3)]
+        header, decoded = decodeChunk(encodeChunk(1, 3, events, totalEvents=700))
+        self.assertEqual(header['chunkIndex'], 1)
+        self.assertEqual(header['chunkCount'], 3)
+        self.assertEqual(header['eventCount'], 2)
+        self.assertEqual(header['totalEvents'], 700)
+        self.assertTrue(header['frozen'])
+        self.assertEqual(header['freezeReason'], FLIGHT_EVENT_LOOP_OVERRUN)
+        self.assertEqual(decoded, events)
+        # A truncated read keeps the complete events
+        _, decoded = decodeChunk(encodeChunk(0, 1, events)[:-1])
+        self.assertEqual(decoded, events[:1])
+
+    def test_timeline_unwraps_the_cycle_counter(self):
+        events = [(CYCLE_COUNTER_WRAP - 240000, FLIGHT_EVENT_BOOT, 0, 0),
+                  (480000, FLIGHT_EVENT_CONNECT, 0, 0),
+                  (720000, FLIGHT_EVENT_LOOP_OVERRUN, 0, 0)]
+        timeline = toTimeline(events, 240)
+        self.assertEqual([t for t, _, _, _ in timeline], [0.0, 3000.0, 4000.0])
+        self.assertEqual([e[1:] for e in timeline], [e[1:] for e in events])
+        self.assertEqual(toTimeline([], 240), [])
+
+    def test_timeline_converts_each_frequency_stretch(self):
+        # 1 ms at 240 MHz, 3 ms at 80 MHz, then 2 ms at 160 MHz, with the
+        # changes recorded right after switching
+        events = [(0, FLIGHT_EVENT_BOOT, 0, 0),
+                  (240000, FLIGHT_EVENT_CPU_FREQ, 240, 80),
+                  (480000, FLIGHT_EVENT_CONNECT, 0, 0),
+                  (480000 + 80, FLIGHT_EVENT_CPU_FREQ, 80, 160),
+                  (480080 + 320000, FLIGHT_EVENT_LOOP_OVERRUN, 0, 0)]
+        timeline = toTimeline(events, 160)
+        self.assertEqual([round(t, 3) for t, _, _, _ in timeline],
+                         [0.0, 1000.0, 4000.0, 4001.0, 6001.0])
+        # The ring lost the oldest change: its previous frequency still
+        # comes from the newest one
+        timeline = toTimeline(events[2:], 160)
+        self.assertEqual([round(t, 3) for t, _, _, _ in timeline], [0.0, 1.0, 2001.0])
+
+    def test_describe_event(self):
+        self.assertEqual(describeEvent(FLIGHT_EVENT_CPU_FREQ, 240, 80), 'CPU_FREQ 240 -> 80 MHz')
+        self.assertIn('Nunchuck', describeEvent(FLIGHT_EVENT_I2C_ERROR, 1, 0))
+        self.assertIn('TRUNCATED', describeEvent(FLIGHT_EVENT_NOTIFY_FAILURE, 4,
+                                                 FLIGHT_NOTIFY_TRUNCATED))
+        self.assertIn('UNKNOWN(200)', describeEvent(200, 0, 0))
+
+    def test_saved_recording_round_trips(self):
+        chunks = [encodeChunk(0, 2, [(i * 2400, FLIGHT_EVENT_CONNECT, 0, i) for i in range(60)]),
+                  encodeChunk(1, 2, [(200000, FLIGHT_EVENT_LOOP_OVERRUN, 0, 45)])]
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'hitch.bin')
+            saveRecording(path, chunks)
+            self.assertEqual(loadRecording(path), chunks)
+        output = io.StringIO()
+        with contextlib.redirect_stdout(output):
+            printRecording(chunks)
+        lines = output.getvalue().splitlines()
+        self.assertIn('61 kept', lines[0])
+        self.assertIn('Frozen by LOOP_OVERRUN', lines[1])
+        # Events of every chunk, on one timeline
+        self.assertEqual(len(lines), 2 + 61)
+        self.assertTrue(lines[-1].strip().startswith('0.833 ms'), lines[-1])
+
+    def test_empty_recording(self):
+        output = io.StringIO()
+        with contextlib.redirect_stdout(output):
+            printRecording([])
+            printRecording([encodeChunk(0, 0, [])])
+        self.assertIn('Recording is empty.', output.getvalue())
+        self.assertIn('0 kept', output.getvalue())
+
+
+if __name__ == '__main__':
+    unittest.main()
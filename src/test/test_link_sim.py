@@ -0,0 +1,97 @@
+"""
+File: test_link_sim.py
+Description: Runs the host build of the firmware against the link simulator
+             and checks the traffic it produces: keepalives while still,
+             every characteristic while in use, and notifications held back
+             while the controller has no free TX buffer. Run through
+             run_tests.py, or with python -m unittest from src/python.
+Author: Humza Ali
+"""
+
+import os
+import shutil
+import tempfile
+import unittest
+
+from link_sim import (FirmwareTraffic, LinkProfile, LinkSimulator,
+                      LINK_PROFILES, STREAMS, simulate)
+
+# Time the simulated central connects at, see firmware_traffic.cpp
+CONNECT_US = 1000000
+
+
+class TestLinkSim(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        if shutil.which(os.environ.get('CXX', 'g++')) == None:
+            raise unittest.SkipTest("no C++ compiler")
+        cls.buildDir = tempfile.TemporaryDirectory()
+        cls.firmware = FirmwareTraffic(cls.buildDir.name)
+        # Lying on a table, with a little sensor noise
+        cls.stillTrace = os.path.join(cls.buildDir.name, 'still.csv')
+        with open(cls.stillTrace, 'w') as f:
+            f.write('timestampUs,ax,ay,az,gx,gy,gz,label\n')
+            for i in range(1000):
+                noise = 0.002 * ((i * 7) % 5 - 2)
+                f.write(f"{i * 10000},{noise},{-noise},{1.0 + noise},0.1,-0.1,0.0,\n")
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.buildDir.cleanup()
+
+    def test_still_controllers_only_send_keepalives(self):
+        link = LinkProfile(**LINK_PROFILES['fast'])
+        simulator = LinkSimulator(link)
+        process = self.firmware.start(12.0, link.attMtu, self.stillTrace,
+                                      buttonRateHz=0.0, joystickRateHz=0.0)
+        results = simulator.run(process)
+        for name in ('wiimote_sensor', 'nunchuck_sensor'):
+            # Reported at the full rate until still for 2 s after boot, then
+            # once a second
+            sampleTimes = [s for _, s in simulator.delivered[name]]
+            late = [t for t in sampleTimes if t > CONNECT_US + 3000000]
+            self.assertGreater(len([t for t in sampleTimes if t < CONNECT_US + 1000000]), 50)
+            self.assertTrue(8 <= len(late) <= 10, late)
+            for previous, current in zip(late, late[1:]):
+                self.assertAlmostEqual(current - previous, 1000000, delta=20000)
+        # Idle buttons are only sent when they change
+        for name in ('wiimote_button', 'nunchuck_button'):
+            lastButtonUs = max(s for _, s in simulator.delivered[name])
+            self.assertLess(lastButtonUs, CONNECT_US + 3000000)
+        self.assertNotIn('gesture', results['streams'])
+        # The governor steps down while nothing is sampled
+        self.assertLess(results['meanCpuMhz'], 160)
+
+    def test_every_characteristic_reported(self):
+        results = simulate(self.firmware, LinkProfile(**LINK_PROFILES['fast']),
+                           durationS=20.0)
+        streams = results['streams']
+        self.assertEqual(set(streams), set(STREAMS) - {'hid_report'})
+        for name, stream in streams.items():
+            # Only what was still queued when the run ended is missing
+            self.assertLessEqual(stream['handedOff'] - stream['delivered'], 12, name)
+        self.assertAlmostEqual(streams['time_sync']['rateHz'], 2.0, delta=0.3)
+        self.assertGreater(streams['gesture']['handedOff'], 0)
+
+    def test_firmware_holds_reports_back_for_tx_buffers(self):
+        txBuffers = 6
+        simulator = LinkSimulator(LinkProfile(**LINK_PROFILES['default']), txBuffers=txBuffers)
+        process = self.firmware.start(8.0, LINK_PROFILES['default']['attMtu'])
+        results = simulator.run(process)
+        self.assertGreater(results['noTxBuffer'], 0)
+        self.assertEqual(results['saturated'], 0)
+        # The loop never waits on the link, so it keeps passing every few
+        # hundred us with the link saturated
+        self.assertGreater(simulator.firmwareStats['passes'], 8.0 * 5000)
+        # Held back reports take turns, so no characteristic is starved
+        streams = results['streams']
+        self.assertGreater(streams['nunchuck_sensor']['rateHz'], 0.8 * streams['wiimote_sensor']['rateHz'])
+        self.assertEqual(streams['gesture']['handedOff'], streams['gesture']['delivered'])
+        # Only notified with a free buffer: a sample takes up to two LL
+        # packets, and time sync responses don't wait
+        self.assertLessEqual(results['maxQueuedPackets'], txBuffers + 2)
+
+
+if __name__ == '__main__':
+    unittest.main()
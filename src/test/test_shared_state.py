@@ -0,0 +1,117 @@
+"""
+File: test_shared_state.py
+Description: Tests the shared memory channel between the BLE ingest process
+             and its consumers, including consumers in other processes. Run
+             through run_tests.py, or with python -m unittest from
+             src/python.
+Author: Humza Ali
+"""
+
+import os
+import subprocess
+import sys
+import time
+import unittest
+from multiprocessing import shared_memory
+
+from shared_state import ControllerSample, SharedControllerState, attachSharedMemory
+
+PYTHON_DIR = os.path.dirname(sys.modules['shared_state'].__file__)
+
+# Reads slot 0 in another process and prints its buttons, like a
+# --mode output process would
+CONSUMER_SCRIPT = """
+import sys
+sys.path.insert(0, sys.argv[1])
+from shared_state import SharedControllerState
+state = SharedControllerState(sys.argv[2])
+sequence, sample = state.read(0)
+print(sample.buttons1)
+state.close()
+"""
+
+
+def regionExists(name):
+    """ Indicates whether a shared memory region exists, without tracking it. """
+    try:
+        attachSharedMemory(name).close()
+    except FileNotFoundError:
+        return False
+    return True
+
+
+class TestSharedState(unittest.TestCase):
+
+    def setUp(self):
+        self.name = f"pymote_test_{os.getpid()}_{self._testMethodName}"[:30]
+        self.owner = SharedControllerState(self.name, 2, create=True)
+
+    def tearDown(self):
+        self.owner.close()
+
+    def sample(self, buttons1):
+        sample = ControllerSample()
+        sample.buttons1 = buttons1
+        sample.joystickData = (12, 240)
+        sample.accelData = (0.5, -0.25, 1.0)
+        sample.motionTimestamp = 123456789
+        return sample
+
+    def test_read_back(self):
+        self.owner.write(1, self.sample(0x5A))
+        consumer = SharedControllerState(self.name, 2)
+        try:
+            sequence, sample = consumer.read(1)
+            self.assertEqual(sequence, 2)
+            self.assertEqual(sample.buttons1, 0x5A)
+            self.assertEqual(sample.joystickData, (12, 240))
+            self.assertEqual(sample.accelData, (0.5, -0.25, 1.0))
+            self.assertIsNone(sample.gyroData)
+            self.assertEqual(sample.motionTimestamp, 123456789)
+            # Slots don't share data
+            self.assertEqual(consumer.sequence(0), 0)
+        finally:
+            consumer.close()
+
+    def test_consumer_process_exit_keeps_region(self):
+        # A consumer process exiting must not remove the ingest process's
+        # region, whichever way it detaches
+        self.owner.write(0, self.sample(0x21))
+        for _ in range(2):
+            output = subprocess.run([sys.executable, '-c', CONSUMER_SCRIPT,
+                                     PYTHON_DIR, self.name],
+                                    check=True, capture_output=True, text=True)
+            self.assertEqual(output.stdout.strip(), str(0x21))
+            self.assertNotIn('leaked', output.stderr)
+            # The resource tracker of the consumer cleans up after it exits
+            time.sleep(0.2)
+            self.assertTrue(regionExists(self.name))
+        consumer = SharedControllerState(self.name, 2)
+        self.assertEqual(consumer.read(0)[1].buttons1, 0x21)
+        consumer.close()
+
+    def test_owner_close_tolerates_missing_region(self):
+        other = shared_memory.SharedMemory(name=self.name)
+        other.close()
+        other.unlink()
+        self.owner.close()
+        self.assertFalse(regionExists(self.name))
+        # tearDown closes again
+        self.owner = SharedControllerState(self.name, 2, create=True)
+
+    def test_owner_close_removes_region(self):
+        self.owner.close()
+        self.assertFalse(regionExists(self.name))
+        self.owner = SharedControllerState(self.name, 2, create=True)
+
+    def test_stale_region_is_reused(self):
+        # A region left behind by a previous run is cleared and reused
+        self.owner.write(0, self.sample(0x7F))
+        self.owner.owner = False
+        self.owner.close()
+        self.owner = SharedControllerState(self.name, 2, create=True)
+        self.assertEqual(self.owner.sequence(0), 0)
+
+
+if __name__ == '__main__':
+    unittest.main()
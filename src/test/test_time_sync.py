@@ -0,0 +1,193 @@
+"""
+File: test_time_sync.py
+Description: Drives time_sync.ClockSync with a simulated device clock that
+             has an offset, a drift, wraps at 32 bits, and is reached over a
+             link with jittery and asymmetric delays. Run through
+             run_tests.py, or with python -m unittest from src/python.
+Author: Humza Ali
+"""
+
+import random
+import unittest
+
+from time_sync import ClockSync, DEVICE_CLOCK_WRAP
+
+
+class SimulatedLink(object):
+    """
+    Device clock and BLE link used to run time sync exchanges.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, seed, offsetUs, driftPpm, upDelayUs, downDelayUs,
+                 jitterUs=7500, startHostUs=1000000000):
+        """
+        Initializes the simulated link.
+
+        Params:
+            seed (int): Seed of the delay jitter.
+            offsetUs (int): Device time when the host time is startHostUs.
+            driftPpm (float): How much faster the device clock runs, in ppm.
+            upDelayUs (int): Minimum host to device delay, in us.
+            downDelayUs (int): Minimum device to host delay, in us.
+            jitterUs (int): Delays vary by up to this much, e.g. a
+                            connection interval, in us.
+            startHostUs (int): Host time of the first exchange, in us.
+        """
+        self.random = random.Random(seed)
+        self.offsetUs = offsetUs
+        self.rate = 1.0 + driftPpm * 1e-6
+        self.upDelayUs = upDelayUs
+        self.downDelayUs = downDelayUs
+        self.jitterUs = jitterUs
+        self.startHostUs = startHostUs
+        self.hostUs = startHostUs
+        self.rtts = []
+
+    def deviceTime(self, hostUs):
+        """ Returns the unwrapped device time at a host time, in us. """
+        return self.offsetUs + int((hostUs - self.startHostUs) * self.rate)
+
+    def delay(self, minimumUs):
+        """ Returns a link delay, mostly close to its minimum. """
+        if self.jitterUs == 0:
+            return minimumUs
+        return minimumUs + int(self.random.expovariate(4.0 / self.jitterUs))
+
+    def exchange(self, clockSync, periodUs=500000):
+        """ Runs one exchange and advances the host time by a period. """
+        t1 = self.hostUs
+        receiveUs = t1 + self.delay(self.upDelayUs)
+        transmitUs = receiveUs + self.random.randint(50, 300)
+        t4 = transmitUs + self.delay(self.downDelayUs)
+        t2 = self.deviceTime(receiveUs)
+        t3 = self.deviceTime(transmitUs)
+        self.rtts.append((t4 - t1) - (t3 - t2))
+        clockSync.addExchange(t1, t2 % DEVICE_CLOCK_WRAP, t3 % DEVICE_CLOCK_WRAP, t4)
+        self.hostUs += periodUs
+
+
+class TestClockSync(unittest.TestCase):
+
+    def run_link(self, link, clockSync, exchanges):
+        for _ in range(exchanges):
+            link.exchange(clockSync)
+
+    def assert_maps(self, link, clockSync, toleranceUs):
+        """ Checks device times around the last exchange map back to the host. """
+        for backUs in (0, 1000000, 5000000, 10000000):
+            hostUs = link.hostUs - backUs
+            deviceUs = link.deviceTime(hostUs) % DEVICE_CLOCK_WRAP
+            self.assertLessEqual(abs(clockSync.toHostTime(deviceUs) - hostUs), toleranceUs)
+
+    def test_not_synced_before_min_exchanges(self):
+        clockSync = ClockSync(minExchanges=4)
+        link = SimulatedLink(1, 123456789, 0.0, 3750, 3750)
+        self.run_link(link, clockSync, 3)
+        self.assertIsNone(clockSync.toHostTime(link.deviceTime(link.hostUs)))
+        metrics = clockSync.metrics()
+        self.assertFalse(metrics['synced'])
+        self.assertEqual(metrics['exchanges'], 3)
+        self.assertIsNone(metrics['residualUs'])
+        link.exchange(clockSync)
+        self.assertTrue(clockSync.metrics()['synced'])
+
+    def test_offset_and_drift_without_jitter(self):
+        # Crystal tolerance is +/-40 ppm, so both clocks can be 40 ppm off
+        for driftPpm in (80.0, -80.0, 0.0):
+            with self.subTest(driftPpm=driftPpm):
+                clockSync = ClockSync()
+                link = SimulatedLink(1, 123456789, driftPpm, 3750, 3750, jitterUs=0)
+                self.run_link(link, clockSync, 20)
+                metrics = clockSync.metrics()
+                self.assertAlmostEqual(metrics['driftPpm'], driftPpm, delta=0.5)
+                # Offset at the reference point of the fit
+                deviceRef = clockSync.deviceRef
+                hostRef = link.startHostUs + (deviceRef - link.offsetUs) / link.rate
+                self.assertAlmostEqual(metrics['offsetUs'], hostRef - deviceRef, delta=200.0)
+                self.assert_maps(link, clockSync, 200)
+
+    def test_offset_and_drift(self):
+        # With a connection interval of jitter the drift is only resolved to
+        # tens of ppm over the 32 s window, which still keeps samples within
+        # a millisecond. The bounds hold over 200 seeds.
+        for seed, driftPpm in ((1, 80.0), (2, -80.0), (3, 20.0)):
+            with self.subTest(seed=seed, driftPpm=driftPpm):
+                clockSync = ClockSync()
+                link = SimulatedLink(seed, 123456789, driftPpm, 3750, 3750)
+                self.run_link(link, clockSync, 120)
+                metrics = clockSync.metrics()
+                self.assertAlmostEqual(metrics['driftPpm'], driftPpm, delta=40.0)
+                deviceRef = clockSync.deviceRef
+                hostRef = link.startHostUs + (deviceRef - link.offsetUs) / link.rate
+                self.assertAlmostEqual(metrics['offsetUs'], hostRef - deviceRef, delta=1000.0)
+                self.assert_maps(link, clockSync, 1000)
+
+    def test_asymmetric_delay(self):
+        # The exchange can't tell a longer downlink from an offset, so the
+        # estimate is off by half the asymmetry
+        upDelayUs, downDelayUs = 2000, 12000
+        clockSync = ClockSync()
+        link = SimulatedLink(4, 5000000, 40.0, upDelayUs, downDelayUs, jitterUs=0)
+        self.run_link(link, clockSync, 20)
+        biasUs = (downDelayUs - upDelayUs) / 2.0
+        for backUs in (0, 5000000):
+            hostUs = link.hostUs - backUs
+            errorUs = clockSync.toHostTime(link.deviceTime(hostUs)) - hostUs
+            self.assertAlmostEqual(errorUs, biasUs, delta=200.0)
+        self.assertAlmostEqual(clockSync.metrics()['driftPpm'], 40.0, delta=0.5)
+
+    def test_wrap(self):
+        # Start 10 s before micros() wraps and run past it. The estimate
+        # must match a run of the same link that doesn't wrap.
+        clockSync = ClockSync()
+        link = SimulatedLink(5, DEVICE_CLOCK_WRAP - 10000000, 50.0, 3750, 3750)
+        self.run_link(link, clockSync, 60)
+        referenceSync = ClockSync()
+        referenceLink = SimulatedLink(5, 1000000, 50.0, 3750, 3750)
+        self.run_link(referenceLink, referenceSync, 60)
+        self.assertEqual(clockSync.deviceWraps, 1)
+        self.assertAlmostEqual(clockSync.driftPpm(), referenceSync.driftPpm(), places=6)
+        self.assert_maps(link, clockSync, 1000)
+        for backUs in (0, 10000000, 25000000):
+            hostUs = link.hostUs - backUs
+            self.assertAlmostEqual(clockSync.toHostTime(link.deviceTime(hostUs) % DEVICE_CLOCK_WRAP),
+                                   referenceSync.toHostTime(referenceLink.deviceTime(hostUs)),
+                                   delta=1)
+        # A sample stamped before the wrap but mapped after it
+        hostUs = link.startHostUs + 5000000
+        deviceUs = link.deviceTime(hostUs)
+        self.assertLess(deviceUs, DEVICE_CLOCK_WRAP)
+        self.assertLessEqual(abs(clockSync.toHostTime(deviceUs) - hostUs), 1000)
+
+    def test_metrics(self):
+        clockSync = ClockSync(windowSize=32)
+        link = SimulatedLink(6, 0, 0.0, 3750, 3750)
+        self.run_link(link, clockSync, 40)
+        metrics = clockSync.metrics()
+        self.assertEqual(set(metrics), {'synced', 'exchanges', 'offsetUs', 'driftPpm',
+                                        'lastRttUs', 'minRttUs', 'residualUs'})
+        self.assertTrue(metrics['synced'])
+        self.assertEqual(metrics['exchanges'], 32)
+        self.assertEqual(metrics['lastRttUs'], link.rtts[-1])
+        self.assertEqual(metrics['minRttUs'], min(link.rtts))
+        self.assertGreaterEqual(metrics['minRttUs'], 2 * 3750)
+        # The fit uses the lowest round trip half, whose midpoints only
+        # scatter by a fraction of the jitter
+        self.assertLess(metrics['residualUs'], 1000.0)
+
+    def test_reset(self):
+        clockSync = ClockSync()
+        link = SimulatedLink(7, 0, 0.0, 3750, 3750)
+        self.run_link(link, clockSync, 10)
+        clockSync.reset()
+        metrics = clockSync.metrics()
+        self.assertFalse(metrics['synced'])
+        self.assertEqual(metrics['exchanges'], 0)
+        self.assertIsNone(metrics['minRttUs'])
+
+
+if __name__ == '__main__':
+    unittest.main()
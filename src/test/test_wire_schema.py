@@ -0,0 +1,159 @@
+"""
+File: test_wire_schema.py
+Description: Round trips every wire schema message between the firmware and
+             the host. A host program compiled against wire_schema.h fills
+             each payload struct and prints its bytes, which the generated
+             Python decoders must read back and the encoders reproduce. Run
+             through run_tests.py, or with python -m unittest from
+             src/python.
+Author: Humza Ali
+"""
+
+import json
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import unittest
+
+import wire_schema
+
+TEST_DIR = os.path.dirname(os.path.abspath(__file__))
+SOURCE_DIR = os.path.dirname(TEST_DIR)
+SCHEMA_DIR = os.path.join(SOURCE_DIR, 'schema')
+sys.path.insert(0, SCHEMA_DIR)
+
+from gen_wire_schema import FIELD_TYPES, SCHEMA_FILE, camelCase, generateCpp, generatePython
+
+
+def fieldValues(message, pattern):
+    """
+    Returns test values for the fields of a message.
+
+    Params:
+        message (dict): Message from the schema.
+        pattern (int): 0 for distinct values per field, 1 for the largest
+                       values, 2 for the smallest.
+
+    Return:
+        (list): One value per field, as the host decodes it.
+    """
+    values = []
+    for i, field in enumerate(message['fields']):
+        fieldType = field['type']
+        if fieldType == 'f32':
+            value = (-1.5 + 0.25 * i, 3.4e38, -1.0e-3)[pattern]
+            # Decoded values are single precision
+            value = struct.unpack('<f', struct.pack('<f', value))[0]
+        else:
+            bits = int(fieldType[1:])
+            signed = fieldType[0] == 'i'
+            if pattern == 0:
+                # A different byte in every position, to catch swapped bytes
+                value = int.from_bytes(bytes((0x10 * (i + 1) + b) & 0x7F
+                                             for b in range(bits // 8)), 'little')
+                value = -value if signed else value
+            elif pattern == 1:
+                value = (1 << (bits - 1)) - 1 if signed else (1 << bits) - 1
+            else:
+                value = -(1 << (bits - 1)) if signed else 0
+        values.append(value)
+    return values
+
+
+def cppLiteral(fieldType, value):
+    """ Returns a C++ literal for a field value. """
+    if fieldType == 'f32':
+        return f"(float){value:.17g}"
+    if value < 0:
+        # The most negative value can't be written as a negated literal
+        return f"({FIELD_TYPES[fieldType][0]})({value + 1}LL - 1LL)"
+    return f"({FIELD_TYPES[fieldType][0]}){value}ULL"
+
+
+def generateRoundTripProgram(schema):
+    """
+    Generates a host program that fills every message with the test values
+    and prints its name, pattern and bytes in hex, one per line.
+    """
+    lines = ['#include <cstdio>',
+             '#include <cstring>',
+             '#include "wire_schema.h"',
+             '',
+             'static void dump(const char* name, int pattern, const void* pData, size_t length)',
+             '{',
+             '    printf("%s %d ", name, pattern);',
+             '    for (size_t i = 0; i < length; i++) {',
+             '        printf("%02x", ((const unsigned char*)pData)[i]);',
+             '    }',
+             '    printf("\\n");',
+             '}',
+             '',
+             'int main(void)',
+             '{']
+    for message in schema['messages']:
+        for pattern in range(3):
+            lines.append('    {')
+            lines.append(f"        {message['name']}_t payload;")
+            lines.append('        memset(&payload, 0xEE, sizeof(payload));')
+            for field, value in zip(message['fields'], fieldValues(message, pattern)):
+                lines.append(f"        payload.{field['name']} = {cppLiteral(field['type'], value)};")
+            lines.append(f"        dump(\"{message['name']}\", {pattern}, &payload, sizeof(payload));")
+            lines.append('    }')
+    lines += ['    return 0;', '}', '']
+    return '\n'.join(lines)
+
+
+class TestWireSchema(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        with open(SCHEMA_FILE) as f:
+            cls.schema = json.load(f)
+
+    def test_generated_files_up_to_date(self):
+        with open(os.path.join(SOURCE_DIR, 'include', 'wire_schema.h')) as f:
+            self.assertEqual(f.read(), generateCpp(self.schema) + '\n')
+        with open(os.path.join(SOURCE_DIR, 'python', 'wire_schema.py')) as f:
+            self.assertEqual(f.read(), generatePython(self.schema))
+
+    def test_round_trip(self):
+        compiler = os.environ.get('CXX', 'g++')
+        if shutil.which(compiler) == None:
+            self.skipTest(f"{compiler} not found")
+        with tempfile.TemporaryDirectory() as buildDir:
+            source = os.path.join(buildDir, 'wire_schema_round_trip.cpp')
+            binary = os.path.join(buildDir, 'wire_schema_round_trip')
+            with open(source, 'w') as f:
+                f.write(generateRoundTripProgram(self.schema))
+            subprocess.run([compiler, '-std=gnu++11', '-Wall', '-Werror',
+                            '-I' + os.path.join(SOURCE_DIR, 'include'),
+                            source, '-o', binary], check=True)
+            output = subprocess.run([binary], check=True, capture_output=True,
+                                    text=True).stdout
+
+        payloads = {}
+        for line in output.splitlines():
+            name, pattern, data = line.split()
+            payloads[(name, int(pattern))] = bytes.fromhex(data)
+        for message in self.schema['messages']:
+            name = message['name']
+            constant = name.upper()
+            decode = getattr(wire_schema, 'decode' + camelCase(name))
+            encode = getattr(wire_schema, 'encode' + camelCase(name))
+            for pattern in range(3):
+                with self.subTest(message=name, pattern=pattern):
+                    data = payloads[(name, pattern)]
+                    values = fieldValues(message, pattern)
+                    self.assertEqual(len(data), getattr(wire_schema, constant + '_LENGTH_BYTES'))
+                    self.assertEqual(list(decode(data)), values)
+                    self.assertEqual(encode(*values), data)
+                    # Decoding in place from a larger buffer
+                    buffer = memoryview(b'\x55' * 3 + data + b'\x55')
+                    self.assertEqual(list(decode(buffer, 3)), values)
+
+
+if __name__ == '__main__':
+    unittest.main()
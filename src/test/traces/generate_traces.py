@@ -0,0 +1,384 @@
+"""
+File: generate_traces.py
+Description: Generates the labeled IMU traces replayed by the host tests.
+             No recordings from the device are available, so each trace is
+             produced by a rigid body model of a hand-held controller and a
+             model of the MPU sensors. Motion is integrated at 1 kHz. The
+             sensors add bias, scale error, noise, their low pass filter,
+             clipping to the configured range and quantization. Samples are
+             taken every 10 ms with scheduling jitter, like the firmware loop.
+             The traces use the same CSV format as a capture from the device,
+             so a recording can replace them:
+
+                 timestampUs,ax,ay,az,gx,gy,gz,label
+
+             Acceleration is in g and rotation rate in dps. The label column
+             marks the first sample of each everyday movement (MOTION) in
+             still_motion.csv. In gestures.csv it marks the first sample of
+             each gesture (SWING_START, SHAKE, FLICK) and the sample a swing
+             peaks at (SWING_PEAK), so the gesture detector is checked
+             against motion it wasn't tuned on. Regenerate the checked-in
+             traces with:
+
+                 python generate_traces.py
+
+Author: Humza Ali
+"""
+
+import argparse
+import csv
+import math
+import os
+import random
+
+TRACE_DIR = os.path.dirname(os.path.abspath(__file__))
+
+# Standard gravity, in m/s^2
+GRAVITY = 9.80665
+# Step of the motion integration, in s
+PHYSICS_STEP_S = 0.001
+# Sampling period of the firmware loop, in us
+SAMPLE_PERIOD_US = 10000
+# Largest deviation of a sample from its scheduled time, in us
+SAMPLE_JITTER_US = 400
+# Device time of the first sample, in us
+START_TIME_US = 2000000
+# Cutoff of the sensor low pass filter, in Hz
+SENSOR_FILTER_HZ = 44.0
+
+
+def cross(a, b):
+    return (a[1] * b[2] - a[2] * b[1],
+            a[2] * b[0] - a[0] * b[2],
+            a[0] * b[1] - a[1] * b[0])
+
+
+def normalize(v):
+    norm = math.sqrt(sum(c * c for c in v))
+    return tuple(c / norm for c in v)
+
+
+def quaternionMultiply(a, b):
+    return (a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3],
+            a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2],
+            a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1],
+            a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0])
+
+
+def toBody(q, v):
+    """ Rotates a world frame vector into the body frame of orientation q. """
+    conjugate = (q[0], -q[1], -q[2], -q[3])
+    rotated = quaternionMultiply(quaternionMultiply(conjugate, (0.0,) + tuple(v)), q)
+    return rotated[1:]
+
+
+def minimumJerk(phase):
+    """ Velocity profile of a minimum jerk movement, integrating to 1 over [0, 1]. """
+    return 30.0 * phase * phase * (1.0 - phase) * (1.0 - phase)
+
+
+class SensorModel(object):
+    """
+    Accelerometer and gyroscope of an MPU, as configured by the firmware.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, rng, accelRangeG, gyroRangeDps=2000):
+        self.random = rng
+        self.accelRangeG = accelRangeG
+        self.gyroRangeDps = gyroRangeDps
+        self.accelLsb = accelRangeG / 32768.0
+        self.gyroLsb = gyroRangeDps / 32768.0
+        self.accelBias = [rng.gauss(0.0, 0.015) for _ in range(3)]
+        self.accelScale = [1.0 + rng.gauss(0.0, 0.01) for _ in range(3)]
+        self.gyroBias = [rng.gauss(0.0, 0.6) for _ in range(3)]
+        self.filterWeight = 1.0 - math.exp(-2.0 * math.pi * SENSOR_FILTER_HZ * PHYSICS_STEP_S)
+        self.accel = None
+        self.gyro = None
+
+    def step(self, accelG, gyroDps):
+        """ Runs the sensor low pass filter over one integration step. """
+        if self.accel == None:
+            self.accel = list(accelG)
+            self.gyro = list(gyroDps)
+            return
+        for i in range(3):
+            self.accel[i] += (accelG[i] - self.accel[i]) * self.filterWeight
+            self.gyro[i] += (gyroDps[i] - self.gyro[i]) * self.filterWeight
+
+    def read(self):
+        """ Returns a clipped and quantized sample of the filtered signals. """
+        def convert(value, lsb, rangeValue):
+            value = max(-rangeValue, min(rangeValue - lsb, value))
+            return round(value / lsb) * lsb
+        accel = [convert(self.accel[i] * self.accelScale[i] + self.accelBias[i] +
+                         self.random.gauss(0.0, 0.004), self.accelLsb, self.accelRangeG)
+                 for i in range(3)]
+        gyro = [convert(self.gyro[i] + self.gyroBias[i] + self.random.gauss(0.0, 0.1),
+                        self.gyroLsb, self.gyroRangeDps)
+                for i in range(3)]
+        return accel, gyro
+
+
+class Session(object):
+    """
+    Hand-held controller moved through a sequence of segments. Each segment
+    sets the body rotation rate, the world acceleration of the grip and the
+    offset of the IMU from the center of rotation for every integration
+    step.
+
+    Attributes:
+        None
+    """
+
+    def __init__(self, seed, accelRangeG):
+        self.random = random.Random(seed)
+        self.sensor = SensorModel(self.random, accelRangeG)
+        # Body to world orientation, starts lying flat
+        self.orientation = (1.0, 0.0, 0.0, 0.0)
+        self.timeS = 0.0
+        self.nextSampleS = 0.0
+        self.sampleIndex = 0
+        self.pendingLabel = ''
+        self.lastRate = (0.0, 0.0, 0.0)
+        self.rows = []
+
+    def label(self, name):
+        """ Labels the next sample taken. """
+        self.pendingLabel = name
+
+    def step(self, rateDps, linear=(0.0, 0.0, 0.0), lever=(0.0, 0.0, 0.0)):
+        """
+        Advances the model by one integration step.
+
+        Params:
+            rateDps (tuple): Body rotation rate, in dps.
+            linear (tuple): World acceleration of the center of rotation, in m/s^2.
+            lever (tuple): Body frame offset of the IMU from the center of
+                           rotation, in m.
+        """
+        rate = tuple(math.radians(r) for r in rateDps)
+        angular = tuple((r - l) / PHYSICS_STEP_S for r, l in zip(rate, self.lastRate))
+        self.lastRate = rate
+        # Specific force at the IMU: grip acceleration minus gravity, plus
+        # the tangential and centripetal terms of the rotation
+        specific = toBody(self.orientation, (linear[0], linear[1], linear[2] + GRAVITY))
+        tangential = cross(angular, lever)
+        centripetal = cross(rate, cross(rate, lever))
+        accelG = tuple((s + t + c) / GRAVITY
+                       for s, t, c in zip(specific, tangential, centripetal))
+        self.sensor.step(accelG, rateDps)
+
+        norm = math.sqrt(sum(r * r for r in rate))
+        if norm > 0.0:
+            half = norm * PHYSICS_STEP_S / 2.0
+            delta = (math.cos(half),) + tuple(r / norm * math.sin(half) for r in rate)
+            self.orientation = normalize(quaternionMultiply(self.orientation, delta))
+
+        self.timeS += PHYSICS_STEP_S
+        if self.timeS >= self.nextSampleS:
+            accel, gyro = self.sensor.read()
+            jitterUs = self.random.randint(-SAMPLE_JITTER_US, SAMPLE_JITTER_US)
+            timestampUs = START_TIME_US + self.sampleIndex * SAMPLE_PERIOD_US + jitterUs
+            self.rows.append([timestampUs] + accel + gyro + [self.pendingLabel])
+            self.pendingLabel = ''
+            self.sampleIndex += 1
+            self.nextSampleS = self.sampleIndex * SAMPLE_PERIOD_US / 1000000.0
+
+    def steps(self, durationS):
+        return range(max(1, int(durationS / PHYSICS_STEP_S)))
+
+    def randomAxis(self, horizontal=False):
+        """ Returns a random unit axis, in the body XY plane if horizontal. """
+        while True:
+            axis = [self.random.gauss(0.0, 1.0) for _ in range(3)]
+            if horizontal:
+                axis[2] *= 0.2
+            if sum(a * a for a in axis) > 0.01:
+                return normalize(axis)
+
+    def restOnTable(self, durationS):
+        """ Lying still, only sensor noise. """
+        for _ in self.steps(durationS):
+            self.step((0.0, 0.0, 0.0))
+
+    def restInHand(self, durationS):
+        """ Held still: physiological tremor and a slow drift of the hand. """
+        tremorHz = self.random.uniform(8.0, 12.0)
+        tremorDps = self.random.uniform(0.3, 0.9)
+        driftHz = self.random.uniform(0.2, 0.5)
+        driftDps = self.random.uniform(0.3, 0.8)
+        axis = self.randomAxis()
+        for n in self.steps(durationS):
+            t = n * PHYSICS_STEP_S
+            rate = tremorDps * math.sin(2 * math.pi * tremorHz * t) + \
+                   driftDps * math.sin(2 * math.pi * driftHz * t)
+            linear = 0.03 * math.sin(2 * math.pi * tremorHz * t + 1.0)
+            self.step(tuple(a * rate for a in axis), (linear, 0.0, 0.0))
+
+    def rest(self, durationS):
+        if self.random.random() < 0.5:
+            self.restOnTable(durationS)
+        else:
+            self.restInHand(durationS)
+
+    def tilt(self):
+        """ Slow turn of the wrist to a new orientation. """
+        angleDeg = self.random.uniform(20.0, 70.0) * self.random.choice((-1.0, 1.0))
+        durationS = self.random.uniform(0.6, 1.4)
+        axis = self.randomAxis(horizontal=True)
+        count = len(self.steps(durationS))
+        for n in range(count):
+            rate = angleDeg / durationS * minimumJerk((n + 0.5) / count)
+            self.step(tuple(a * rate for a in axis), lever=(0.0, 0.08, 0.0))
+
+    def point(self):
+        """ Aiming at the screen: small corrections about the vertical axes. """
+        durationS = self.random.uniform(1.0, 2.5)
+        segments = self.random.randint(3, 6)
+        for _ in range(segments):
+            angleDeg = self.random.uniform(3.0, 12.0) * self.random.choice((-1.0, 1.0))
+            segmentS = durationS / segments
+            axis = normalize((self.random.gauss(0.0, 0.3), self.random.gauss(0.0, 0.3), 1.0))
+            count = len(self.steps(segmentS))
+            for n in range(count):
+                rate = angleDeg / segmentS * minimumJerk((n + 0.5) / count)
+                self.step(tuple(a * rate for a in axis), lever=(0.0, 0.15, 0.0))
+
+    def pickUp(self):
+        """ Lifting the controller off the table and putting it down again. """
+        heightM = self.random.uniform(0.1, 0.3)
+        for direction in (1.0, -1.0):
+            durationS = self.random.uniform(0.5, 0.9)
+            count = len(self.steps(durationS))
+            axis = self.randomAxis(horizontal=True)
+            tiltDeg = self.random.uniform(5.0, 20.0) * direction
+            for n in range(count):
+                phase = (n + 0.5) / count
+                # Derivative of the minimum jerk velocity profile
+                jerkPhase = 60.0 * phase * (1.0 - phase) * (1.0 - 2.0 * phase)
+                lift = direction * heightM * jerkPhase / (durationS * durationS)
+                rate = tiltDeg / durationS * minimumJerk(phase)
+                self.step(tuple(a * rate for a in axis), (0.0, 0.0, lift))
+            self.restInHand(self.random.uniform(0.2, 0.5))
+
+    def swing(self):
+        """ Forearm swing about the elbow. """
+        durationS = self.random.uniform(0.25, 0.5)
+        angleDeg = self.random.uniform(70.0, 150.0)
+        axis = self.randomAxis(horizontal=True)
+        lever = (0.0, self.random.uniform(0.2, 0.35), 0.0)
+        count = len(self.steps(durationS))
+        for n in range(count):
+            rate = angleDeg / durationS * minimumJerk((n + 0.5) / count)
+            self.step(tuple(a * rate for a in axis), lever=lever)
+        # Bring it back slowly
+        count = len(self.steps(1.0))
+        for n in range(count):
+            rate = -angleDeg * minimumJerk((n + 0.5) / count)
+            self.step(tuple(a * rate for a in axis), lever=lever)
+
+    def gestureSwing(self):
+        """ Fast forearm swing, as when swinging a racket or a sword. """
+        durationS = self.random.uniform(0.15, 0.35)
+        angleDeg = self.random.uniform(90.0, 160.0)
+        axis = self.randomAxis(horizontal=True)
+        lever = (0.0, self.random.uniform(0.2, 0.35), 0.0)
+        count = len(self.steps(durationS))
+        self.label('SWING_START')
+        for n in range(count):
+            if n == count // 2:
+                # Minimum jerk movements are fastest half way through
+                self.label('SWING_PEAK')
+            rate = angleDeg / durationS * minimumJerk((n + 0.5) / count)
+            self.step(tuple(a * rate for a in axis), lever=lever)
+        # Bring it back slowly, below the swing threshold
+        count = len(self.steps(1.5))
+        for n in range(count):
+            rate = -angleDeg / 1.5 * minimumJerk((n + 0.5) / count)
+            self.step(tuple(a * rate for a in axis), lever=lever)
+
+    def gestureShake(self):
+        """ Shaking the controller back and forth along one direction. """
+        frequencyHz = self.random.uniform(4.0, 7.0)
+        amplitude = self.random.uniform(1.2, 2.0) * GRAVITY
+        durationS = self.random.uniform(0.8, 1.2)
+        direction = self.randomAxis(horizontal=True)
+        wobbleAxis = self.randomAxis()
+        wobbleDps = self.random.uniform(10.0, 40.0)
+        self.label('SHAKE')
+        for n in self.steps(durationS):
+            phase = 2 * math.pi * frequencyHz * n * PHYSICS_STEP_S
+            linear = tuple(d * amplitude * math.sin(phase) for d in direction)
+            # The wrist turns a little with every stroke
+            rate = wobbleDps * math.cos(phase)
+            self.step(tuple(a * rate for a in wobbleAxis), linear)
+
+    def gestureFlick(self):
+        """ Short jab of the controller, stopped by the wrist. """
+        amplitude = self.random.uniform(3.5, 5.0) * GRAVITY
+        direction = self.randomAxis(horizontal=True)
+        count = len(self.steps(0.04))
+        self.label('FLICK')
+        for n in range(count):
+            value = amplitude * math.sin(math.pi * (n + 0.5) / count)
+            self.step((0.0, 0.0, 0.0), tuple(d * value for d in direction))
+        count = len(self.steps(0.08))
+        for n in range(count):
+            value = -0.6 * GRAVITY * math.sin(math.pi * (n + 0.5) / count)
+            self.step((0.0, 0.0, 0.0), tuple(d * value for d in direction))
+
+    def gestureSession(self, gestures):
+        """ Swings, shakes and flicks, each followed by a rest. """
+        self.restOnTable(1.0)
+        for _ in range(gestures):
+            self.random.choice((self.gestureSwing, self.gestureShake, self.gestureFlick))()
+            self.rest(self.random.uniform(0.8, 1.5))
+        return self.rows
+
+    def stillMotionSession(self, movements):
+        """
+        Rests long enough for a controller to be considered still, each
+        followed by an everyday movement.
+        """
+        self.restOnTable(3.0)
+        for _ in range(movements):
+            self.label('MOTION')
+            self.random.choice((self.tilt, self.point, self.pickUp, self.swing))()
+            self.rest(self.random.uniform(2.6, 3.6))
+        return self.rows
+
+
+def writeTrace(path, rows):
+    """ Writes a trace to a CSV file. """
+    with open(path, 'w', newline='') as f:
+        writer = csv.writer(f, lineterminator='\n')
+        writer.writerow(['timestampUs', 'ax', 'ay', 'az', 'gx', 'gy', 'gz', 'label'])
+        for row in rows:
+            writer.writerow([row[0]] + [f"{v:.4f}" for v in row[1:4]] +
+                            [f"{v:.2f}" for v in row[4:7]] + [row[7]])
+
+
+# Checked-in traces: file name, seed, accelerometer range in g, generator
+TRACES = [
+    ('still_motion.csv', 26, 2, lambda session: session.stillMotionSession(12)),
+    ('gestures.csv', 38, 4, lambda session: session.gestureSession(60)),
+]
+
+
+def main():
+    """ Main function handler. """
+    parser = argparse.ArgumentParser(description="Generates the host test IMU traces")
+    parser.add_argument('--output-dir', default=TRACE_DIR,
+                        help='directory to write the traces to')
+    args = parser.parse_args()
+    for name, seed, accelRangeG, generate in TRACES:
+        rows = generate(Session(seed, accelRangeG))
+        writeTrace(os.path.join(args.output_dir, name), rows)
+        print(f"{name}: {len(rows)} samples")
+
+
+if __name__ == '__main__':
+    main()